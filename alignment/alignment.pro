@@ -52,10 +52,14 @@ OBJECTS_DIR = obj
 
 # Input
 HEADERS += matrix.h \
+           sym_matrix.h \
            standard_align.h \
+           millepede_align.h \
            ToyModel.h \
 
 SOURCES += matrix.cpp \
+           sym_matrix.cpp \
            standard_align.cpp \
+           millepede_align.cpp \
            test.cpp \
            ToyModel.cpp \
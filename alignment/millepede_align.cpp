@@ -0,0 +1,394 @@
+#include "millepede_align.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+namespace tracking_dev
+{
+    // 4x4 Cholesky for the local system of one track, false if not
+    // positive definite
+    static bool cholesky_local(const double (&A)[4][4], double (&L)[4][4])
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            double d = A[j][j];
+            for (int k = 0; k < j; k++)
+                d -= L[j][k] * L[j][k];
+            if (!(d > 0))
+                return false;
+            L[j][j] = std::sqrt(d);
+
+            for (int i = j + 1; i < 4; i++)
+            {
+                double s = A[i][j];
+                for (int k = 0; k < j; k++)
+                    s -= L[i][k] * L[j][k];
+                L[i][j] = s / L[j][j];
+            }
+        }
+        return true;
+    }
+
+    // solve L L^T x = v in place
+    static void solve_local(const double (&L)[4][4], double *v)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            for (int k = 0; k < i; k++)
+                v[i] -= L[i][k] * v[k];
+            v[i] /= L[i][i];
+        }
+        for (int i = 3; i >= 0; i--)
+        {
+            for (int k = i + 1; k < 4; k++)
+                v[i] -= L[k][i] * v[k];
+            v[i] /= L[i][i];
+        }
+    }
+
+    MillepedeAlign::MillepedeAlign()
+    {
+    }
+
+    MillepedeAlign::~MillepedeAlign()
+    {
+    }
+
+    bool MillepedeAlign::LoadTracks(const char *path)
+    {
+        std::fstream f(path, std::fstream::in);
+        if (!f.is_open())
+        {
+            std::cout << "Error: cannot open file: " << path << std::endl;
+            return false;
+        }
+
+        hits.clear();
+        nlayer = 0;
+        std::string line;
+        std::vector<double> values;
+        int iline = 0;
+        while (std::getline(f, line))
+        {
+            iline++;
+            values.clear();
+            std::istringstream iss(line);
+            double v;
+            while (iss >> v)
+                values.push_back(v);
+            if (values.empty())
+                continue;
+
+            int n = static_cast<int>(values.size() / 3);
+            if (values.size() % 3 != 0 || n < 3 || (nlayer > 0 && n != nlayer))
+            {
+                std::cout << "Error: " << path << " line " << iline
+                          << ": expect " << (nlayer > 0 ? nlayer : 3) << "+ hits of x y z." << std::endl;
+                return false;
+            }
+            nlayer = n;
+
+            for (int i = 0; i < n; i++)
+                hits.push_back(hit_t{values[3 * i], values[3 * i + 1], values[3 * i + 2]});
+        }
+
+        nglobal = nlayer * NPAR_LAYER;
+        global_params.assign(nglobal, 0.);
+        delta.assign(nglobal, 0.);
+        delta_prev.assign(nglobal, 0.);
+        G.assign(nglobal * NPAR_LOCAL, 0.);
+        GinvG.assign(nglobal * NPAR_LOCAL, 0.);
+        meas.resize(2 * nlayer);
+        transformed.resize(nlayer);
+
+        std::cout << "INFO:: Millepede: loaded " << GetNtracks() << " tracks with "
+                  << nlayer << " hits from " << path << std::endl;
+        return GetNtracks() > 0;
+    }
+
+    void MillepedeAlign::Solve()
+    {
+        size_t ntracks = GetNtracks();
+        if (ntracks == 0)
+        {
+            std::cout << "Error: Millepede: no tracks loaded." << std::endl;
+            return;
+        }
+
+        size_t n = (batch_size == 0) ? ntracks : std::min(batch_size, ntracks);
+        for (int iter = 0; iter < niter; iter++)
+        {
+            size_t start = (batch_size == 0) ? 0 : (iter * n) % ntracks;
+            double chi2 = ProcessIteration(start, n);
+            std::cout << "Millepede iteration " << iter << ": chi square = " << chi2 << std::endl;
+        }
+    }
+
+    // one global fit on n tracks from start (wrapping around), the global
+    // parameters are updated with the result
+    double MillepedeAlign::ProcessIteration(size_t start, size_t n)
+    {
+        size_t ntracks = GetNtracks();
+        n = std::min(n, ntracks);
+
+        size_t dim = nglobal;
+        if (solver == Solver::Full)
+            dim += NPAR_LOCAL * n;
+        if (C.Size() != dim)
+            C.Resize(dim);
+        else
+            C.Zero();
+        b.assign(dim, 0.);
+
+        double chi2 = 0.;
+        for (size_t j = 0; j < n; j++)
+        {
+            chi2 += ProcessTrack((start + j) % ntracks);
+
+            if (solver == Solver::Full)
+                AccumulateFull(j);
+            else
+                AccumulateSchur();
+        }
+
+        // the local blocks got theirs per track
+        for (int i = 0; i < nglobal; i++)
+            C(i, i) += regularization;
+        if (solver == Solver::Full)
+        {
+            for (size_t i = nglobal; i < dim; i++)
+                C(i, i) += regularization;
+        }
+        FixParameters(C, b);
+
+        if (!C.SolveLDLT(b, solution))
+        {
+            std::cout << "Warning: Millepede: global system is singular, parameters not updated." << std::endl;
+            solution.assign(dim, 0.);
+        }
+
+        for (int i = 0; i < nglobal; i++)
+        {
+            delta[i] = step_size * solution[i];
+            if (eta > 0)
+            {
+                delta[i] = eta * delta_prev[i] + (1. - eta) * delta[i];
+                delta_prev[i] = delta[i];
+            }
+            global_params[i] -= delta[i];
+        }
+
+        return chi2;
+    }
+
+    // transform with the current global parameters, fit a straight line and
+    // fill the derivatives of every measurement, returns the track chi2
+    double MillepedeAlign::ProcessTrack(size_t itrack)
+    {
+        const hit_t *p = &hits[itrack * nlayer];
+
+        // local fit x = kx * z + bx, y = ky * z + by on the transformed hits
+        hit_t *tp = transformed.data();
+        double sz = 0, szz = 0, sx = 0, szx = 0, sy = 0, szy = 0;
+        for (int i = 0; i < nlayer; i++)
+        {
+            Transform(p[i], i, tp[i]);
+            sz += tp[i].z, szz += tp[i].z * tp[i].z;
+            sx += tp[i].x, szx += tp[i].z * tp[i].x;
+            sy += tp[i].y, szy += tp[i].z * tp[i].y;
+        }
+        double det = nlayer * szz - sz * sz;
+        double kx = (nlayer * szx - sz * sx) / det;
+        double bx = (sx - kx * sz) / nlayer;
+        double ky = (nlayer * szy - sz * sy) / det;
+        double by = (sy - ky * sz) / nlayer;
+
+        double chi2 = 0;
+        for (int i = 0; i < nlayer; i++)
+        {
+            measurement_t &mx = meas[2 * i];
+            measurement_t &my = meas[2 * i + 1];
+            mx.layer = my.layer = i;
+
+            // global derivatives use the measured hit, as in pede.py
+            mx.g[0] = 1, mx.g[1] = 0, mx.g[2] = -kx;
+            mx.g[3] = -kx * p[i].y, mx.g[4] = p[i].z + kx * p[i].x, mx.g[5] = -p[i].y;
+            my.g[0] = 0, my.g[1] = 1, my.g[2] = -ky;
+            my.g[3] = -(p[i].z + ky * p[i].y), my.g[4] = ky * p[i].x, my.g[5] = p[i].x;
+            for (int k = 0; k < NPAR_LAYER; k++)
+            {
+                if (IsFixed(i, k))
+                    mx.g[k] = my.g[k] = 0;
+            }
+
+            mx.l[0] = -tp[i].z, mx.l[1] = -1, mx.l[2] = 0, mx.l[3] = 0;
+            my.l[0] = 0, my.l[1] = 0, my.l[2] = -tp[i].z, my.l[3] = -1;
+
+            // measured - projected
+            mx.r = tp[i].x - (bx + kx * tp[i].z);
+            my.r = tp[i].y - (by + ky * tp[i].z);
+            chi2 += mx.r * mx.r + my.r * my.r;
+        }
+
+        return chi2;
+    }
+
+    // add the track to the reduced global system:
+    //     C += sum g g^T - G Gamma^-1 G^T
+    //     b += sum g r   - G Gamma^-1 beta
+    void MillepedeAlign::AccumulateSchur()
+    {
+        double gamma[4][4] = {}, beta[4] = {};
+        std::fill(G.begin(), G.end(), 0.);
+
+        for (auto &m : meas)
+        {
+            double *Gl = &G[m.layer * NPAR_LAYER * NPAR_LOCAL];
+            for (int ii = 0; ii < NPAR_LAYER; ii++)
+            {
+                for (int a = 0; a < NPAR_LOCAL; a++)
+                    Gl[ii * NPAR_LOCAL + a] += m.g[ii] * m.l[a];
+            }
+
+            for (int a = 0; a < NPAR_LOCAL; a++)
+            {
+                for (int c = 0; c < NPAR_LOCAL; c++)
+                    gamma[a][c] += m.l[a] * m.l[c];
+                beta[a] += m.l[a] * m.r;
+            }
+        }
+        for (int a = 0; a < NPAR_LOCAL; a++)
+            gamma[a][a] += regularization;
+
+        double L[4][4] = {};
+        if (!cholesky_local(gamma, L))
+        {
+            std::cout << "Warning: Millepede: singular local fit, track skipped." << std::endl;
+            return;
+        }
+
+        for (auto &m : meas)
+        {
+            int offset = m.layer * NPAR_LAYER;
+            for (int ii = 0; ii < NPAR_LAYER; ii++)
+            {
+                double *row = C.Row(offset + ii) + offset;
+                for (int jj = 0; jj <= ii; jj++)
+                    row[jj] += m.g[ii] * m.g[jj];
+                b[offset + ii] += m.g[ii] * m.r;
+            }
+        }
+
+        // Gamma^-1 G^T and Gamma^-1 beta
+        for (int k = 0; k < nglobal; k++)
+        {
+            double *x = &GinvG[k * NPAR_LOCAL];
+            std::copy(&G[k * NPAR_LOCAL], &G[k * NPAR_LOCAL] + NPAR_LOCAL, x);
+            solve_local(L, x);
+        }
+        solve_local(L, beta);
+
+        for (int k = 0; k < nglobal; k++)
+        {
+            const double *Gk = &G[k * NPAR_LOCAL];
+            if (Gk[0] == 0 && Gk[1] == 0 && Gk[2] == 0 && Gk[3] == 0)
+                continue;
+
+            double *row = C.Row(k);
+            for (int m = 0; m <= k; m++)
+            {
+                const double *Xm = &GinvG[m * NPAR_LOCAL];
+                row[m] -= Gk[0] * Xm[0] + Gk[1] * Xm[1] + Gk[2] * Xm[2] + Gk[3] * Xm[3];
+            }
+            b[k] -= Gk[0] * beta[0] + Gk[1] * beta[1] + Gk[2] * beta[2] + Gk[3] * beta[3];
+        }
+    }
+
+    // add the track to the complete system, its local parameters are
+    // at nglobal + NPAR_LOCAL * jtrack
+    void MillepedeAlign::AccumulateFull(size_t jtrack)
+    {
+        size_t local = nglobal + NPAR_LOCAL * jtrack;
+        for (auto &m : meas)
+        {
+            int offset = m.layer * NPAR_LAYER;
+            for (int ii = 0; ii < NPAR_LAYER; ii++)
+            {
+                for (int jj = 0; jj <= ii; jj++)
+                    C(offset + ii, offset + jj) += m.g[ii] * m.g[jj];
+                b[offset + ii] += m.g[ii] * m.r;
+            }
+
+            for (int a = 0; a < NPAR_LOCAL; a++)
+            {
+                for (int ii = 0; ii < NPAR_LAYER; ii++)
+                    C(local + a, offset + ii) += m.l[a] * m.g[ii];
+                for (int c = 0; c <= a; c++)
+                    C(local + a, local + c) += m.l[a] * m.l[c];
+                b[local + a] += m.l[a] * m.r;
+            }
+        }
+    }
+
+    // fixed parameters get a unit diagonal and no right hand side, their
+    // correction is 0 (pede.py uses 1e10, which would spoil the pivot
+    // tolerance of the LDLT)
+    void MillepedeAlign::FixParameters(SymMatrix &m, std::vector<double> &v) const
+    {
+        for (int l = 0; l < nlayer; l++)
+        {
+            for (int k = 0; k < NPAR_LAYER; k++)
+            {
+                if (!IsFixed(l, k))
+                    continue;
+
+                uint32_t i = l * NPAR_LAYER + k;
+                for (uint32_t j = 0; j < m.Size(); j++)
+                    m(i, j) = 0;
+                m(i, i) = 1.;
+                v[i] = 0;
+            }
+        }
+    }
+
+    bool MillepedeAlign::IsFixed(int ilayer, int ipar) const
+    {
+        if (ilayer == fixed_layer)
+            return true;
+        if (!angle_align && ipar >= 3)
+            return true;
+        return false;
+    }
+
+    // rotation first, then translation: R = [1, -az, ay; az, 1, -ax; -ay, ax, 1]
+    void MillepedeAlign::Transform(const hit_t &p, int ilayer, hit_t &out) const
+    {
+        const double *par = &global_params[ilayer * NPAR_LAYER];
+        out.x = p.x - par[5] * p.y + par[4] * p.z + par[0];
+        out.y = par[5] * p.x + p.y - par[3] * p.z + par[1];
+        out.z = -par[4] * p.x + par[3] * p.y + p.z + par[2];
+    }
+
+    void MillepedeAlign::WriteTextFile(const char *path)
+    {
+        std::fstream f(path, std::fstream::out);
+        if (!f.is_open())
+        {
+            std::cout << "Error: can't open file: " << path << std::endl;
+            return;
+        }
+
+        std::cout << "INFO:: Millepede: Writing results to :" << path << std::endl;
+        for (int l = 0; l < nlayer; l++)
+        {
+            for (int k = 0; k < NPAR_LAYER; k++)
+                f << std::setw(12) << std::fixed << std::setprecision(6) << global_params[l * NPAR_LAYER + k];
+            f << std::endl;
+        }
+        f.close();
+    }
+};
@@ -0,0 +1,122 @@
+#ifndef MILLEPEDE_ALIGN_H
+#define MILLEPEDE_ALIGN_H
+
+/*
+ * global alignment fit, same formulation as millepede/core/pede.py
+ *
+ * - every track has 4 local parameters (kx, bx, ky, by) next to the 6
+ *   global parameters (dx, dy, dz, ax, ay, az) of each layer, layer i is
+ *   the i-th hit of the track
+ *
+ * - the local parameters are eliminated track by track (Schur complement,
+ *   as Millepede does), so the system that is solved only has the global
+ *   parameters: C' = C - G Gamma^-1 G^T, b' = b - G Gamma^-1 beta,
+ *   solved with the dense LDLT of SymMatrix
+ *
+ * - Solver::Full builds the complete global + local system as pede.py does
+ *   and solves it directly, it is only meant as a reference
+ *
+ * - step size, momentum, batch size and regularization have the pede.py
+ *   meaning and defaults, global parameters are updated as
+ *   params -= delta
+ *
+ */
+
+#include "sym_matrix.h"
+#include <vector>
+#include <cstddef>
+
+namespace tracking_dev
+{
+    class MillepedeAlign
+    {
+    public:
+        static constexpr int NPAR_LAYER = 6; // global, per layer
+        static constexpr int NPAR_LOCAL = 4; // local, per track
+
+        enum class Solver
+        {
+            Schur, // local parameters eliminated per track (default)
+            Full,  // global + local system, reference only
+        };
+
+    public:
+        MillepedeAlign();
+        ~MillepedeAlign();
+
+        // text file, one track per line: x0 y0 z0 x1 y1 z1 ...
+        // (the generator/ToyModel format read by pede.py)
+        bool LoadTracks(const char *path);
+        void Solve();
+        double ProcessIteration(size_t start, size_t n);
+        void WriteTextFile(const char *path);
+
+        // setters, pede.py defaults
+        void SetIterations(int n) {niter = n;}
+        void SetBatchSize(size_t n) {batch_size = n;} // 0: all tracks
+        void SetStepSize(double s) {step_size = s;}
+        void SetMomentum(double e) {eta = e;}         // 0: no momentum
+        void SetRegularization(double l) {regularization = l;}
+        void SetFixedLayer(int l) {fixed_layer = l;}  // -1: no fixed layer
+        void SetAngleAlign(bool b) {angle_align = b;}
+        void SetSolver(Solver s) {solver = s;}
+
+        int GetNlayer() const {return nlayer;}
+        size_t GetNtracks() const {return nlayer > 0 ? hits.size() / nlayer : 0;}
+        const std::vector<double> &GetResults() const {return global_params;}
+        const std::vector<double> &GetLastDelta() const {return delta;}
+
+    private:
+        struct hit_t
+        {
+            double x, y, z;
+        };
+
+        // derivatives and residual of one measurement (x or y of a hit)
+        struct measurement_t
+        {
+            int layer;
+            double g[NPAR_LAYER];
+            double l[NPAR_LOCAL];
+            double r;
+        };
+
+        double ProcessTrack(size_t itrack);
+        void Transform(const hit_t &p, int ilayer, hit_t &out) const;
+        void AccumulateSchur();
+        void AccumulateFull(size_t jtrack);
+        void FixParameters(SymMatrix &m, std::vector<double> &v) const;
+        bool IsFixed(int ilayer, int ipar) const;
+
+    private:
+        int niter = 100;
+        size_t batch_size = 1000;
+        double step_size = 0.1;
+        double eta = 0.9;
+        double regularization = 1e-6;
+        int fixed_layer = 0;
+        bool angle_align = true;
+        Solver solver = Solver::Schur;
+
+        int nlayer = 0;
+        int nglobal = 0;
+        std::vector<hit_t> hits; // nlayer hits per track
+
+        std::vector<double> global_params;
+        std::vector<double> delta;
+        std::vector<double> delta_prev;
+
+        // reduced (or full) system
+        SymMatrix C;
+        std::vector<double> b;
+        std::vector<double> solution;
+
+        // per track work buffers
+        std::vector<hit_t> transformed;
+        std::vector<measurement_t> meas;
+        std::vector<double> G;     // nglobal x NPAR_LOCAL
+        std::vector<double> GinvG; // Gamma^-1 G^T, same layout as G
+    };
+};
+
+#endif
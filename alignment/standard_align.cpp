@@ -5,6 +5,8 @@
 #include <vector>
 #include <algorithm>
 #include <map>
+#include <chrono>
+#include <thread>
 
 namespace tracking_dev
 {
@@ -25,10 +27,8 @@ namespace tracking_dev
             exit(0);
         }
 
-        M.SetDimension(nparam, nparam);
-        M.Zero();
-        b.SetDimension(nparam, 1);
-        b.Zero();
+        M.Resize(nparam);
+        b.assign(nparam, 0.);
         a.SetDimension(nparam, 1);
         a.Zero();
     }
@@ -47,14 +47,60 @@ namespace tracking_dev
     {
         CurrentBigChi2 = 0.;
         M.Zero();
-        b.Zero();
+        std::fill(b.begin(), b.end(), 0.);
+
+        a_cache.resize(nparam);
+        for (int i = 0; i < nparam; i++)
+            a_cache[i] = a.at(i, 0);
 
-        std::cout << "Total tracks used for alignment: " << data_cache.size() << std::endl;
-        for (auto &i : data_cache)
+        size_t ntracks = track_offset.size() - 1;
+        std::cout << "Total tracks used for alignment: " << ntracks << std::endl;
+        auto t0 = std::chrono::steady_clock::now();
+
+        // every thread takes a contiguous block of tracks
+        int nth = static_cast<int>(std::min<size_t>(nthreads, std::max<size_t>(ntracks, 1)));
+        accumulators.resize(nth);
+        for (auto &acc : accumulators)
+        {
+            if (acc.M.Size() != static_cast<uint32_t>(nparam))
+                acc.M.Resize(nparam);
+            else
+                acc.M.Zero();
+            acc.b.assign(nparam, 0.);
+            acc.chi2 = 0.;
+        }
+
+        auto process_block = [&](int ith)
+        {
+            size_t begin = ntracks * ith / nth;
+            size_t end = ntracks * (ith + 1) / nth;
+            for (size_t i = begin; i < end; i++)
+                ProcessTrack(i, accumulators[ith]);
+        };
+
+        if (nth == 1)
+            process_block(0);
+        else
         {
-            ProcessTrack(i);
+            std::vector<std::thread> workers;
+            for (int i = 0; i < nth; i++)
+                workers.emplace_back(process_block, i);
+            for (auto &th : workers)
+                th.join();
         }
 
+        for (auto &acc : accumulators)
+        {
+            M += acc.M;
+            for (int i = 0; i < nparam; i++)
+                b[i] += acc.b[i];
+            CurrentBigChi2 += acc.chi2;
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (elapsed > 0)
+            std::cout << "Accumulated " << ntracks << " tracks at " << ntracks / elapsed << " tracks/s" << std::endl;
+
         std::cout << "Iteration: " << MaxIter << ": previous chi2: " << PrevBigChi2 << " current chi2: " << CurrentBigChi2 << std::endl;
         // chi2 doesn't improve anymore, stop iteration
         double ratio_chi2 = (PrevBigChi2 - CurrentBigChi2) / PrevBigChi2;
@@ -68,65 +114,89 @@ namespace tracking_dev
         PrevBigChi2 = CurrentBigChi2;
     }
 
-    void StandardAlign::ProcessTrack(const std::vector<point_t> &hits)
+    // keep a track for the iterations, hits must be on known layers
+    void StandardAlign::AddTrack(const std::vector<point_t> &hits)
+    {
+        for (auto &i : hits)
+        {
+            if (z_to_index.find(i.z) == z_to_index.end())
+            {
+                std::cout << "Error: found no layer id for point: " << i << std::endl;
+                exit(0);
+            }
+
+            hit_record_t h;
+            h.x = static_cast<float>(i.x);
+            h.y = static_cast<float>(i.y);
+            h.layer = z_to_index[i.z];
+            track_hits.push_back(h);
+        }
+        track_offset.push_back(track_hits.size());
+    }
+
+    void StandardAlign::ProcessTrack(size_t itrack, accumulator_t &acc)
     {
+        std::vector<point_t> &corrected_hits = acc.corrected_hits;
+
         // step 1) offset, rotation correction
-        std::vector<point_t> corrected_hits;
-        Transform(hits, corrected_hits);
+        corrected_hits.clear();
+        for (size_t k = track_offset[itrack]; k < track_offset[itrack + 1]; k++)
+        {
+            const hit_record_t &h = track_hits[k];
+            point_t p(h.x, h.y, index_to_z[h.layer]);
+            point_t c = Transform(p, h.layer);
+            c.layer_id = h.layer;
+            corrected_hits.push_back(c);
+        }
 
         // step 2) local fit
         double xtrack, ytrack, xptrack, yptrack, chi2ndf;
-        std::vector<double> xresid, yresid;
         tracking_utility->FitLine(corrected_hits, xtrack, ytrack, xptrack,
-                                  yptrack, chi2ndf, xresid, yresid, 0.08, 0.08);
-        CurrentBigChi2 += chi2ndf;
+                                  yptrack, chi2ndf, acc.xresid, acc.yresid, 0.08, 0.08);
+        acc.chi2 += chi2ndf;
 
-        // step 3) update matrix
-        int ihit = 0;
-        Matrix M_itrack(nparam, nparam), b_itrack(nparam, 1);
+        // step 3) update matrix, Mi = Ai^T Ai and bi = Ai^T di are added
+        // to the thread's M and b directly, M is symmetric: lower triangle only
         for (auto &i : corrected_hits)
         {
-            Matrix Ai, di;
+            double Ai[2][NPAR_LAYER], di[2];
             UpdateMatrixAi(xptrack, yptrack, i, Ai);
             UpdateMatrixdi(xptrack, yptrack, xtrack, ytrack, i, di);
 
-            Matrix Mi, bi;
-            Mi = Ai.Transpose() * Ai;
-            bi = Ai.Transpose() * di;
-            // std::cout<<"M"<<ihit<<std::endl<<Mi<<std::endl;
-            // std::cout<<"b"<<ihit<<std::endl<<bi<<std::endl;
-
-            // track
-            for (int ii = 0; ii < nparam_per_layer; ii++)
+            int offset = i.layer_id * NPAR_LAYER;
+            for (int ii = 0; ii < NPAR_LAYER; ii++)
             {
-                for (int jj = 0; jj < nparam_per_layer; jj++)
+                double *row = acc.M.Row(offset + ii) + offset;
+                for (int jj = 0; jj <= ii; jj++)
                 {
-                    M_itrack(ihit * nparam_per_layer + ii, ihit * nparam_per_layer + jj) = Mi.at(ii, jj);
+                    row[jj] += Ai[0][ii] * Ai[0][jj] + Ai[1][ii] * Ai[1][jj];
                 }
 
-                b_itrack(ihit * nparam_per_layer + ii, 0) = bi.at(ii, 0);
+                acc.b[offset + ii] += Ai[0][ii] * di[0] + Ai[1][ii] * di[1];
             }
-            ihit++;
         }
-        // std::cout<<"M_itrack:"<<std::endl<<M_itrack<<std::endl;
-        // std::cout<<"b_itrack"<<std::endl<<b_itrack<<std::endl;
-
-        M = M + M_itrack;
-        b = b + b_itrack;
     }
 
     void StandardAlign::SolveIteration()
     {
         // std::cout<<"M matrix: "<<std::endl<<M<<std::endl;
-        // std::cout<<"b matrix: "<<std::endl<<b<<std::endl;
-        Matrix m_inverse = M.Inverse();
-        // M.PrintDimension();
-        // getchar();
-        Matrix delta_a = m_inverse * b;
+        if (solver == Solver::GaussJordan)
+        {
+            Matrix m_inverse = M.ToMatrix().Inverse();
+            Matrix delta = m_inverse * Matrix(b);
+            delta_a.resize(nparam);
+            for (int i = 0; i < nparam; i++)
+                delta_a[i] = delta.at(i, 0);
+        }
+        else if (!M.SolveLDLT(b, delta_a))
+        {
+            // same as Inverse() on a singular matrix: no update
+            std::cout << "Warning: normal matrix is singular, parameters not updated." << std::endl;
+            delta_a.assign(nparam, 0.);
+        }
 
         // std::cout << "iteration : " << MaxIter << std::endl;
         // std::cout << "improvement: " << std::endl;
-        // std::cout << delta_a << std::endl;
 
         for (int i = 0; i < nlayer; i++)
         {
@@ -136,7 +206,7 @@ namespace tracking_dev
 
             for (int j = 0; j < nparam_per_layer; j++)
             {
-                a(i * nparam_per_layer + j, 0) = a.at(i * nparam_per_layer + j, 0) + delta_a.at(i * nparam_per_layer + j, 0);
+                a(i * nparam_per_layer + j, 0) = a.at(i * nparam_per_layer + j, 0) + delta_a[i * nparam_per_layer + j];
             }
         }
         std::cout << "results: " << std::endl;
@@ -151,6 +221,11 @@ namespace tracking_dev
         Init(); // need re-initialize after setting dimension
     }
 
+    void StandardAlign::SetNumberOfThreads(int n)
+    {
+        nthreads = std::max(n, 1);
+    }
+
     int StandardAlign::GetNparam()
     {
         return nparam;
@@ -224,28 +299,32 @@ namespace tracking_dev
         std::map<double, int> _tmp_index;
         for (auto &i : all_events)
         {
-            std::vector<point_t> tmp;
             for (auto &hit : i.hits)
-            {
-                tmp.push_back(hit);
                 _tmp_index[hit.z] = 0;
-            }
-
-            Sort(tmp);
-            data_cache.push_back(tmp);
         }
 
         // create unordered_maps to correlate layer_id vs layer_z
         int layer_id = 0;
+        index_to_z.clear();
         for (auto &i : _tmp_index)
         {
-            index_to_z[layer_id] = i.first;
+            index_to_z.push_back(i.first);
             z_to_index[i.first] = layer_id;
             layer_id++;
         }
-        // for(auto &i: index_to_z) {
-        //     std::cout<<"layer id = "<<i.first<<" layer z = "<<i.second<<std::endl;
+        // for(size_t i=0; i<index_to_z.size(); i++) {
+        //     std::cout<<"layer id = "<<i<<" layer z = "<<index_to_z[i]<<std::endl;
         // }
+
+        std::vector<point_t> tmp;
+        for (auto &i : all_events)
+        {
+            tmp = i.hits;
+            Sort(tmp);
+            AddTrack(tmp);
+        }
+        std::cout << "INFO:: Alignment: " << track_offset.size() - 1 << " tracks cached, "
+                  << track_hits.size() * sizeof(hit_record_t) / 1024. / 1024. << " MB" << std::endl;
     }
 
     // sort hits, ascending order in z
@@ -257,14 +336,6 @@ namespace tracking_dev
                 return false; });
     }
 
-    void StandardAlign::Transform(const std::vector<point_t> &in, std::vector<point_t> &out)
-    {
-        for (auto &i : in)
-        {
-            out.push_back(Transform(i));
-        }
-    }
-
     point_t StandardAlign::Transform(const point_t &p)
     {
         if (z_to_index.find(p.z) == z_to_index.end())
@@ -273,13 +344,23 @@ namespace tracking_dev
             exit(0);
         }
 
-        int ilayer = z_to_index[p.z];
-        double dx = a.at(nparam_per_layer * ilayer, 0);
-        double dy = a.at(nparam_per_layer * ilayer + 1, 0);
-        double dz = a.at(nparam_per_layer * ilayer + 2, 0);
-        double ax = a.at(nparam_per_layer * ilayer + 3, 0);
-        double ay = a.at(nparam_per_layer * ilayer + 4, 0);
-        double az = a.at(nparam_per_layer * ilayer + 5, 0);
+        a_cache.resize(nparam);
+        for (int i = 0; i < nparam; i++)
+            a_cache[i] = a.at(i, 0);
+
+        return Transform(p, z_to_index[p.z]);
+    }
+
+    // uses a_cache, set up by ProcessIteration()
+    point_t StandardAlign::Transform(const point_t &p, int ilayer)
+    {
+        const double *par = &a_cache[nparam_per_layer * ilayer];
+        double dx = par[0];
+        double dy = par[1];
+        double dz = par[2];
+        double ax = par[3];
+        double ay = par[4];
+        double az = par[5];
 
         point_t res;
         res.x = p.x - az * p.y + ay * p.z + dx;
@@ -290,27 +371,23 @@ namespace tracking_dev
     }
 
     void StandardAlign::UpdateMatrixAi(const double &kx, const double &ky,
-                                       const point_t &pi, Matrix &Ai)
+                                       const point_t &pi, double (&Ai)[2][NPAR_LAYER])
     {
-        Ai.SetDimension(2, nparam_per_layer);
-
-        Ai(0, 0) = 1, Ai(0, 1) = 0, Ai(0, 2) = -kx;
-        Ai(0, 3) = -pi.y * kx, Ai(0, 4) = pi.z + pi.x * kx, Ai(0, 5) = -pi.y;
-        // Ai(0, 3) = -pi.y * kx, Ai(0, 4) = pi.x*kx, Ai(0, 5) = -pi.y; // incorrect
+        Ai[0][0] = 1, Ai[0][1] = 0, Ai[0][2] = -kx;
+        Ai[0][3] = -pi.y * kx, Ai[0][4] = pi.z + pi.x * kx, Ai[0][5] = -pi.y;
+        // Ai[0][3] = -pi.y * kx, Ai[0][4] = pi.x*kx, Ai[0][5] = -pi.y; // incorrect
 
-        Ai(1, 0) = 0, Ai(1, 1) = 1, Ai(1, 2) = -ky;
-        Ai(1, 3) = -(pi.z + pi.y * ky), Ai(1, 4) = pi.x * ky, Ai(1, 5) = pi.x;
-        // Ai(1, 3) = -(pi.y * ky), Ai(1, 4) = pi.x*ky, Ai(1, 5) = pi.x; // incorrect
+        Ai[1][0] = 0, Ai[1][1] = 1, Ai[1][2] = -ky;
+        Ai[1][3] = -(pi.z + pi.y * ky), Ai[1][4] = pi.x * ky, Ai[1][5] = pi.x;
+        // Ai[1][3] = -(pi.y * ky), Ai[1][4] = pi.x*ky, Ai[1][5] = pi.x; // incorrect
     }
 
     void StandardAlign::UpdateMatrixdi(const double &kx, const double &ky,
                                        const double &bx, const double &by,
-                                       const point_t &pi, Matrix &di)
+                                       const point_t &pi, double (&di)[2])
     {
-        di.SetDimension(2, 1);
-
-        di(0, 0) = kx * pi.z + bx - pi.x;
-        di(1, 0) = ky * pi.z + by - pi.y;
+        di[0] = kx * pi.z + bx - pi.x;
+        di[1] = ky * pi.z + by - pi.y;
     }
 
 };
@@ -4,13 +4,24 @@
 #include "tracking_struct.h"
 #include "TrackingUtility.h"
 #include "matrix.h"
+#include "sym_matrix.h"
 #include "ToyModel.h"
 #include <unordered_map>
+#include <vector>
 
 namespace tracking_dev {
     class StandardAlign 
     {
     public:
+        static constexpr int NPAR_LAYER = 6;
+
+        // how M * delta_a = b is solved in each iteration
+        enum class Solver
+        {
+            LDLT,        // dense LDL^T factorization (default)
+            GaussJordan, // sparse Matrix::Inverse(), kept as a reference
+        };
+
         StandardAlign();
         ~StandardAlign();
 
@@ -21,15 +32,16 @@ namespace tracking_dev {
         void CopyToyModelData();
         void Solve();
         void ProcessIteration();
-        void ProcessTrack(const std::vector<point_t> &hits);
+        void AddTrack(const std::vector<point_t> &hits);
+        void SetNumberOfThreads(int n);
         void Sort(std::vector<point_t> &hits);
-        void Transform(const std::vector<point_t> &in, std::vector<point_t> &out);
         point_t Transform(const point_t &p);
+        point_t Transform(const point_t &p, int ilayer);
         void UpdateMatrixAi(const double &kx, const double &ky,
-                const point_t &pi, Matrix &Ai);
+                const point_t &pi, double (&Ai)[2][NPAR_LAYER]);
         void UpdateMatrixdi(const double &kx, const double &ky,
                 const double &bx, const double &by,
-                const point_t &pi, Matrix &di);
+                const point_t &pi, double (&di)[2]);
         void SolveIteration();
 
         void SetNlayer(int n);
@@ -41,6 +53,11 @@ namespace tracking_dev {
         void SetAnchorLayers(){}
         int GetNparam();
         std::unordered_map<int, bool> GetAnchorLayers();
+        void SetSolver(Solver s) {solver = s;}
+        int GetNumberOfThreads() const {return nthreads;}
+        const Matrix &GetResults() const {return a;}
+        const SymMatrix &GetNormalMatrix() const {return M;}
+        const std::vector<double> &GetNormalVector() const {return b;}
 
     private:
         int MaxIter = 100;
@@ -49,19 +66,48 @@ namespace tracking_dev {
         double CurrentBigChi2 = 0;
         int nlayer = 0;
         int nparam = 0;
-        int nparam_per_layer = 6;
+        int nparam_per_layer = NPAR_LAYER;
         std::unordered_map<int, bool> m_anchor_layers;
+        Solver solver = Solver::LDLT;
 
-        Matrix M;
-        Matrix b;
+        SymMatrix M;
+        std::vector<double> b;
+        std::vector<double> delta_a;
         Matrix a;
 
         // indexing layers according to z position
         std::unordered_map<double, int> z_to_index;
-        std::unordered_map<int, double> index_to_z;
+        std::vector<double> index_to_z;
+
+        // a as a plain array, refreshed before each iteration
+        std::vector<double> a_cache;
+
+        // track cache, kept between iterations: hits in float, layer index
+        // instead of z, all tracks in one flat array
+        struct hit_record_t
+        {
+            float x, y;
+            int layer;
+        };
+        std::vector<hit_record_t> track_hits;
+        std::vector<size_t> track_offset{0};
+
+        // per thread sums of M, b and chi2, reduced in thread order before
+        // the solve, so the result doesn't depend on scheduling. The work
+        // buffers of ProcessTrack are reused for every track.
+        struct accumulator_t
+        {
+            SymMatrix M;
+            std::vector<double> b;
+            double chi2 = 0.;
+
+            std::vector<point_t> corrected_hits;
+            std::vector<double> xresid, yresid;
+        };
+        void ProcessTrack(size_t itrack, accumulator_t &acc);
 
-        // data cache
-        std::vector<std::vector<point_t>> data_cache;
+        int nthreads = 1;
+        std::vector<accumulator_t> accumulators;
         //
         TrackingUtility *tracking_utility;
 
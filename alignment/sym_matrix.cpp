@@ -0,0 +1,161 @@
+#include "sym_matrix.h"
+#include <iomanip>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+
+namespace tracking_dev
+{
+    SymMatrix::SymMatrix()
+    {
+    }
+
+    SymMatrix::SymMatrix(uint32_t n)
+    {
+        Resize(n);
+    }
+
+    SymMatrix::~SymMatrix()
+    {
+    }
+
+    void SymMatrix::Resize(uint32_t n)
+    {
+        dim = n;
+        _M.assign(static_cast<size_t>(n) * n, 0.);
+    }
+
+    void SymMatrix::Zero()
+    {
+        std::fill(_M.begin(), _M.end(), 0.);
+    }
+
+    SymMatrix &SymMatrix::operator+=(const SymMatrix &m)
+    {
+        if (m.dim != dim)
+        {
+            std::cout << "Error: SymMatrix::operator+= dimension mismatch: "
+                      << dim << " vs " << m.dim << std::endl;
+            exit(0);
+        }
+
+        for (size_t i = 0; i < _M.size(); i++)
+            _M[i] += m._M[i];
+        return *this;
+    }
+
+    // M = L * D * L^T, L unit lower triangular, D diagonal
+    bool SymMatrix::SolveLDLT(const std::vector<double> &b, std::vector<double> &x) const
+    {
+        if (dim == 0 || b.size() != dim)
+        {
+            std::cout << "Error: SymMatrix::SolveLDLT dimension mismatch: "
+                      << dim << " vs " << b.size() << std::endl;
+            return false;
+        }
+
+        const size_t n = dim;
+        _L.assign(n * n, 0.);
+        _D.assign(n, 0.);
+
+        // pivots are compared to the largest diagonal element
+        double max_diag = 0.;
+        for (size_t i = 0; i < n; i++)
+            max_diag = std::max(max_diag, std::abs(_M[i * n + i]));
+        const double tolerance = 1e-14 * max_diag;
+        if (max_diag == 0.)
+        {
+            std::cout << "Warning: SymMatrix::SolveLDLT zero matrix." << std::endl;
+            return false;
+        }
+
+        // row j of L times D, reused for every row below j
+        std::vector<double> ld(n);
+        for (size_t j = 0; j < n; j++)
+        {
+            const double *Lj = &_L[j * n];
+            double dj = _M[j * n + j];
+            for (size_t k = 0; k < j; k++)
+            {
+                ld[k] = Lj[k] * _D[k];
+                dj -= Lj[k] * ld[k];
+            }
+
+            if (!(dj > tolerance))
+            {
+                std::cout << "Warning: SymMatrix::SolveLDLT pivot (" << j << ", " << j
+                          << ") = " << dj << ", matrix is singular." << std::endl;
+                return false;
+            }
+            _D[j] = dj;
+            _L[j * n + j] = 1.;
+
+            for (size_t i = j + 1; i < n; i++)
+            {
+                const double *Li = &_L[i * n];
+                double s = _M[i * n + j];
+                for (size_t k = 0; k < j; k++)
+                    s -= Li[k] * ld[k];
+                _L[i * n + j] = s / dj;
+            }
+        }
+
+        // L * y = b
+        x.assign(b.begin(), b.end());
+        for (size_t i = 0; i < n; i++)
+        {
+            const double *Li = &_L[i * n];
+            double s = x[i];
+            for (size_t k = 0; k < i; k++)
+                s -= Li[k] * x[k];
+            x[i] = s;
+        }
+
+        // D * z = y
+        for (size_t i = 0; i < n; i++)
+            x[i] /= _D[i];
+
+        // L^T * x = z
+        for (size_t i = n; i-- > 0;)
+        {
+            double s = x[i];
+            for (size_t k = i + 1; k < n; k++)
+                s -= _L[k * n + i] * x[k];
+            x[i] = s;
+        }
+
+        return true;
+    }
+
+    Matrix SymMatrix::ToMatrix() const
+    {
+        Matrix res(dim, dim);
+        for (uint32_t i = 0; i < dim; i++)
+        {
+            for (uint32_t j = 0; j <= i; j++)
+            {
+                double v = _M[static_cast<size_t>(i) * dim + j];
+                if (v == 0)
+                    continue;
+                res(i, j) = v;
+                res(j, i) = v;
+            }
+        }
+        return res;
+    }
+
+    std::ostream &operator<<(std::ostream &os, const SymMatrix &m)
+    {
+        for (uint32_t i = 0; i < m.Size(); i++)
+        {
+            for (uint32_t j = 0; j < m.Size(); j++)
+            {
+                os << std::setfill(' ') << std::setw(12) << std::setprecision(4) << m.at(i, j) << ",";
+            }
+            os << std::endl;
+        }
+
+        return os;
+    }
+};
@@ -0,0 +1,72 @@
+#ifndef SYM_MATRIX_H
+#define SYM_MATRIX_H
+
+/*
+ * dense symmetric matrix for the alignment normal equations
+ *
+ * - elements are kept in one contiguous row-major n x n array, only the
+ *   lower triangle (i >= j) is used, (i, j) and (j, i) refer to the same
+ *   element
+ *
+ * - M * x = b is solved with a LDL^T factorization (no pivoting, M is
+ *   symmetric positive (semi-)definite), the inverse is never formed
+ *
+ * - double precision only, for the same reason as in matrix.h
+ *
+ */
+
+#include "matrix.h"
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <utility>
+
+namespace tracking_dev
+{
+    class SymMatrix
+    {
+    public:
+        SymMatrix();
+        SymMatrix(uint32_t n);
+        ~SymMatrix();
+
+        void Resize(uint32_t n); // resize and set every element to 0
+        void Zero();             // keeps dimension, set every element to 0
+        uint32_t Size() const {return dim;}
+
+        double at(uint32_t i, uint32_t j) const
+        {
+            if(i < j) std::swap(i, j);
+            return _M[i * dim + j];
+        }
+
+        double &operator()(uint32_t i, uint32_t j)
+        {
+            if(i < j) std::swap(i, j);
+            return _M[i * dim + j];
+        }
+
+        SymMatrix &operator+=(const SymMatrix &m);
+
+        // row i, elements 0..i are valid
+        double *Row(uint32_t i) {return &_M[static_cast<size_t>(i) * dim];}
+
+        // solve M * x = b, return false if M is singular
+        bool SolveLDLT(const std::vector<double> &b, std::vector<double> &x) const;
+
+        // copy to the sparse matrix type (both triangles)
+        Matrix ToMatrix() const;
+
+    private:
+        uint32_t dim = 0;
+        std::vector<double> _M;
+
+        // factorization workspace, reused between solves
+        mutable std::vector<double> _L;
+        mutable std::vector<double> _D;
+    };
+
+    std::ostream &operator<<(std::ostream &os, const SymMatrix &m);
+};
+
+#endif
@@ -1,16 +1,76 @@
 #include "standard_align.h"
 #include "matrix.h"
+#include "sym_matrix.h"
+#include "millepede_align.h"
 #include "ToyModel.h"
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
 
 using namespace tracking_dev;
 
+static int compare_solvers(int nthreads);
+static int time_solvers(int nlayer, int ntracks);
+static int run_millepede(const char *path, bool validate, const char *reference);
+static bool check_pede_reference(const char *path, const char *reference);
+
 int main(int argc, char* argv[])
 {
+    // alignment [-j N]           : toy model alignment on N threads
+    // alignment [-j N] --compare : both solvers on the toy model must agree,
+    //                              and N threads must agree with 1 thread
+    // alignment --timing         : LDLT vs Gauss-Jordan on 20 layers x 6 parameters
+    // alignment --millepede tracks.txt [--validate [--reference ref.txt]]
+    //                            : global fit with local parameters (pede.py),
+    //                              --validate checks it against the full system
+    //                              and against the pede.py result (default
+    //                              alignment/millepede_reference.txt, made by
+    //                              millepede/pede_reference.py from
+    //                              alignment/millepede_tracks.txt)
+    int nthreads = 1;
+    bool compare = false, timing = false, validate = false;
+    const char *millepede_input = nullptr;
+    const char *reference = "alignment/millepede_reference.txt";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            nthreads = std::stoi(argv[++i]);
+        else if (strcmp(argv[i], "--compare") == 0)
+            compare = true;
+        else if (strcmp(argv[i], "--timing") == 0)
+            timing = true;
+        else if (strcmp(argv[i], "--millepede") == 0 && i + 1 < argc)
+            millepede_input = argv[++i];
+        else if (strcmp(argv[i], "--validate") == 0)
+            validate = true;
+        else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc)
+            reference = argv[++i];
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [-j threads] [--compare | --timing"
+                      << " | --millepede tracks.txt [--validate [--reference ref.txt]]]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (compare)
+        return compare_solvers(nthreads);
+    if (timing)
+        return time_solvers(20, 1000);
+    if (millepede_input)
+        return run_millepede(millepede_input, validate, reference);
+
     //ToyModel *toy = new ToyModel();
     //toy -> Generate();
 
     StandardAlign *align = new StandardAlign();
+    align -> SetNumberOfThreads(nthreads);
     align -> SetupToyModel();
     align -> SetNlayer(5);
     // align -> LoadTextFile("alignment/ref.txt");
@@ -20,3 +80,295 @@ int main(int argc, char* argv[])
 
     return 0;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// offsets of two toy model alignments, differences above tolerance (relative
+// to max(1, |parameter|)) are printed
+
+static bool compare_results(const char *name, const StandardAlign &a1,
+        const StandardAlign &a2, double tolerance)
+{
+    const Matrix &r1 = a1.GetResults();
+    const Matrix &r2 = a2.GetResults();
+    double max_diff = 0;
+    bool ok = true;
+    for (uint32_t i = 0; i < r1.GetDimension().first; i++)
+    {
+        double diff = std::abs(r1.at(i, 0) - r2.at(i, 0));
+        max_diff = std::max(max_diff, diff);
+        if (diff > tolerance * std::max(1., std::abs(r2.at(i, 0))))
+        {
+            std::cout << "parameter " << i << ": " << r1.at(i, 0)
+                      << " vs " << r2.at(i, 0) << std::endl;
+            ok = false;
+        }
+    }
+
+    std::cout << name << ": max |difference| = " << max_diff
+              << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// normal equations of one pass over the toy model, 1 thread vs nthreads.
+// Only the summation order differs, M and b must agree within 1e-12
+// relative to their largest element.
+
+static bool compare_threads(int nthreads)
+{
+    StandardAlign serial, mt;
+    mt.SetNumberOfThreads(nthreads);
+    for (auto *align : {&serial, &mt})
+    {
+        align -> SetupToyModel();
+        align -> SetNlayer(5);
+        align -> ProcessIteration();
+    }
+
+    const SymMatrix &M1 = serial.GetNormalMatrix(), &M2 = mt.GetNormalMatrix();
+    const std::vector<double> &b1 = serial.GetNormalVector(), &b2 = mt.GetNormalVector();
+    double max_M = 0, max_b = 0, diff_M = 0, diff_b = 0;
+    for (uint32_t i = 0; i < M1.Size(); i++)
+    {
+        for (uint32_t j = 0; j <= i; j++)
+        {
+            max_M = std::max(max_M, std::abs(M1.at(i, j)));
+            diff_M = std::max(diff_M, std::abs(M1.at(i, j) - M2.at(i, j)));
+        }
+        max_b = std::max(max_b, std::abs(b1[i]));
+        diff_b = std::max(diff_b, std::abs(b1[i] - b2[i]));
+    }
+    diff_M /= std::max(max_M, 1e-300);
+    diff_b /= std::max(max_b, 1e-300);
+
+    bool ok = diff_M <= 1e-12 && diff_b <= 1e-12;
+    std::cout << nthreads << " threads vs 1 thread: relative difference M: " << diff_M
+              << ", b: " << diff_b << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// run the toy model alignment with both solvers, offsets must match.
+// With nthreads > 1 the threaded accumulation is compared too, and the
+// threaded alignment must end up at the same offsets.
+
+static int compare_solvers(int nthreads)
+{
+    StandardAlign ldlt, gauss_jordan, ldlt_mt;
+    ldlt.SetSolver(StandardAlign::Solver::LDLT);
+    gauss_jordan.SetSolver(StandardAlign::Solver::GaussJordan);
+    ldlt_mt.SetSolver(StandardAlign::Solver::LDLT);
+    ldlt_mt.SetNumberOfThreads(nthreads);
+
+    std::vector<StandardAlign*> runs{&ldlt, &gauss_jordan};
+    if (nthreads > 1)
+        runs.push_back(&ldlt_mt);
+
+    for (auto *align : runs)
+    {
+        align -> SetupToyModel();
+        align -> SetNlayer(5);
+        align -> SetAnchorLayers(0);
+        align -> Solve();
+    }
+
+    bool ok = compare_results("solver comparison", ldlt, gauss_jordan, 1e-6);
+    if (nthreads > 1)
+    {
+        ok = compare_threads(nthreads) && ok;
+        ok = compare_results("threaded alignment", ldlt_mt, ldlt, 1e-9) && ok;
+    }
+    return ok ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// normal matrix from straight tracks through nlayer layers, solve it with
+// LDLT and with the sparse Gauss-Jordan inverse
+
+static int time_solvers(int nlayer, int ntracks)
+{
+    const int npar = StandardAlign::NPAR_LAYER;
+    const int n = nlayer * npar;
+
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<double> pos(-20., 20.), slope(-0.1, 0.1);
+    std::normal_distribution<double> resid(0., 0.01);
+
+    StandardAlign align;
+    SymMatrix M(n);
+    std::vector<double> b(n, 0.);
+    for (int itrack = 0; itrack < ntracks; itrack++)
+    {
+        double x0 = pos(gen), y0 = pos(gen), kx = slope(gen), ky = slope(gen);
+        for (int l = 0; l < nlayer; l++)
+        {
+            double z = 10. * l;
+            point_t p(x0 + kx * z, y0 + ky * z, z);
+
+            double Ai[2][StandardAlign::NPAR_LAYER], di[2];
+            align.UpdateMatrixAi(kx, ky, p, Ai);
+            di[0] = resid(gen);
+            di[1] = resid(gen);
+
+            for (int ii = 0; ii < npar; ii++)
+            {
+                for (int jj = 0; jj <= ii; jj++)
+                    M(l * npar + ii, l * npar + jj) += Ai[0][ii] * Ai[0][jj] + Ai[1][ii] * Ai[1][jj];
+                b[l * npar + ii] += Ai[0][ii] * di[0] + Ai[1][ii] * di[1];
+            }
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+
+    const int nrep_ldlt = 100;
+    std::vector<double> x_ldlt;
+    auto t0 = clock::now();
+    for (int i = 0; i < nrep_ldlt; i++)
+    {
+        if (!M.SolveLDLT(b, x_ldlt))
+            return 1;
+    }
+    double t_ldlt = std::chrono::duration<double, std::milli>(clock::now() - t0).count() / nrep_ldlt;
+
+    Matrix sparse_M = M.ToMatrix(), sparse_b(b);
+    t0 = clock::now();
+    Matrix x_gj = sparse_M.Inverse() * sparse_b;
+    double t_gj = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+    double max_diff = 0;
+    for (int i = 0; i < n; i++)
+        max_diff = std::max(max_diff, std::abs(x_ldlt[i] - x_gj.at(i, 0)));
+
+    std::cout << std::setprecision(4)
+              << nlayer << " layers x " << npar << " parameters, " << ntracks << " tracks" << std::endl
+              << "    LDLT:         " << t_ldlt << " ms" << std::endl
+              << "    Gauss-Jordan: " << t_gj << " ms" << std::endl
+              << "    speed up:     " << t_gj / t_ldlt << std::endl
+              << "    max |difference| = " << max_diff << std::endl;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// millepede global fit with the pede.py settings. The validation solves one
+// batch both with the local parameters eliminated and with the complete
+// global + local system (what pede.py does), the corrections must agree,
+// then compares the fit with a result of pede.py itself.
+
+static int run_millepede(const char *path, bool validate, const char *reference)
+{
+    if (validate)
+    {
+        MillepedeAlign schur, full;
+        full.SetSolver(MillepedeAlign::Solver::Full);
+
+        const size_t nbatch = 200;
+        std::vector<double> d[2];
+        double t[2];
+        int k = 0;
+        for (auto *align : {&schur, &full})
+        {
+            if (!align -> LoadTracks(path))
+                return 1;
+            align -> SetStepSize(1.);
+            align -> SetMomentum(0.);
+
+            auto t0 = std::chrono::steady_clock::now();
+            align -> ProcessIteration(0, nbatch);
+            t[k] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            d[k++] = align -> GetLastDelta();
+        }
+
+        double max_d = 0, diff = 0;
+        for (size_t i = 0; i < d[0].size(); i++)
+        {
+            max_d = std::max(max_d, std::abs(d[1][i]));
+            diff = std::max(diff, std::abs(d[0][i] - d[1][i]));
+        }
+        diff /= std::max(max_d, 1e-300);
+        bool ok = diff <= 1e-6;
+        std::cout << "millepede, " << nbatch << " tracks: Schur " << t[0] << " ms, full system "
+                  << t[1] << " ms, relative difference " << diff
+                  << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+        if (!ok || !check_pede_reference(path, reference))
+            return 1;
+    }
+
+    MillepedeAlign align;
+    if (!align.LoadTracks(path))
+        return 1;
+    align.Solve();
+    align.WriteTextFile("alignment/millepede_results.txt");
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the reference has the chi2/ndf of every pede.py iteration (one batch of all
+// tracks, pede.py defaults otherwise) and the global parameters after the
+// last one. Tolerances: 1e-8 relative on chi2/ndf, 1e-6 of the largest
+// correction on the parameters (both are far above the double rounding of
+// the two implementations, ~1e-11 and ~1e-8)
+
+static bool check_pede_reference(const char *path, const char *reference)
+{
+    std::ifstream f(reference);
+    if (!f.is_open())
+    {
+        std::cout << "Error: cannot open pede.py reference: " << reference << std::endl;
+        return false;
+    }
+
+    std::vector<double> ref_chi2, ref_params;
+    std::string line, key;
+    while (std::getline(f, line))
+    {
+        std::istringstream iss(line);
+        if (!(iss >> key) || key[0] == '#')
+            continue;
+        int index;
+        double v;
+        iss >> index;
+        if (key == "chi2/ndf" && iss >> v)
+            ref_chi2.push_back(v);
+        else if (key == "layer")
+        {
+            while (iss >> v)
+                ref_params.push_back(v);
+        }
+    }
+
+    MillepedeAlign align;
+    if (!align.LoadTracks(path))
+        return false;
+    size_t ntracks = align.GetNtracks();
+    if (ref_chi2.empty() || ref_params.size() != align.GetResults().size())
+    {
+        std::cout << "Error: " << reference << " does not have " << align.GetNlayer()
+                  << " layers of pede.py results." << std::endl;
+        return false;
+    }
+
+    double ndf = static_cast<double>(ntracks * (2 * align.GetNlayer() - 4));
+    double chi2_diff = 0;
+    for (size_t i = 0; i < ref_chi2.size(); i++)
+    {
+        double chi2 = align.ProcessIteration(0, ntracks) / ndf;
+        chi2_diff = std::max(chi2_diff, std::abs(chi2 - ref_chi2[i]) / std::abs(ref_chi2[i]));
+    }
+
+    double max_p = 0, p_diff = 0;
+    const auto &params = align.GetResults();
+    for (size_t i = 0; i < params.size(); i++)
+    {
+        max_p = std::max(max_p, std::abs(ref_params[i]));
+        p_diff = std::max(p_diff, std::abs(params[i] - ref_params[i]));
+    }
+    p_diff /= std::max(max_p, 1e-300);
+
+    bool ok = chi2_diff <= 1e-8 && p_diff <= 1e-6;
+    std::cout << "millepede vs pede.py, " << ntracks << " tracks, " << ref_chi2.size()
+              << " iterations: chi2/ndf relative difference " << chi2_diff
+              << ", parameters relative difference " << p_diff
+              << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+    return ok;
+}
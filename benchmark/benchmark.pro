@@ -0,0 +1,61 @@
+######################################################################
+# offline benchmarks on synthetic evio data
+######################################################################
+
+TEMPLATE = app
+TARGET = ../bin/gem_benchmark
+
+QMAKE_CXXFLAGS -= -std=gnu++1y
+QMAKE_CXXFLAGS -= -std=c++1y
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_CXXFLAGS += -g
+QMAKE_CFLAGS   += -g
+QMAKE_LFLAGS   += -g
+
+######################################################################
+# self headers
+INCLUDEPATH += . ./include
+
+######################################################################
+# decoder headers
+INCLUDEPATH += ../decoder/include ../third_party/evio-5.2
+
+# decoder lib
+LIBS += -L../decoder/lib -ldecoder
+
+######################################################################
+# gem headers
+INCLUDEPATH += ../gem/include ../gem/third_party
+
+# gem lib
+LIBS += -L../gem/lib -lgem
+
+######################################################################
+# tracking headers
+INCLUDEPATH += ../tracking_dev/include
+
+# tracking lib
+LIBS += -L../tracking_dev/lib -ltracking_dev
+
+######################################################################
+# root headers
+INCLUDEPATH += $$system(root-config --incdir)
+# root libs
+LIBS += $$system(root-config --glibs)
+
+######################################################################
+# moc dir
+MOC_DIR = moc
+
+######################################################################
+# obj dir
+OBJECTS_DIR = obj
+
+######################################################################
+HEADERS += include/SyntheticEvioWriter.h \
+           include/SyntheticEventGenerator.h \
+
+# source path
+SOURCES += src/main.cpp \
+           src/SyntheticEvioWriter.cpp \
+           src/SyntheticEventGenerator.cpp \
@@ -0,0 +1,116 @@
+#ifndef SYNTHETIC_EVENT_GENERATOR_H
+#define SYNTHETIC_EVENT_GENERATOR_H
+
+////////////////////////////////////////////////////////////////
+// Synthetic gem event generator
+//
+// Produces raw apv frames for the apvs of the loaded gem map:
+// per strip pedestal and noise, a common mode per time sample,
+// straight tracks through the tracking geometry and random
+// background clusters. Tracks are generated the same way as the
+// alignment toy model (random origin and slope, projected with
+// TrackingUtility), then converted to local coordinates with the
+// inverse of the CoordSystem transform, so the replay finds them
+// where they were generated.
+//
+// The pedestal and common mode range the frames were generated
+// with can be written out in the usual database format.
+
+#include "SyntheticEvioWriter.h"
+#include "tracking_struct.h"
+
+#include <vector>
+#include <string>
+#include <random>
+#include <unordered_map>
+
+class GEMSystem;
+class GEMAPV;
+
+namespace tracking_dev {
+    class CoordSystem;
+    class TrackingUtility;
+};
+
+class SyntheticEventGenerator
+{
+public:
+    struct Config
+    {
+        int n_apvs = -1;                // apvs taken from the map, < 0 means all
+        int n_tracks = 1;               // tracks per event
+        double occupancy = 0.01;        // fraction of strips fired by background
+        double noise = 5.;              // strip noise (adc)
+        double common_mode_noise = 10.; // common mode spread per time sample (adc)
+        double signal = 600.;           // most probable peak amplitude (adc)
+        double max_slope = 0.1;         // track slope range, dx/dz and dy/dz
+        int time_samples = 6;
+        unsigned int seed = 1;
+    };
+
+    // one readout strip, sorted by position in its plane
+    struct strip_t
+    {
+        float position;
+        int frame;
+        int ch;
+    };
+
+    // tracking geometry of one detector
+    struct detector_t
+    {
+        int det_id = -1;
+        double z = 0.;
+        tracking_dev::point_t offset;
+        double m[2][2] = {{1., 0.}, {0., 1.}}; // local -> lab rotation
+        std::vector<strip_t> *strips[2] = {nullptr, nullptr};
+    };
+
+    SyntheticEventGenerator(GEMSystem *sys, tracking_dev::CoordSystem *coord,
+            SyntheticEvioWriter::Format f);
+    ~SyntheticEventGenerator();
+
+    void SetConfig(const Config &c) {config = c;}
+    const Config &GetConfig() const {return config;}
+
+    bool Initialize();
+    const std::vector<SyntheticEvioWriter::APVFrame> &Generate();
+
+    bool WritePedestal(const std::string &path, int slot_id) const;
+    bool WriteCommonModeRange(const std::string &path, int slot_id) const;
+
+    int GetNAPVs() const {return static_cast<int>(apvs.size());}
+    uint64_t GetTrackHits() const {return n_track_hits;}
+    uint64_t GetBackgroundClusters() const {return n_background;}
+
+private:
+    void generateTracks();
+    void generateBackground();
+    void deposit(const std::vector<strip_t> &strips, double u, double amplitude, double t0);
+    void digitize();
+    bool toLocal(const detector_t &det, const tracking_dev::point_t &lab, double &u, double &v) const;
+
+private:
+    GEMSystem *gem_sys;
+    tracking_dev::CoordSystem *coord_system;
+    tracking_dev::TrackingUtility *tracking_utility;
+    SyntheticEvioWriter::Format format;
+    Config config;
+
+    std::mt19937 gen;
+
+    std::vector<GEMAPV*> apvs;
+    std::vector<std::vector<float>> pedestal_offset, pedestal_noise;
+    std::vector<std::vector<float>> signal;  // per apv, ts major like the frames
+    std::vector<SyntheticEvioWriter::APVFrame> frames;
+
+    // strips of each plane, key = det_id * 2 + plane type
+    std::unordered_map<int, std::vector<strip_t>> plane_strips;
+    std::vector<detector_t> detectors;       // detectors in the tracking geometry
+    int reference_detector = -1;             // tracks start from the most upstream one
+
+    uint64_t n_track_hits = 0;
+    uint64_t n_background = 0;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef SYNTHETIC_EVIO_WRITER_H
+#define SYNTHETIC_EVIO_WRITER_H
+
+////////////////////////////////////////////////////////////////
+// Synthetic evio writer
+//
+// Packs raw apv frames into coda events with the same bank
+// layout the decoders expect from real data:
+//
+//     event bank (tag 1)
+//       -> roc bank (tag = crate id)
+//            -> data bank (tag = MPD_SSP / MPD_VME / SRS fec tag)
+//
+// The payload of the data bank follows the ssp, mpd vme or srs
+// firmware format, so the output goes through exactly the same
+// EventParser -> raw decoder -> GEMSystem path as detector data.
+
+#include "MPDDataStruct.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+class SyntheticEvioWriter
+{
+public:
+    enum class Format
+    {
+        SSP,
+        VME,
+        SRS,
+    };
+
+    // one apv in one event, adc is time sample major:
+    // adc[ts * 128 + ch], ch is the apv readout channel
+    struct APVFrame
+    {
+        APVAddress addr;
+        std::vector<int> adc;
+    };
+
+    SyntheticEvioWriter(Format f = Format::SSP);
+    ~SyntheticEvioWriter();
+
+    bool Open(const std::string &path);
+    void Close();
+    bool WriteEvent(const std::vector<APVFrame> &frames, uint32_t event_number,
+            int time_samples);
+    const std::vector<uint32_t> &BuildEvent(const std::vector<APVFrame> &frames,
+            uint32_t event_number, int time_samples);
+
+    Format GetFormat() const {return format;}
+    int GetSlotID() const {return slot_id;}
+    int GetDataBankTag() const;
+    uint64_t GetBytesWritten() const {return bytes_written;}
+
+    static bool ParseFormat(const std::string &s, Format &f);
+    static const char *FormatName(Format f);
+
+private:
+    void packSSP(const std::vector<const APVFrame*> &frames, uint32_t event_number,
+            int time_samples);
+    void packVME(const std::vector<const APVFrame*> &frames, uint32_t event_number,
+            int time_samples);
+    void packSRS(const std::vector<const APVFrame*> &frames, uint32_t event_number,
+            int time_samples);
+
+private:
+    Format format;
+    int handle = -1;
+    int slot_id = 3;
+    uint64_t bytes_written = 0;
+
+    std::vector<uint32_t> buffer;
+    std::vector<int> srs_values;
+};
+
+#endif
@@ -0,0 +1,383 @@
+#include "SyntheticEventGenerator.h"
+#include "GEMSystem.h"
+#include "GEMDetector.h"
+#include "GEMPlane.h"
+#include "GEMAPV.h"
+#include "GEMStruct.h"
+#include "CoordSystem.h"
+#include "TrackingUtility.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+////////////////////////////////////////////////////////////////
+// signal shape and size
+
+#define TIME_SAMPLE_NS 25.
+#define SHAPING_TIME_NS 50.
+#define STRIP_SPREAD_MM 0.4        // sigma of the charge spread over strips
+#define BACKGROUND_CLUSTER_SIZE 3  // strips per background cluster, to convert occupancy
+#define SIGNAL_SPREAD 0.4          // log normal width of the peak amplitude
+
+// pedestal level by readout, srs signals go down from the baseline
+#define MPD_PEDESTAL_LEVEL 1500.
+#define SRS_PEDESTAL_LEVEL 2800.
+#define PEDESTAL_SPREAD 100.
+
+////////////////////////////////////////////////////////////////
+// ctor
+
+SyntheticEventGenerator::SyntheticEventGenerator(GEMSystem *sys,
+        tracking_dev::CoordSystem *coord, SyntheticEvioWriter::Format f)
+    : gem_sys(sys), coord_system(coord), tracking_utility(new tracking_dev::TrackingUtility()),
+    format(f)
+{
+}
+
+////////////////////////////////////////////////////////////////
+// dtor
+
+SyntheticEventGenerator::~SyntheticEventGenerator()
+{
+    delete tracking_utility;
+}
+
+////////////////////////////////////////////////////////////////
+// pick apvs, draw pedestals, build strip lookup and geometry
+
+bool SyntheticEventGenerator::Initialize()
+{
+    if(gem_sys == nullptr) {
+        std::cout<<"Error: SyntheticEventGenerator: gem system not set."<<std::endl;
+        return false;
+    }
+
+    gen.seed(config.seed);
+    n_track_hits = n_background = 0;
+
+    // apvs in a fixed order, so the same seed gives the same file
+    apvs.clear();
+    for(auto &apv: gem_sys -> GetAPVList())
+        if(apv -> GetPlane() != nullptr)
+            apvs.push_back(apv);
+    std::sort(apvs.begin(), apvs.end(), [](const GEMAPV *a, const GEMAPV *b) {
+            APVAddress x = a -> GetAddress(), y = b -> GetAddress();
+            if(x.crate_id != y.crate_id) return x.crate_id < y.crate_id;
+            if(x.mpd_id != y.mpd_id) return x.mpd_id < y.mpd_id;
+            return x.adc_ch < y.adc_ch;
+            });
+    if(config.n_apvs >= 0 && config.n_apvs < static_cast<int>(apvs.size()))
+        apvs.resize(config.n_apvs);
+    else if(config.n_apvs > static_cast<int>(apvs.size()))
+        std::cout<<"Warning: SyntheticEventGenerator: "<<config.n_apvs<<" apvs requested, "
+            <<"the map has only "<<apvs.size()<<"."<<std::endl;
+
+    if(apvs.empty()) {
+        std::cout<<"Error: SyntheticEventGenerator: no apv connected to a detector plane in the map."
+            <<std::endl;
+        return false;
+    }
+
+    // pedestals
+    double level = (format == SyntheticEvioWriter::Format::SRS) ?
+        SRS_PEDESTAL_LEVEL : MPD_PEDESTAL_LEVEL;
+    std::uniform_real_distribution<double> offset_dist(level - PEDESTAL_SPREAD, level + PEDESTAL_SPREAD);
+    std::uniform_real_distribution<double> noise_dist(0.8 * config.noise, 1.2 * config.noise);
+
+    size_t frame_size = config.time_samples * APV_STRIP_SIZE;
+    pedestal_offset.assign(apvs.size(), std::vector<float>(APV_STRIP_SIZE));
+    pedestal_noise.assign(apvs.size(), std::vector<float>(APV_STRIP_SIZE));
+    signal.assign(apvs.size(), std::vector<float>(frame_size, 0.));
+    frames.resize(apvs.size());
+    for(size_t i = 0; i < apvs.size(); ++i)
+    {
+        frames[i].addr = apvs[i] -> GetAddress();
+        frames[i].adc.assign(frame_size, 0);
+        for(int ch = 0; ch < APV_STRIP_SIZE; ++ch) {
+            pedestal_offset[i][ch] = offset_dist(gen);
+            pedestal_noise[i][ch] = noise_dist(gen);
+        }
+    }
+
+    // strip positions of each plane, only the chosen apvs
+    plane_strips.clear();
+    for(size_t i = 0; i < apvs.size(); ++i)
+    {
+        GEMPlane *plane = apvs[i] -> GetPlane();
+        int key = plane -> GetDetector() -> GetDetID() * 2 + plane -> GetType();
+        auto &strips = plane_strips[key];
+        for(int ch = 0; ch < APV_STRIP_SIZE; ++ch) {
+            strip_t s;
+            s.position = plane -> GetStripPosition(apvs[i] -> GetPlaneStripNb(ch));
+            s.frame = static_cast<int>(i);
+            s.ch = ch;
+            strips.push_back(s);
+        }
+    }
+    for(auto &it: plane_strips)
+        std::sort(it.second.begin(), it.second.end(), [](const strip_t &a, const strip_t &b) {
+                return a.position < b.position;
+                });
+
+    // tracking geometry: detectors with both planes read out
+    detectors.clear();
+    reference_detector = -1;
+    if(coord_system == nullptr) {
+        std::cout<<"Warning: SyntheticEventGenerator: no tracking geometry, "
+            <<"generating background only."<<std::endl;
+        return true;
+    }
+    for(auto &det: gem_sys -> GetDetectorList())
+    {
+        int det_id = det -> GetDetID();
+        auto x_it = plane_strips.find(det_id * 2 + GEMPlane::Plane_X);
+        auto y_it = plane_strips.find(det_id * 2 + GEMPlane::Plane_Y);
+        if(x_it == plane_strips.end() || y_it == plane_strips.end())
+            continue;
+        if(!coord_system -> HasDetectorConfig(det_id))
+            continue;
+
+        detector_t d;
+        d.det_id = det_id;
+        d.offset = coord_system -> GetDetectorOffset(det_id);
+        d.z = coord_system -> GetDetectorPosition(det_id).z + d.offset.z;
+        d.strips[0] = &x_it -> second;
+        d.strips[1] = &y_it -> second;
+
+        // local -> lab rotation, from the transform of the unit vectors
+        tracking_dev::point_t ex(1., 0., 0.), ey(0., 1., 0.);
+        coord_system -> Rotate(ex, coord_system -> GetDetectorTiltAngle(det_id));
+        coord_system -> Rotate(ey, coord_system -> GetDetectorTiltAngle(det_id));
+        d.m[0][0] = ex.x; d.m[0][1] = ey.x;
+        d.m[1][0] = ex.y; d.m[1][1] = ey.y;
+
+        detectors.push_back(d);
+        if(coord_system -> IsInTrackerSystem(det_id) &&
+                (reference_detector < 0 || d.z < detectors[reference_detector].z))
+            reference_detector = static_cast<int>(detectors.size()) - 1;
+    }
+
+    if(reference_detector < 0 && config.n_tracks > 0)
+        std::cout<<"Warning: SyntheticEventGenerator: no tracking detector among the chosen apvs, "
+            <<"generating background only."<<std::endl;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// generate one event
+
+const std::vector<SyntheticEvioWriter::APVFrame> &SyntheticEventGenerator::Generate()
+{
+    for(auto &s: signal)
+        std::fill(s.begin(), s.end(), 0.f);
+
+    generateTracks();
+    generateBackground();
+    digitize();
+
+    return frames;
+}
+
+////////////////////////////////////////////////////////////////
+// straight tracks from the most upstream tracking detector
+
+void SyntheticEventGenerator::generateTracks()
+{
+    if(reference_detector < 0)
+        return;
+
+    const detector_t &ref = detectors[reference_detector];
+    std::uniform_real_distribution<double> x_dist(ref.strips[0]->front().position, ref.strips[0]->back().position);
+    std::uniform_real_distribution<double> y_dist(ref.strips[1]->front().position, ref.strips[1]->back().position);
+    std::uniform_real_distribution<double> slope_dist(-config.max_slope, config.max_slope);
+    std::uniform_real_distribution<double> t0_dist(0., TIME_SAMPLE_NS);
+    std::uniform_real_distribution<double> share_dist(0.8, 1.2);
+    std::lognormal_distribution<double> amplitude_dist(std::log(config.signal), SIGNAL_SPREAD);
+
+    for(int itrack = 0; itrack < config.n_tracks; ++itrack)
+    {
+        // origin on the reference detector, in lab coordinates
+        double u = x_dist(gen), v = y_dist(gen);
+        tracking_dev::point_t origin(ref.m[0][0] * u + ref.m[0][1] * v + ref.offset.x,
+                ref.m[1][0] * u + ref.m[1][1] * v + ref.offset.y, ref.z);
+        tracking_dev::point_t dir(slope_dist(gen), slope_dist(gen), 1.);
+        dir = dir.unit();
+
+        double t0 = t0_dist(gen);
+        for(auto &det: detectors)
+        {
+            tracking_dev::point_t p = tracking_utility -> projected_point(origin, dir, det.z);
+            if(!toLocal(det, p, u, v))
+                continue;
+
+            double ax = amplitude_dist(gen);
+            deposit(*det.strips[0], u, ax, t0);
+            deposit(*det.strips[1], v, ax * share_dist(gen), t0);
+            n_track_hits++;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// uncorrelated clusters on each plane
+
+void SyntheticEventGenerator::generateBackground()
+{
+    if(config.occupancy <= 0.)
+        return;
+
+    std::uniform_real_distribution<double> t0_dist(0., TIME_SAMPLE_NS);
+    std::lognormal_distribution<double> amplitude_dist(std::log(config.signal), SIGNAL_SPREAD);
+
+    for(auto &it: plane_strips)
+    {
+        const auto &strips = it.second;
+        std::poisson_distribution<int> n_dist(config.occupancy * strips.size() / BACKGROUND_CLUSTER_SIZE);
+        std::uniform_real_distribution<double> u_dist(strips.front().position, strips.back().position);
+
+        int n = n_dist(gen);
+        for(int i = 0; i < n; ++i)
+            deposit(strips, u_dist(gen), amplitude_dist(gen), t0_dist(gen));
+        n_background += n;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// spread one hit over the strips around u, with a CR-RC shape
+// in time
+
+void SyntheticEventGenerator::deposit(const std::vector<strip_t> &strips, double u,
+        double amplitude, double t0)
+{
+    double pulse[64];
+    int nts = std::min(config.time_samples, 64);
+    for(int ts = 0; ts < nts; ++ts) {
+        double t = (ts + 1) * TIME_SAMPLE_NS - t0;
+        pulse[ts] = (t > 0.) ? (t / SHAPING_TIME_NS) * std::exp(1. - t / SHAPING_TIME_NS) : 0.;
+    }
+
+    const double range = 3. * STRIP_SPREAD_MM;
+    auto it = std::lower_bound(strips.begin(), strips.end(), u - range,
+            [](const strip_t &s, double val) {return s.position < val;});
+
+    for(; it != strips.end() && it -> position <= u + range; ++it)
+    {
+        double d = (it -> position - u) / STRIP_SPREAD_MM;
+        double a = amplitude * std::exp(-0.5 * d * d);
+        auto &s = signal[it -> frame];
+        for(int ts = 0; ts < nts; ++ts)
+            s[ts * APV_STRIP_SIZE + it -> ch] += a * pulse[ts];
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// pedestal + common mode + noise + signal
+
+void SyntheticEventGenerator::digitize()
+{
+    std::normal_distribution<double> unit(0., 1.);
+    double polarity = (format == SyntheticEvioWriter::Format::SRS) ? -1. : 1.;
+
+    for(size_t i = 0; i < frames.size(); ++i)
+    {
+        auto &adc = frames[i].adc;
+        const auto &s = signal[i];
+        const auto &offset = pedestal_offset[i];
+        const auto &noise = pedestal_noise[i];
+
+        for(int ts = 0; ts < config.time_samples; ++ts)
+        {
+            double cm = config.common_mode_noise * unit(gen);
+            int base = ts * APV_STRIP_SIZE;
+            for(int ch = 0; ch < APV_STRIP_SIZE; ++ch) {
+                double v = offset[ch] + cm + noise[ch] * unit(gen) + polarity * s[base + ch];
+                adc[base + ch] = static_cast<int>(std::lround(v));
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// lab -> detector local coordinates, false if outside the
+// readout area
+
+bool SyntheticEventGenerator::toLocal(const detector_t &det, const tracking_dev::point_t &lab,
+        double &u, double &v) const
+{
+    double dx = lab.x - det.offset.x, dy = lab.y - det.offset.y;
+    double det_m = det.m[0][0] * det.m[1][1] - det.m[0][1] * det.m[1][0];
+    if(std::abs(det_m) < 1e-12)
+        return false;
+
+    u = ( det.m[1][1] * dx - det.m[0][1] * dy) / det_m;
+    v = (-det.m[1][0] * dx + det.m[0][0] * dy) / det_m;
+
+    return u >= det.strips[0]->front().position && u <= det.strips[0]->back().position &&
+        v >= det.strips[1]->front().position && v <= det.strips[1]->back().position;
+}
+
+////////////////////////////////////////////////////////////////
+// write the pedestal used for generation, same format as
+// GEMAPV::PrintOutPedestal
+
+bool SyntheticEventGenerator::WritePedestal(const std::string &path, int slot_id) const
+{
+    std::ofstream out(path, std::ofstream::out);
+    if(!out.is_open()) {
+        std::cout<<"Error: cannot open pedestal file: "<<path<<std::endl;
+        return false;
+    }
+
+    for(size_t i = 0; i < apvs.size(); ++i)
+    {
+        const APVAddress &addr = frames[i].addr;
+        out << "APV "
+            << std::setw(16) << addr.crate_id
+            << std::setw(16) << slot_id
+            << std::setw(16) << addr.mpd_id
+            << std::setw(16) << addr.adc_ch
+            << std::endl;
+
+        for(int ch = 0; ch < APV_STRIP_SIZE; ++ch)
+        {
+            out << std::setw(16) << ch
+                << std::setw(16) << std::setprecision(6) << pedestal_offset[i][ch]
+                << std::setw(16) << std::setprecision(4) << pedestal_noise[i][ch]
+                << std::endl;
+        }
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// write the common mode range, same format as
+// GEMAPV::PrintOutCommonModeRange
+
+bool SyntheticEventGenerator::WriteCommonModeRange(const std::string &path, int slot_id) const
+{
+    std::ofstream out(path, std::ofstream::out);
+    if(!out.is_open()) {
+        std::cout<<"Error: cannot open common mode file: "<<path<<std::endl;
+        return false;
+    }
+
+    int range = static_cast<int>(std::ceil(5. * config.common_mode_noise));
+    for(size_t i = 0; i < apvs.size(); ++i)
+    {
+        const APVAddress &addr = frames[i].addr;
+        out << std::setw(12) << addr.crate_id
+            << std::setw(12) << slot_id
+            << std::setw(12) << addr.mpd_id
+            << std::setw(12) << addr.adc_ch
+            << std::setw(12) << -range
+            << std::setw(12) << range
+            << std::endl;
+    }
+
+    return true;
+}
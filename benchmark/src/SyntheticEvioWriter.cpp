@@ -0,0 +1,417 @@
+#include "SyntheticEvioWriter.h"
+#include "RolStruct.h"
+#include "sspApvdec.h"
+#include "MPDVMERawEventDecoder.h"
+#include "SRSRawEventDecoder.h"
+#include "evio.h"
+
+#include <iostream>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////
+// apv frame layout
+
+#define APV_CHANNELS 128
+#define SSP_FIRMWARE_TIME_SAMPLES 6
+
+// srs frame: 3 sync words + 8 address + 1 error bit, then 128 channels
+#define SRS_SYNC_WORDS 3
+#define SRS_ADDRESS_WORDS 9
+#define SRS_IDLE_WORDS 4
+#define SRS_SYNC_LEVEL (APV_HEADER - 500)
+#define SRS_HIGH_LEVEL (APV_HEADER + 1300)
+
+////////////////////////////////////////////////////////////////
+// evio bank types, see the evio user guide
+
+#define EVIO_BANK_OF_BANKS 0x10
+#define EVIO_UINT32 0x1
+#define CODA_PHYSICS_EVENT_TAG 1
+
+////////////////////////////////////////////////////////////////
+// ctor
+
+SyntheticEvioWriter::SyntheticEvioWriter(Format f)
+    : format(f)
+{
+}
+
+////////////////////////////////////////////////////////////////
+// dtor
+
+SyntheticEvioWriter::~SyntheticEvioWriter()
+{
+    Close();
+}
+
+////////////////////////////////////////////////////////////////
+// open evio file for writing
+
+bool SyntheticEvioWriter::Open(const std::string &path)
+{
+    Close();
+
+    int status = evOpen(const_cast<char*>(path.c_str()), const_cast<char*>("w"), &handle);
+    if(status != S_SUCCESS) {
+        std::cout<<"Error: SyntheticEvioWriter cannot open file: "<<path<<std::endl;
+        handle = -1;
+        return false;
+    }
+
+    bytes_written = 0;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// close evio file
+
+void SyntheticEvioWriter::Close()
+{
+    if(handle < 0)
+        return;
+
+    evClose(handle);
+    handle = -1;
+}
+
+////////////////////////////////////////////////////////////////
+// build and write one event
+
+bool SyntheticEvioWriter::WriteEvent(const std::vector<APVFrame> &frames,
+        uint32_t event_number, int time_samples)
+{
+    if(handle < 0) {
+        std::cout<<"Error: SyntheticEvioWriter: no file opened."<<std::endl;
+        return false;
+    }
+
+    const std::vector<uint32_t> &buf = BuildEvent(frames, event_number, time_samples);
+    if(evWrite(handle, buf.data()) != S_SUCCESS) {
+        std::cout<<"Error: SyntheticEvioWriter: failed writing event "<<event_number<<std::endl;
+        return false;
+    }
+
+    bytes_written += buf.size() * sizeof(uint32_t);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// build one coda event, one roc bank per crate
+
+const std::vector<uint32_t> &SyntheticEvioWriter::BuildEvent(
+        const std::vector<APVFrame> &frames, uint32_t event_number, int time_samples)
+{
+    buffer.clear();
+
+    // sort apvs by address, so each crate/mpd is one contiguous block
+    std::vector<const APVFrame*> sorted;
+    sorted.reserve(frames.size());
+    for(auto &f: frames)
+        sorted.push_back(&f);
+    std::sort(sorted.begin(), sorted.end(), [](const APVFrame *a, const APVFrame *b) {
+            if(a->addr.crate_id != b->addr.crate_id) return a->addr.crate_id < b->addr.crate_id;
+            if(a->addr.mpd_id != b->addr.mpd_id) return a->addr.mpd_id < b->addr.mpd_id;
+            return a->addr.adc_ch < b->addr.adc_ch;
+            });
+
+    // a bank header is 2 words, the length word does not count itself
+    auto open_bank = [&](int tag, int type) -> size_t
+    {
+        size_t pos = buffer.size();
+        buffer.push_back(0);
+        buffer.push_back(((static_cast<uint32_t>(tag) & 0xffff) << 16) | ((type & 0x3f) << 8));
+        return pos;
+    };
+    auto close_bank = [&](size_t pos)
+    {
+        buffer[pos] = static_cast<uint32_t>(buffer.size() - pos - 1);
+    };
+
+    size_t event_pos = open_bank(CODA_PHYSICS_EVENT_TAG, EVIO_BANK_OF_BANKS);
+
+    size_t i = 0;
+    while(i < sorted.size())
+    {
+        int crate = sorted[i]->addr.crate_id;
+        size_t j = i;
+        while(j < sorted.size() && sorted[j]->addr.crate_id == crate)
+            j++;
+        std::vector<const APVFrame*> crate_frames(sorted.begin() + i, sorted.begin() + j);
+
+        size_t roc_pos = open_bank(crate, EVIO_BANK_OF_BANKS);
+        size_t data_pos = open_bank(GetDataBankTag(), EVIO_UINT32);
+
+        switch(format)
+        {
+            case Format::SSP:
+                packSSP(crate_frames, event_number, time_samples);
+                break;
+            case Format::VME:
+                packVME(crate_frames, event_number, time_samples);
+                break;
+            case Format::SRS:
+                packSRS(crate_frames, event_number, time_samples);
+                break;
+        }
+
+        close_bank(data_pos);
+        close_bank(roc_pos);
+        i = j;
+    }
+
+    close_bank(event_pos);
+    return buffer;
+}
+
+////////////////////////////////////////////////////////////////
+// tag of the data bank holding apv data
+
+int SyntheticEvioWriter::GetDataBankTag() const
+{
+    switch(format)
+    {
+        case Format::SSP:
+            return static_cast<int>(Bank_TagID::MPD_SSP);
+        case Format::VME:
+            return static_cast<int>(Bank_TagID::MPD_VME);
+        case Format::SRS:
+            return Fec_Bank_Tag[0];
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////
+// ssp format: block header, event header, trigger time, then
+// one mpd frame per mpd and 3 words per apv channel
+
+void SyntheticEvioWriter::packSSP(const std::vector<const APVFrame*> &frames,
+        uint32_t event_number, int time_samples)
+{
+    // the ssp firmware always ships 6 time samples
+    auto sample = [&](const APVFrame *f, int ts, int ch) -> uint32_t
+    {
+        int v = 0;
+        if(ts < time_samples && ts * APV_CHANNELS + ch < static_cast<int>(f->adc.size()))
+            v = f->adc[ts * APV_CHANNELS + ch];
+        v = std::max(-4096, std::min(4095, v)); // 13 bit signed
+        return static_cast<uint32_t>(v) & 0x1fff;
+    };
+
+    size_t block_start = buffer.size();
+
+    block_header_t bh; bh.raw = 0;
+    bh.bf.data_type_defining = 1;
+    bh.bf.data_type_tag = 0;
+    bh.bf.slot_number = slot_id;
+    bh.bf.number_of_events_in_block = 1;
+    bh.bf.event_block_number = event_number & 0x3ff;
+    buffer.push_back(bh.raw);
+
+    sspApv_event_header_t eh; eh.raw = 0;
+    eh.bf.data_type_defining = 1;
+    eh.bf.data_type_tag = 2;
+    eh.bf.trigger_number = event_number & 0x7ffffff;
+    buffer.push_back(eh.raw);
+
+    sspApv_trigger_time_1_t t1; t1.raw = 0;
+    t1.bf.data_type_defining = 1;
+    t1.bf.data_type_tag = 3;
+    t1.bf.trigger_time_l = (event_number * 100) & 0xffffff;
+    buffer.push_back(t1.raw);
+    sspApv_trigger_time_2_t t2; t2.raw = 0;
+    t2.bf.trigger_time_h = ((event_number * 100) >> 24) & 0xffffff;
+    buffer.push_back(t2.raw);
+
+    int current_mpd = -1;
+    for(auto &f: frames)
+    {
+        if(f->addr.mpd_id != current_mpd) {
+            current_mpd = f->addr.mpd_id;
+
+            sspApv_mpd_frame_1_t mf; mf.raw = 0;
+            mf.bf.data_type_defining = 1;
+            mf.bf.data_type_tag = 5;
+            mf.bf.fiber = current_mpd & 0x3f;
+            mf.bf.mpd_id = current_mpd & 0x1f;
+            mf.bf.flags = 0;
+            buffer.push_back(mf.raw);
+        }
+
+        for(int ch = 0; ch < APV_CHANNELS; ++ch)
+        {
+            sspApv_apv_data_1_t d1; d1.raw = 0;
+            d1.bf.apv_channel_num_40 = ch & 0x1f;
+            d1.bf.apv_sample0 = sample(f, 0, ch);
+            d1.bf.apv_sample1 = sample(f, 1, ch);
+            buffer.push_back(d1.raw);
+
+            sspApv_apv_data_2_t d2; d2.raw = 0;
+            d2.bf.apv_channel_num_65 = (ch >> 5) & 0x3;
+            d2.bf.apv_sample2 = sample(f, 2, ch);
+            d2.bf.apv_sample3 = sample(f, 3, ch);
+            buffer.push_back(d2.raw);
+
+            sspApv_apv_data_3_t d3; d3.raw = 0;
+            d3.bf.apv_id = f->addr.adc_ch & 0x1f;
+            d3.bf.apv_sample4 = sample(f, 4, ch);
+            d3.bf.apv_sample5 = sample(f, 5, ch);
+            buffer.push_back(d3.raw);
+        }
+    }
+
+    block_trailer_t bt; bt.raw = 0;
+    bt.bf.data_type_defining = 1;
+    bt.bf.data_type_tag = 1;
+    bt.bf.slot_number = slot_id;
+    bt.bf.words_in_block = (buffer.size() - block_start + 1) & 0x3fffff;
+    buffer.push_back(bt.raw);
+
+    if(time_samples > SSP_FIRMWARE_TIME_SAMPLES)
+        std::cout<<"Warning: SyntheticEvioWriter: ssp format holds "<<SSP_FIRMWARE_TIME_SAMPLES
+            <<" time samples, the rest are dropped."<<std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+// mpd vme format: one block per mpd, apv data words carry the
+// apv header, 128 adc values + 1 trailer per time sample
+
+void SyntheticEvioWriter::packVME(const std::vector<const APVFrame*> &frames,
+        uint32_t event_number, int time_samples)
+{
+    auto word = [](MPD_VME_Raw_Data_Type type, uint32_t payload) -> uint32_t
+    {
+        return (static_cast<uint32_t>(type) << 21) | (payload & 0x1fffff);
+    };
+    auto apv_word = [&](APV_Ch_Data_Info info, uint32_t payload) -> uint32_t
+    {
+        return word(MPD_VME_Raw_Data_Type::APV_Ch_Data,
+                (static_cast<uint32_t>(info) << 19) | (payload & 0x7ffff));
+    };
+
+    size_t i = 0;
+    while(i < frames.size())
+    {
+        int mpd = frames[i]->addr.mpd_id;
+        size_t block_start = buffer.size();
+
+        buffer.push_back(word(MPD_VME_Raw_Data_Type::Block_Header, (mpd & 0x1f) << 16));
+        buffer.push_back(word(MPD_VME_Raw_Data_Type::Event_Header, event_number & 0xfffff));
+
+        uint64_t clock_counts = static_cast<uint64_t>(event_number) * 100;
+        buffer.push_back(word(MPD_VME_Raw_Data_Type::Trigger_Time, (clock_counts >> 20) & 0xfffff));
+        buffer.push_back(word(MPD_VME_Raw_Data_Type::Trigger_Time, (1 << 20) | (clock_counts & 0xfffff)));
+
+        size_t event_start = buffer.size();
+        for(; i < frames.size() && frames[i]->addr.mpd_id == mpd; ++i)
+        {
+            const APVFrame *f = frames[i];
+            buffer.push_back(apv_word(APV_Ch_Data_Info::APV_Header, f->addr.adc_ch & 0xf));
+
+            for(int ts = 0; ts < time_samples; ++ts)
+            {
+                for(int ch = 0; ch < APV_CHANNELS; ++ch)
+                {
+                    int v = 0;
+                    if(ts * APV_CHANNELS + ch < static_cast<int>(f->adc.size()))
+                        v = f->adc[ts * APV_CHANNELS + ch];
+                    v = std::max(0, std::min(4095, v)); // 12 bit adc
+                    buffer.push_back(apv_word(APV_Ch_Data_Info::ADC_Value, v));
+                }
+                buffer.push_back(apv_word(APV_Ch_Data_Info::APV_Trailer, (ts & 0xf) << 8));
+            }
+            buffer.push_back(apv_word(APV_Ch_Data_Info::Trailer, 0));
+        }
+
+        // event trailer: word count and fine trigger time, leading bit 0
+        uint32_t n_words = (buffer.size() - event_start + 1) & 0xfff;
+        buffer.push_back(word(MPD_VME_Raw_Data_Type::Event_Trailer, n_words << 8));
+        buffer.push_back(word(MPD_VME_Raw_Data_Type::Block_Trailer,
+                    (buffer.size() - block_start + 1) & 0xfffff));
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// srs format: per apv a frame counter, the "ADC" + channel word
+// and the fec word, then 16 bit values packed in byte swapped
+// pairs; 0xfafafafa closes the fec data.
+// each time sample is 3 sync words below APV_HEADER, 9 address
+// and error words, then the 128 channels.
+
+void SyntheticEvioWriter::packSRS(const std::vector<const APVFrame*> &frames,
+        uint32_t event_number, int time_samples)
+{
+    // inverse of SRSRawEventDecoder::Word32ToWord16
+    auto pack = [](int v1, int v2) -> uint32_t
+    {
+        uint32_t a = static_cast<uint32_t>(std::max(0, std::min(0xffff, v1)));
+        uint32_t b = static_cast<uint32_t>(std::max(0, std::min(0xffff, v2)));
+        return ((a & 0xff) << 24) | (((a >> 8) & 0xff) << 16) | ((b & 0xff) << 8) | ((b >> 8) & 0xff);
+    };
+
+    for(auto &f: frames)
+    {
+        srs_values.clear();
+        for(int k = 0; k < SRS_IDLE_WORDS; ++k)
+            srs_values.push_back(SRS_HIGH_LEVEL);
+
+        for(int ts = 0; ts < time_samples; ++ts)
+        {
+            for(int k = 0; k < SRS_SYNC_WORDS; ++k)
+                srs_values.push_back(SRS_SYNC_LEVEL);
+            for(int k = 0; k < SRS_ADDRESS_WORDS; ++k)
+                srs_values.push_back(SRS_HIGH_LEVEL);
+            for(int ch = 0; ch < APV_CHANNELS; ++ch)
+            {
+                int v = 0;
+                if(ts * APV_CHANNELS + ch < static_cast<int>(f->adc.size()))
+                    v = f->adc[ts * APV_CHANNELS + ch];
+                srs_values.push_back(std::max(0, std::min(4095, v)));
+            }
+        }
+
+        for(int k = 0; k < SRS_IDLE_WORDS; ++k)
+            srs_values.push_back(SRS_HIGH_LEVEL);
+        if(srs_values.size() % 2)
+            srs_values.push_back(SRS_HIGH_LEVEL);
+
+        buffer.push_back(event_number & 0xffffff);                     // frame counter
+        buffer.push_back((0x414443u << 8) | (f->addr.adc_ch & 0xff));  // "ADC" + adc channel
+        buffer.push_back((f->addr.mpd_id & 0xff) << 16);               // fec id
+
+        for(size_t k = 0; k < srs_values.size(); k += 2)
+            buffer.push_back(pack(srs_values[k], srs_values[k+1]));
+    }
+
+    buffer.push_back(0xfafafafa);
+}
+
+////////////////////////////////////////////////////////////////
+// format name <-> enum
+
+bool SyntheticEvioWriter::ParseFormat(const std::string &s, Format &f)
+{
+    if(s == "ssp" || s == "SSP" || s == "vtp" || s == "VTP") {
+        f = Format::SSP;
+        return true;
+    }
+    if(s == "vme" || s == "VME") {
+        f = Format::VME;
+        return true;
+    }
+    if(s == "srs" || s == "SRS") {
+        f = Format::SRS;
+        return true;
+    }
+    return false;
+}
+
+const char *SyntheticEvioWriter::FormatName(Format f)
+{
+    switch(f)
+    {
+        case Format::SSP: return "ssp";
+        case Format::VME: return "vme";
+        case Format::SRS: return "srs";
+    }
+    return "unknown";
+}
@@ -0,0 +1,457 @@
+////////////////////////////////////////////////////////////////
+// gem_benchmark
+//
+// Offline benchmarks on synthetic data:
+//
+//     gem_benchmark generate <file.evio>  write a synthetic run, plus the
+//                                         pedestal and common mode files
+//     gem_benchmark decode   <file.evio>  event parser + raw decoder
+//     gem_benchmark zs       <file.evio>  + apv fill and zero suppression
+//     gem_benchmark cluster  <file.evio>  + clustering
+//     gem_benchmark tracking <file.evio>  + tracking
+//     gem_benchmark replay   <file.evio>  + cluster root tree output
+//     gem_benchmark all      <file.evio>  generate, then all of the above
+//
+// Events are loaded into memory first, so the numbers do not
+// depend on the disk. Results are printed in events/s and can be
+// appended to a csv file (--report) to follow them over time.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "ConfigArgs.h"
+#include "EvioFileReader.h"
+#include "EventParser.h"
+#include "MPDSSPRawEventDecoder.h"
+#include "MPDVMERawEventDecoder.h"
+#include "SRSRawEventDecoder.h"
+#include "GEMSystem.h"
+#include "GEMDataHandler.h"
+#include "GEMReplayStats.h"
+#include "TrackingDataHandler.h"
+#include "Tracking.h"
+#include "CoordSystem.h"
+#include "SyntheticEvioWriter.h"
+#include "SyntheticEventGenerator.h"
+#include "hardcode.h"
+
+#define PROGRESS_COUNT 1000
+
+struct bench_result_t
+{
+    std::string name;
+    int events = 0;
+    double seconds = 0.;
+    double tracks = 0.;    // tracks found per event, tracking only
+};
+
+struct bench_input_t
+{
+    std::string evio_file;
+    std::string pedestal_file;
+    std::string common_mode_file;
+    std::string output_file;
+    int nev = 0;
+    std::vector<std::vector<uint32_t>> events;
+};
+
+static SyntheticEvioWriter::Format build_format();
+static std::string default_path(const std::string &evio_file, const std::string &suffix);
+static bench_result_t generate(GEMSystem *gem_sys, SyntheticEvioWriter::Format format,
+        const SyntheticEventGenerator::Config &conf, const bench_input_t &in);
+static bool load_events(bench_input_t &in);
+static bench_result_t bench_decode(SyntheticEvioWriter::Format format, const bench_input_t &in);
+static bench_result_t bench_replay(GEMSystem *gem_sys, const std::string &name, const bench_input_t &in);
+static void print_results(const std::vector<bench_result_t> &results, std::ostream &os);
+static void write_report(const std::vector<bench_result_t> &results, const std::string &path);
+
+int main(int argc, char* argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddPositional("mode", "generate, decode, zs, cluster, tracking, replay or all");
+    arg_parser.AddPositional("evio_file", "synthetic data file in evio format");
+    arg_parser.AddArg<int>("-n", "nev", "number of events to generate/process", 10000);
+    arg_parser.AddArgs<std::string>({"--format"}, "format", "readout format: ssp, vme or srs (default: the one this build decodes)",
+            SyntheticEvioWriter::FormatName(build_format()));
+    arg_parser.AddArgs<int>({"--apvs"}, "apvs", "number of apvs taken from the gem map (< 0 means all)", -1);
+    arg_parser.AddArgs<int>({"--tracks"}, "tracks", "tracks per event", 1);
+    arg_parser.AddArgs<double>({"--occupancy"}, "occupancy", "fraction of strips fired by background", 0.01);
+    arg_parser.AddArgs<double>({"--noise"}, "noise", "strip noise (adc)", 5.);
+    arg_parser.AddArgs<double>({"--cm_noise"}, "cm_noise", "common mode spread per time sample (adc)", 10.);
+    arg_parser.AddArgs<double>({"--signal"}, "signal", "most probable signal amplitude (adc)", 600.);
+    arg_parser.AddArgs<double>({"--max_slope"}, "max_slope", "maximum track slope", 0.1);
+    arg_parser.AddArgs<int>({"--seed"}, "seed", "random seed", 1);
+    arg_parser.AddArgs<std::string>({"--pedestal"}, "pedestal_file", "pedestal file (default: <evio_file>_ped.dat)", "");
+    arg_parser.AddArgs<std::string>({"--common_mode"}, "common_mode_file", "common mode file (default: <evio_file>_cm.txt)", "");
+    arg_parser.AddArgs<std::string>({"--output_root_filename"}, "output_root_filename", "cluster tree of the replay benchmark", "");
+    arg_parser.AddArgs<std::string>({"--report"}, "report_file", "append the results to this csv file", "");
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    // show arguments
+    for(auto &it : args) {
+        std::cout << it.first << ": " << it.second.String() << std::endl;
+    }
+
+    std::string mode = args["mode"].String();
+    if(mode != "generate" && mode != "decode" && mode != "zs" && mode != "cluster" &&
+            mode != "tracking" && mode != "replay" && mode != "all") {
+        std::cout<<"ERROR:: unknown benchmark mode: "<<mode<<std::endl;
+        return -1;
+    }
+
+    SyntheticEvioWriter::Format format;
+    if(!SyntheticEvioWriter::ParseFormat(args["format"].String(), format)) {
+        std::cout<<"ERROR:: unknown readout format: "<<args["format"].String()<<std::endl;
+        return -1;
+    }
+
+    bench_input_t in;
+    in.evio_file = args["evio_file"].String();
+    in.nev = args["nev"].Int();
+    in.pedestal_file = args["pedestal_file"].String();
+    if(in.pedestal_file.size() <= 0)
+        in.pedestal_file = default_path(in.evio_file, "_ped.dat");
+    in.common_mode_file = args["common_mode_file"].String();
+    if(in.common_mode_file.size() <= 0)
+        in.common_mode_file = default_path(in.evio_file, "_cm.txt");
+    in.output_file = args["output_root_filename"].String();
+
+    SyntheticEventGenerator::Config conf;
+    conf.n_apvs = args["apvs"].Int();
+    conf.n_tracks = args["tracks"].Int();
+    conf.occupancy = args["occupancy"].Double();
+    conf.noise = args["noise"].Double();
+    conf.common_mode_noise = args["cm_noise"].Double();
+    conf.signal = args["signal"].Double();
+    conf.max_slope = args["max_slope"].Double();
+    conf.seed = static_cast<unsigned int>(args["seed"].Int());
+
+    // -: gem system
+    GEMSystem *gem_system = new GEMSystem();
+    gem_system -> Configure("config/gem.conf");
+
+    std::vector<bench_result_t> results;
+
+    // -: synthetic data
+    if(mode == "generate" || mode == "all")
+        results.push_back(generate(gem_system, format, conf, in));
+
+    // -: benchmarks
+    if(mode != "generate")
+    {
+        if(mode != "decode" && format != build_format()) {
+            std::cout<<"WARNING:: this build decodes "<<SyntheticEvioWriter::FormatName(build_format())
+                <<" data, the "<<SyntheticEvioWriter::FormatName(format)
+                <<" file will only be used for the decode benchmark."<<std::endl;
+        }
+
+        if(!load_events(in))
+            return -1;
+
+        if(mode == "decode" || mode == "all")
+            results.push_back(bench_decode(format, in));
+
+        if(format == build_format()) {
+            for(auto &name: {"zs", "cluster", "tracking", "replay"})
+                if(mode == name || mode == "all")
+                    results.push_back(bench_replay(gem_system, name, in));
+        }
+    }
+
+    print_results(results, std::cout);
+    if(args["report_file"].String().size() > 0)
+        write_report(results, args["report_file"].String());
+
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////
+// readout format of this build, see hardcode.h
+
+static SyntheticEvioWriter::Format build_format()
+{
+#ifdef USE_VME
+    return SyntheticEvioWriter::Format::VME;
+#elif defined(USE_SRS)
+    return SyntheticEvioWriter::Format::SRS;
+#else
+    return SyntheticEvioWriter::Format::SSP;
+#endif
+}
+
+////////////////////////////////////////////////////////////////
+// <evio_file without .evio> + suffix
+
+static std::string default_path(const std::string &evio_file, const std::string &suffix)
+{
+    std::string stem = evio_file;
+    size_t pos = stem.rfind(".evio");
+    if(pos != std::string::npos)
+        stem = stem.substr(0, pos);
+    return stem + suffix;
+}
+
+////////////////////////////////////////////////////////////////
+// write a synthetic run
+
+static bench_result_t generate(GEMSystem *gem_sys, SyntheticEvioWriter::Format format,
+        const SyntheticEventGenerator::Config &conf, const bench_input_t &in)
+{
+    bench_result_t res;
+    res.name = "generate";
+
+    tracking_dev::CoordSystem coord_system;
+    SyntheticEventGenerator generator(gem_sys, &coord_system, format);
+    generator.SetConfig(conf);
+    if(!generator.Initialize())
+        exit(-1);
+
+    SyntheticEvioWriter writer(format);
+    if(!writer.Open(in.evio_file))
+        exit(-1);
+
+    std::cout<<"INFO:: generating "<<in.nev<<" "<<SyntheticEvioWriter::FormatName(format)
+        <<" events with "<<generator.GetNAPVs()<<" apvs to: "<<in.evio_file<<std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<in.nev; i++)
+    {
+        if((i % PROGRESS_COUNT) == 0)
+            std::cout<<"Generated events - "<<i<<"\r"<<std::flush;
+
+        writer.WriteEvent(generator.Generate(), i, conf.time_samples);
+    }
+    writer.Close();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    res.events = in.nev;
+
+    std::cout<<"INFO:: "<<writer.GetBytesWritten() / 1024. / 1024.<<" MB written, "
+        <<generator.GetTrackHits() / std::max(in.nev, 1)<<" track hits and "
+        <<generator.GetBackgroundClusters() / std::max(in.nev, 1)<<" background clusters per event."
+        <<std::endl;
+
+    // the pedestal used to generate the data, for the replay
+    std::cout<<"INFO:: saving pedestal file to : "<<in.pedestal_file<<std::endl;
+    generator.WritePedestal(in.pedestal_file, writer.GetSlotID());
+    std::cout<<"INFO:: saving commonMode file to : "<<in.common_mode_file<<std::endl;
+    generator.WriteCommonModeRange(in.common_mode_file, writer.GetSlotID());
+
+    return res;
+}
+
+////////////////////////////////////////////////////////////////
+// load the whole file into memory, timed as read
+
+static bool load_events(bench_input_t &in)
+{
+    EvioFileReader evio_reader;
+    evio_reader.SetFile(in.evio_file);
+    if(!evio_reader.OpenFile()) {
+        std::cout<<"Cannot open evio file: "<<in.evio_file<<std::endl;
+        std::cout<<"please check your evio file path."<<std::endl;
+        return false;
+    }
+
+    GEMReplayStats stats;
+    const uint32_t *pBuf;
+    uint32_t fBufLen;
+    while(static_cast<int>(in.events.size()) < in.nev)
+    {
+        GEMReplayStats::Timer timer(&stats, GEMReplayStats::Read);
+        if(evio_reader.ReadNoCopy(&pBuf, &fBufLen) != S_SUCCESS)
+            break;
+        in.events.emplace_back(pBuf, pBuf + fBufLen);
+    }
+    evio_reader.CloseFile();
+
+    if(in.events.empty()) {
+        std::cout<<"ERROR:: no event in evio file: "<<in.evio_file<<std::endl;
+        return false;
+    }
+
+    std::cout<<"INFO:: loaded "<<in.events.size()<<" events in "
+        <<stats.GetStageSeconds(GEMReplayStats::Read)<<" s";
+    if(static_cast<int>(in.events.size()) < in.nev)
+        std::cout<<", they will be reused to reach "<<in.nev<<" events";
+    std::cout<<std::endl;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// event parser + raw decoder only
+
+static bench_result_t bench_decode(SyntheticEvioWriter::Format format, const bench_input_t &in)
+{
+    bench_result_t res;
+    res.name = "decode";
+
+    EventParser event_parser;
+    AbstractRawDecoder *decoder = nullptr;
+    const std::unordered_map<APVAddress, std::vector<int>> *apvs = nullptr;
+    switch(format) {
+        case SyntheticEvioWriter::Format::VME:
+            {
+                MPDVMERawEventDecoder *d = new MPDVMERawEventDecoder();
+                apvs = &d -> GetAPV();
+                decoder = d;
+            }
+            break;
+        case SyntheticEvioWriter::Format::SRS:
+            {
+                SRSRawEventDecoder *d = new SRSRawEventDecoder();
+                apvs = &d -> GetAPV();
+                decoder = d;
+            }
+            break;
+        default:
+            {
+                MPDSSPRawEventDecoder *d = new MPDSSPRawEventDecoder();
+                apvs = &d -> GetAPV();
+                decoder = d;
+            }
+            break;
+    }
+    event_parser.RegisterRawDecoder(SyntheticEvioWriter(format).GetDataBankTag(), decoder);
+
+    GEMReplayStats stats;
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<in.nev; i++)
+    {
+        const std::vector<uint32_t> &ev = in.events[i % in.events.size()];
+        {
+            GEMReplayStats::Timer timer(&stats, GEMReplayStats::Parse);
+            event_parser.ParseEvent(ev.data(), ev.size());
+        }
+        stats.AddCount(GEMReplayStats::APVs, apvs -> size());
+        stats.EndOfEvent();
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    res.events = in.nev;
+
+    std::cout<<"---- decode ----"<<std::endl;
+    stats.Print(std::cout);
+
+    delete decoder;
+    return res;
+}
+
+////////////////////////////////////////////////////////////////
+// the replay chain, stopped after zero suppression, clustering,
+// tracking or the root tree
+
+static bench_result_t bench_replay(GEMSystem *gem_sys, const std::string &name, const bench_input_t &in)
+{
+    bench_result_t res;
+    res.name = name;
+
+    bool do_cluster = (name != "zs");
+    bool do_tracking = (name == "tracking" || name == "replay");
+    bool do_tree = (name == "replay");
+
+    GEMReplayStats stats;
+
+    GEMDataHandler *gem_data_handler = new GEMDataHandler();
+    gem_data_handler -> SetGEMSystem(gem_sys);
+    gem_data_handler -> RegisterRawDecoders();
+    gem_data_handler -> SetReplayMode(true);
+    if(do_cluster)
+        gem_data_handler -> TurnOnClustering();
+    else
+        gem_data_handler -> TurnOffClustering();
+    if(!do_tree)
+        gem_data_handler -> DisableOutputRootTree();
+    gem_data_handler -> SetupReplay(in.evio_file, 0, -1, in.pedestal_file, in.common_mode_file);
+    if(in.output_file.size() > 0)
+        gem_data_handler -> SetClusterRootFileName(in.output_file);
+    gem_data_handler -> SetReplayStats(&stats);
+
+    tracking_dev::TrackingDataHandler *tracking_data_handler = nullptr;
+    tracking_dev::Tracking *tracking = nullptr;
+    if(do_tracking) {
+        tracking_data_handler = new tracking_dev::TrackingDataHandler();
+        tracking_data_handler -> SetGEMSystem(gem_sys);
+        tracking_data_handler -> SetGEMDataHandler(gem_data_handler);
+        tracking_data_handler -> Init();
+        tracking_data_handler -> SetupDetector();
+        tracking = tracking_data_handler -> GetTrackingHandle();
+    }
+
+    long long tracks_found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i<in.nev; i++)
+    {
+        const std::vector<uint32_t> &ev = in.events[i % in.events.size()];
+        gem_data_handler -> ProcessEvent(ev.data(), ev.size(), i);
+        gem_data_handler -> EndofThisEvent(i);
+
+        if(do_tracking) {
+            {
+                GEMReplayStats::Timer timer(&stats, GEMReplayStats::Tracking);
+                tracking_data_handler -> ClearPrevEvent();
+                tracking_data_handler -> PackageEventData();
+                tracking -> FindTracks();
+            }
+            stats.AddCount(GEMReplayStats::TrackCandidates, tracking -> GetNCandidatesTested());
+            stats.AddCount(GEMReplayStats::AbortedLayerGroups, tracking -> GetNAbortedLayerGroups());
+            tracks_found += tracking -> GetNTracksFound();
+        }
+        stats.EndOfEvent();
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    res.events = in.nev;
+    res.tracks = in.nev > 0 ? static_cast<double>(tracks_found) / in.nev : 0.;
+
+    if(do_tree) {
+        GEMReplayStats::Timer timer(&stats, GEMReplayStats::TreeFill);
+        gem_data_handler -> Write();
+    }
+
+    std::cout<<"---- "<<name<<" ----"<<std::endl;
+    stats.Print(std::cout);
+
+    delete tracking_data_handler;
+    delete gem_data_handler;
+    return res;
+}
+
+////////////////////////////////////////////////////////////////
+// summary table
+
+static void print_results(const std::vector<bench_result_t> &results, std::ostream &os)
+{
+    os<<std::endl<<"benchmark summary:"<<std::endl;
+    os<<std::setw(12)<<"benchmark"<<std::setw(12)<<"events"<<std::setw(14)<<"time (s)"
+        <<std::setw(14)<<"events/s"<<std::setw(14)<<"tracks/event"<<std::endl;
+    for(auto &r: results) {
+        os<<std::setw(12)<<r.name<<std::setw(12)<<r.events<<std::setw(14)<<r.seconds
+            <<std::setw(14)<<(r.seconds > 0 ? r.events / r.seconds : 0.)
+            <<std::setw(14)<<r.tracks<<std::endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// append results to a csv file, header on a new file
+
+static void write_report(const std::vector<bench_result_t> &results, const std::string &path)
+{
+    bool new_file = !std::ifstream(path).good();
+
+    std::ofstream f(path, std::ofstream::out | std::ofstream::app);
+    if(!f.is_open()) {
+        std::cout<<"ERROR: cannot open benchmark report file: "<<path<<std::endl;
+        return;
+    }
+
+    if(new_file)
+        f<<"name,events,seconds,events_per_s,tracks_per_event"<<std::endl;
+    for(auto &r: results) {
+        f<<r.name<<","<<r.events<<","<<r.seconds<<","
+            <<(r.seconds > 0 ? r.events / r.seconds : 0.)<<","<<r.tracks<<std::endl;
+    }
+}
@@ -0,0 +1,704 @@
+////////////////////////////////////////////////////////////////
+// gem_microbench
+//
+// Isolated timing of the per-apv and per-event kernels:
+//
+//     cm_correction   GEMAPV::CommonModeCorrection_MPD/SRS   ns/apv
+//     cm_sorting      GEMAPV::dynamic_ts_common_mode_sorting ns/apv
+//     cm_danning      GEMAPV::dynamic_ts_common_mode_danning ns/apv
+//     zero_sup        GEMAPV::FillRawData + ZeroSuppression  ns/apv
+//     form_clusters   GEMCluster::FormClusters               ns/event
+//     find_tracks     Tracking::FindTracks                   ns/event
+//     epics_parse     EPICSystem::FillRawData                ns/bank
+//
+// APV frames are recorded from an evio file first (--evio_file, for
+// example a file written by "gem_benchmark generate"), then every
+// gem kernel is fed the same frames / strip hit lists. The kernel
+// outputs can be saved as golden outputs (--golden_out) and checked
+// against a saved file (--golden): a performance change on a kernel
+// must not change its output beyond --tolerance (0 = bitwise).
+//
+// By default the kernels run on the recorded sample in benchmark/data
+// (10 events of 8 APVs written by "gem_benchmark generate" with the
+// default seed, with its pedestal and common mode files), and are
+// checked against benchmark/data/microbench_golden.txt. Regenerate the
+// golden file with --golden_out only for an intended output change.
+// The golden check is off (--golden none) by default for another evio
+// file. A kernel whose input file is missing is skipped, and so are
+// its golden outputs.
+//
+// epics_parse times the text EPICS bank parse (--epics_bank), its
+// values are checked by epics_test (epics/test/epics_test.cpp).
+//
+// The FADC250 kernels have their own targets: fadc_decoder_test
+// (fadc/test/decoder_test.cpp) decodes a recorded bank without
+// allocations, fadc_analyzer_test (fadc/test/analyzer_test.cpp)
+// checks and times the waveform analysis.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include "ConfigArgs.h"
+#include "EvioFileReader.h"
+#include "EventParser.h"
+#include "MPDSSPRawEventDecoder.h"
+#include "MPDVMERawEventDecoder.h"
+#include "SRSRawEventDecoder.h"
+#include "RolStruct.h"
+#include "GEMSystem.h"
+#include "GEMDetector.h"
+#include "GEMPlane.h"
+#include "GEMAPV.h"
+#include "GEMCluster.h"
+#include "TrackingDataHandler.h"
+#include "Tracking.h"
+#include "hardcode.h"
+#include "EPICSystem.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+// one decoded apv in one event
+struct apv_frame_t
+{
+    GEMAPV *apv;
+    std::vector<int> raw;
+    APVDataType flags;
+};
+
+// one recorded event
+struct recorded_event_t
+{
+    std::vector<apv_frame_t> frames;
+    std::vector<std::vector<StripHit>> plane_hits;  // zero suppressed hits, per plane
+    EventData zs_data;
+};
+
+////////////////////////////////////////////////////////////////
+// timing of one kernel
+
+struct kernel_stat_t
+{
+    std::string name;
+    std::string unit;       // "apv" or "event"
+    uint64_t calls = 0;     // number of units processed
+    bench_clock::duration time = bench_clock::duration::zero();
+};
+
+////////////////////////////////////////////////////////////////
+// golden output: one line per kernel output,
+//     <kernel> <key> <value> <value> ...
+// written with enough digits to reproduce floats bitwise
+
+class GoldenOutput
+{
+public:
+    bool Load(const std::string &path)
+    {
+        std::ifstream f(path);
+        if(!f.is_open()) {
+            std::cout<<"ERROR: cannot open golden output file: "<<path<<std::endl;
+            return false;
+        }
+        std::string line;
+        while(std::getline(f, line))
+            if(line.size() > 0)
+                lines.push_back(line);
+        checking = true;
+        return true;
+    }
+
+    bool Open(const std::string &path)
+    {
+        out.open(path, std::ofstream::out);
+        if(!out.is_open()) {
+            std::cout<<"ERROR: cannot open golden output file: "<<path<<std::endl;
+            return false;
+        }
+        out<<std::setprecision(17);
+        return true;
+    }
+
+    void SetTolerance(double t) {tolerance = t;}
+    bool IsActive() const {return checking || out.is_open();}
+
+    void Add(const std::string &kernel, const std::string &key, const std::vector<double> &values)
+    {
+        if(out.is_open()) {
+            out<<kernel<<" "<<key;
+            for(auto &v: values)
+                out<<" "<<v;
+            out<<"\n";
+        }
+        if(checking)
+            check(kernel, key, values);
+    }
+
+    bool Finish()
+    {
+        if(checking && next < lines.size()) {
+            std::cout<<"GOLDEN MISMATCH: "<<lines.size() - next<<" golden outputs were not produced"<<std::endl;
+            mismatches += lines.size() - next;
+        }
+        if(out.is_open())
+            out.close();
+        return mismatches == 0;
+    }
+
+    // drop the golden outputs of a kernel that is not run
+    void Skip(const std::string &kernel)
+    {
+        auto it = std::remove_if(lines.begin() + next, lines.end(), [&](const std::string &l) {
+                return l.compare(0, kernel.size() + 1, kernel + " ") == 0;
+                });
+        lines.erase(it, lines.end());
+    }
+
+    uint64_t GetMismatches() const {return mismatches;}
+    uint64_t GetChecked() const {return next;}
+
+private:
+    void check(const std::string &kernel, const std::string &key, const std::vector<double> &values)
+    {
+        if(next >= lines.size()) {
+            report(kernel + " " + key, "no golden output left");
+            return;
+        }
+
+        std::istringstream iss(lines[next++]);
+        std::string g_kernel, g_key;
+        iss >> g_kernel >> g_key;
+        if(g_kernel != kernel || g_key != key) {
+            report(kernel + " " + key, "expected " + g_kernel + " " + g_key);
+            return;
+        }
+
+        std::vector<double> g_values;
+        double v;
+        while(iss >> v)
+            g_values.push_back(v);
+        if(g_values.size() != values.size()) {
+            report(kernel + " " + key, std::to_string(values.size()) + " values, golden has "
+                    + std::to_string(g_values.size()));
+            return;
+        }
+
+        for(size_t i=0; i<values.size(); i++)
+        {
+            double diff = std::abs(values[i] - g_values[i]);
+            double scale = std::max(1., std::max(std::abs(values[i]), std::abs(g_values[i])));
+            if(diff > tolerance * scale) {
+                std::ostringstream msg;
+                msg<<std::setprecision(9)<<"value "<<i<<": "<<values[i]<<" vs golden "<<g_values[i];
+                report(kernel + " " + key, msg.str());
+                return;
+            }
+        }
+    }
+
+    void report(const std::string &where, const std::string &what)
+    {
+        // print the first few, count the rest
+        if(mismatches < 20)
+            std::cout<<"GOLDEN MISMATCH: "<<where<<": "<<what<<std::endl;
+        mismatches++;
+    }
+
+private:
+    std::vector<std::string> lines;
+    size_t next = 0;
+    bool checking = false;
+    std::ofstream out;
+    double tolerance = 0.;
+    uint64_t mismatches = 0;
+};
+
+static bool record_events(GEMSystem *gem_sys, const std::string &path, int nev,
+        std::vector<recorded_event_t> &events);
+static void bench_apv_kernels(const std::vector<recorded_event_t> &events, int repeat,
+        GoldenOutput &golden, std::vector<kernel_stat_t> &stats);
+static void bench_form_clusters(GEMSystem *gem_sys, const std::vector<recorded_event_t> &events,
+        int repeat, GoldenOutput &golden, kernel_stat_t &stat);
+static void bench_find_tracks(GEMSystem *gem_sys, const std::vector<recorded_event_t> &events,
+        int repeat, GoldenOutput &golden, kernel_stat_t &stat);
+static bool bench_epics_parse(const std::string &bank_file, const std::string &map_file,
+        int repeat, kernel_stat_t &stat);
+static std::string apv_key(int ev, const GEMAPV *apv);
+
+// the recorded sample and its golden outputs
+static const std::string sample_evio = "benchmark/data/microbench_sample.evio";
+static const std::string sample_pedestal = "benchmark/data/microbench_ped.dat";
+static const std::string sample_common_mode = "benchmark/data/microbench_cm.txt";
+static const std::string sample_golden = "benchmark/data/microbench_golden.txt";
+static const std::vector<std::string> gem_kernels = {"cm_correction", "cm_sorting", "cm_danning",
+    "zero_sup", "form_clusters", "find_tracks"};
+
+int main(int argc, char* argv[])
+{
+    ConfigArgs arg_parser;
+    arg_parser.AddHelps({"-h", "--help"});
+    arg_parser.AddArgs<std::string>({"-f", "--evio_file"}, "evio_file",
+            "evio file to record the apv frames from, the gem kernels are skipped without it", sample_evio);
+    arg_parser.AddArg<int>("-n", "nev", "number of events to record", 1000);
+    arg_parser.AddArg<int>("-r", "repeat", "number of passes over the recorded events", 10);
+    arg_parser.AddArgs<std::string>({"--pedestal"}, "pedestal_file", "pedestal file", sample_pedestal);
+    arg_parser.AddArgs<std::string>({"--common_mode"}, "common_mode_file", "common mode file",
+            sample_common_mode);
+    arg_parser.AddArgs<std::string>({"--golden"}, "golden_file",
+            "check kernel outputs against this golden file (none = no check)", sample_golden);
+    arg_parser.AddArgs<std::string>({"--golden_out"}, "golden_out_file", "save kernel outputs as golden file", "");
+    arg_parser.AddArgs<double>({"--tolerance"}, "tolerance", "relative tolerance of the golden check (0 = bitwise)", 0.);
+    arg_parser.AddArgs<std::string>({"--epics_bank"}, "epics_bank_file", "text epics bank for epics_parse",
+            "epics/epics_bank_sample.txt");
+    arg_parser.AddArgs<std::string>({"--epics_map"}, "epics_map_file", "epics channel map", "epics/epics_map.txt");
+
+    auto args = arg_parser.ParseArgs(argc, argv);
+
+    // show arguments
+    for(auto &it : args) {
+        std::cout << it.first << ": " << it.second.String() << std::endl;
+    }
+
+    // -: golden outputs, the sample golden file only goes with the sample
+    const std::string &evio_file = args["evio_file"].String();
+    std::string golden_file = args["golden_file"].String();
+    if(golden_file == "none" || (golden_file == sample_golden && evio_file != sample_evio))
+        golden_file.clear();
+    if(args["golden_out_file"].String().size() > 0)
+        golden_file.clear();
+
+    GoldenOutput golden;
+    golden.SetTolerance(args["tolerance"].Double());
+    if(golden_file.size() > 0 && !golden.Load(golden_file))
+        return -1;
+    if(args["golden_out_file"].String().size() > 0 && !golden.Open(args["golden_out_file"].String()))
+        return -1;
+
+    int repeat = std::max(args["repeat"].Int(), 1);
+    std::vector<kernel_stat_t> stats;
+
+    // -: gem kernels, on the apv frames and strip hits recorded from the evio file
+    std::vector<recorded_event_t> events;
+    if(evio_file.empty() || !std::ifstream(evio_file).good()) {
+        std::cout<<"INFO:: no evio file \""<<evio_file<<"\", gem kernels skipped."<<std::endl;
+        for(auto &k: gem_kernels)
+            golden.Skip(k);
+    }
+    else {
+        GEMSystem *gem_system = new GEMSystem();
+        gem_system -> Configure("config/gem.conf");
+        gem_system -> ReadPedestalFile(args["pedestal_file"].String(), args["common_mode_file"].String());
+
+        if(!record_events(gem_system, evio_file, args["nev"].Int(), events)) {
+            delete gem_system;
+            return -1;
+        }
+
+        bench_apv_kernels(events, repeat, golden, stats);
+        stats.emplace_back();
+        bench_form_clusters(gem_system, events, repeat, golden, stats.back());
+        stats.emplace_back();
+        bench_find_tracks(gem_system, events, repeat, golden, stats.back());
+
+        delete gem_system;
+    }
+
+    // -: kernels with their own inputs
+    stats.emplace_back();
+    if(!bench_epics_parse(args["epics_bank_file"].String(), args["epics_map_file"].String(),
+                repeat, stats.back()))
+        stats.pop_back();
+
+    // -: summary
+    std::cout<<std::endl<<"kernel summary ("<<events.size()<<" events x "<<repeat<<" passes):"<<std::endl;
+    std::cout<<std::setw(16)<<"kernel"<<std::setw(14)<<"calls"<<std::setw(14)<<"total (s)"
+        <<std::setw(16)<<"ns/unit"<<std::endl;
+    for(auto &s: stats) {
+        double t = std::chrono::duration<double>(s.time).count();
+        std::cout<<std::setw(16)<<s.name<<std::setw(14)<<s.calls<<std::setw(14)<<t
+            <<std::setw(12)<<(s.calls > 0 ? t * 1e9 / s.calls : 0.)<<" /"<<s.unit<<std::endl;
+    }
+
+    if(!golden.Finish()) {
+        std::cout<<"GOLDEN CHECK FAILED: "<<golden.GetMismatches()<<" mismatches."<<std::endl;
+        return 1;
+    }
+    if(golden_file.size() > 0)
+        std::cout<<"golden check passed: "<<golden.GetChecked()<<" outputs."<<std::endl;
+
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////
+// decode the evio file once, keep the apv frames and the zero
+// suppressed strip hits of every plane
+
+static bool record_events(GEMSystem *gem_sys, const std::string &path, int nev,
+        std::vector<recorded_event_t> &events)
+{
+    EvioFileReader evio_reader;
+    evio_reader.SetFile(path);
+    if(!evio_reader.OpenFile()) {
+        std::cout<<"Cannot open evio file: "<<path<<std::endl;
+        return false;
+    }
+
+    EventParser event_parser;
+#ifdef USE_VME
+    MPDVMERawEventDecoder *decoder = new MPDVMERawEventDecoder();
+    event_parser.RegisterRawDecoder(static_cast<int>(Bank_TagID::MPD_VME), decoder);
+#elif defined(USE_SRS)
+    SRSRawEventDecoder *decoder = new SRSRawEventDecoder();
+    for(auto &i: Fec_Bank_Tag)
+        event_parser.RegisterRawDecoder(static_cast<int>(i), decoder);
+#else
+    MPDSSPRawEventDecoder *decoder = new MPDSSPRawEventDecoder();
+    event_parser.RegisterRawDecoder(static_cast<int>(Bank_TagID::MPD_SSP), decoder);
+#endif
+
+    std::vector<GEMPlane*> planes;
+    for(auto &det: gem_sys -> GetDetectorList())
+        for(auto &plane: det -> GetPlaneList())
+            if(plane != nullptr)
+                planes.push_back(plane);
+
+    const uint32_t *pBuf;
+    uint32_t fBufLen;
+    while(static_cast<int>(events.size()) < nev && evio_reader.ReadNoCopy(&pBuf, &fBufLen) == S_SUCCESS)
+    {
+        event_parser.ParseEvent(pBuf, fBufLen);
+
+        recorded_event_t ev;
+        const auto &flags = decoder -> GetAPVDataFlags();
+        for(auto &i: decoder -> GetAPV())
+        {
+            GEMAPV *apv = gem_sys -> GetAPV(i.first);
+            if(apv == nullptr)
+                continue;
+
+            apv_frame_t frame;
+            frame.apv = apv;
+            frame.raw = i.second;
+            auto flags_it = flags.find(i.first);
+            if(flags_it != flags.end())
+                frame.flags = flags_it -> second;
+            else
+                frame.flags.SetAPVAddress(i.first);
+            ev.frames.push_back(std::move(frame));
+        }
+        if(ev.frames.empty())
+            continue;
+
+        // fixed apv order, so the golden outputs do not depend on the hash map
+        std::sort(ev.frames.begin(), ev.frames.end(), [](const apv_frame_t &a, const apv_frame_t &b) {
+                APVAddress x = a.apv -> GetAddress(), y = b.apv -> GetAddress();
+                if(x.crate_id != y.crate_id) return x.crate_id < y.crate_id;
+                if(x.mpd_id != y.mpd_id) return x.mpd_id < y.mpd_id;
+                return x.adc_ch < y.adc_ch;
+                });
+
+        // zero suppression and strip hits, the input of the clustering
+        for(auto &frame: ev.frames)
+#ifdef USE_SRS
+            gem_sys -> FillRawDataSRS(frame.apv -> GetAddress(), frame.raw, ev.zs_data);
+#else
+            gem_sys -> FillRawDataMPD(frame.apv -> GetAddress(), frame.raw, frame.flags, ev.zs_data);
+#endif
+        gem_sys -> ChooseEvent(ev.zs_data);
+        for(auto &plane: planes)
+            ev.plane_hits.push_back(plane -> GetStripHits());
+
+        events.push_back(std::move(ev));
+    }
+    evio_reader.CloseFile();
+    delete decoder;
+
+    if(events.empty()) {
+        std::cout<<"ERROR:: no apv data recorded from: "<<path<<std::endl;
+        return false;
+    }
+
+    size_t napvs = 0;
+    for(auto &ev: events)
+        napvs += ev.frames.size();
+    std::cout<<"INFO:: recorded "<<events.size()<<" events, "
+        <<napvs / events.size()<<" apvs per event."<<std::endl;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// common mode and zero suppression kernels, per apv
+
+static void bench_apv_kernels(const std::vector<recorded_event_t> &events, int repeat,
+        GoldenOutput &golden, std::vector<kernel_stat_t> &stats)
+{
+    kernel_stat_t cm_correction{"cm_correction", "apv"};
+    kernel_stat_t cm_sorting{"cm_sorting", "apv"};
+    kernel_stat_t cm_danning{"cm_danning", "apv"};
+    kernel_stat_t zero_sup{"zero_sup", "apv"};
+
+    std::vector<float> buf, sub;
+    std::vector<double> cm_out, sorting_out, danning_out, zs_out;
+
+    for(int pass = 0; pass < repeat; pass++)
+    {
+        bool record = (pass == 0) && golden.IsActive();
+
+        for(size_t iev = 0; iev < events.size(); iev++)
+        {
+            for(auto &frame: events[iev].frames)
+            {
+                GEMAPV *apv = frame.apv;
+                uint32_t nts = std::min(apv -> GetNTimeSamples(),
+                        static_cast<uint32_t>(frame.raw.size() / MPD_APV_TS_LEN));
+
+                // fill + zero suppression, this also sets the data flags of
+                // the frame and resets the offline common mode
+                {
+                    auto t0 = bench_clock::now();
+#ifdef USE_SRS
+                    apv -> FillRawDataSRS(frame.raw);
+#else
+                    apv -> FillRawDataMPD(frame.raw, frame.flags);
+#endif
+                    apv -> ZeroSuppression();
+                    zero_sup.time += bench_clock::now() - t0;
+                    zero_sup.calls++;
+                }
+
+                // hit channels and their corrected samples
+                zs_out.clear();
+                if(record) {
+                    std::vector<GEM_Strip_Data> hits;
+                    apv -> CollectZeroSupHits(hits);
+                    for(auto &h: hits) {
+                        zs_out.push_back(h.addr.strip);
+                        for(auto &v: h.values)
+                            zs_out.push_back(v);
+                    }
+                }
+
+                // raw frame, time sample by time sample
+                buf.resize(nts * APV_STRIP_SIZE);
+                for(uint32_t ts = 0; ts < nts; ts++)
+                    for(uint32_t ch = 0; ch < APV_STRIP_SIZE; ch++)
+                        buf[ts * APV_STRIP_SIZE + ch] = frame.raw[ts * MPD_APV_TS_LEN + ch];
+
+                // the dynamic common mode kernels take offset subtracted strips
+                std::vector<GEMAPV::Pedestal> peds = apv -> GetPedestalList();
+                sub = buf;
+                for(uint32_t ts = 0; ts < nts; ts++)
+                    for(uint32_t ch = 0; ch < APV_STRIP_SIZE; ch++)
+#ifdef USE_SRS
+                        sub[ts * APV_STRIP_SIZE + ch] = peds[ch].offset - sub[ts * APV_STRIP_SIZE + ch];
+#else
+                        sub[ts * APV_STRIP_SIZE + ch] -= peds[ch].offset;
+#endif
+
+                sorting_out.clear();
+                {
+                    auto t0 = bench_clock::now();
+                    for(uint32_t ts = 0; ts < nts; ts++)
+                        sorting_out.push_back(apv -> dynamic_ts_common_mode_sorting(&sub[ts * APV_STRIP_SIZE],
+                                    APV_STRIP_SIZE));
+                    cm_sorting.time += bench_clock::now() - t0;
+                    cm_sorting.calls++;
+                }
+
+                danning_out.clear();
+                {
+                    auto t0 = bench_clock::now();
+                    for(uint32_t ts = 0; ts < nts; ts++)
+                        danning_out.push_back(apv -> dynamic_ts_common_mode_danning(&sub[ts * APV_STRIP_SIZE],
+                                    APV_STRIP_SIZE));
+                    cm_danning.time += bench_clock::now() - t0;
+                    cm_danning.calls++;
+                }
+
+                // full correction, in place on the raw frame
+                {
+                    auto t0 = bench_clock::now();
+                    for(uint32_t ts = 0; ts < nts; ts++)
+#ifdef USE_SRS
+                        apv -> CommonModeCorrection_SRS(&buf[ts * APV_STRIP_SIZE], APV_STRIP_SIZE, ts);
+#else
+                        apv -> CommonModeCorrection_MPD(&buf[ts * APV_STRIP_SIZE], APV_STRIP_SIZE, ts);
+#endif
+                    cm_correction.time += bench_clock::now() - t0;
+                    cm_correction.calls++;
+                }
+
+                if(!record)
+                    continue;
+
+                // corrected sum of each time sample, the offline common
+                // mode is only kept as integers
+                cm_out.clear();
+                for(uint32_t ts = 0; ts < nts; ts++) {
+                    double sum = 0.;
+                    for(uint32_t ch = 0; ch < APV_STRIP_SIZE; ch++)
+                        sum += buf[ts * APV_STRIP_SIZE + ch];
+                    cm_out.push_back(sum);
+                }
+
+                std::string key = apv_key(iev, apv);
+                golden.Add("cm_correction", key, cm_out);
+                golden.Add("cm_sorting", key, sorting_out);
+                golden.Add("cm_danning", key, danning_out);
+                golden.Add("zero_sup", key, zs_out);
+            }
+        }
+    }
+
+    stats.push_back(cm_correction);
+    stats.push_back(cm_sorting);
+    stats.push_back(cm_danning);
+    stats.push_back(zero_sup);
+}
+
+////////////////////////////////////////////////////////////////
+// clustering of the recorded strip hits, per event
+
+static void bench_form_clusters(GEMSystem *gem_sys, const std::vector<recorded_event_t> &events,
+        int repeat, GoldenOutput &golden, kernel_stat_t &stat)
+{
+    stat.name = "form_clusters";
+    stat.unit = "event";
+
+    GEMCluster *method = gem_sys -> GetClusterMethod();
+    std::vector<StripHit> hits;
+    std::vector<StripCluster> clusters;
+    std::vector<double> out;
+
+    for(int pass = 0; pass < repeat; pass++)
+    {
+        bool record = (pass == 0) && golden.IsActive();
+
+        for(size_t iev = 0; iev < events.size(); iev++)
+        {
+            const auto &plane_hits = events[iev].plane_hits;
+            for(size_t ip = 0; ip < plane_hits.size(); ip++)
+            {
+                hits = plane_hits[ip];
+                clusters.clear();
+
+                auto t0 = bench_clock::now();
+                method -> FormClusters(hits, clusters);
+                stat.time += bench_clock::now() - t0;
+
+                if(!record)
+                    continue;
+
+                out.clear();
+                for(auto &c: clusters) {
+                    out.push_back(c.position);
+                    out.push_back(c.peak_charge);
+                    out.push_back(c.total_charge);
+                    out.push_back(c.max_timebin);
+                    out.push_back(c.hits.size());
+                }
+                golden.Add("form_clusters", std::to_string(iev) + "/" + std::to_string(ip), out);
+            }
+            stat.calls++;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// tracking on the reconstructed hits, per event
+
+static void bench_find_tracks(GEMSystem *gem_sys, const std::vector<recorded_event_t> &events,
+        int repeat, GoldenOutput &golden, kernel_stat_t &stat)
+{
+    stat.name = "find_tracks";
+    stat.unit = "event";
+
+    tracking_dev::TrackingDataHandler *tracking_data_handler = new tracking_dev::TrackingDataHandler();
+    tracking_data_handler -> SetGEMSystem(gem_sys);
+    tracking_data_handler -> Init();
+    tracking_data_handler -> SetupDetector();
+    tracking_dev::Tracking *tracking = tracking_data_handler -> GetTrackingHandle();
+
+    for(int pass = 0; pass < repeat; pass++)
+    {
+        bool record = (pass == 0) && golden.IsActive();
+
+        for(size_t iev = 0; iev < events.size(); iev++)
+        {
+            // clustering and hit packaging are not part of this kernel
+            gem_sys -> Reconstruct(events[iev].zs_data);
+            tracking_data_handler -> ClearPrevEvent();
+            tracking_data_handler -> PackageEventData();
+
+            auto t0 = bench_clock::now();
+            tracking -> FindTracks();
+            stat.time += bench_clock::now() - t0;
+            stat.calls++;
+
+            if(!record)
+                continue;
+
+            std::vector<double> out;
+            out.push_back(tracking -> GetNTracksFound());
+            double xt, yt, xp, yp, chi2;
+            if(tracking -> GetBestTrack(xt, yt, xp, yp, chi2)) {
+                out.push_back(xt);
+                out.push_back(yt);
+                out.push_back(xp);
+                out.push_back(yp);
+                out.push_back(chi2);
+            }
+            golden.Add("find_tracks", std::to_string(iev), out);
+        }
+    }
+
+    delete tracking_data_handler;
+}
+
+////////////////////////////////////////////////////////////////
+// epics bank parsing, per bank, skipped (false) without the bank file
+
+static bool bench_epics_parse(const std::string &bank_file, const std::string &map_file,
+        int repeat, kernel_stat_t &stat)
+{
+    stat.name = "epics_parse";
+    stat.unit = "bank";
+
+    std::ifstream f(bank_file);
+    if(!f.is_open()) {
+        std::cout<<"INFO:: no epics bank file \""<<bank_file<<"\", epics_parse skipped."<<std::endl;
+        return false;
+    }
+    std::stringstream ss;
+    ss << f.rdbuf();
+    std::string bank = ss.str();
+
+    EPICSystem epics(map_file);
+
+    // 1000 banks per pass
+    for(int pass = 0; pass < repeat; pass++)
+    {
+        auto t0 = bench_clock::now();
+        for(int i = 0; i < 1000; i++)
+            epics.FillRawData(bank.c_str());
+        stat.time += bench_clock::now() - t0;
+        stat.calls += 1000;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// event/crate/mpd/adc
+
+static std::string apv_key(int ev, const GEMAPV *apv)
+{
+    APVAddress addr = apv -> GetAddress();
+    return std::to_string(ev) + "/" + std::to_string(addr.crate_id) + "/"
+        + std::to_string(addr.mpd_id) + "/" + std::to_string(addr.adc_ch);
+}
@@ -1,6 +1,6 @@
 #!/bin/bash
 
-folders=(alignment decoder epics fadc gem gui replay tracking_dev .)
+folders=(alignment benchmark decoder epics fadc gem gui replay tracking_dev .)
 
 echo "start"
 
@@ -17,6 +17,9 @@ done
 echo "rm -rf tracking_dev/Makefile.tracking_dev_app"
 rm -rf tracking_dev/Makefile.tracking_dev_app
 
+echo "rm -rf benchmark/Makefile.microbench"
+rm -rf benchmark/Makefile.microbench
+
 echo "rm -rf gem/lib/*"
 rm -rf gem/lib/*
 echo "rm -rf tracking_dev/lib/*"
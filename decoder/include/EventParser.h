@@ -16,6 +16,11 @@
 class EventParser
 {
 public:
+    // bank/segment/tagsegment tags have at most 12 bits (see GeneralEvioStruct.h)
+    static constexpr int MAX_TAGS = 4096;
+    // deepest bank hierarchy that is walked, deeper banks are skipped
+    static constexpr int MAX_DEPTH = 16;
+
     EventParser();
     ~EventParser();
 
@@ -25,18 +30,13 @@ public:
     void ParseSegment(const uint32_t *pBuf, uint32_t fBufLen);
     void ParseTagSegment(const uint32_t *pBuf, uint32_t fBufLen);
 
-    // vTagTrack saves hierarchy bank tag number
-    void SeparateSubHierarchy(const uint32_t *pBuf, uint32_t fBufLen, 
-            EvioPrimitiveDataType content_type, EvioPrimitiveDataType self_type,
-            std::vector<int> &vTagTrack);
-
-    void ParseData(const uint32_t *pBuf, uint32_t fBufLen, 
-            EvioPrimitiveDataType content_type, EvioPrimitiveDataType self_type,
-            std::vector<int> &vTagTrack);
-
     void RegisterRawDecoder(int, AbstractRawDecoder* decoder);
     AbstractRawDecoder* GetRawDecoder(int);
 
+    // container banks with this tag are not walked into, for example the
+    // roc of a detector that has no registered decoder
+    void SkipSubtree(int tag, bool skip = true);
+
     void Reset();
     void ClearForNextEvent();
 
@@ -44,8 +44,33 @@ public:
     uint32_t GetEventNumber();
 
 private:
-    // {tag -> decoder}, decode data according to tag
+    // walk the hierarchy below pBuf with an explicit stack
+    void Walk(const uint32_t *pBuf, uint32_t fBufLen, EvioPrimitiveDataType self_type);
+    // header of a bank/segment/tagsegment, pushes containers on the walk stack
+    // and hands leaves to their decoder
+    void Visit(const uint32_t *pBuf, uint32_t fBufLen, EvioPrimitiveDataType self_type, int level);
+
+private:
+    // {tag -> decoder}, all registered decoders
     std::unordered_map<int, AbstractRawDecoder*> mDecoder;
+    // flat copy of mDecoder for the lookup while parsing, and the skipped tags
+    std::vector<AbstractRawDecoder*> decoder_table;
+    std::vector<bool> skip_table;
+
+    // walk stack: open containers, their next child and the type of their children
+    struct walk_frame_t
+    {
+        const uint32_t *buf;
+        uint32_t len, pos;
+        EvioPrimitiveDataType child_type;
+    };
+    walk_frame_t walk_stack[MAX_DEPTH];
+    int walk_depth = 0;
+
+    // tags from the event bank down to the current bank, and the same tags
+    // passed to the decoders (capacity reserved, never reallocated)
+    int tag_track[MAX_DEPTH + 1];
+    std::vector<int> vTagTrack;
 
     uint32_t event_number = 0;
 };
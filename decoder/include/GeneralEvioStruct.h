@@ -133,11 +133,33 @@ const std::unordered_map<int, EvioPrimitiveDataType> mapEvioPrimitiveDataType =
 
 ////////////////////////////////////////////////////////////////
 // a wrapper for looking up the primitive data type map
+// (same content as the map, as a switch: it is called for every bank)
 
 inline EvioPrimitiveDataType DataType(int key) 
 {
-    if(mapEvioPrimitiveDataType.find(key) != mapEvioPrimitiveDataType.end())
-        return mapEvioPrimitiveDataType.at(key);
+    switch(key) {
+        case 0x0:  return EvioPrimitiveDataType::Unknown32Bit;
+        case 0x1:  return EvioPrimitiveDataType::UnsignedInt32Bit;
+        case 0x2:  return EvioPrimitiveDataType::Float32Bit;
+        case 0x3:  return EvioPrimitiveDataType::Char8Bit;
+        case 0x4:  return EvioPrimitiveDataType::SignedShort16Bit;
+        case 0x5:  return EvioPrimitiveDataType::UnsignedShort16Bit;
+        case 0x6:  return EvioPrimitiveDataType::SignedChar8Bit;
+        case 0x7:  return EvioPrimitiveDataType::UnsignedChar8Bit;
+        case 0x8:  return EvioPrimitiveDataType::Double64Bit;
+        case 0x9:  return EvioPrimitiveDataType::SignedInt64Bit;
+        case 0xa:  return EvioPrimitiveDataType::UnsignedInt64Bit;
+        case 0xb:  return EvioPrimitiveDataType::SignedInt32Bit;
+        case 0xc:  return EvioPrimitiveDataType::TagSegment;
+        case 0xd:  return EvioPrimitiveDataType::Segment;
+        case 0xe:  return EvioPrimitiveDataType::Bank;
+        case 0xf:  return EvioPrimitiveDataType::Composite;
+        case 0x10: return EvioPrimitiveDataType::Bank;
+        case 0x20: return EvioPrimitiveDataType::Segment;
+        case 0x21: return EvioPrimitiveDataType::Hollerit;
+        case 0x22: return EvioPrimitiveDataType::N_Value;
+        default: break;
+    }
 
     return EvioPrimitiveDataType::Undefined;
 };
@@ -0,0 +1,31 @@
+######################################################################
+# event parser test, decoder calls vs a recursive reference walker, timing
+######################################################################
+
+TEMPLATE = app
+TARGET = ../bin/decoder_parser_test
+
+QMAKE_CXXFLAGS -= -std=gnu++1y
+QMAKE_CXXFLAGS -= -std=c++1y
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_CXXFLAGS += -g
+QMAKE_CFLAGS   += -g
+QMAKE_LFLAGS   += -g
+
+######################################################################
+# self headers, the parser is built in (no evio or root needed)
+INCLUDEPATH += ./include
+
+######################################################################
+# moc dir
+MOC_DIR = moc_test
+
+######################################################################
+# obj dir, not the one of the library (its objects are built -fPIC)
+OBJECTS_DIR = obj_test
+
+######################################################################
+# source path
+SOURCES += test/parser_test.cpp \
+           src/EventParser.cpp \
+           src/AbstractRawDecoder.cpp \
@@ -6,7 +6,9 @@
 // ctor
 
 EventParser::EventParser()
+    : decoder_table(MAX_TAGS, nullptr), skip_table(MAX_TAGS, false)
 {
+    vTagTrack.reserve(MAX_DEPTH + 1);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -73,11 +75,7 @@ void EventParser::ParseEvent(const uint32_t *pBuf, uint32_t fBufLen)
 
 void EventParser::ParseBank(const uint32_t *pBuf, uint32_t fBufLen)
 {
-    EventBankHeader event_header(pBuf[0], pBuf[1]);
-    auto type = event_header.type;
-    std::vector<int> vTagTrack(1, event_header.tag);
-
-    SeparateSubHierarchy(pBuf, fBufLen, DataType(type), EvioPrimitiveDataType::Bank, vTagTrack);
+    Walk(pBuf, fBufLen, EvioPrimitiveDataType::Bank);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -86,11 +84,7 @@ void EventParser::ParseBank(const uint32_t *pBuf, uint32_t fBufLen)
 
 void EventParser::ParseSegment(const uint32_t *pBuf, uint32_t fBufLen)
 {
-    EventSegmentHeader event_header(pBuf[0]);
-    auto type = event_header.type;
-    std::vector<int> vTagTrack(1, event_header.tag);
-
-    SeparateSubHierarchy(pBuf, fBufLen, DataType(type), EvioPrimitiveDataType::Segment, vTagTrack);
+    Walk(pBuf, fBufLen, EvioPrimitiveDataType::Segment);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -99,116 +93,108 @@ void EventParser::ParseSegment(const uint32_t *pBuf, uint32_t fBufLen)
 
 void EventParser::ParseTagSegment(const uint32_t *pBuf, uint32_t fBufLen)
 {
-    EventTagSegmentHeader event_header(pBuf[0]);
-    auto type = event_header.type;
-    std::vector<int> vTagTrack(1, event_header.tag);
-
-    SeparateSubHierarchy(pBuf, fBufLen, DataType(type), EvioPrimitiveDataType::TagSegment, vTagTrack);
+    Walk(pBuf, fBufLen, EvioPrimitiveDataType::TagSegment);
 }
 
 ////////////////////////////////////////////////////////////////
-// separate sub hierarchy structure
-// if we encountered a container bank structure, this function 
-// will separate all the sub banks out, and pass the separate banks
-// to corresponding routines
-
-void EventParser::SeparateSubHierarchy(const uint32_t *pBuf, uint32_t fBufLen, 
-        EvioPrimitiveDataType content_type, EvioPrimitiveDataType self_type,
-        std::vector<int> &vTagTrack)
+// walk the bank hierarchy
+// containers are kept on a fixed size stack instead of recursing,
+// the top of the stack is the container whose next child is read.
+// The decoders see the banks in the same order as before (depth
+// first), with the same tag track.
+
+void EventParser::Walk(const uint32_t *pBuf, uint32_t fBufLen, EvioPrimitiveDataType self_type)
 {
-    // content_type = type of data stored in this buffer "pBuf"
-    // self_type = type of this buffer (this buffer itself is a BANK/Seg/TagSeg?)
-    uint32_t pos = 0;
-
-    // get header length
-    if(self_type == EvioPrimitiveDataType::Bank) 
-        pos = 2;
-    else if(self_type == EvioPrimitiveDataType::Segment ||
-            self_type == EvioPrimitiveDataType::TagSegment)
-        pos = 1;
-
-    switch(content_type) 
+    walk_depth = 0;
+    Visit(pBuf, fBufLen, self_type, 0);
+
+    while(walk_depth > 0)
     {
-        case EvioPrimitiveDataType::Bank:
-            // the whole buffer is a hierarchy of banks
-            while(pos < fBufLen) {
-                EventBankHeader sub_bank_header(pBuf[pos], pBuf[pos+1]);
-                vTagTrack.push_back(sub_bank_header.tag);
-                // length from header does not include the length word itself
-                // thus the total length should be (header.length+1)
-                SeparateSubHierarchy(&pBuf[pos], sub_bank_header.length+1, 
-                        DataType(sub_bank_header.type), content_type, vTagTrack);
-                pos += (sub_bank_header.length+1);
-                vTagTrack.pop_back();
-            }
-            break;
-        case EvioPrimitiveDataType::Segment:
-            // the whole buffer is a hierachy of segments
-            while(pos < fBufLen){
-                EventSegmentHeader sub_segment_header(pBuf[pos]);
-                vTagTrack.push_back(sub_segment_header.tag);
-                SeparateSubHierarchy(&pBuf[pos], sub_segment_header.length+1, 
-                        DataType(sub_segment_header.type), content_type, vTagTrack);
-                pos += (sub_segment_header.length+1);
-                vTagTrack.pop_back();
-            }
-            break;
-        case EvioPrimitiveDataType::TagSegment:
-            // the whole buffer is a hierachy of tagsegments
-            while(pos < fBufLen) {
-                EventTagSegmentHeader sub_tagseg_header(pBuf[pos]);
-                vTagTrack.push_back(sub_tagseg_header.tag);
-                SeparateSubHierarchy(&pBuf[pos], sub_tagseg_header.length+1, 
-                        DataType(sub_tagseg_header.type), content_type, vTagTrack);
-                pos += (sub_tagseg_header.length+1);
-                vTagTrack.pop_back();
-            }
-            break;
-        case EvioPrimitiveDataType::Undefined:
-            // unsupported evio data type
-            break;
-        default:
-            {
-                // the whole buffer is one data bank
-                ParseData(pBuf, fBufLen, content_type, self_type, vTagTrack);
-            }
-    };
+        walk_frame_t &frame = walk_stack[walk_depth - 1];
+        if(frame.pos >= frame.len) {
+            walk_depth--;
+            continue;
+        }
+
+        // length from header does not include the length word itself
+        // thus the total length should be (header.length+1)
+        const uint32_t *sub = &frame.buf[frame.pos];
+        uint32_t sub_len = (frame.child_type == EvioPrimitiveDataType::Bank) ?
+            sub[0] + 1 : (sub[0] & 0xffff) + 1;
+        if(sub_len == 0 || sub_len > frame.len - frame.pos) {
+            std::cout<<"Error: EventParser: bank length "<<sub_len<<" exceeds its container, skipped the rest."
+                <<std::endl;
+            walk_depth--;
+            continue;
+        }
+        frame.pos += sub_len;
+
+        Visit(sub, sub_len, frame.child_type, walk_depth);
+    }
 }
 
 ////////////////////////////////////////////////////////////////
-// parse event data
-// this function to process raw detector data in Banks/Segments/TagSegments
+// one bank/segment/tagsegment at hierarchy level "level"
+// a container is pushed on the walk stack, a leaf (raw detector
+// data) is passed to the decoder registered for its tag
 
-void EventParser::ParseData(const uint32_t *pBuf, [[maybe_unused]] uint32_t fBufLen, 
-        [[maybe_unused]] EvioPrimitiveDataType content_type, EvioPrimitiveDataType self_type, 
-        std::vector<int> &vTagTrack)
+void EventParser::Visit(const uint32_t *pBuf, uint32_t fBufLen, EvioPrimitiveDataType self_type, int level)
 {
-    // get tag
-    [[maybe_unused]] int tag = 0, length = 0, header_length = 0;
+    int tag = 0, type = 0, length = 0, header_length = 0;
 
     if(self_type == EvioPrimitiveDataType::Bank) {
         EventBankHeader header(pBuf[0], pBuf[1]);
-        tag = header.tag; length = header.length;
+        tag = header.tag; type = header.type; length = header.length;
         header_length = 2;
     }
     else if(self_type == EvioPrimitiveDataType::Segment) {
         EventSegmentHeader header(pBuf[0]);
-        tag = header.tag; length = header.length;
+        tag = header.tag; type = header.type; length = header.length;
         header_length = 1;
     }
     else if(self_type == EvioPrimitiveDataType::TagSegment) {
         EventTagSegmentHeader header(pBuf[0]);
-        tag = header.tag; length = header.length;
+        tag = header.tag; type = header.type; length = header.length;
         header_length = 1;
     }
     else {
         std::cout<<"Warning: Unsupported bank type."<<std::endl;
+        return;
     }
 
-    // decode
-    if(mDecoder.find(tag) != mDecoder.end()) {
-        mDecoder[tag] -> Decode(&pBuf[header_length], length-1, vTagTrack);
+    tag_track[level] = tag;
+    EvioPrimitiveDataType content_type = DataType(type);
+
+    switch(content_type)
+    {
+        case EvioPrimitiveDataType::Bank:
+        case EvioPrimitiveDataType::Segment:
+        case EvioPrimitiveDataType::TagSegment:
+            // container, its children are read by Walk()
+            if(skip_table[tag])
+                return;
+            if(level >= MAX_DEPTH) {
+                std::cout<<"Warning: EventParser: bank hierarchy deeper than "<<MAX_DEPTH
+                    <<" levels, skipped."<<std::endl;
+                return;
+            }
+            walk_stack[walk_depth++] = walk_frame_t{pBuf, fBufLen,
+                static_cast<uint32_t>(header_length), content_type};
+            return;
+        case EvioPrimitiveDataType::Undefined:
+            // unsupported evio data type
+            return;
+        default:
+            break;
     }
+
+    // decode
+    AbstractRawDecoder *decoder = decoder_table[tag];
+    if(decoder == nullptr)
+        return;
+
+    vTagTrack.assign(tag_track, tag_track + level + 1);
+    decoder -> Decode(&pBuf[header_length], length-1, vTagTrack);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -223,6 +209,11 @@ void EventParser::RegisterRawDecoder(int tag, AbstractRawDecoder* decoder)
     }
 
     mDecoder[tag] = decoder;
+
+    // a tag over 12 bits never matches a bank header, it is only
+    // kept for GetRawDecoder()
+    if(tag >= 0 && tag < MAX_TAGS)
+        decoder_table[tag] = decoder;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -231,9 +222,22 @@ void EventParser::RegisterRawDecoder(int tag, AbstractRawDecoder* decoder)
 
 AbstractRawDecoder * EventParser::GetRawDecoder(int tag)
 {
-    if(mDecoder.find(tag) == mDecoder.end())
+    auto it = mDecoder.find(tag);
+    if(it == mDecoder.end())
         return nullptr;
-    return mDecoder[tag];
+    return it -> second;
+}
+
+////////////////////////////////////////////////////////////////
+// skip (or walk again) the containers with this tag
+
+void EventParser::SkipSubtree(int tag, bool skip)
+{
+    if(tag < 0 || tag >= MAX_TAGS) {
+        std::cout<<__PRETTY_FUNCTION__<<" Warning: tag "<<tag<<" out of range."<<std::endl;
+        return;
+    }
+    skip_table[tag] = skip;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -127,6 +127,15 @@ int EvioFileReader::ReadEventNum(const uint32_t **pEvent, uint32_t *buflen,
     return evReadRandom(fFileHandle, pEvent, buflen, eventNumber);
 }
 
+////////////////////////////////////////////////////////////////
+// total number of events in the file, evio scans the file
+// for it unless it was opened in random access mode ("ra")
+
+int EvioFileReader::GetNumberOfEvents(uint32_t *count)
+{
+    return evIoctl(fFileHandle, const_cast<char*>("E"), count);
+}
+
 ////////////////////////////////////////////////////////////////
 // get current event number being processed
 
@@ -0,0 +1,494 @@
+////////////////////////////////////////////////////////////////
+// parser_test
+//
+// EventParser (walk with an explicit stack) against a recursive
+// reference walker, the way the parser used to split the banks:
+//
+//     parser_test [-r repeat] [-n nevents]
+//
+// - n random events (default 2000): banks, segments and tagsegments
+//   nested up to 7 levels, container and leaf tags drawn from the
+//   same small pool, so decoder tags also show up on containers.
+//   Every decoder call (decoder, data offset, length, tag track)
+//   must be the same as the reference one, also with SkipSubtree
+//   set for two tags and after one of them is unset again.
+// - timing on events like the SSP ones: a trigger bank of segments,
+//   4 gem rocs and a roc of another detector (tag 40) with 50 small
+//   banks nobody decodes. -r passes of 50 parses of 200 events,
+//   ns/event for the reference, EventParser and EventParser with
+//   SkipSubtree(40); skipping must not change what is decoded, and
+//   no parse after the warm-up one may allocate (heap allocations are
+//   counted by the operator new below).
+//
+// Returns 0 if every check passed.
+
+#include "EventParser.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////
+// heap allocation counter
+
+static std::atomic<uint64_t> heap_allocations{0};
+
+void *operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+////////////////////////////////////////////////////////////////
+// one decoder call
+
+struct dispatch_t
+{
+    int decoder;
+    long offset;
+    uint32_t length;
+    std::vector<int> tags;
+
+    bool operator ==(const dispatch_t &rhs) const
+    {
+        return decoder == rhs.decoder && offset == rhs.offset && length == rhs.length && tags == rhs.tags;
+    }
+};
+
+// keeps every call, offsets are counted from the event buffer
+class RecordDecoder : public AbstractRawDecoder
+{
+public:
+    RecordDecoder(int i, std::vector<dispatch_t> &out) : id(i), calls(out) {}
+
+    void Decode(const uint32_t *pBuf, uint32_t fBufLen, std::vector<int> &vTagTrack) override
+    {
+        calls.push_back(dispatch_t{id, pBuf - base, fBufLen, vTagTrack});
+    }
+    void Clear() override {}
+
+    const uint32_t *base = nullptr;
+
+private:
+    int id;
+    std::vector<dispatch_t> &calls;
+};
+
+// hash of every call, does not allocate
+class HashDecoder : public AbstractRawDecoder
+{
+public:
+    void Decode(const uint32_t *pBuf, uint32_t fBufLen, std::vector<int> &vTagTrack) override
+    {
+        mix(pBuf - base);
+        mix(fBufLen);
+        for (int tag : vTagTrack)
+            mix(tag);
+        mix(-1);
+        calls++;
+    }
+    void Clear() override {}
+
+    const uint32_t *base = nullptr;
+    uint64_t hash = 1469598103934665603ULL;
+    long calls = 0;
+
+private:
+    void mix(long v) { hash = (hash ^ static_cast<uint64_t>(v)) * 1099511628211ULL; }
+};
+
+////////////////////////////////////////////////////////////////
+// recursive reference walker, decoders by id
+
+class ReferenceParser
+{
+public:
+    std::unordered_map<int, int> decoders;   // tag -> decoder id
+    std::unordered_set<int> skip;
+
+    void Parse(const uint32_t *buf, uint32_t len, std::vector<dispatch_t> &out)
+    {
+        base = buf;
+        calls = &out;
+        EventBankHeader header(buf[0], buf[1]);
+        std::vector<int> tags(1, header.tag);
+        split(buf, len, DataType(header.type), EvioPrimitiveDataType::Bank, tags);
+    }
+
+private:
+    void split(const uint32_t *buf, uint32_t len, EvioPrimitiveDataType content_type,
+            EvioPrimitiveDataType self_type, std::vector<int> &tags)
+    {
+        uint32_t pos = (self_type == EvioPrimitiveDataType::Bank) ? 2 : 1;
+        bool container = content_type == EvioPrimitiveDataType::Bank ||
+            content_type == EvioPrimitiveDataType::Segment || content_type == EvioPrimitiveDataType::TagSegment;
+
+        if (container) {
+            if (skip.count(tags.back()))
+                return;
+            while (pos < len) {
+                int tag = 0, type = 0, length = 0;
+                header(&buf[pos], content_type, tag, type, length);
+                tags.push_back(tag);
+                split(&buf[pos], length + 1, DataType(type), content_type, tags);
+                tags.pop_back();
+                pos += length + 1;
+            }
+            return;
+        }
+        if (content_type == EvioPrimitiveDataType::Undefined)
+            return;
+
+        int tag = 0, type = 0, length = 0;
+        header(buf, self_type, tag, type, length);
+        auto it = decoders.find(tag);
+        if (it != decoders.end())
+            calls -> push_back(dispatch_t{it -> second, &buf[pos] - base, static_cast<uint32_t>(length - 1), tags});
+    }
+
+    static void header(const uint32_t *buf, EvioPrimitiveDataType self_type, int &tag, int &type, int &length)
+    {
+        if (self_type == EvioPrimitiveDataType::Bank) {
+            EventBankHeader h(buf[0], buf[1]);
+            tag = h.tag; type = h.type; length = h.length;
+        } else if (self_type == EvioPrimitiveDataType::Segment) {
+            EventSegmentHeader h(buf[0]);
+            tag = h.tag; type = h.type; length = h.length;
+        } else {
+            EventTagSegmentHeader h(buf[0]);
+            tag = h.tag; type = h.type; length = h.length;
+        }
+    }
+
+    const uint32_t *base = nullptr;
+    std::vector<dispatch_t> *calls = nullptr;
+};
+
+////////////////////////////////////////////////////////////////
+// evio event writer
+
+class EventWriter
+{
+public:
+    std::vector<uint32_t> buf;
+
+    size_t OpenBank(int tag, int type)
+    {
+        buf.push_back(0);
+        buf.push_back(static_cast<uint32_t>(tag & 0xfff) << 16 | static_cast<uint32_t>(type & 0x3f) << 8);
+        return buf.size() - 2;
+    }
+    size_t OpenSegment(int tag, int type)
+    {
+        buf.push_back(static_cast<uint32_t>(tag & 0xff) << 24 | static_cast<uint32_t>(type & 0x3f) << 16);
+        return buf.size() - 1;
+    }
+    size_t OpenTagSegment(int tag, int type)
+    {
+        buf.push_back(static_cast<uint32_t>(tag & 0xfff) << 20 | static_cast<uint32_t>(type & 0xf) << 16);
+        return buf.size() - 1;
+    }
+    size_t Open(EvioPrimitiveDataType self_type, int tag, int type)
+    {
+        if (self_type == EvioPrimitiveDataType::Bank)
+            return OpenBank(tag, type);
+        if (self_type == EvioPrimitiveDataType::Segment)
+            return OpenSegment(tag, type);
+        return OpenTagSegment(tag, type);
+    }
+    // the length word does not count itself
+    void Close(EvioPrimitiveDataType self_type, size_t pos)
+    {
+        uint32_t length = buf.size() - pos - 1;
+        if (self_type == EvioPrimitiveDataType::Bank)
+            buf[pos] = length;
+        else
+            buf[pos] |= length & 0xffff;
+    }
+};
+
+static const int tag_pool[] = {1, 3, 5, 7, 10, 40, 200, 3561};
+static const int decoder_tags[] = {3, 7, 10, 200, 3561};
+
+static void add_random_node(EventWriter &ev, std::mt19937 &rng, EvioPrimitiveDataType self_type, int depth)
+{
+    std::uniform_int_distribution<int> pick(0, 99);
+    int tag = tag_pool[pick(rng) % 8];
+    if (self_type == EvioPrimitiveDataType::Segment)
+        tag &= 0xff;
+
+    // container, a tagsegment only has 4 bits for the type of its content
+    bool tag_segment = self_type == EvioPrimitiveDataType::TagSegment;
+    if (depth < 7 && pick(rng) < 45) {
+        static const EvioPrimitiveDataType child_types[] = {EvioPrimitiveDataType::Bank,
+            EvioPrimitiveDataType::Segment, EvioPrimitiveDataType::TagSegment};
+        int k = pick(rng) % 3;
+        int type = (k == 0) ? ((tag_segment || pick(rng) < 50) ? 0xe : 0x10) :
+                   (k == 1) ? ((tag_segment || pick(rng) < 50) ? 0xd : 0x20) : 0xc;
+        size_t pos = ev.Open(self_type, tag, type);
+        int nchildren = pick(rng) % 5;
+        for (int i = 0; i < nchildren; i++)
+            add_random_node(ev, rng, child_types[k], depth + 1);
+        ev.Close(self_type, pos);
+        return;
+    }
+
+    // leaf: 32 bit, float, short, char, composite, or an undefined type
+    static const int leaf_types[] = {0x1, 0x2, 0x5, 0xb, 0x3, 0xf, 0x1, 0x11};
+    int type = leaf_types[pick(rng) % (tag_segment ? 7 : 8)];
+    size_t pos = ev.Open(self_type, tag, type);
+    int nwords = pick(rng) % 6;
+    for (int i = 0; i < nwords; i++)
+        ev.buf.push_back(rng());
+    ev.Close(self_type, pos);
+}
+
+static std::vector<uint32_t> random_event(std::mt19937 &rng)
+{
+    EventWriter ev;
+    size_t pos = ev.OpenBank(1, 0x10);
+    int nchildren = 1 + rng() % 6;
+    for (int i = 0; i < nchildren; i++)
+        add_random_node(ev, rng, EvioPrimitiveDataType::Bank, 1);
+    ev.Close(EvioPrimitiveDataType::Bank, pos);
+    return ev.buf;
+}
+
+// trigger bank of segments, gem rocs (ssp data, tag 3561, with two
+// more banks), and a roc of another detector with many small banks
+static std::vector<uint32_t> ssp_event(std::mt19937 &rng)
+{
+    EventWriter ev;
+    size_t event = ev.OpenBank(1, 0x10);
+
+    size_t trigger = ev.OpenBank(0xff21, 0x20);
+    for (int i = 0; i < 3; i++) {
+        size_t seg = ev.OpenSegment(7 + i, 0x1);
+        for (int k = 0; k < 4; k++)
+            ev.buf.push_back(rng());
+        ev.Close(EvioPrimitiveDataType::Segment, seg);
+    }
+    ev.Close(EvioPrimitiveDataType::Bank, trigger);
+
+    for (int roc = 2; roc <= 5; roc++) {
+        size_t r = ev.OpenBank(roc, 0x10);
+        size_t ssp = ev.OpenBank(3561, 0x1);
+        for (int k = 0; k < 200; k++)
+            ev.buf.push_back(rng());
+        ev.Close(EvioPrimitiveDataType::Bank, ssp);
+        size_t ti = ev.OpenBank(0xe10, 0x1);
+        for (int k = 0; k < 10; k++)
+            ev.buf.push_back(rng());
+        ev.Close(EvioPrimitiveDataType::Bank, ti);
+        size_t fadc = ev.OpenBank(3, 0x1);
+        for (int k = 0; k < 20; k++)
+            ev.buf.push_back(rng());
+        ev.Close(EvioPrimitiveDataType::Bank, fadc);
+        ev.Close(EvioPrimitiveDataType::Bank, r);
+    }
+
+    size_t other = ev.OpenBank(40, 0x10);
+    for (int i = 0; i < 50; i++) {
+        size_t b = ev.OpenBank(100 + i, 0x1);
+        ev.buf.push_back(rng());
+        ev.Close(EvioPrimitiveDataType::Bank, b);
+    }
+    ev.Close(EvioPrimitiveDataType::Bank, other);
+
+    ev.Close(EvioPrimitiveDataType::Bank, event);
+    return ev.buf;
+}
+
+static bool test_dispatch(int nevents);
+static bool test_timing(int repeat);
+
+int main(int argc, char* argv[])
+{
+    int repeat = 10, nevents = 2000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repeat = std::max(std::stoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            nevents = std::stoi(argv[++i]);
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [-r repeat] [-n nevents]" << std::endl;
+            return 1;
+        }
+    }
+
+    bool ok = test_dispatch(nevents);
+    ok = test_timing(repeat) && ok;
+
+    std::cout << (ok ? "parser_test: all checks passed." : "parser_test: FAILED.") << std::endl;
+    return ok ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////
+// decoder calls of EventParser vs the reference, on random events
+
+static bool test_dispatch(int nevents)
+{
+    std::mt19937 rng(50);
+    std::vector<std::vector<uint32_t>> events;
+    for (int i = 0; i < nevents; i++)
+        events.push_back(random_event(rng));
+
+    std::vector<dispatch_t> calls, ref_calls;
+    std::vector<RecordDecoder*> decoders;
+    EventParser parser;
+    ReferenceParser reference;
+    int id = 0;
+    for (int tag : decoder_tags) {
+        decoders.push_back(new RecordDecoder(id, calls));
+        parser.RegisterRawDecoder(tag, decoders.back());
+        reference.decoders[tag] = id++;
+    }
+
+    bool ok = true;
+    auto check = [&] (const std::string &name) {
+        long ncalls = 0;
+        int mismatches = 0;
+        for (size_t i = 0; i < events.size(); i++) {
+            calls.clear();
+            ref_calls.clear();
+            for (auto d : decoders)
+                d -> base = events[i].data();
+            parser.ParseEvent(events[i].data(), events[i].size());
+            reference.Parse(events[i].data(), events[i].size(), ref_calls);
+            ncalls += ref_calls.size();
+            if (calls == ref_calls)
+                continue;
+            if (mismatches++ < 10)
+                std::cout << "    event " << i << ": " << calls.size() << " decoder calls vs "
+                          << ref_calls.size() << std::endl;
+        }
+        std::cout << name << ": " << events.size() << " events, " << ncalls << " decoder calls, "
+                  << mismatches << " mismatched events" << (mismatches ? " -- FAILED" : " -- PASSED") << std::endl;
+        ok = ok && (mismatches == 0);
+    };
+
+    check("random events");
+
+    parser.SkipSubtree(5);
+    parser.SkipSubtree(40);
+    reference.skip = {5, 40};
+    check("random events, containers 5 and 40 skipped");
+
+    parser.SkipSubtree(5, false);
+    reference.skip = {40};
+    check("random events, container 40 skipped");
+
+    for (auto d : decoders)
+        delete d;
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////
+// parse time per event, reference vs EventParser (with and without
+// the roc of the other detector)
+
+static bool test_timing(int repeat)
+{
+    std::mt19937 rng(51);
+    std::vector<std::vector<uint32_t>> events;
+    for (int i = 0; i < 200; i++)
+        events.push_back(ssp_event(rng));
+
+    using clock = std::chrono::steady_clock;
+    const int nparse = 50;
+    double nev = static_cast<double>(nparse) * events.size() * repeat;
+
+    // reference, with the decoder ids only
+    ReferenceParser reference;
+    for (int tag : {3561, 7, 3})
+        reference.decoders[tag] = tag;
+    std::vector<dispatch_t> ref_calls;
+    ref_calls.reserve(64);
+    clock::duration t_ref = clock::duration::zero();
+    for (int pass = 0; pass < repeat; pass++) {
+        auto t0 = clock::now();
+        for (int i = 0; i < nparse; i++)
+            for (auto &e : events) {
+                ref_calls.clear();
+                reference.Parse(e.data(), e.size(), ref_calls);
+            }
+        t_ref += clock::now() - t0;
+    }
+
+    // EventParser, the decoder calls are hashed
+    bool ok = true;
+    uint64_t hashes[2] = {0, 0};
+    double ns[2] = {0., 0.};
+    for (int skip = 0; skip < 2; skip++)
+    {
+        EventParser parser;
+        HashDecoder ssp, trigger, fadc;
+        parser.RegisterRawDecoder(3561, &ssp);
+        parser.RegisterRawDecoder(7, &trigger);
+        parser.RegisterRawDecoder(3, &fadc);
+        if (skip)
+            parser.SkipSubtree(40);
+
+        // warm-up, also the hashed pass
+        for (auto &e : events) {
+            ssp.base = trigger.base = fadc.base = e.data();
+            parser.ParseEvent(e.data(), e.size());
+        }
+        hashes[skip] = ssp.hash ^ (trigger.hash * 3) ^ (fadc.hash * 7);
+
+        uint64_t nalloc = heap_allocations.load();
+        clock::duration t = clock::duration::zero();
+        for (int pass = 0; pass < repeat; pass++) {
+            auto t0 = clock::now();
+            for (int i = 0; i < nparse; i++)
+                for (auto &e : events)
+                    parser.ParseEvent(e.data(), e.size());
+            t += clock::now() - t0;
+        }
+        nalloc = heap_allocations.load() - nalloc;
+        ns[skip] = std::chrono::duration<double, std::nano>(t).count() / nev;
+
+        if (nalloc > 0) {
+            std::cout << "    " << nalloc << " heap allocations in " << nev << " parses" << std::endl;
+            ok = false;
+        }
+    }
+
+    if (hashes[0] != hashes[1]) {
+        std::cout << "    skipping roc 40 changed the decoder calls" << std::endl;
+        ok = false;
+    }
+
+    std::cout << std::setprecision(4)
+              << "ssp events, " << events[0].size() << " words, " << nev << " events" << std::endl
+              << "    reference (recursive):    " << std::chrono::duration<double, std::nano>(t_ref).count() / nev
+              << " ns/event" << std::endl
+              << "    EventParser:              " << ns[0] << " ns/event" << std::endl
+              << "    EventParser, roc skipped: " << ns[1] << " ns/event" << std::endl
+              << "ssp events: same decoder calls with roc 40 skipped, no allocation"
+              << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+    return ok;
+}
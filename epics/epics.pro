@@ -16,6 +16,12 @@ QMAKE_LFLAGS   += -g
 
 INCLUDEPATH += ./include ../gem/include ../gem/third_party
 
+######################################################################
+# root headers
+INCLUDEPATH += $$system(root-config --incdir)
+# root libs
+LIBS += $$system(root-config --glibs)
+
 MOC_DIR = moc
 OBJECTS_DIR = obj
 
@@ -0,0 +1,38 @@
+######################################################################
+# epics bank parsing test
+######################################################################
+
+TEMPLATE = app
+TARGET = ../bin/epics_test
+
+QMAKE_CXXFLAGS -= -std=gnu++1y
+QMAKE_CXXFLAGS -= -std=c++1y
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_CXXFLAGS += -g
+QMAKE_CFLAGS   += -g
+QMAKE_LFLAGS   += -g
+
+######################################################################
+# epics headers
+INCLUDEPATH += ./include
+
+# epics lib
+LIBS += -L./lib -lepics
+
+######################################################################
+# root headers
+INCLUDEPATH += $$system(root-config --incdir)
+# root libs
+LIBS += $$system(root-config --glibs)
+
+######################################################################
+# moc dir
+MOC_DIR = moc
+
+######################################################################
+# obj dir
+OBJECTS_DIR = obj
+
+######################################################################
+# source path
+SOURCES += test/epics_test.cpp \
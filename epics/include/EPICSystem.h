@@ -3,7 +3,7 @@
 
 #include <vector>
 #include <string>
-#include <deque>
+#include <string_view>
 #include <unordered_map>
 
 // epics channel
@@ -50,8 +50,51 @@ struct EpicsData
 //============================================================================//
 
 
+//============================================================================//
+// EPICS TIME SERIES                                                          //
+//============================================================================//
+// one channel: the event numbers where its value changed and the values,
+// in ascending event number. The value at an event is the last change
+// at or before it.
+struct EpicsSeries
+{
+    std::vector<int32_t> events;
+    std::vector<float> values;
+
+    void clear()
+    {
+        events.clear();
+        values.clear();
+    }
+    size_t size() const {return events.size();}
+};
+
+
 class EPICSystem
 {
+public:
+    // value lookup for increasing event numbers, every lookup after a Seek()
+    // continues from where the previous one of the channel stopped, so a
+    // replay that goes forward costs O(1) per event and channel. Seeking
+    // backwards falls back to a binary search.
+    class Cursor
+    {
+    public:
+        Cursor(const EPICSystem &s);
+
+        void Seek(int event_number);
+        float Value(int channel);
+        int GetEventNumber() const {return event;}
+
+    private:
+        const EPICSystem *sys;
+        int event = -1;
+        uint32_t generation = 0;
+        uint32_t clear_count = 0;        // of sys, the positions are stale when it changes
+        std::vector<size_t> pos;         // entries <= event, per channel
+        std::vector<uint32_t> pos_valid; // generation the position is valid for
+    };
+
 public:
     EPICSystem(const std::string &s);
     ~EPICSystem();
@@ -72,11 +115,21 @@ public:
     float GetValue(const std::string &name) const;
     int GetEventNumber() const;
     int GetChannel(const std::string &name) const;
-    const EpicsData &GetEvent(const unsigned int &index) const;
-    const std::deque<EpicsData> &GetEventData() const {return epics_data;}
-    unsigned int GetEventCount() const {return epics_data.size();}
+    EpicsData GetEvent(const unsigned int &index) const;
+    unsigned int GetEventCount() const {return saved_events.size();}
+    const EpicsSeries &GetSeries(int channel) const;
     float FindValue(int event_number, const std::string &name) const;
+    float FindValue(int event_number, int channel) const;
     int FindEvent(int event_number) const;
+    Cursor GetCursor() const {return Cursor(*this);}
+
+    // values of a channel at a list of events, fastest for ascending events
+    void ValuesAt(int channel, const int32_t *events, size_t n, float *out) const;
+    std::vector<float> ValuesAt(int channel, const std::vector<int32_t> &events) const;
+
+    // the series as a root tree in the current directory: one entry, two
+    // branches per channel, <name> (values) and <name>_event (event numbers)
+    void WriteTree(const char *tree_name = "epics") const;
 
     // binary search, return the closest smaller value of the input if the same
     // value is not found
@@ -112,11 +165,25 @@ public:
     }
 
 
+private:
+    int LookupChannel(std::string_view name, size_t pos);
+    void AppendValues(int event_number, const std::vector<float> &values);
+
 private:
     // data related
     std::unordered_map<std::string, uint32_t> epics_map;
     std::vector<float> epics_values;
-    std::deque<EpicsData> epics_data;
+
+    // saved events, and per channel the values where they changed
+    std::vector<int32_t> saved_events;
+    std::vector<EpicsSeries> epics_series;
+
+    // number of times the series were cleared, for the cursors
+    uint32_t clear_count = 0;
+
+    // channel index of the n-th name in the last bank (-1 = unknown
+    // channel), banks usually list the channels in the same order
+    std::vector<std::pair<std::string, int>> bank_channels;
 };
 
 #endif
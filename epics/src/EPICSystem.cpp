@@ -1,10 +1,14 @@
 #include "EPICSystem.h"
-#include <sstream>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
-#include <cassert>
+#include <charconv>
+#include <cerrno>
+#include <cstdlib>
+#include <cctype>
+
+#include <TTree.h>
 
 #define EPICS_UNDEFINED_VALUE -9999.9
 
@@ -20,7 +24,10 @@ EPICSystem::~EPICSystem()
 
 void EPICSystem::Reset()
 {
-    epics_data = std::deque<EpicsData>();
+    saved_events.clear();
+    for(auto &series : epics_series)
+        series.clear();
+    clear_count++;
 
     for(auto &value : epics_values)
     {
@@ -89,6 +96,7 @@ void EPICSystem::AddChannel(const std::string &name)
     if(it == epics_map.end()) {
         epics_map[name] = epics_values.size();
         epics_values.push_back(EPICS_UNDEFINED_VALUE);
+        bank_channels.clear();
     } else {
         std::cout << " EPICS Warning: Failed to add duplicated channel "
                   << name << ", its channel id is " << it->second
@@ -105,6 +113,7 @@ void EPICSystem::AddChannel(const std::string &name, uint32_t id, float value)
 
     epics_map[name] = id;
     epics_values.at(id) = value;
+    bank_channels.clear();
 }
 
 void EPICSystem::UpdateChannel(const std::string &name, const float &value)
@@ -115,66 +124,143 @@ void EPICSystem::UpdateChannel(const std::string &name, const float &value)
     }
 }
 
-void EPICSystem::FillRawData(const char *data)
+// same characters as the whitespace of std::istream in the "C" locale
+static inline bool is_space(char c)
 {
-    std::string raw_data(data);
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
 
-    std::istringstream iss(raw_data);
-    std::string tmp;
-    std::vector<std::string> cache;
-    while(iss >> tmp) {
-        std::string _t = strip(tmp);
+// next whitespace separated token, empty at the end of the string
+static inline std::string_view next_token(const char *&p)
+{
+    while(*p && is_space(*p)) ++p;
+    const char *begin = p;
+    while(*p && !is_space(*p)) ++p;
+    return std::string_view(begin, p - begin);
+}
 
-        if(_t.size() > 0) cache.push_back(_t);
+// convert as std::stod does: the leading number of the token is used,
+// false if there is none or it is out of range
+static bool to_value(std::string_view token, float &value)
+{
+#if defined(__cpp_lib_to_chars)
+    // from_chars only when it takes the whole token, "0x1A" would stop
+    // after the "0"
+    double v;
+    auto res = std::from_chars(token.data(), token.data() + token.size(), v);
+    if(res.ec == std::errc() && res.ptr == token.data() + token.size()) {
+        value = v;
+        return true;
     }
+    if(res.ec == std::errc::result_out_of_range)
+        return false;
+#endif
+    // what from_chars doesn't take (leading '+', hex, trailing characters),
+    // the token is followed by whitespace or the end of the bank, so strtod
+    // stops in the token
+    char *end;
+    errno = 0;
+    double v2 = std::strtod(token.data(), &end);
+    if(end == token.data() || errno == ERANGE)
+        return false;
+    value = v2;
+    return true;
+}
 
-    int N = cache.size();
-
-    // expect 2 elements for each epics channel
-    // channel_name  channel_value
-    assert(N % 2 == 0);
+// channel index of a name, pos is the position of the name in the bank
+int EPICSystem::LookupChannel(std::string_view name, size_t pos)
+{
+    if(pos < bank_channels.size() && bank_channels[pos].first == name)
+        return bank_channels[pos].second;
+
+    std::string key(name);
+    auto it = epics_map.find(key);
+    int index = (it == epics_map.end()) ? -1 : static_cast<int>(it->second);
+
+    if(pos >= bank_channels.size())
+        bank_channels.resize(pos + 1);
+    bank_channels[pos].first = std::move(key);
+    bank_channels[pos].second = index;
+    return index;
+}
 
-    std::string name;
-    float number;
-    for(int i=0; i<N/2; i++)
+// the bank is a list of "channel_name channel_value" pairs separated by
+// whitespace, parsed in place. Unknown channels are ignored, a value that
+// cannot be converted is reported and the channel keeps its value, a
+// name without value at the end is ignored.
+void EPICSystem::FillRawData(const char *data)
+{
+    const char *p = data;
+    size_t pos = 0;
+    while(true)
     {
-        name = cache[2*i];
-        try {
-            number = std::stod(cache[2*i+1]);
-        } catch (...) {
+        std::string_view name = next_token(p);
+        std::string_view value = next_token(p);
+        if(value.empty())
+            break;
+
+        float number;
+        if(!to_value(value, number)) {
             std::cout<<__PRETTY_FUNCTION__<<" ERROR: failed to convert epics channel value:"
-                <<cache[2*i + 1]<<std::endl;
+                <<value<<std::endl;
+            pos++;
+            continue;
         }
 
-        UpdateChannel(name, number);
+        int index = LookupChannel(name, pos++);
+        if(index >= 0)
+            epics_values[index] = number;
     }
 }
 
 void EPICSystem::AddEvent(EpicsData &&data)
 {
-    epics_data.emplace_back(data);
+    AppendValues(data.event_number, data.values);
 }
 
 void EPICSystem::AddEvent(const EpicsData &data)
 {
-    epics_data.push_back(data);
+    AppendValues(data.event_number, data.values);
 }
 
 void EPICSystem::SaveData(const int &event_number, bool online)
 {
-    if(online && epics_data.size())
-        epics_data.pop_front();
+    // online only the latest values are kept
+    if(online) {
+        saved_events.clear();
+        for(auto &series : epics_series)
+            series.clear();
+        clear_count++;
+    }
+
+    AppendValues(event_number, epics_values);
+}
+
+// a channel only gets an entry when its value changed
+void EPICSystem::AppendValues(int event_number, const std::vector<float> &values)
+{
+    if(epics_series.size() < values.size())
+        epics_series.resize(values.size());
 
-    epics_data.emplace_back(event_number, epics_values);
+    saved_events.push_back(event_number);
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        EpicsSeries &series = epics_series[i];
+        if(!series.values.empty() && series.values.back() == values[i])
+            continue;
+
+        series.events.push_back(event_number);
+        series.values.push_back(values[i]);
+    }
 }
 
 float EPICSystem::GetValue(const std::string &name)
 const
 {
-    unsigned int ch = GetChannel(name);
+    int ch = GetChannel(name);
 
-    if(epics_data.size() && epics_data.back().values.size() > ch)
-        return epics_data.back().values.at(ch);
+    if(ch >= 0 && ch < (int)epics_series.size() && epics_series[ch].size())
+        return epics_series[ch].values.back();
 
     return EPICS_UNDEFINED_VALUE;
 }
@@ -182,10 +268,10 @@ const
 int EPICSystem::GetEventNumber()
 const
 {
-    if(epics_data.empty())
+    if(saved_events.empty())
         return -1;
 
-    return epics_data.back().event_number;
+    return saved_events.back();
 }
 
 int EPICSystem::GetChannel(const std::string &name)
@@ -243,25 +329,38 @@ const
     out.close();
 }
 
-const EpicsData &EPICSystem::GetEvent(const unsigned int &index)
+EpicsData EPICSystem::GetEvent(const unsigned int &index)
 const
 {
-    if(epics_data.empty()) {
+    if(saved_events.empty()) {
         std::cout<<__PRETTY_FUNCTION__<<" ERROR: emtpy data bank!"
             <<std::endl;
+        return EpicsData();
     }
 
-    if(index >= epics_data.size())
-        return epics_data.back();
+    int event_number = (index >= saved_events.size()) ? saved_events.back()
+        : saved_events.at(index);
 
-    return epics_data.at(index);
+    std::vector<float> values(epics_series.size());
+    for(size_t i = 0; i < epics_series.size(); i++)
+        values[i] = FindValue(event_number, i);
+
+    return EpicsData(event_number, values);
 }
 
-float EPICSystem::FindValue(int evt, const std::string &name)
+const EpicsSeries &EPICSystem::GetSeries(int channel)
 const
 {
-    float result = EPICS_UNDEFINED_VALUE;
+    static const EpicsSeries empty;
+    if(channel < 0 || channel >= (int)epics_series.size())
+        return empty;
 
+    return epics_series[channel];
+}
+
+float EPICSystem::FindValue(int evt, const std::string &name)
+const
+{
     auto it = epics_map.find(name);
     if(it == epics_map.end()) {
         std::cerr << " EPICS Warning: Did not find EPICS channel "
@@ -270,27 +369,151 @@ const
         return EPICS_UNDEFINED_VALUE;
     }
 
-    uint32_t channel_id = it->second;
+    return FindValue(evt, it->second);
+}
 
-    auto ev_it = binary_search_close_less(epics_data.begin(), epics_data.end(), evt);
+// last change at or before evt
+float EPICSystem::FindValue(int evt, int channel)
+const
+{
+    const EpicsSeries &series = GetSeries(channel);
 
-    // found the epics event that just before evt, and it has that channel
-    if((ev_it != epics_data.end()) &&
-       (ev_it->values.size() > channel_id)) {
-        result = ev_it->values.at(channel_id);
-    }
+    auto it = std::upper_bound(series.events.begin(), series.events.end(), evt);
+    if(it == series.events.begin())
+        return EPICS_UNDEFINED_VALUE;
 
-    return result;
+    return series.values[it - series.events.begin() - 1];
 }
 
 int EPICSystem::FindEvent(int evt)
 const
 {
-    auto it = binary_search_close_less(epics_data.begin(), epics_data.end(), evt);
+    auto it = binary_search_close_less(saved_events.begin(), saved_events.end(), evt);
 
-    // found the epics event that just before evt, and it has that channel
-    if(it != epics_data.end())
-        return (it - epics_data.begin());
+    // found the epics event that just before evt
+    if(it != saved_events.end())
+        return (it - saved_events.begin());
 
     return -1;
 }
+
+void EPICSystem::ValuesAt(int channel, const int32_t *events, size_t n, float *out)
+const
+{
+    const EpicsSeries &series = GetSeries(channel);
+    const int32_t *ev = series.events.data();
+    size_t N = series.size();
+
+    // walk along the series while the events go up, search otherwise
+    size_t pos = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        if(i == 0 || events[i] < events[i - 1])
+            pos = std::upper_bound(ev, ev + N, events[i]) - ev;
+        else
+            while(pos < N && ev[pos] <= events[i]) pos++;
+
+        out[i] = (pos == 0) ? EPICS_UNDEFINED_VALUE : series.values[pos - 1];
+    }
+}
+
+std::vector<float> EPICSystem::ValuesAt(int channel, const std::vector<int32_t> &events)
+const
+{
+    std::vector<float> res(events.size());
+    ValuesAt(channel, events.data(), events.size(), res.data());
+    return res;
+}
+
+// root branch names can't have '.' or ':'
+static std::string branch_name(const std::string &channel)
+{
+    std::string res = channel;
+    for(auto &c : res) {
+        if(!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+            c = '_';
+    }
+    return res;
+}
+
+void EPICSystem::WriteTree(const char *tree_name)
+const
+{
+    TTree *tree = new TTree(tree_name, "epics channels");
+
+    // the branches point into the series, filled once
+    std::vector<std::vector<int32_t>> events(epics_series.size());
+    std::vector<std::vector<float>> values(epics_series.size());
+    std::vector<std::vector<int32_t>*> p_events(epics_series.size());
+    std::vector<std::vector<float>*> p_values(epics_series.size());
+    for(auto &ch : GetSortedList())
+    {
+        if(ch.id >= epics_series.size())
+            continue;
+
+        events[ch.id] = epics_series[ch.id].events;
+        values[ch.id] = epics_series[ch.id].values;
+        p_events[ch.id] = &events[ch.id];
+        p_values[ch.id] = &values[ch.id];
+
+        std::string name = branch_name(ch.name);
+        tree -> Branch(name.c_str(), &p_values[ch.id]);
+        tree -> Branch((name + "_event").c_str(), &p_events[ch.id]);
+    }
+
+    std::vector<int32_t> all_events = saved_events;
+    std::vector<int32_t> *p_all_events = &all_events;
+    tree -> Branch("saved_event", &p_all_events);
+
+    tree -> Fill();
+    tree -> Write();
+    delete tree;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// cursor
+
+EPICSystem::Cursor::Cursor(const EPICSystem &s)
+    : sys(&s), clear_count(s.clear_count)
+{
+}
+
+void EPICSystem::Cursor::Seek(int event_number)
+{
+    // going back, every channel has to search again
+    if(event_number < event)
+        generation++;
+
+    event = event_number;
+}
+
+float EPICSystem::Cursor::Value(int channel)
+{
+    const EpicsSeries &series = sys -> GetSeries(channel);
+    if(series.size() == 0)
+        return EPICS_UNDEFINED_VALUE;
+
+    // the series were cleared (Reset, online mode) and maybe refilled since
+    // the last call, every channel has to search again
+    if(clear_count != sys -> clear_count) {
+        clear_count = sys -> clear_count;
+        generation++;
+    }
+
+    if(static_cast<size_t>(channel) >= pos.size()) {
+        pos.resize(channel + 1, 0);
+        pos_valid.resize(channel + 1, generation - 1);
+    }
+
+    size_t &p = pos[channel];
+    if(pos_valid[channel] != generation) {
+        p = std::upper_bound(series.events.begin(), series.events.end(), event)
+            - series.events.begin();
+        pos_valid[channel] = generation;
+    }
+    else {
+        while(p < series.size() && series.events[p] <= event) p++;
+    }
+
+    return (p == 0) ? EPICS_UNDEFINED_VALUE : series.values[p - 1];
+}
@@ -0,0 +1,307 @@
+////////////////////////////////////////////////////////////////
+// epics_test
+//
+// EPICSystem::FillRawData on the sample bank, checked against
+// literal values:
+//
+//     epics_test [bank_file] [map_file]
+//
+// defaults are epics/epics_bank_sample.txt and epics/epics_map.txt
+// (run from the top directory). The sample bank is in the text
+// format of the recorded EPICS banks, with an unknown channel,
+// values that do not convert, a leading '+', a hex value and a
+// value with trailing characters.
+//
+// The channel series (SaveData, FindValue, FindEvent, GetEvent,
+// ValuesAt and the Cursor) are checked against full snapshots of
+// 2000 random saves, then again after a Reset() and a refill.
+//
+// returns 0 if every check passed
+
+#include "EPICSystem.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <algorithm>
+
+// value of a channel that never got one (EPICS_UNDEFINED_VALUE)
+static const float undefined = -9999.9;
+
+static bool test_sample_bank(const std::string &bank_file, const std::string &map_file);
+static bool test_bank_order(const std::string &map_file);
+static bool test_series(const std::string &map_file);
+
+int main(int argc, char* argv[])
+{
+    std::string bank_file = (argc > 1) ? argv[1] : "epics/epics_bank_sample.txt";
+    std::string map_file = (argc > 2) ? argv[2] : "epics/epics_map.txt";
+
+    bool ok = test_sample_bank(bank_file, map_file);
+    ok = test_bank_order(map_file) && ok;
+    ok = test_series(map_file) && ok;
+
+    std::cout<<(ok ? "epics_test: all checks passed." : "epics_test: FAILED.")<<std::endl;
+    return ok ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////
+// compare the current values of the system, channels not in the
+// list must still be undefined
+
+static bool check_values(const char *name, const EPICSystem &epics,
+        const std::vector<std::pair<std::string, double>> &expected)
+{
+    std::unordered_map<std::string, float> values;
+    for(auto &ch: epics.GetSortedList())
+        values[ch.name] = ch.value;
+
+    int mismatches = 0;
+    auto report = [&](const std::string &ch, float v, float e) {
+        if(mismatches++ < 20)
+            std::cout<<"    "<<ch<<": "<<v<<" vs expected "<<e<<std::endl;
+    };
+
+    for(auto &e: expected) {
+        auto it = values.find(e.first);
+        if(it == values.end()) {
+            std::cout<<"    "<<e.first<<": not in the channel map"<<std::endl;
+            mismatches++;
+            continue;
+        }
+        // stod and then float, as the parser does
+        if(it -> second != static_cast<float>(e.second))
+            report(e.first, it -> second, static_cast<float>(e.second));
+        values.erase(it);
+    }
+    for(auto &v: values)
+        if(v.second != undefined)
+            report(v.first, v.second, undefined);
+
+    std::cout<<name<<": "<<expected.size()<<" values, "<<mismatches<<" mismatches"
+        <<(mismatches == 0 ? " -- PASSED" : " -- FAILED")<<std::endl;
+    return mismatches == 0;
+}
+
+////////////////////////////////////////////////////////////////
+// the sample bank, parsed twice (the second time through the
+// cached channel order)
+
+static const std::vector<std::pair<std::string, double>> sample_values = {
+    {"IPM1C08.XPOS", -0.1843},
+    {"IPM1C10", 1},
+    {"IPM1C10.XPOS", 0.0271},
+    {"IPM1C10.YPOS", -0.3512},
+    {"IPM1C12.XPOS", 0.1120},
+    {"IPM1C12.YPOS", 0.0934},
+    {"IPM1H04A.XPOS", -0.0215},
+    {"IPM1H04A.YPOS", 0.4471},
+    {"IPM1H04E.XPOS", 0.0532},
+    {"IPM1H04E.YPOS", -0.2760},
+    {"IPM1H04A.XSOF", 26},          // 0x1A
+    {"IPM1H04A.YSOF", 1.5},         // +1.5
+    {"IPM1H04E.XSOF", 12.5},        // 12.5mA
+    {"IPM1H04.XSOF", undefined},    // ***
+    {"IPM1H04.YSOF", 0},
+    {"IPM1H04.XPOS", -0.0367},
+    {"IPM1H04.YPOS", 0.3825},
+    {"hac_bcm_dvm1_read", 0.581093},
+    {"hac_bcm_dvm2_read", 0.579412},
+    {"hac_bcm_average", 2.41532},
+    {"hac_unser_current", 2.39971},
+    {"hac_bcm_A1", 2.41877},
+    {"hac_bcm_A2", 2.41187},
+    {"hac_bcm_A1sdev", 0.00412},
+    {"hac_bcm_A2sdev", 0.00398},
+    {"IBC0L02Current", 2.4437},
+    {"IBC3H00CRCUR4", 2.4405},
+    {"hac_unser_read", 402.77},     // +402.77
+    {"HA:K224:Current", 0},
+    {"ibcm1", 2.41},
+    {"ecSHMS_Angle", 11.003},
+    {"ecSDI_B_True_NMR", -0.71125},
+    {"ecSDI_HP", undefined},        // INVALID
+    {"ecSHB_HP", -1.8701},
+    {"HALLC:p", 10542.1},
+    {"ecSQ1_I_True", -367.12},
+    {"ecSQ2_I_True", -512.88},
+    {"ecSQ3_I_True", -364.09},
+};
+
+static bool test_sample_bank(const std::string &bank_file, const std::string &map_file)
+{
+    std::ifstream f(bank_file);
+    if(!f.is_open()) {
+        std::cout<<"ERROR: cannot open epics bank file: "<<bank_file<<std::endl;
+        return false;
+    }
+    std::stringstream ss;
+    ss << f.rdbuf();
+    std::string bank = ss.str();
+
+    EPICSystem epics(map_file);
+    epics.FillRawData(bank.c_str());
+    bool ok = check_values("sample bank", epics, sample_values);
+    epics.FillRawData(bank.c_str());
+    return check_values("sample bank, second parse", epics, sample_values) && ok;
+}
+
+////////////////////////////////////////////////////////////////
+// banks with a different channel order than the previous one,
+// a bad value, an unknown channel and a name without value
+
+static bool test_bank_order(const std::string &map_file)
+{
+    EPICSystem epics(map_file);
+    epics.FillRawData("IPM1C10 2 hac_bcm_A1 0.5 IPM1C08.XPOS -1e-3");
+    bool ok = check_values("bank 1", epics, {
+            {"IPM1C10", 2}, {"hac_bcm_A1", 0.5}, {"IPM1C08.XPOS", -1e-3}});
+
+    epics.FillRawData("\thac_bcm_A1 0x10\n unknown_channel 7 IPM1C10 n/a IPM1C12 -4.25 ibcm1");
+    ok = check_values("bank 2", epics, {
+            {"IPM1C10", 2}, {"hac_bcm_A1", 16}, {"IPM1C08.XPOS", -1e-3}, {"IPM1C12", -4.25}}) && ok;
+
+    epics.FillRawData("IPM1C10 3 hac_bcm_A1 +.25");
+    ok = check_values("bank 3", epics, {
+            {"IPM1C10", 3}, {"hac_bcm_A1", 0.25}, {"IPM1C08.XPOS", -1e-3}, {"IPM1C12", -4.25}}) && ok;
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////
+// the series against snapshots of every save. Saves are random
+// event numbers going up, a few channels change between saves.
+
+struct snapshot_t
+{
+    int event;
+    std::vector<float> values;
+};
+
+// value of a channel at an event: last snapshot at or before it
+static float snapshot_value(const std::vector<snapshot_t> &snapshots, int event, int ch)
+{
+    auto it = std::upper_bound(snapshots.begin(), snapshots.end(), event,
+            [](int e, const snapshot_t &s) {return e < s.event;});
+    if(it == snapshots.begin())
+        return undefined;
+    return (it - 1) -> values[ch];
+}
+
+static void fill_saves(EPICSystem &epics, const std::vector<EPICSChannel> &channels,
+        int first_event, int nsaves, std::mt19937 &rng, std::vector<snapshot_t> &snapshots)
+{
+    std::uniform_int_distribution<int> gap(1, 50), pick(0, channels.size() - 1), change(0, 3);
+    std::uniform_real_distribution<float> value(-10., 10.);
+
+    snapshots.clear();
+    int event = first_event;
+    for(int i = 0; i < nsaves; i++)
+    {
+        for(int n = change(rng); n > 0; n--)
+            epics.UpdateChannel(channels[pick(rng)].name, value(rng));
+        epics.SaveData(event);
+        snapshots.push_back(snapshot_t{event, epics.GetCurrentValues()});
+        event += gap(rng);
+    }
+}
+
+static bool check_series(const char *name, const EPICSystem &epics, EPICSystem::Cursor &cursor,
+        const std::vector<snapshot_t> &snapshots, std::mt19937 &rng)
+{
+    int nch = snapshots.front().values.size();
+    int first = snapshots.front().event, last = snapshots.back().event;
+    int mismatches = 0;
+    auto check = [&](const char *what, int event, int ch, float v) {
+        float e = snapshot_value(snapshots, event, ch);
+        if(v == e)
+            return;
+        if(mismatches++ < 20)
+            std::cout<<"    "<<what<<": event "<<event<<", channel "<<ch<<": "<<v
+                <<" vs expected "<<e<<std::endl;
+    };
+
+    // events before, between and after the saves, going up
+    std::vector<int32_t> events;
+    for(int ev = first - 5; ev <= last + 5; ev++)
+        events.push_back(ev);
+
+    // FindValue, and the cursor going forward
+    for(auto ev: events) {
+        cursor.Seek(ev);
+        for(int ch = 0; ch < nch; ch++) {
+            check("FindValue", ev, ch, epics.FindValue(ev, ch));
+            check("Cursor", ev, ch, cursor.Value(ch));
+        }
+    }
+
+    // the cursor going back and forth
+    std::uniform_int_distribution<int> random_event(first - 5, last + 5);
+    for(int i = 0; i < 2000; i++) {
+        int ev = random_event(rng);
+        cursor.Seek(ev);
+        for(int ch = 0; ch < nch; ch++)
+            check("Cursor, random", ev, ch, cursor.Value(ch));
+    }
+
+    // batch, ascending and shuffled
+    std::vector<int32_t> shuffled = events;
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    for(int ch = 0; ch < nch; ch++) {
+        std::vector<float> v = epics.ValuesAt(ch, events), w = epics.ValuesAt(ch, shuffled);
+        for(size_t i = 0; i < events.size(); i++) {
+            check("ValuesAt", events[i], ch, v[i]);
+            check("ValuesAt, shuffled", shuffled[i], ch, w[i]);
+        }
+    }
+
+    // saved events
+    if(epics.GetEventCount() != snapshots.size()) {
+        std::cout<<"    "<<epics.GetEventCount()<<" saved events, expected "<<snapshots.size()<<std::endl;
+        mismatches++;
+    }
+    for(size_t i = 0; i < snapshots.size() && i < epics.GetEventCount(); i++) {
+        EpicsData data = epics.GetEvent(i);
+        if(data.event_number != snapshots[i].event || data.values != snapshots[i].values
+                || epics.FindEvent(snapshots[i].event) != static_cast<int>(i)) {
+            if(mismatches++ < 20)
+                std::cout<<"    GetEvent/FindEvent: save "<<i<<" differs"<<std::endl;
+        }
+    }
+
+    size_t entries = 0;
+    for(int ch = 0; ch < nch; ch++)
+        entries += epics.GetSeries(ch).size();
+    std::cout<<name<<": "<<snapshots.size()<<" saves, "<<entries<<" series entries for "
+        <<snapshots.size() * nch<<" snapshot values, "<<mismatches<<" mismatches"
+        <<(mismatches == 0 ? " -- PASSED" : " -- FAILED")<<std::endl;
+    return mismatches == 0;
+}
+
+static bool test_series(const std::string &map_file)
+{
+    EPICSystem epics(map_file);
+    std::vector<EPICSChannel> channels = epics.GetSortedList();
+    if(channels.empty()) {
+        std::cout<<"ERROR: no epics channels in: "<<map_file<<std::endl;
+        return false;
+    }
+
+    std::mt19937 rng(2024);
+    std::vector<snapshot_t> snapshots;
+    EPICSystem::Cursor cursor = epics.GetCursor();
+
+    fill_saves(epics, channels, 100, 2000, rng, snapshots);
+    bool ok = check_series("series", epics, cursor, snapshots, rng);
+
+    // a new run: the cursor stopped at the end of the previous one, the new
+    // events come after it, the cursor must not continue from its old position
+    cursor.Seek(snapshots.back().event);
+    for(size_t ch = 0; ch < channels.size(); ch++)
+        cursor.Value(ch);
+    epics.Reset();
+    fill_saves(epics, channels, snapshots.back().event + 100, 2000, rng, snapshots);
+    return check_series("series after Reset()", epics, cursor, snapshots, rng) && ok;
+}
@@ -0,0 +1,37 @@
+######################################################################
+# fadc250 waveform analyzer test, float/int16 and double paths vs the
+# stored reference results
+######################################################################
+
+TEMPLATE = app
+TARGET = ../bin/fadc_analyzer_test
+
+QMAKE_CXXFLAGS -= -std=gnu++1y
+QMAKE_CXXFLAGS -= -std=c++1y
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_CXXFLAGS += -g
+QMAKE_CFLAGS   += -g
+QMAKE_LFLAGS   += -g
+
+######################################################################
+# fadc headers, the analyzer is built in (fadc has no library)
+INCLUDEPATH += ./include
+
+######################################################################
+# root headers
+INCLUDEPATH += $$system(root-config --incdir)
+# root libs
+LIBS += $$system(root-config --glibs)
+
+######################################################################
+# moc dir
+MOC_DIR = moc
+
+######################################################################
+# obj dir
+OBJECTS_DIR = obj
+
+######################################################################
+# source path
+SOURCES += test/analyzer_test.cpp \
+           src/WfAnalyzer.cpp \
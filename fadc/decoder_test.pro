@@ -0,0 +1,35 @@
+######################################################################
+# fadc250 decoder test, recorded bank decoded without allocations
+######################################################################
+
+TEMPLATE = app
+TARGET = ../bin/fadc_decoder_test
+
+QMAKE_CXXFLAGS -= -std=gnu++1y
+QMAKE_CXXFLAGS -= -std=c++1y
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_CXXFLAGS += -g
+QMAKE_CFLAGS   += -g
+QMAKE_LFLAGS   += -g
+
+######################################################################
+# fadc headers, the decoder is built in (fadc has no library)
+INCLUDEPATH += ./include
+
+######################################################################
+# decoder headers, only the decoder base class is needed
+INCLUDEPATH += ../decoder/include
+
+######################################################################
+# moc dir
+MOC_DIR = moc
+
+######################################################################
+# obj dir
+OBJECTS_DIR = obj
+
+######################################################################
+# source path
+SOURCES += test/decoder_test.cpp \
+           src/Fadc250Decoder.cpp \
+           ../decoder/src/AbstractRawDecoder.cpp \
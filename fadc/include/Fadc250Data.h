@@ -1,6 +1,7 @@
 #pragma once
 
 #define FADC250_MAX_NPEAKS 4
+#define FADC250_MAX_NCHANNELS 16
 #define FADC250_MAX_NSAMPLES 256
 
 #include <cstdint>
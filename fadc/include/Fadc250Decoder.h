@@ -36,6 +36,9 @@ enum Fadc250Type {
     FillerWord = 15,
 };
 
+// the event is meant to be reused, Clear() keeps the capacity of the channel
+// buffers so decoding into the same event does not allocate once it has seen
+// the largest window
 class Fadc250Event
 {
 public:
@@ -43,9 +46,10 @@ public:
     std::vector<uint32_t> time;
     std::vector<Fadc250Data> channels;
 
-    Fadc250Event(uint32_t n = 0, uint32_t nch = 16)
+    Fadc250Event(uint32_t n = 0, uint32_t nch = FADC250_MAX_NCHANNELS)
         : number(n), mode(0)
     {
+        time.reserve(4);
         channels.resize(nch);
     }
 
@@ -60,11 +64,13 @@ public:
 class Fadc250Decoder : public AbstractRawDecoder
 {
 public:
+    static constexpr uint32_t ALL_CHANNELS = (1u << FADC250_MAX_NCHANNELS) - 1;
+
     Fadc250Decoder(double clk = 250.);
 
-    // for an event data
-    void DecodeEvent(Fadc250Event &event, const uint32_t *buf, size_t len) const;
-    inline Fadc250Event DecodeEvent(const uint32_t *buf, size_t len, size_t nchans = 16) const
+    // for an event data, channels not set in chan_mask are skipped
+    void DecodeEvent(Fadc250Event &event, const uint32_t *buf, size_t len, uint32_t chan_mask = ALL_CHANNELS) const;
+    inline Fadc250Event DecodeEvent(const uint32_t *buf, size_t len, size_t nchans = FADC250_MAX_NCHANNELS) const
     {
         Fadc250Event evt;
         evt.channels.resize(nchans);
@@ -72,13 +78,17 @@ public:
         return evt;
     }
 
+    // decodes into the decoder's own event, only the channels in the mask
     virtual void Decode(const uint32_t *pBuf, uint32_t fBufLen, std::vector<int> &vTagTrack);
     virtual void Clear();
     const Fadc250Event &GetDecodedEvent() const {return _event;}
 
+    void SetChannelMask(uint32_t mask) {_chan_mask = mask;}
+    uint32_t GetChannelMask() const {return _chan_mask;}
 
 private:
     double _clk;
+    uint32_t _chan_mask = ALL_CHANNELS;
 
     Fadc250Event _event;
 };
@@ -6,13 +6,18 @@
 //
 // History:
 // v1.0.0: a working version with basic functionalities, Chao Peng, 2020/08/04
+// v1.1.0: float/int16 path with preallocated buffers (Analyze with a Workspace)
 
 #include "Fadc250Data.h"
 #include <algorithm>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <memory>
 
 
+class TSpectrum;
+
 namespace fdec {
 
 // some help functions
@@ -72,6 +77,40 @@ inline void _linear_regr(double &p0, double &p1, double &err, const T *x, const
     err = std::sqrt(err/static_cast<double>(npts));
 }
 
+// buffers of the float/int16 analysis path, they keep their capacity between
+// waveforms, use one per thread
+struct Workspace
+{
+    std::vector<int16_t> samples;
+    std::vector<float> buffer;
+    std::vector<double> sum, sum2, background;
+    // a window of the spectrum smoothed in double, for the decisions close to a cut
+    std::vector<double> window;
+    std::vector<int8_t> trend;
+    std::vector<Peak> candidates;
+    // set when a decision of the float path was within rounding of a cut
+    bool tie = false;
+    // background fit of the spectra without a flat baseline, made on first use
+    std::unique_ptr<TSpectrum> spectrum;
+
+    Workspace();
+    Workspace(Workspace &&);
+    Workspace &operator =(Workspace &&);
+    ~Workspace();
+
+    void Reserve(size_t nsamples)
+    {
+        samples.reserve(nsamples);
+        buffer.reserve(nsamples);
+        sum.reserve(nsamples + 1);
+        sum2.reserve(nsamples + 1);
+        background.reserve(nsamples);
+        window.reserve(nsamples);
+        trend.reserve(nsamples);
+        candidates.reserve(nsamples/3 + 1);
+    }
+};
+
 // analyzer class
 class Analyzer
 {
@@ -86,11 +125,21 @@ public:
     void Analyze(Fadc250Data &data) const;
     Fadc250Data Analyze(const uint32_t *samples, size_t nsamples) const;
 
+    // same analysis with int16 samples and a float spectrum in the workspace
+    // buffers, results agree with Analyze(data) within float precision, a
+    // waveform with a decision within rounding of a cut is redone by Analyze(data)
+    void Analyze(Fadc250Data &data, Workspace &ws) const;
+
     // find pedestal, it assumes the pedestal is a constant (for simple FADC250 spectrum)
     Pedestal FindPedestal(const std::vector<double> &buffer, const std::vector<Peak> &/*peaks*/) const;
+    // float version, ws.samples must hold the samples of buffer (as left by Analyze)
+    Pedestal FindPedestal(const float *buffer, size_t npts, Workspace &ws) const;
 
     // search local maxima as peak candidates
     std::vector<Peak> SearchMaxima(const std::vector<double> &buffer, double height_thres) const;
+    // float version, candidates are left in ws.candidates, ws.samples must
+    // hold the samples of buffer (as left by Analyze)
+    void SearchMaxima(const float *buffer, size_t npts, double height_thres, Workspace &ws) const;
 
     // get
     double GetThreshold() const { return _thres; }
@@ -107,21 +156,88 @@ public:
     void SetOverflowValue(uint32_t overflow) { _overflow = overflow; }
 
 private:
+    template<typename T>
+    void fill_peaks(Fadc250Data &data, const T *buffer, std::vector<Peak> &candidates, bool *tie = nullptr) const;
+
+    // samples [i, i + n) of ws.samples smoothed in double as Analyze(data) does
+    const double *double_window(Workspace &ws, size_t i, size_t n) const
+    {
+        ws.window.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            ws.window[k] = SmoothSample(ws.samples.data(), ws.samples.size(), _res, i + k);
+        }
+        return ws.window.data();
+    }
+
+    // a < b, also sets *tie (if given) when a and b are closer than _tie
+    bool below(double a, double b, bool *tie) const
+    {
+        if (tie && std::abs(a - b) < _tie) { *tie = true; }
+        return a < b;
+    }
+
     double _thres, _clk, _ped_flat;
     size_t _res, _npeds;
     uint32_t _overflow;
 
+    // float path only: a value closer than this to a cut (or a pedestal window
+    // closer than this in mean) may fall on the other side in double, smoothed
+    // spectra of integer samples often land exactly on the cuts
+    static constexpr double _tie = 1e-3;
+
 
 public:
     // static methods
     template<typename T>
     static std::vector<double> SmoothSpectrum(const T *samples, size_t nsamples, size_t res)
+    {
+        std::vector<double> buffer(nsamples);
+        SmoothSpectrum(samples, nsamples, res, buffer.data());
+        return buffer;
+    }
+
+    // same smoothing into a preallocated double buffer
+    template<typename T>
+    static void SmoothSpectrum(const T *samples, size_t nsamples, size_t res, double *out)
     {
         if (res <= 1) {
-            return std::vector<double>(samples, samples + nsamples);
+            for (size_t i = 0; i < nsamples; ++i) { out[i] = samples[i]; }
+            return;
         }
-        std::vector<double> buffer(nsamples);
         for (size_t i = 0; i < nsamples; ++i) {
+            out[i] = SmoothSample(samples, nsamples, res, i);
+        }
+    }
+
+    // one smoothed sample
+    template<typename T>
+    static double SmoothSample(const T *samples, size_t nsamples, size_t res, size_t i)
+    {
+        double val = samples[i];
+        double weights = 1.0;
+        for (size_t j = 1; j < res; ++j) {
+            if (j >= i || j + i >= nsamples) { continue; }
+            double weight = 1.0 - j/static_cast<double>(res + 1);
+            val += weight*(samples[i - j] + samples[i + j]);
+            weights += 2.*weight;
+        }
+        return val/weights;
+    }
+
+    // same smoothing into a preallocated float buffer, the samples that
+    // have all neighbors are done one weight at a time over the whole
+    // range, so the loops vectorize
+    static void SmoothSpectrum(const int16_t *samples, size_t nsamples, size_t res, float *out)
+    {
+        if (res <= 1) {
+            for (size_t i = 0; i < nsamples; ++i) { out[i] = samples[i]; }
+            return;
+        }
+
+        // edges, as above
+        size_t lo = std::min(res, nsamples);
+        size_t hi = (nsamples >= 2*res) ? nsamples - res + 1 : lo;
+        auto edge = [&] (size_t i) {
             double val = samples[i];
             double weights = 1.0;
             for (size_t j = 1; j < res; ++j) {
@@ -130,9 +246,24 @@ public:
                 val += weight*(samples[i - j] + samples[i + j]);
                 weights += 2.*weight;
             }
-            buffer[i] = val/weights;
+            out[i] = val/weights;
+        };
+        for (size_t i = 0; i < lo; ++i) { edge(i); }
+        for (size_t i = hi; i < nsamples; ++i) { edge(i); }
+
+        // inside
+        float weights = 1.f;
+        for (size_t i = lo; i < hi; ++i) { out[i] = samples[i]; }
+        for (size_t j = 1; j < res; ++j) {
+            const float weight = 1.f - j/static_cast<float>(res + 1);
+            const int16_t *sl = samples - j, *sr = samples + j;
+            for (size_t i = lo; i < hi; ++i) {
+                out[i] += weight*static_cast<float>(sl[i] + sr[i]);
+            }
+            weights += 2.f*weight;
         }
-        return buffer;
+        const float inv = 1.f/weights;
+        for (size_t i = lo; i < hi; ++i) { out[i] *= inv; }
     }
 
     template<typename T>
@@ -7,6 +7,7 @@
 //
 
 #include "Fadc250Decoder.h"
+#include <algorithm>
 
 using namespace fdec;
 
@@ -23,11 +24,18 @@ inline Fadc250Data &get_channel(Fadc250Event &ev, uint32_t ch)
     return ev.channels[ch];
 }
 
+// number of samples, stands in for the raw data of a disabled channel
+struct SampleCounter {
+    size_t n = 0;
+    size_t size() const { return n; }
+    void push_back(uint32_t) { ++n; }
+};
+
 template<class Container>
-inline uint32_t fill_in_words(const uint32_t *buf, size_t beg, Container &raw_data, size_t max_words = -1)
+inline uint32_t fill_in_words(const uint32_t *buf, size_t beg, size_t buflen, Container &raw_data, size_t max_words = -1)
 {
     uint32_t nwords = 0;
-    for (uint32_t i = beg + 1; raw_data.size() < max_words; ++i, ++nwords) {
+    for (size_t i = beg + 1; i < buflen && raw_data.size() < max_words; ++i, ++nwords) {
         auto data = buf[i];
         // finished
         if ((data & 0x80000000) && nwords > 0) {
@@ -57,7 +65,7 @@ struct PeakBuffer {
     bool in_data = false;
 };
 
-void Fadc250Decoder::DecodeEvent(Fadc250Event &res, const uint32_t *buf, size_t buflen)
+void Fadc250Decoder::DecodeEvent(Fadc250Event &res, const uint32_t *buf, size_t buflen, uint32_t chan_mask)
 const
 {
     res.Clear();
@@ -77,7 +85,10 @@ const
     }
 
     res.number = (header & 0x3FFFFF);
-    std::vector<std::vector<PeakBuffer>> peak_buffers(res.channels.size());
+    // the channel number has 4 bits and the pulse number 2 bits
+    PeakBuffer peak_buffers[FADC250_MAX_NCHANNELS][FADC250_MAX_NPEAKS];
+    const uint32_t nch = std::min<size_t>(res.channels.size(), FADC250_MAX_NCHANNELS);
+    auto enabled = [&] (uint32_t ch) { return ch < nch && TEST_BIT(chan_mask, ch); };
     uint32_t type = FillerWord;
 
     for (size_t iw = 1; iw < buflen; ++iw) {
@@ -101,9 +112,14 @@ const
                 // get channel and window size
                 uint32_t ch = (data >> 23) & 0xF;
                 size_t nwords= (data & 0xFFF);
-                auto &raw_data = get_channel(res, ch).raw;
-                raw_data.clear();
-                iw += fill_in_words(buf, iw, raw_data, nwords);
+                if (enabled(ch)) {
+                    auto &raw_data = get_channel(res, ch).raw;
+                    raw_data.clear();
+                    iw += fill_in_words(buf, iw, buflen, raw_data, nwords);
+                } else {
+                    SampleCounter skipped;
+                    iw += fill_in_words(buf, iw, buflen, skipped, nwords);
+                }
             } else {
                 std::cout << "Fadc250Decoder Error: unexpected window raw data word. ";
                 print_word(data);
@@ -126,9 +142,7 @@ const
                 uint32_t ch = (data >> 23) & 0xF;
                 uint32_t pulse_num = (data >> 21) & 0x3;
                 // uint32_t quality = (data >> 19) & 0x3;
-                if (peak_buffers[ch].size() < pulse_num + 1) {
-                    peak_buffers[ch].resize(4);
-                }
+                if (!enabled(ch)) { break; }
                 peak_buffers[ch][pulse_num].integral = data & 0x7FFFF;
                 peak_buffers[ch][pulse_num].in_data = true;
             }
@@ -138,10 +152,7 @@ const
                 uint32_t ch = (data >> 23) & 0xF;
                 uint32_t pulse_num = (data >> 21) & 0x3;
                 // uint32_t quality = (data >> 19) & 0x3;
-                [[maybe_unused]]auto &chan = get_channel(res, ch);
-                if (peak_buffers[ch].size() < pulse_num + 1) {
-                    peak_buffers[ch].resize(4);
-                }
+                if (!enabled(ch)) { break; }
                 // convert to ns (1e3 / _clk (MHz) / 64)
                 peak_buffers[ch][pulse_num].time = data & 0xFFFF;
                 peak_buffers[ch][pulse_num].in_data = true;
@@ -166,7 +177,7 @@ const
     }
 
     // fill peak buffers to result
-    for (size_t i = 0; i < peak_buffers.size(); ++i) {
+    for (size_t i = 0; i < nch; ++i) {
         for (auto &peak : peak_buffers[i]) {
             if (!peak.in_data) {
                 continue;
@@ -181,15 +192,18 @@ const
     return;
 }
 
-void Fadc250Decoder::Decode([[maybe_unused]]const uint32_t *pBuf, 
-        [[maybe_unused]]uint32_t fBufLen, 
+void Fadc250Decoder::Decode(const uint32_t *pBuf, uint32_t fBufLen,
         [[maybe_unused]]std::vector<int> &vTagTrack)
 {
-    // skip block header information
-    Fadc250Event event = DecodeEvent(&pBuf[2], fBufLen);
-    _event = std::move(event);
+    // skip block header information, decode in place to keep the buffers
+    if (fBufLen <= 2) {
+        _event.Clear();
+        return;
+    }
+    DecodeEvent(_event, &pBuf[2], fBufLen - 2, _chan_mask);
 }
 
 void Fadc250Decoder::Clear()
 {
+    _event.Clear();
 }
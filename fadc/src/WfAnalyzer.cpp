@@ -5,6 +5,12 @@
 
 using namespace fdec;
 
+// the background fit is only complete here
+Workspace::Workspace() = default;
+Workspace::Workspace(Workspace &&) = default;
+Workspace &Workspace::operator =(Workspace &&) = default;
+Workspace::~Workspace() = default;
+
 // constructor
 Analyzer::Analyzer(size_t res, double thres, size_t npeds, double ped_flat, uint32_t overflow, double clk)
 : _thres(thres), _clk(clk), _ped_flat(ped_flat), _res(res), _npeds(npeds), _overflow(overflow)
@@ -29,13 +35,67 @@ void Analyzer::Analyze(Fadc250Data &data) const
     data.ped = FindPedestal(buffer, candidates);
 
     // get final results
+    fill_peaks(data, &buffer[0], candidates);
+
+    /*
+    std::sort(peaks.begin(), peaks.end(),
+                [] (const Peak &p1, const Peak &p2) { return p1.height > p2.height; });
+    */
+    return;
+}
+
+// float/int16 path, nothing is allocated once the workspace has grown to the waveform size,
+// except the work array of the background fit for the spectra without a flat baseline and
+// the waveforms redone by the double path
+void Analyzer::Analyze(Fadc250Data &data, Workspace &ws) const
+{
+    size_t nsamples = data.raw.size();
+    if (!nsamples) { return; }
+
+    data.peaks.clear();
+    ws.tie = false;
+
+    // 12-bit samples, clamped in case of garbage words
+    ws.samples.resize(nsamples);
+    const uint32_t *raw = data.raw.data();
+    int16_t *samples = ws.samples.data();
+    for (size_t i = 0; i < nsamples; ++i) {
+        samples[i] = static_cast<int16_t>(std::min<uint32_t>(raw[i], INT16_MAX));
+    }
+
+    ws.buffer.resize(nsamples);
+    SmoothSpectrum(samples, nsamples, _res, ws.buffer.data());
+
+    // search local maxima
+    SearchMaxima(ws.buffer.data(), nsamples, _thres, ws);
+
+    // get pedestal
+    data.ped = FindPedestal(ws.buffer.data(), nsamples, ws);
+
+    // get final results
+    fill_peaks(data, ws.buffer.data(), ws.candidates, &ws.tie);
+
+    // a decision within the float rounding of a cut, let the double path decide
+    if (ws.tie) {
+        Analyze(data);
+    }
+}
+
+// pedestal subtraction, integral and the real sample peak of the candidates,
+// tie is only given by the float path
+template<typename T>
+void Analyzer::fill_peaks(Fadc250Data &data, const T *buffer, std::vector<Peak> &candidates, bool *tie) const
+{
+    const uint32_t *samples = data.raw.data();
+    size_t nsamples = data.raw.size();
+
     for (auto &peak : candidates) {
         // pedestal subtraction
         double peak_height = buffer[peak.pos] - data.ped.mean;
         // wrong baselin in the rough candidtes finding, below threshold, or not statistically significant
         if ((peak_height * peak.height < 0.) ||
-            (std::abs(peak_height) < _thres) ||
-            (std::abs(peak_height) < 3.0*data.ped.err)) {
+            below(std::abs(peak_height), _thres, tie) ||
+            below(std::abs(peak_height), 3.0*data.ped.err, tie)) {
             continue;
         }
         peak.height = peak_height;
@@ -46,14 +106,14 @@ void Analyzer::Analyze(Fadc250Data &data) const
         for (int i = peak.pos - 1; i >= static_cast<int>(peak.left); --i) {
             double val = buffer[i] - data.ped.mean;
             // stop when it touches or acrosses the baseline
-            if (std::abs(val) < data.ped.err || val * peak.height < 0.) {
+            if (below(std::abs(val), data.ped.err, tie) || val * peak.height < 0.) {
                 peak.left = i; break;
             }
             peak.integral += val;
         }
         for (size_t i = peak.pos + 1; i <= peak.right; ++i) {
             double val = buffer[i] - data.ped.mean;
-            if (std::abs(val) < data.ped.err || val * peak.height < 0.) {
+            if (below(std::abs(val), data.ped.err, tie) || val * peak.height < 0.) {
                 peak.right = i; break;
             }
             peak.integral += val;
@@ -62,8 +122,9 @@ void Analyzer::Analyze(Fadc250Data &data) const
         // determine the real sample peak
         uint32_t sample_pos = peak.pos;
         peak.height = samples[sample_pos] - data.ped.mean;
-        auto update_peak = [] (Peak &peak, double val, uint32_t pos) {
-            if (std::abs(val) > std::abs(peak.height)) {
+        // equal samples give equal values on both paths, no tie
+        auto update_peak = [this, tie] (Peak &peak, double val, uint32_t pos) {
+            if (val != peak.height && below(std::abs(peak.height), std::abs(val), tie)) {
                 peak.pos = pos;
                 peak.height = val;
             }
@@ -84,15 +145,8 @@ void Analyzer::Analyze(Fadc250Data &data) const
         // fill to results
         data.peaks.emplace_back(peak);
     }
-
-    /*
-    std::sort(peaks.begin(), peaks.end(),
-                [] (const Peak &p1, const Peak &p2) { return p1.height > p2.height; });
-    */
-    return;
 }
 
-
 // analyze waveform
 Fadc250Data Analyzer::Analyze(const uint32_t *samples, size_t nsamples) const
 {
@@ -147,6 +201,80 @@ Pedestal Analyzer::FindPedestal(const std::vector<double> &buffer, const std::ve
     return CalcPedestal(&ybuf[ybuf.size()/5], 3*ybuf.size()/5, 1.0, 3, _npeds);
 }
 
+// same search on the float buffer, sliding window sums instead of one mean/err per window
+Pedestal Analyzer::FindPedestal(const float *buffer, size_t npts, Workspace &ws) const
+{
+    Pedestal ped{0., 0.};
+    // too few samples, use the minimum value as the pedestal
+    if (npts < _npeds) {
+        _calc_mean_err(ped.mean, ped.err, buffer, npts);
+        for (size_t i = 0; i < npts; ++i) {
+            if (buffer[i] < ped.mean) { ped.mean = buffer[i]; }
+        }
+        return ped;
+    }
+
+    // number of trailing samples for pedestal
+    size_t ntrails = std::max(_npeds, npts/12);
+    // criteria for good pedestal (some overflow events will have a few flat samples)
+    double max_mean = _overflow*0.95;
+    bool find_baseline = false;
+
+    // running sums, so every window costs the same
+    ws.sum.resize(npts + 1);
+    ws.sum2.resize(npts + 1);
+    ws.sum[0] = ws.sum2[0] = 0.;
+    for (size_t i = 0; i < npts; ++i) {
+        ws.sum[i + 1] = ws.sum[i] + buffer[i];
+        ws.sum2[i + 1] = ws.sum2[i] + static_cast<double>(buffer[i])*buffer[i];
+    }
+
+    // progressively find a good baseline, compare variances and take the
+    // square root of the chosen one only. A window within rounding of the
+    // flatness cut, or of the mean of the best window so far (equal means are
+    // common), is decided on the spectrum smoothed in double as the double path does
+    const double inv = 1./ntrails;
+    const double max_var = _ped_flat*_ped_flat, var_tie = 2.*_ped_flat*_tie;
+    double ped_var = 0.;
+    size_t ped_win = 0;
+    ped.mean = max_mean;
+    for (size_t i = 0; i <= npts - ntrails; ++i) {
+        double mean = (ws.sum[i + ntrails] - ws.sum[i])*inv;
+        double var = (ws.sum2[i + ntrails] - ws.sum2[i])*inv - mean*mean;
+        bool flat = var < max_var;
+        if (std::abs(var - max_var) < var_tie) {
+            double dmean = 0., derr = 0.;
+            _calc_mean_err(dmean, derr, double_window(ws, i, ntrails), ntrails);
+            flat = derr < _ped_flat;
+        }
+        if(flat && below(mean, max_mean, &ws.tie)) {
+            bool lower = mean < ped.mean;
+            if (find_baseline && std::abs(mean - ped.mean) < _tie) {
+                double dmean = 0., dmean_ped = 0., derr = 0.;
+                _calc_mean_err(dmean, derr, double_window(ws, i, ntrails), ntrails);
+                _calc_mean_err(dmean_ped, derr, double_window(ws, ped_win, ntrails), ntrails);
+                lower = dmean < dmean_ped;
+            }
+            find_baseline = true;
+            if (lower) { ped.mean = mean; ped_var = var; ped_win = i; }
+        }
+    }
+    ped.err = std::sqrt(std::max(ped_var, 0.));
+    if (find_baseline) {
+        return ped;
+    }
+
+    // complicated spectrum, smoothed again in double so the background fit
+    // sees the same spectrum as the double path
+    auto &ybuf = ws.background;
+    ybuf.resize(npts);
+    SmoothSpectrum(ws.samples.data(), npts, _res, ybuf.data());
+    if (!ws.spectrum) { ws.spectrum.reset(new TSpectrum()); }
+    ws.spectrum->Background(&ybuf[0], ybuf.size(), ybuf.size()/4, TSpectrum::kBackDecreasingWindow,
+                    TSpectrum::kBackOrder2, false, TSpectrum::kBackSmoothing3, false);
+    return CalcPedestal(&ybuf[ybuf.size()/5], 3*ybuf.size()/5, 1.0, 3, _npeds);
+}
+
 std::vector<Peak> Analyzer::SearchMaxima(const std::vector<double> &buffer, double height_thres) const
 {
     std::vector<Peak> candidates;
@@ -181,3 +309,53 @@ std::vector<Peak> Analyzer::SearchMaxima(const std::vector<double> &buffer, doub
     return candidates;
 }
 
+// same search on the float buffer, the trend between neighbors is computed
+// once for the whole spectrum (vectorizable), the peak ranges are then
+// walked on the trend array
+void Analyzer::SearchMaxima(const float *buffer, size_t npts, double height_thres, Workspace &ws) const
+{
+    auto &candidates = ws.candidates;
+    candidates.clear();
+    if (npts < 3) { return; }
+
+    // trend[i]: buffer[i] vs buffer[i - 1], 0 if the difference is below 0.1
+    ws.trend.resize(npts);
+    int8_t *trend = ws.trend.data();
+    const float thr = 0.1f, thr_tie = _tie;
+    int ties = 0;
+    trend[0] = 0;
+    for (size_t i = 1; i < npts; ++i) {
+        float diff = buffer[i] - buffer[i - 1];
+        trend[i] = static_cast<int8_t>((diff >= thr) - (diff <= -thr));
+        ties += std::abs(std::abs(diff) - thr) < thr_tie;
+    }
+    if (ties) { ws.tie = true; }
+
+    for (uint32_t i = 1; i < npts - 1; ++i) {
+        int tr1 = trend[i];
+        int tr2 = -trend[i + 1];
+        // peak at the rising (declining) edge
+        if ((tr1 * tr2 >= 0) && (tr1 != 0)) {
+            uint32_t left = 1, right = 1;
+            // search the peak range
+            while ((i > left + 1) && (trend[i - left] == tr1)) {
+                left ++;
+            }
+            while ((i + right < npts - 1) && (-trend[i + right + 1]*tr1 >= 0)) {
+                right ++;
+            }
+
+            double base = (buffer[i - left] * right + buffer[i + right] * left) / static_cast<double>(left + right);
+            double height = std::abs(buffer[i] - base);
+            // within rounding of the threshold, the spectrum smoothed in double decides
+            if (std::abs(height - height_thres) < _tie) {
+                const double *dbuf = double_window(ws, i - left, left + right + 1);
+                double dbase = (dbuf[0] * right + dbuf[left + right] * left) / static_cast<double>(left + right);
+                height = std::abs(dbuf[left] - dbase);
+            }
+            if (height > height_thres) {
+                candidates.emplace_back(buffer[i] - base, 0., 0., i, i - left, i + right);
+            }
+        }
+    }
+}
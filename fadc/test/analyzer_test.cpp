@@ -0,0 +1,388 @@
+////////////////////////////////////////////////////////////////
+// analyzer_test
+//
+// fdec::Analyzer, float/int16 path (Analyze with a Workspace) and
+// double path (Analyze) against stored reference results:
+//
+//     analyzer_test [-r repeat] [-n nwaveforms] [-f reference] [-w] [fadc_dir]
+//
+// - the 16 recorded FADC250 waveforms in fadc_dir (default
+//   fadc/plots, raw_adc_channel<N>.txt, one event of 16 channels x
+//   100 samples), also timed: -r passes of 1000 events, ns/event
+// - n synthetic waveforms (default 20000): pedestal 300 with noise
+//   of 4 counts and one pulse, some with two or no pulse, some on a
+//   drifting baseline (no flat window, background fit). The
+//   generator only uses the raw mt19937 output, so the waveforms are
+//   the same with every compiler and standard library
+//
+// The reference (default fadc/examples/analyzer_reference.txt) holds
+// the results of the analyzer before the float path was added, for
+// the recorded waveforms and the first 1000 synthetic ones; -w writes
+// it again from the double path instead of checking.
+//
+// The double path must give the reference results (1e-8), the float
+// path the reference results and, for all n synthetic waveforms, the
+// double path results: same peak positions and ranges, heights,
+// integrals and pedestals within 1e-4 (relative to max(1, |value|)).
+// Returns 0 if every check passed.
+
+#include "WfAnalyzer.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+using namespace fdec;
+
+// results by waveform name
+typedef std::map<std::string, Fadc250Data> Results;
+
+static const int nref_synthetic = 1000;
+
+static bool read_waveform(const std::string &dir, int ch, std::vector<uint32_t> &raw);
+static bool read_reference(const std::string &path, Results &ref);
+static void write_result(std::ostream &out, const std::string &name, const Fadc250Data &data);
+static bool test_recorded(const Analyzer &analyzer, const std::string &dir, int repeat,
+                          const Results &ref, std::ostream *out);
+static bool test_synthetic(const Analyzer &analyzer, int nwaveforms, const Results &ref, std::ostream *out);
+
+int main(int argc, char* argv[])
+{
+    int repeat = 10, nwaveforms = 20000;
+    bool write = false;
+    std::string dir = "fadc/plots", ref_file = "fadc/examples/analyzer_reference.txt";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repeat = std::max(std::stoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            nwaveforms = std::stoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            ref_file = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0)
+            write = true;
+        else if (argv[i][0] != '-')
+            dir = argv[i];
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [-r repeat] [-n nwaveforms] [-f reference] [-w] [fadc_dir]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    Results ref;
+    std::ofstream out;
+    if (write) {
+        out.open(ref_file);
+        if (!out.is_open()) {
+            std::cout << "ERROR: cannot write reference file: " << ref_file << std::endl;
+            return 1;
+        }
+        nwaveforms = std::max(nwaveforms, nref_synthetic);
+    } else if (!read_reference(ref_file, ref)) {
+        return 1;
+    }
+
+    Analyzer analyzer;
+    std::ostream *pout = write ? &out : nullptr;
+    bool ok = test_recorded(analyzer, dir, repeat, ref, pout);
+    ok = test_synthetic(analyzer, nwaveforms, ref, pout) && ok;
+
+    if (write) {
+        std::cout << "reference written to " << ref_file << std::endl;
+        return ok ? 0 : 1;
+    }
+    std::cout << (ok ? "analyzer_test: all checks passed." : "analyzer_test: FAILED.") << std::endl;
+    return ok ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////
+// result of one waveform vs the expected one
+
+class Comparison
+{
+public:
+    Comparison(double t) : tol(t) {}
+
+    void Check(const std::string &where, const Fadc250Data &res, const Fadc250Data &ref)
+    {
+        compare(where, "pedestal mean", res.ped.mean, ref.ped.mean);
+        compare(where, "pedestal err", res.ped.err, ref.ped.err);
+        if (res.peaks.size() != ref.peaks.size()) {
+            compare(where, "peaks", res.peaks.size(), ref.peaks.size());
+            return;
+        }
+        for (size_t i = 0; i < ref.peaks.size(); i++) {
+            const Peak &p = res.peaks[i], &e = ref.peaks[i];
+            std::string name = "peak " + std::to_string(i) + " ";
+            compare(where, name + "pos", p.pos, e.pos);
+            compare(where, name + "left", p.left, e.left);
+            compare(where, name + "right", p.right, e.right);
+            compare(where, name + "height", p.height, e.height);
+            compare(where, name + "integral", p.integral, e.integral);
+            compare(where, name + "overflow", p.overflow, e.overflow);
+        }
+        npeaks += ref.peaks.size();
+        nchecked++;
+    }
+
+    int GetMismatches() const {return mismatches;}
+    int GetPeaks() const {return npeaks;}
+    int GetChecked() const {return nchecked;}
+
+private:
+    void compare(const std::string &where, const std::string &what, double v, double expected)
+    {
+        if (std::abs(v - expected) <= tol * std::max(1., std::abs(expected)))
+            return;
+        if (mismatches++ < 20)
+            std::cout << "    " << where << " " << what << ": " << v << " vs " << expected << std::endl;
+    }
+
+    double tol;
+    int mismatches = 0, npeaks = 0, nchecked = 0;
+};
+
+static bool report(const std::string &what, const Comparison &cmp)
+{
+    bool ok = cmp.GetMismatches() == 0;
+    std::cout << "    " << std::left << std::setw(28) << what << std::right << cmp.GetChecked() << " waveforms, "
+              << cmp.GetPeaks() << " peaks, " << cmp.GetMismatches() << " mismatches"
+              << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+    return ok;
+}
+
+// checks one waveform against the reference (if there is one for it)
+// and the float path against the double path, or writes the reference
+class Checks
+{
+public:
+    Checks(const Results &r, std::ostream *o)
+    : ref(r), out(o), double_ref(1e-8), float_ref(1e-4), float_double(1e-4) {}
+
+    void Check(const std::string &name, const Fadc250Data &res_double, const Fadc250Data &res_float)
+    {
+        if (out) {
+            write_result(*out, name, res_double);
+            return;
+        }
+        auto it = ref.find(name);
+        if (it != ref.end()) {
+            double_ref.Check(name + " (double path)", res_double, it -> second);
+            float_ref.Check(name + " (float path)", res_float, it -> second);
+        }
+        float_double.Check(name + " (float vs double)", res_float, res_double);
+    }
+
+    bool Report()
+    {
+        if (out)
+            return true;
+        bool ok = report("double path vs reference:", double_ref);
+        ok = report("float path vs reference:", float_ref) && ok;
+        ok = report("float path vs double path:", float_double) && ok;
+        return ok;
+    }
+
+private:
+    const Results &ref;
+    std::ostream *out;
+    Comparison double_ref, float_ref, float_double;
+};
+
+////////////////////////////////////////////////////////////////
+// recorded waveforms, checked and timed per event of 16 channels
+
+static bool test_recorded(const Analyzer &analyzer, const std::string &dir, int repeat,
+                          const Results &ref, std::ostream *out)
+{
+    const int nch = 16;
+    std::vector<Fadc250Data> res_double(nch), res_float(nch);
+    for (int ch = 0; ch < nch; ch++) {
+        if (!read_waveform(dir, ch, res_double[ch].raw))
+            return false;
+        res_float[ch].raw = res_double[ch].raw;
+    }
+
+    Workspace ws;
+    ws.Reserve(FADC250_MAX_NSAMPLES);
+
+    using clock = std::chrono::steady_clock;
+    clock::duration t_double = clock::duration::zero(), t_float = clock::duration::zero();
+    for (int pass = 0; pass < repeat; pass++)
+    {
+        auto t0 = clock::now();
+        for (int i = 0; i < 1000; i++)
+            for (auto &d : res_double)
+                analyzer.Analyze(d);
+        t_double += clock::now() - t0;
+
+        t0 = clock::now();
+        for (int i = 0; i < 1000; i++)
+            for (auto &d : res_float)
+                analyzer.Analyze(d, ws);
+        t_float += clock::now() - t0;
+    }
+
+    Checks checks(ref, out);
+    for (int ch = 0; ch < nch; ch++)
+        checks.Check("channel " + std::to_string(ch), res_double[ch], res_float[ch]);
+
+    double nev = 1000. * repeat;
+    double ns_double = std::chrono::duration<double, std::nano>(t_double).count() / nev;
+    double ns_float = std::chrono::duration<double, std::nano>(t_float).count() / nev;
+    std::cout << std::setprecision(4)
+              << "recorded event, " << nch << " channels x " << res_double[0].raw.size() << " samples, "
+              << nev << " events" << std::endl
+              << "    double path:      " << ns_double << " ns/event" << std::endl
+              << "    float/int16 path: " << ns_float << " ns/event" << std::endl
+              << "    speed up:         " << ns_double / ns_float << std::endl;
+    return checks.Report();
+}
+
+////////////////////////////////////////////////////////////////
+// synthetic waveforms
+
+// [0, 1) and gaussian numbers from the raw engine output only
+class Generator
+{
+public:
+    Generator(uint32_t seed) : engine(seed) {}
+
+    double Uniform(double lo, double hi)
+    {
+        return lo + (hi - lo) * (engine() / 4294967296.);
+    }
+
+    double Gaus(double sigma)
+    {
+        // Box-Muller, 1 - u keeps the log finite
+        double u1 = 1. - Uniform(0., 1.), u2 = Uniform(0., 1.);
+        return sigma * std::sqrt(-2. * std::log(u1)) * std::cos(2. * M_PI * u2);
+    }
+
+private:
+    std::mt19937 engine;
+};
+
+static void add_pulse(std::vector<double> &wf, Generator &gen)
+{
+    double a = gen.Uniform(15., 3000.), t0 = gen.Uniform(5., wf.size() - 20.), tau = gen.Uniform(1.5, 6.);
+    for (size_t i = 0; i < wf.size(); i++) {
+        double x = (i - t0) / tau;
+        if (x > 0.)
+            wf[i] += a * x * x * std::exp(2. * (1. - x));
+    }
+}
+
+static bool test_synthetic(const Analyzer &analyzer, int nwaveforms, const Results &ref, std::ostream *out)
+{
+    Generator gen(250);
+    Workspace ws;
+    ws.Reserve(FADC250_MAX_NSAMPLES);
+    Fadc250Data res_double, res_float;
+    std::vector<double> wf;
+    Checks checks(ref, out);
+    int ndrift = 0, nties = 0;
+
+    for (int n = 0; n < nwaveforms; n++)
+    {
+        // 0: no pulse, 1-2: two pulses, 3: drifting baseline, else one pulse
+        int k = static_cast<int>(gen.Uniform(0., 20.));
+        wf.assign(100, 300.);
+        if (k == 3) {
+            double s = gen.Uniform(-3., 3.);
+            for (size_t i = 0; i < wf.size(); i++)
+                wf[i] += s * i;
+            ndrift++;
+        }
+        if (k != 0)
+            add_pulse(wf, gen);
+        if (k == 1 || k == 2)
+            add_pulse(wf, gen);
+
+        res_double.Clear();
+        for (auto v : wf)
+            res_double.raw.push_back(static_cast<uint32_t>(std::min(std::max(std::lround(v + gen.Gaus(4.)), 0L), 4095L)));
+        res_float.raw = res_double.raw;
+
+        analyzer.Analyze(res_double);
+        analyzer.Analyze(res_float, ws);
+        nties += ws.tie;
+        if (!out || n < nref_synthetic)
+            checks.Check("waveform " + std::to_string(n), res_double, res_float);
+    }
+
+    std::cout << "synthetic waveforms: " << nwaveforms << " (" << ndrift << " on a drifting baseline), "
+              << nties << " redone by the double path (decision within float rounding of a cut)" << std::endl;
+    return checks.Report();
+}
+
+////////////////////////////////////////////////////////////////
+// reference results, one waveform per line:
+// name, pedestal mean and err, number of peaks and for each peak
+// pos, left, right, height, integral, overflow
+
+static void write_result(std::ostream &out, const std::string &name, const Fadc250Data &data)
+{
+    out << name << "," << std::setprecision(12) << data.ped.mean << " " << data.ped.err << " " << data.peaks.size();
+    for (auto &p : data.peaks)
+        out << " " << p.pos << " " << p.left << " " << p.right << " " << p.height << " " << p.integral
+            << " " << p.overflow;
+    out << std::endl;
+}
+
+static bool read_reference(const std::string &path, Results &ref)
+{
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cout << "ERROR: cannot open analyzer reference file: " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(f, line))
+    {
+        size_t comma = line.find(',');
+        if (line.empty() || comma == std::string::npos)
+            continue;
+        Fadc250Data &data = ref[line.substr(0, comma)];
+        std::istringstream values(line.substr(comma + 1));
+        size_t npeaks = 0;
+        values >> data.ped.mean >> data.ped.err >> npeaks;
+        for (size_t i = 0; i < npeaks; i++) {
+            Peak p;
+            values >> p.pos >> p.left >> p.right >> p.height >> p.integral >> p.overflow;
+            data.peaks.push_back(p);
+        }
+        if (!values) {
+            std::cout << "ERROR: bad line in analyzer reference file: " << line << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// recorded fadc250 waveform of one channel, one sample per line
+
+static bool read_waveform(const std::string &dir, int ch, std::vector<uint32_t> &raw)
+{
+    std::string path = dir + "/raw_adc_channel" + std::to_string(ch) + ".txt";
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cout << "ERROR: cannot open fadc waveform file: " << path << std::endl;
+        return false;
+    }
+    uint32_t val;
+    while (f >> val)
+        raw.push_back(val);
+    return true;
+}
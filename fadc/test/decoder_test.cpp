@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////
+// decoder_test
+//
+// fdec::Fadc250Decoder on a recorded FADC250 bank:
+//
+//     decoder_test [-r repeat] [-b fadc_bank] [fadc_dir]
+//
+// - fadc_bank (default fadc/examples/fadc_bank_sample.txt, hex words)
+//   holds one event: two trigger time words, the 16 windows of the
+//   recorded waveforms in fadc_dir (default fadc/plots,
+//   raw_adc_channel<N>.txt) and pulse integral/time words of
+//   channels 0, 1, 2, 5, 9 (two pulses) and 15 (pulse 3)
+// - it is decoded repeat x 1e5 times (default 1e6) with all channels
+//   and then with the channel mask 0x0205 (channels 0, 2, 9)
+//
+// The decoded windows must be the recorded waveforms and the pulses
+// the ones below, channels not in the mask must stay empty, and no
+// decode after the warm-up one may allocate (heap allocations are
+// counted by the operator new below). Returns 0 if every check
+// passed.
+
+#include "Fadc250Decoder.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+using namespace fdec;
+
+////////////////////////////////////////////////////////////////
+// heap allocation counter
+
+static std::atomic<uint64_t> heap_allocations{0};
+
+void *operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// pulse words in the bank, time in ns (1/64 clock of 250 MHz)
+struct expected_pulse_t
+{
+    uint32_t ch;
+    double integral, time;
+};
+
+static const std::vector<expected_pulse_t> expected_pulses = {
+    {0, 212., 260.},
+    {1, 463., 264.},
+    {2, 1418., 252.},
+    {5, 777., 384.},
+    {9, 26796., 320.},
+    {9, 3120., 512.},
+    {15, 91., 64.},
+};
+
+static bool read_bank(const std::string &path, std::vector<uint32_t> &bank);
+static bool read_waveform(const std::string &dir, int ch, std::vector<uint32_t> &raw);
+static int check_event(const Fadc250Event &event, uint32_t mask, const std::vector<std::vector<uint32_t>> &waveforms);
+
+int main(int argc, char* argv[])
+{
+    int repeat = 10;
+    std::string bank_file = "fadc/examples/fadc_bank_sample.txt", dir = "fadc/plots";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repeat = std::max(std::stoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            bank_file = argv[++i];
+        else if (argv[i][0] != '-')
+            dir = argv[i];
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [-r repeat] [-b fadc_bank] [fadc_dir]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<uint32_t> bank;
+    if (!read_bank(bank_file, bank))
+        return 1;
+    std::vector<std::vector<uint32_t>> waveforms(FADC250_MAX_NCHANNELS);
+    for (int ch = 0; ch < FADC250_MAX_NCHANNELS; ch++)
+        if (!read_waveform(dir, ch, waveforms[ch]))
+            return 1;
+
+    using clock = std::chrono::steady_clock;
+    Fadc250Decoder decoder;
+    std::vector<int> tags;
+    const int ndecode = 100000 * repeat;
+    bool ok = true;
+
+    for (uint32_t mask : {Fadc250Decoder::ALL_CHANNELS, 0x0205u})
+    {
+        decoder.SetChannelMask(mask);
+
+        // warm-up, the event buffers grow here
+        decoder.Decode(bank.data(), bank.size(), tags);
+
+        uint64_t nalloc = heap_allocations.load();
+        auto t0 = clock::now();
+        for (int i = 0; i < ndecode; i++) {
+            decoder.Clear();
+            decoder.Decode(bank.data(), bank.size(), tags);
+        }
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count() / ndecode;
+        nalloc = heap_allocations.load() - nalloc;
+
+        int errors = check_event(decoder.GetDecodedEvent(), mask, waveforms);
+        if (nalloc > 0) {
+            std::cout << "    " << nalloc << " heap allocations in " << ndecode << " decodes" << std::endl;
+            errors++;
+        }
+
+        std::cout << std::setprecision(4) << "mask 0x" << std::hex << std::setw(4) << std::setfill('0') << mask
+                  << std::dec << std::setfill(' ') << ": " << ndecode << " decodes, " << ns << " ns/bank, "
+                  << errors << " errors" << (errors ? " -- FAILED" : " -- PASSED") << std::endl;
+        ok = ok && (errors == 0);
+    }
+
+    std::cout << (ok ? "decoder_test: all checks passed." : "decoder_test: FAILED.") << std::endl;
+    return ok ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////
+// decoded event vs the recorded waveforms and the pulse words
+
+static int check_event(const Fadc250Event &event, uint32_t mask, const std::vector<std::vector<uint32_t>> &waveforms)
+{
+    int errors = 0;
+    auto error = [&errors] (const std::string &what) {
+        if (errors++ < 20)
+            std::cout << "    " << what << std::endl;
+    };
+
+    if (event.number != 516)
+        error("event number " + std::to_string(event.number) + " vs 516");
+    if (event.time != std::vector<uint32_t>{0x123456, 0x654321})
+        error("trigger time: " + std::to_string(event.time.size()) + " words");
+
+    for (uint32_t ch = 0; ch < FADC250_MAX_NCHANNELS; ch++)
+    {
+        const Fadc250Data &data = event.channels[ch];
+        bool enabled = mask & (1u << ch);
+        std::string name = "channel " + std::to_string(ch) + " ";
+
+        if (enabled ? data.raw != waveforms[ch] : !data.raw.empty())
+            error(name + "window: " + std::to_string(data.raw.size()) + " samples");
+
+        size_t np = 0;
+        for (auto &e : expected_pulses) {
+            if (e.ch != ch || !enabled)
+                continue;
+            if (np >= data.peaks.size()) {
+                error(name + "pulse " + std::to_string(np) + " missing");
+                np++;
+                continue;
+            }
+            const Peak &p = data.peaks[np++];
+            if (p.integral != e.integral || p.time != e.time)
+                error(name + "pulse: integral " + std::to_string(p.integral) + " vs " + std::to_string(e.integral)
+                      + ", time " + std::to_string(p.time) + " vs " + std::to_string(e.time));
+        }
+        if (data.peaks.size() > np)
+            error(name + std::to_string(data.peaks.size()) + " pulses vs " + std::to_string(np));
+    }
+    return errors;
+}
+
+////////////////////////////////////////////////////////////////
+// fadc250 bank, one hex word per line
+
+static bool read_bank(const std::string &path, std::vector<uint32_t> &bank)
+{
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cout << "ERROR: cannot open fadc bank file: " << path << std::endl;
+        return false;
+    }
+    std::string word;
+    while (f >> word)
+        bank.push_back(std::stoul(word, nullptr, 16));
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// recorded fadc250 waveform of one channel, one sample per line
+
+static bool read_waveform(const std::string &dir, int ch, std::vector<uint32_t> &raw)
+{
+    std::string path = dir + "/raw_adc_channel" + std::to_string(ch) + ".txt";
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cout << "ERROR: cannot open fadc waveform file: " << path << std::endl;
+        return false;
+    }
+    uint32_t val;
+    while (f >> val)
+        raw.push_back(val);
+    return true;
+}
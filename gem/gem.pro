@@ -59,6 +59,10 @@ DEFINES += QT_DEPRECATED_WARNINGS #MULTI_THREAD
 # Input path
 HEADERS += include/GEMStruct.h \
            include/GEMPedestal.h \
+           include/GEMPedestalShards.h \
+           include/GEMPedestalDB.h \
+           include/GEMReplayStats.h \
+           include/RunNumber.h \
            include/GEMAPV.h \
            include/GEMMPD.h \
            include/GEMPlane.h \
@@ -86,6 +90,10 @@ HEADERS += include/GEMStruct.h \
 ######################################################################
 # source path
 SOURCES += src/GEMPedestal.cpp \
+           src/GEMPedestalShards.cpp \
+           src/GEMPedestalDB.cpp \
+           src/GEMReplayStats.cpp \
+           src/RunNumber.cpp \
            src/GEMAPV.cpp \
            src/GEMMPD.cpp \
            src/GEMPlane.cpp \
@@ -78,6 +78,7 @@ public:
     void UpdatePedestal(const float &offset, const float &noise, const uint32_t &index);
     void UpdateCommonModeRange(const float &c_min, const float &c_max);
     void ZeroSuppression();
+    void UpdateRollingPedestal();
     void CommonModeCorrection_MPD(float *buf, const uint32_t &size, const uint32_t &ts);
     void CommonModeCorrection_SRS(float *buf, const uint32_t &size, const uint32_t &ts);
     float dynamic_ts_common_mode_sorting(float *buf, const uint32_t &size);
@@ -88,6 +89,7 @@ public:
     void ResetHitPos();
     void PrintOutPedestal(std::ofstream &out);
     void PrintOutCommonModeRange(std::ofstream &out);
+    void GetCommonModeDistRange(float &min, float &max) const;
     void PrintOutCommonModeDBAnaFormat(std::ofstream &out);
     StripNb MapStripPRad(int ch);
     StripNb MapStripMPD(int ch);
@@ -97,6 +99,9 @@ public:
     int GetMPDID() const {return mpd_id;}
     int GetADCChannel() const {return adc_ch;}
     APVAddress GetAddress() const {return APVAddress(crate_id, mpd_id, adc_ch);}
+    uint32_t GetSlotID() const {return raw_data_flags.slot_id;}
+    float GetCommonModeRangeMin() const {return common_mode_range_min;}
+    float GetCommonModeRangeMax() const {return common_mode_range_max;}
     uint32_t GetNTimeSamples() const {return time_samples;}
     uint32_t GetTimeSampleSize() const {return APV_STRIP_SIZE;}
     int GetOrientation() const {return orient;}
@@ -131,6 +136,8 @@ public:
     const std::vector<int> & GetOnlineCommonMode() const {return online_common_mode;}
     const std::vector<int> & GetUnusedChannels() const {return unused_channels;}
     std::string GetAPVName() const {return apv_name;}
+    bool GetRollingPedestal() const {return rolling_pedestal;}
+    float GetRollingPedestalWeight() const {return rolling_weight;}
 
     // set parameters
     void SetMPD(GEMMPD *f, int adc_ch, bool force_set = false);
@@ -146,6 +153,7 @@ public:
     void AddUnusedChannel(const int &i) {unused_channels.push_back(i);}
     void SetUnusedChannels(const std::vector<int> &v);
     void SetAPVName(const std::string &n) {apv_name = n;}
+    void SetRollingPedestal(const bool &on, const float &weight);
 
 private:
     void initialize();
@@ -179,6 +187,11 @@ private:
     Pedestal pedestal[APV_STRIP_SIZE];
     float common_mode_range_min = 0;     // common mode range loaded from file
     float common_mode_range_max = 5000;  // and used for offline analysis
+
+    // rolling pedestal: exponentially weighted update of offset/noise
+    // from strips without hits, done after each zero suppression
+    bool rolling_pedestal = false;
+    float rolling_weight = 0.001;
     std::vector<float> commonModeDist;
     StripNb strip_map[APV_STRIP_SIZE];
     bool hit_pos[APV_STRIP_SIZE];
@@ -5,6 +5,7 @@
 #include <vector>
 #include <deque>
 #include <thread>
+#include <functional>
 #include "GEMStruct.h"
 #include "EventParser.h"
 #include "EvioFileReader.h"
@@ -17,6 +18,8 @@ class MPDVMERawEventDecoder;
 class MPDSSPRawEventDecoder;
 class SRSRawEventDecoder;
 class TriggerDecoder;
+class GEMPedestalShards;
+class GEMReplayStats;
 struct APVDataType;
 
 class GEMDataHandler
@@ -40,12 +43,17 @@ public:
     GEMSystem *GetGEMSystem() const {return gem_sys;}
     void SetEvioFileReader(EvioFileReader *e) {evio_reader = e;}
     bool OpenEvioFile(const std::string &path);
+    // gem and trigger decoders, and the "Skip Bank Tags" of the gem config
     void RegisterRawDecoders();
+    // other detectors read out in the same events (not owned), call after RegisterRawDecoders()
+    void RegisterRawDecoder(int tag, AbstractRawDecoder *decoder);
     int DecodeEvent(int &count);
 
     // read from multiple evio splits
     int ReadAllEvioFiles(const std::string &path, int split_start = 0,
             int split_end = -1, bool verbose = false);
+    // path of one split file, empty if the name is not evio/dat
+    static std::string SplitFilePath(const std::string &path, int split);
     // read from single evio
     int ReadSingleEvioFile(const std::string &path, int split=-1, bool verbose = false);
     // interface member
@@ -54,7 +62,8 @@ public:
             const std::string &common_mode_input_file = "",
             const std::string &pedestal_output_file = "", 
             const std::string &commonMode_output_file = "");
-    void SetupReplay(const std::string &r_path, int split_start = 0, int split_end = -1,
+    // false if the pedestal cannot be loaded for the run of r_path
+    bool SetupReplay(const std::string &r_path, int split_start = 0, int split_end = -1,
             const std::string &pedestal_input_file = "",
             const std::string &common_mode_input_file = "",
             const std::string &pedestal_output_file = "", 
@@ -97,8 +106,14 @@ public:
     void EnableOutputRootTree() {root_tree_enabled = true;}
     void DisableOutputRootTree(){root_tree_enabled = false;}
     void SetMaxPedestalEvents(const int &s);
+    void SetPedestalThreads(const int &n) {fPedestalThreads = n;}
     void SetClusterRootFileName(const std::string &n) {replay_cluster_output_file = n;}
     void SetHitRootFileName(const std::string &n) {replay_hit_output_file = n;}
+    // optional stage timers, not owned
+    void SetReplayStats(GEMReplayStats *s) {replay_stats = s;}
+    // called with the cluster tree right before every fill, for the data of other
+    // detectors in the same event (cluster replay only)
+    void SetClusterTreeHook(std::function<void(GEMRootClusterTree*)> f) {cluster_tree_hook = std::move(f);}
 
     GEMRootHitTree * GetHitTree() {return root_hit_tree;}
     GEMRootClusterTree *GetClusterTree() {return root_cluster_tree;}
@@ -111,6 +126,7 @@ public:
 
 private:
     void waitEventProcess();
+    void SetupPedestalShards();
 
 private:
     EvioFileReader *evio_reader;
@@ -136,9 +152,18 @@ private:
     std::string pedestal_output_file = "database/gem_ped.dat";
     std::string commonMode_output_file = "database/CommonModeRange.txt";
 
+    // run of the replayed/pedestal file, selects and stamps pedestal databases
+    int run_number = -1;
+
     int fEventNumber = 0;
+    int fLastEventNumber = 0;
     int fMaxPedestalEvents = -1;
 
+    // pedestal mode: apvs sharded over worker threads
+    // < 0: read "Pedestal Threads" from gem config; 0: all cores; 1: no threads
+    int fPedestalThreads = -1;
+    GEMPedestalShards *pedestal_shards = nullptr;
+
     bool root_tree_enabled = true;
     std::string output_path = "Rootfiles/";
     // replay data to root hit tree
@@ -149,12 +174,16 @@ private:
     GEMRootClusterTree *root_cluster_tree = nullptr;
     std::string replay_cluster_output_file = "";
     bool bReplayCluster = false;
+    std::function<void(GEMRootClusterTree*)> cluster_tree_hook;
 
     // trigger time
     std::pair<uint32_t, uint32_t> triggerTime;
 
 	// purely convert evio files to root files
 	bool bEvio2RootFiles = false;
+
+    // stage timers and counters (replay instrumentation)
+    GEMReplayStats *replay_stats = nullptr;
 };
 
 #endif
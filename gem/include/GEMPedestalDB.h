@@ -0,0 +1,99 @@
+#ifndef GEM_PEDESTAL_DB_H
+#define GEM_PEDESTAL_DB_H
+
+////////////////////////////////////////////////////////////////
+// Binary pedestal/common mode database
+//
+// One file holds the offset/noise of every strip and the common
+// mode range of every APV, valid for a run range. The layout is
+// a fixed size header followed by fixed size APV records sorted
+// by APV address, so the file can be mmap'ed and used in place:
+//
+//   FileHeader
+//   APVRecord[n_records]
+//
+// The checksum (crc32) covers all records. All numbers are in
+// the byte order of the machine that wrote the file, a marker in
+// the header is used to reject files from the other byte order.
+//
+// Text pedestal files (gem_ped_xxx.dat + CommonModeRange_xxx.txt)
+// are still supported by GEMSystem, the binary file is recognized
+// by its magic word, not by its name.
+
+#include "MPDDataStruct.h"
+#include "GEMStruct.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class GEMPedestalDB
+{
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kByteOrder = 0x01020304;
+
+    struct FileHeader
+    {
+        char magic[8];          // "GEMPEDDB"
+        uint32_t byte_order;    // kByteOrder
+        uint32_t version;       // kVersion
+        uint32_t header_size;   // sizeof(FileHeader)
+        uint32_t record_size;   // sizeof(APVRecord)
+        uint32_t n_records;
+        uint32_t n_strips;      // APV_STRIP_SIZE
+        int32_t run_min;        // first valid run, < 0: no lower limit
+        int32_t run_max;        // last valid run, < 0: no upper limit
+        uint32_t checksum;      // crc32 of all records
+        uint32_t reserved;
+    };
+
+    struct APVRecord
+    {
+        int32_t crate_id;
+        int32_t slot_id;
+        int32_t mpd_id;
+        int32_t adc_ch;
+        float cm_min;
+        float cm_max;
+        float offset[APV_STRIP_SIZE];
+        float noise[APV_STRIP_SIZE];
+
+        APVAddress GetAddress() const {return APVAddress(crate_id, mpd_id, adc_ch);}
+    };
+
+    GEMPedestalDB() {};
+    ~GEMPedestalDB();
+
+    GEMPedestalDB(const GEMPedestalDB &) = delete;
+    GEMPedestalDB &operator=(const GEMPedestalDB &) = delete;
+
+    // map a file and validate it, returns false on any error
+    bool Open(const std::string &path);
+    // same, and also false if the file is not valid for the run (run < 0: no check)
+    bool Open(const std::string &path, const int &run);
+    void Close();
+    bool IsOpen() const {return header != nullptr;}
+
+    const FileHeader *GetHeader() const {return header;}
+    const APVRecord *GetRecords() const {return records;}
+    size_t GetNumberOfRecords() const {return header ? header->n_records : 0;}
+    bool CoversRun(const int &run) const;
+    const APVRecord *Find(const APVAddress &addr) const;
+
+    // write records to file, they will be sorted by apv address
+    static bool Write(const std::string &path, std::vector<APVRecord> &recs,
+            const int &run_min = -1, const int &run_max = -1);
+    // check the magic word only, to decide which reader to use
+    static bool IsBinaryFile(const std::string &path);
+    static uint32_t CRC32(const void *data, size_t size);
+
+private:
+    void *map_addr = nullptr;
+    size_t map_size = 0;
+    const FileHeader *header = nullptr;
+    const APVRecord *records = nullptr;
+};
+
+#endif
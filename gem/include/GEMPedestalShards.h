@@ -0,0 +1,100 @@
+#ifndef GEM_PEDESTAL_SHARDS_H
+#define GEM_PEDESTAL_SHARDS_H
+
+////////////////////////////////////////////////////////////////
+// Multi-threaded pedestal accumulation
+//
+// The APVs of the GEM system are split into N disjoint shards,
+// each shard is owned by exactly one worker thread. Pedestal
+// accumulators live inside GEMAPV (offset/noise vectors and the
+// common mode distribution), and since only the owning thread
+// ever touches an APV, the accumulation itself is lock free.
+//
+// The decode thread stages the raw APV frames of one event into
+// a per-shard batch, and hands the batches over through a small
+// bounded queue per shard at the end of each event. Batches are
+// recycled, so after warm-up no memory is allocated per event.
+
+#include "MPDDataStruct.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+class GEMSystem;
+class GEMAPV;
+
+class GEMPedestalShards
+{
+public:
+    GEMPedestalShards(GEMSystem *sys, int nthreads, size_t queue_depth = 32);
+    ~GEMPedestalShards();
+
+    GEMPedestalShards(const GEMPedestalShards &) = delete;
+    GEMPedestalShards &operator=(const GEMPedestalShards &) = delete;
+
+    void Start();
+    void Feed(const APVAddress &addr, const std::vector<int> &raw,
+            const APVDataType &flags);
+    void EndOfEvent();
+    void Stop();
+
+    int GetNumberOfThreads() const {return static_cast<int>(shards.size());}
+    bool IsRunning() const {return running;}
+
+private:
+    // apvs sharing one address (normal + ghost) always go to the same shard
+    struct Target
+    {
+        int shard;
+        GEMAPV *apv;
+        GEMAPV *ghost_apv;
+    };
+
+    // raw data of one apv in one event
+    struct APVFrame
+    {
+        const Target *target = nullptr;
+        std::vector<int> raw;
+        APVDataType flags;
+    };
+
+    // all frames of one event that belong to one shard
+    struct Batch
+    {
+        std::vector<APVFrame> frames;
+        size_t n = 0;
+    };
+
+    struct Shard
+    {
+        std::thread th;
+        std::mutex mtx;
+        std::condition_variable cv_full;   // decode thread waits for room
+        std::condition_variable cv_empty;  // worker waits for data
+        std::deque<Batch*> pending;
+        std::vector<Batch*> free_batches;
+        std::vector<Batch*> all_batches;
+        Batch *staging = nullptr;
+        bool done = false;
+    };
+
+    void buildShardMap();
+    void workerLoop(Shard *s);
+    void processFrame(const APVFrame &f);
+    Batch *takeFreeBatch(Shard *s);
+
+private:
+    GEMSystem *gem_sys;
+    std::vector<Shard*> shards;
+    size_t max_queue_depth;
+    bool running = false;
+
+    // apv address -> owning shard, built once before workers start
+    std::unordered_map<APVAddress, Target> shard_map;
+};
+
+#endif
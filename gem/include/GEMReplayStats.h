@@ -0,0 +1,120 @@
+#ifndef GEM_REPLAY_STATS_H
+#define GEM_REPLAY_STATS_H
+
+////////////////////////////////////////////////////////////////
+// Per-stage timing and work counters of a replay
+//
+// Each replay stage is timed with a scoped Timer, which does
+// nothing when it is given a null stats pointer, so the data
+// handler can be instrumented unconditionally. Counters are
+// accumulated per event and folded into totals and per event
+// maxima by EndOfEvent().
+//
+// At the end of the run the summary is written as JSON and CSV;
+// with a report interval set, one CSV row per N events is
+// appended as well, so a stage that regressed after a config
+// change can be spotted while the run is still going.
+
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <cstdint>
+
+class GEMReplayStats
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    enum Stage
+    {
+        Read = 0,       // evio event read
+        Parse,          // EventParser::ParseEvent
+        APVFill,        // GEMSystem::FillRawData*, incl. zero suppression
+        Clustering,     // GEMSystem::Reconstruct
+        Tracking,       // tracking data packaging + Tracking::FindTracks
+        TreeFill,       // root hit/cluster tree and tracking results
+        HistoFill,      // data quality histograms
+        FadcAnalysis,   // fdec::Analyzer on the fadc250 channels
+        NStages
+    };
+
+    enum Counter
+    {
+        APVs = 0,           // decoded apvs
+        Strips,             // strips passing zero suppression
+        TrackCandidates,    // track candidates fitted
+        AbortedLayerGroups, // layer groups over the abort quantity
+        FadcPeaks,          // fadc250 peaks saved
+        NCounters
+    };
+
+    // scoped stage timer
+    class Timer
+    {
+    public:
+        Timer(GEMReplayStats *s, Stage st) : stats(s), stage(st)
+        {
+            if(stats) t0 = clock::now();
+        }
+        ~Timer()
+        {
+            if(stats) stats -> AddTime(stage, clock::now() - t0);
+        }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        GEMReplayStats *stats;
+        Stage stage;
+        clock::time_point t0;
+    };
+
+    GEMReplayStats();
+    ~GEMReplayStats();
+
+    void AddTime(Stage s, clock::duration d);
+    void AddCount(Counter c, uint64_t n) {event_count[c] += n;}
+    void EndOfEvent();
+
+    // append one csv row per n events to path, n <= 0 disables it
+    void SetReportInterval(int n, const std::string &path);
+
+    uint64_t GetEvents() const {return events;}
+    double GetStageSeconds(Stage s) const;
+    uint64_t GetCounter(Counter c) const {return total_count[c];}
+
+    void Print(std::ostream &os) const;
+    bool WriteJSON(const std::string &path) const;
+    bool WriteCSV(const std::string &path) const;
+
+    static const char *StageName(Stage s);
+    static const char *CounterName(Counter c);
+
+private:
+    void writeIntervalRow();
+
+private:
+    clock::time_point start_time;
+    uint64_t events = 0;
+
+    // stage timing
+    clock::duration stage_time[NStages];
+    uint64_t stage_calls[NStages];
+
+    // counters, current event / total / max per event
+    uint64_t event_count[NCounters];
+    uint64_t total_count[NCounters];
+    uint64_t max_count[NCounters];
+
+    // interval report
+    int report_interval = 0;
+    std::ofstream report_file;
+    clock::time_point last_report_time;
+    uint64_t last_report_events = 0;
+    clock::duration last_stage_time[NStages];
+    uint64_t last_total_count[NCounters];
+};
+
+#endif
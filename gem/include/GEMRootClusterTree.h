@@ -26,6 +26,10 @@ public:
     void ClearPrevTracks();
     void ClearPrevRawEvent();
 
+    // fadc250 peaks, only saved when the branches are added
+    void AddFadcBranches();
+    void ClearPrevFadc();
+
 private:
     TTree *pTree = nullptr;
     TFile *pFile = nullptr;
@@ -74,6 +78,16 @@ public:
     std::vector<double> fBestTrackHitUADC, fBestTrackHitVADC;
     std::vector<double> fBestTrackHitIsampMaxUstrip, fBestTrackHitIsampMaxVstrip;
 
+    // -part 3):
+    // fadc250 peaks of the same event, one entry per peak
+    //   fadcChannel - fadc channel of the peak
+    //   fadcPeakTime - peak time (ns), fadcPeakIntegral/fadcPeakHeight - pedestal subtracted
+    //   fadcPedestal - pedestal of the channel
+    int nFadcPeak;
+    std::vector<int> fadcChannel;
+    std::vector<double> fadcPeakTime, fadcPeakIntegral, fadcPeakHeight;
+    std::vector<double> fadcPedestal;
+
 private:
     // -part 2):
     // Raw GEM Data
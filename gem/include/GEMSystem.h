@@ -187,9 +187,11 @@ public:
     void DisconnectMPD(const MPDAddress & mpd_addr, bool force_disconn = false);
     void Configure(const std::string &path);
     void ReadMapFile(const std::string &path);
-    void ReadPedestalFile(std::string path = "", std::string c_path = "");
+    // false if a binary pedestal database cannot be used (also for the run)
+    bool ReadPedestalFile(std::string path = "", std::string c_path = "", const int &run = -1);
     void ReadNoiseAndOffset(const std::string &path);
     void ReadCommonMode(const std::string &path);
+    bool ReadPedestalBinary(const std::string &path, const int &run = -1);
     void Clear();
     void ChooseEvent(const EventData &data);
     void Reconstruct();
@@ -219,6 +221,10 @@ public:
     void Reset();
     void SavePedestal(const std::string &path) const;
     void SaveCommonModeRange(const std::string &path) const;
+    bool SavePedestalBinary(const std::string &path, const int &run_min = -1,
+            const int &run_max = -1) const;
+    void SaveRollingPedestal(const std::string &output_file, const int &event_number,
+            bool force = false) const;
     void SaveHistograms(const std::string &path) const;
     void SetTriggerTime(const std::pair<uint32_t, uint32_t> &);
 
@@ -239,6 +245,7 @@ public:
     bool GetPedestalMode() const {return PedestalMode;}
     bool GetOnlineMode() const {return OnlineMode;}
     bool GetReplayMode() const {return ReplayMode;}
+    bool GetRollingPedestal() const {return rolling_pedestal;}
     void PrintStatus();
 
 private:
@@ -266,6 +273,12 @@ private:
     float def_zth;
     float def_ctth;
 
+    // rolling pedestal (update pedestal from strips without hits)
+    bool rolling_pedestal = false;
+    float rolling_weight = 0.001;
+    int rolling_snapshot_interval = 0;
+    std::string rolling_snapshot_prefix;
+
     // a locker for multi threading
     std::mutex __gem_locker;
 
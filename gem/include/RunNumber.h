@@ -0,0 +1,13 @@
+#ifndef RUN_NUMBER_H
+#define RUN_NUMBER_H
+
+////////////////////////////////////////////////////////////////
+// Run number from a raw data file name, shared by the replay
+// (GEMDataHandler) and the GUI (InfoCenter)
+
+#include <string>
+
+// run number of xxx_334.evio.0 / xxx334.dat.0, -1 if there is none
+int ParseRunNumber(const std::string &path);
+
+#endif
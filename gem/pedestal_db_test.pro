@@ -0,0 +1,35 @@
+######################################################################
+# binary pedestal database test, round trip, broken files, run range
+######################################################################
+
+TEMPLATE = app
+TARGET = ../bin/gem_pedestal_db_test
+
+QMAKE_CXXFLAGS -= -std=gnu++1y
+QMAKE_CXXFLAGS -= -std=c++1y
+QMAKE_CXXFLAGS += -std=c++17
+QMAKE_CXXFLAGS += -g
+QMAKE_CFLAGS   += -g
+QMAKE_LFLAGS   += -g
+
+######################################################################
+# self headers, the database is built in (no root needed)
+INCLUDEPATH += ./include
+
+######################################################################
+# decoder headers (apv address)
+INCLUDEPATH += ../decoder/include
+
+######################################################################
+# moc dir
+MOC_DIR = moc_test
+
+######################################################################
+# obj dir, not the one of the library (its objects are built -fPIC)
+OBJECTS_DIR = obj_test
+
+######################################################################
+# source path
+SOURCES += test/pedestal_db_test.cpp \
+           src/GEMPedestalDB.cpp \
+           src/RunNumber.cpp \
@@ -95,7 +95,8 @@ GEMAPV::GEMAPV(const GEMAPV &that)
     time_samples(that.time_samples), 
     common_thres(that.common_thres), zerosup_thres(that.zerosup_thres),
     crosstalk_thres(that.crosstalk_thres), 
-    online_zero_suppression(that.online_zero_suppression)
+    online_zero_suppression(that.online_zero_suppression),
+    rolling_pedestal(that.rolling_pedestal), rolling_weight(that.rolling_weight)
 {
     initialize();
 
@@ -154,7 +155,8 @@ GEMAPV::GEMAPV(GEMAPV &&that)
     time_samples(that.time_samples), 
     common_thres(that.common_thres), zerosup_thres(that.zerosup_thres),
     crosstalk_thres(that.crosstalk_thres),
-    online_zero_suppression(that.online_zero_suppression)
+    online_zero_suppression(that.online_zero_suppression),
+    rolling_pedestal(that.rolling_pedestal), rolling_weight(that.rolling_weight)
 {
     initialize();
 
@@ -239,6 +241,8 @@ GEMAPV &GEMAPV::operator= (GEMAPV &&rhs)
     zerosup_thres = rhs.zerosup_thres;
     crosstalk_thres = rhs.crosstalk_thres;
     online_zero_suppression = rhs.online_zero_suppression;
+    rolling_pedestal = rhs.rolling_pedestal;
+    rolling_weight = rhs.rolling_weight;
 
     // raw_data related
     buffer_size = rhs.buffer_size;
@@ -845,6 +849,63 @@ void GEMAPV::ZeroSuppression()
             else
                 hit_pos[i] = false;
     }
+
+    if(rolling_pedestal)
+        UpdateRollingPedestal();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// track pedestal drift during physics runs
+// must be called right after ZeroSuppression(): for strips without a hit,
+// raw_data holds (raw - offset - common mode), whose time sample average is
+// one sample of the same quantity GEMAPV::FitPedestal() uses for noise, and
+// its mean is the offset drift. Both are folded into the pedestal with an
+// exponentially weighted average, noise is tracked as variance.
+
+void GEMAPV::UpdateRollingPedestal()
+{
+    // offset subtracted by fpga, we never see it
+    if(online_zero_suppression)
+        return;
+
+    // common mode was not subtracted offline for this event
+    if(offline_common_mode.size() != time_samples)
+        return;
+
+    for(uint32_t i = 0; i < APV_STRIP_SIZE; ++i)
+    {
+        if(hit_pos[i] || m_unused_mask[i])
+            continue;
+
+        float residual = 0.;
+        for(uint32_t j = 0; j < time_samples; ++j)
+            residual += raw_data[DATA_INDEX(i, j)];
+        residual /= time_samples;
+
+#ifdef USE_SRS
+        // srs flips the sign in common mode correction
+        pedestal[i].offset -= rolling_weight * residual;
+#else
+        pedestal[i].offset += rolling_weight * residual;
+#endif
+        float var = pedestal[i].noise * pedestal[i].noise;
+        var += rolling_weight * (residual * residual - var);
+        pedestal[i].noise = std::sqrt(var);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// turn on/off rolling pedestal, weight is the weight of one event
+
+void GEMAPV::SetRollingPedestal(const bool &on, const float &weight)
+{
+    rolling_pedestal = on;
+
+    if(weight > 0. && weight < 1.)
+        rolling_weight = weight;
+    else
+        std::cout << "GEM APV Warning: invalid rolling pedestal weight "
+            << weight << ", using " << rolling_weight << std::endl;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1385,14 +1446,7 @@ void GEMAPV::PrintOutPedestal(std::ofstream &out)
 void GEMAPV::PrintOutCommonModeRange(std::ofstream &out)
 {
     float min = 0, max = 0;
-
-    if(commonModeDist.size() > 0) {
-        min = max = commonModeDist[0];
-        for(auto &i: commonModeDist) {
-            if(min > i) min = i;
-            if(max < i) max = i;
-        }
-    }
+    GetCommonModeDistRange(min, max);
 
     // follow Ben's suggestion, set all minimal common mode value to 0
     //min = 0;
@@ -1406,6 +1460,23 @@ void GEMAPV::PrintOutCommonModeRange(std::ofstream &out)
         << std::endl;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// min and max of the common mode collected in pedestal mode
+
+void GEMAPV::GetCommonModeDistRange(float &min, float &max)
+    const
+{
+    min = max = 0;
+
+    if(commonModeDist.size() > 0) {
+        min = max = commonModeDist[0];
+        for(auto &i: commonModeDist) {
+            if(min > i) min = i;
+            if(max < i) max = i;
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // print out the common mode using analysis format: average, sigma
 //
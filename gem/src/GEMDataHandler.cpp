@@ -8,7 +8,10 @@
 #include "RolStruct.h"
 #include "GEMRootHitTree.h"
 #include "GEMRootClusterTree.h"
+#include "GEMPedestalShards.h"
+#include "GEMReplayStats.h"
 #include "APVStripMapping.h"
+#include "RunNumber.h"
 #include "hardcode.h"
 
 #include <iostream>
@@ -57,6 +60,7 @@ GEMDataHandler::~GEMDataHandler()
 {
     delete new_event;
     delete proc_event;
+    delete pedestal_shards;
 }
 
 
@@ -156,6 +160,28 @@ void GEMDataHandler::RegisterRawDecoders()
         trigger_decoder = new TriggerDecoder();
         event_parser -> RegisterRawDecoder(static_cast<int>(Bank_TagID::Trigger), trigger_decoder);
     }
+
+    // containers without gem data (e.g. the rocs of other detectors) are
+    // not walked into
+    if(gem_sys != nullptr)
+    {
+        for(int tag: ConfigParser::stois(gem_sys -> Value<std::string>("Skip Bank Tags", "", false), ",", " \t"))
+            event_parser -> SkipSubtree(tag);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// register a decoder of another detector, its banks are parsed together with
+// the gem banks in ProcessEvent()
+
+void GEMDataHandler::RegisterRawDecoder(int tag, AbstractRawDecoder *decoder)
+{
+    if(event_parser == nullptr) {
+        std::cout<<"ERROR: GEMDataHandler::RegisterRawDecoder(): call RegisterRawDecoders() first."
+            <<std::endl;
+        return;
+    }
+    event_parser -> RegisterRawDecoder(tag, decoder);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -174,8 +200,11 @@ void GEMDataHandler::Replay(const std::string &r_path, int split_start, int spli
     // set mode before work starts
     SetMode();
 
-    SetupReplay(r_path, split_start, split_end, _pedestal_input, _common_mode_input,
-            _pedestal_output, _commonMode_output);
+    if(!SetupReplay(r_path, split_start, split_end, _pedestal_input, _common_mode_input,
+                _pedestal_output, _commonMode_output)) {
+        std::cout<<"ERROR:: no valid pedestal for "<<r_path<<", replay stopped."<<std::endl;
+        return;
+    }
 
     int count = ReadAllEvioFiles(r_path, split_start, split_end);
 
@@ -191,7 +220,7 @@ void GEMDataHandler::Replay(const std::string &r_path, int split_start, int spli
 ////////////////////////////////////////////////////////////////////////////////
 // setup replay output file names
 
-void GEMDataHandler::SetupReplay(const std::string &r_path, int split_start, [[maybe_unused]]int split_end,
+bool GEMDataHandler::SetupReplay(const std::string &r_path, int split_start, [[maybe_unused]]int split_end,
         const std::string &_pedestal_input, const std::string &_common_mode_input,
         const std::string &_pedestal_output, const std::string &_commonMode_output)
 {
@@ -199,7 +228,9 @@ void GEMDataHandler::SetupReplay(const std::string &r_path, int split_start, [[m
     {
         std::cout<<"INFO::Loading pedestal from : "<<_pedestal_input<<std::endl;
         std::cout<<"INFO::Loading common mode from : "<<_common_mode_input<<std::endl;
-        gem_sys -> ReadPedestalFile(_pedestal_input, _common_mode_input);
+        run_number = ParseRunNumber(r_path);
+        if(!gem_sys -> ReadPedestalFile(_pedestal_input, _common_mode_input, run_number))
+            return false;
 
         // parse output path
         std::string _prefix = "hit_" + std::to_string(split_start);
@@ -213,6 +244,7 @@ void GEMDataHandler::SetupReplay(const std::string &r_path, int split_start, [[m
     else if(pedestalMode)
     {
         std::cout<<"Pedestal started..."<<std::endl;
+        run_number = ParseRunNumber(r_path);
 
         if(_pedestal_output.size() > 0)
             pedestal_output_file = _pedestal_output;
@@ -223,6 +255,8 @@ void GEMDataHandler::SetupReplay(const std::string &r_path, int split_start, [[m
             commonMode_output_file = _commonMode_output;
         else
             std::cout<<"Warning: no common mode output path specified, using default."<<std::endl;
+
+        SetupPedestalShards();
     }
 
     else if(onlineMode)
@@ -230,6 +264,8 @@ void GEMDataHandler::SetupReplay(const std::string &r_path, int split_start, [[m
 
     else
         std::cout<<"ERROR:: incorrect working mode..."<<std::endl;
+
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -249,21 +285,9 @@ int GEMDataHandler::ReadAllEvioFiles(const std::string &path, int split_start,
         for(int i=split_start;i<split_end;i++)
         {
             // parse all input files
-            size_t pos = 0;
-            if(path.find("evio") != std::string::npos) {
-                pos = path.find("evio") + 4;
-            }
-            else if(path.find("dat") != std::string::npos) {
-                pos = path.find("dat") + 3;
-            }
-            else 
-            {
-                std::cout<<__func__<<" Error: only evio/dat files are accepted."
-                    <<path << std::endl;
+            std::string split_path = SplitFilePath(path, i);
+            if(split_path.empty())
                 return count;
-            }
-            std::string split_path = path.substr(0, pos);
-            split_path = split_path + "." + std::to_string(i);
 
             count += ReadSingleEvioFile(split_path.c_str(), -1, verbose);
         }
@@ -271,6 +295,28 @@ int GEMDataHandler::ReadAllEvioFiles(const std::string &path, int split_start,
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// path of split file: <path up to .evio/.dat>.<split>
+
+std::string GEMDataHandler::SplitFilePath(const std::string &path, int split)
+{
+    size_t pos = 0;
+    if(path.find("evio") != std::string::npos) {
+        pos = path.find("evio") + 4;
+    }
+    else if(path.find("dat") != std::string::npos) {
+        pos = path.find("dat") + 3;
+    }
+    else 
+    {
+        std::cout<<__func__<<" Error: only evio/dat files are accepted."
+            <<path << std::endl;
+        return "";
+    }
+
+    return path.substr(0, pos) + "." + std::to_string(split);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // read from single evio file
 
@@ -339,7 +385,10 @@ int GEMDataHandler::DecodeEvent(int &count)
 void GEMDataHandler::ProcessEvent(const uint32_t *pBuf, const uint32_t &fBufLen, 
         [[maybe_unused]]const int &ev_number)
 {
-    event_parser -> ParseEvent(pBuf, fBufLen);
+    {
+        GEMReplayStats::Timer timer(replay_stats, GEMReplayStats::Parse);
+        event_parser -> ParseEvent(pBuf, fBufLen);
+    }
 
 #ifdef USE_VME
     MPDVMERawEventDecoder* decoder = dynamic_cast<MPDVMERawEventDecoder*>(
@@ -370,6 +419,29 @@ void GEMDataHandler::ProcessEvent(const uint32_t *pBuf, const uint32_t &fBufLen,
     triggerTime = trigger_decoder -> GetDecoded();
     //std::cout<<"low: "<<triggerTime.first<<", high: "<<triggerTime.second<<std::endl;
 
+    // pedestal mode: hand the apv frames to the shard workers, they do
+    // the same work as GEMSystem::FillRawData*() in pedestal mode
+    if(pedestalMode && pedestal_shards != nullptr && pedestal_shards -> IsRunning())
+    {
+        APVDataType default_flags;
+        for(auto &i: decoded_data)
+        {
+            auto flags_it = decoded_data_flags.find(i.first);
+            if(flags_it != decoded_data_flags.end())
+                pedestal_shards -> Feed(i.first, i.second, flags_it->second);
+            else {
+                default_flags.SetAPVAddress(i.first);
+                pedestal_shards -> Feed(i.first, i.second, default_flags);
+            }
+        }
+        pedestal_shards -> EndOfEvent();
+        return;
+    }
+
+    if(replay_stats)
+        replay_stats -> AddCount(GEMReplayStats::APVs, decoded_data.size());
+    GEMReplayStats::Timer fill_timer(replay_stats, GEMReplayStats::APVFill);
+
 #ifdef MULTI_THREAD
     const auto & apvs = apv_strip_mapping::Mapping::Instance() -> GetAPVAddressVec();
 
@@ -476,11 +548,34 @@ void GEMDataHandler::Write()
                 std::cout<<"cluster root tree is nullptr."<<std::endl;
             }
         }
+
+        // final snapshot of the rolling pedestal (no-op if disabled)
+        gem_sys -> SaveRollingPedestal(bReplayCluster ? replay_cluster_output_file
+                : replay_hit_output_file, fLastEventNumber, true);
     }
     else if(pedestalMode)
     {
+        // wait for the shard workers to drain before fitting
+        if(pedestal_shards != nullptr)
+            pedestal_shards -> Stop();
+
         // save pedestal
         gem_sys -> FitPedestal();
+
+        // a .pdb output name selects the binary database, which
+        // holds both the pedestal and the common mode range
+        const std::string pdb_ext = ".pdb";
+        if(pedestal_output_file.size() > pdb_ext.size() &&
+                pedestal_output_file.compare(pedestal_output_file.size() - pdb_ext.size(),
+                    pdb_ext.size(), pdb_ext) == 0)
+        {
+            // valid from this run on, until a newer database replaces it
+            std::cout<<"saving pedestal database to : "<<pedestal_output_file
+                <<" (runs from "<<run_number<<")"<<std::endl;
+            gem_sys -> SavePedestalBinary(pedestal_output_file, run_number, -1);
+            return;
+        }
+
         std::cout<<"saving pedestal file to : "<<pedestal_output_file<<std::endl;
         gem_sys -> SavePedestal(pedestal_output_file.c_str());
         // save common mode range
@@ -517,6 +612,7 @@ void GEMDataHandler::StartOfNewEvent(const unsigned char &tag)
 void GEMDataHandler::EndofThisEvent(const int &ev)
 {
     new_event -> event_number = ev;
+    fLastEventNumber = ev;
 
     // wait for the process thread
     waitEventProcess();
@@ -561,16 +657,36 @@ void GEMDataHandler::EndProcess(EventData *ev)
             }
         }
 
-        if(!bReplayCluster && root_tree_enabled)
-            root_hit_tree -> Fill(gem_sys, *ev);
+        if(replay_stats)
+            replay_stats -> AddCount(GEMReplayStats::Strips, (*ev).gem_data.size());
+
+        if(!bReplayCluster) {
+            // hit mode: zero suppressed strips only, nothing to reconstruct
+            if(root_tree_enabled) {
+                GEMReplayStats::Timer timer(replay_stats, GEMReplayStats::TreeFill);
+                root_hit_tree -> Fill(gem_sys, *ev);
+            }
+        }
         else {
             // reconstruct clusters
-            gem_sys -> Reconstruct(*ev);
+            {
+                GEMReplayStats::Timer timer(replay_stats, GEMReplayStats::Clustering);
+                gem_sys -> Reconstruct(*ev);
+            }
 
             // cluster tree will use gem_sys to extract cluster information
-            if(root_tree_enabled)
+            if(root_tree_enabled) {
+                if(cluster_tree_hook)
+                    cluster_tree_hook(root_cluster_tree);
+                GEMReplayStats::Timer timer(replay_stats, GEMReplayStats::TreeFill);
                 root_cluster_tree -> Fill(gem_sys, (*ev).event_number);
+            }
         }
+
+        // periodic snapshot of the rolling pedestal (no-op if disabled),
+        // named after the output file of this replay
+        gem_sys -> SaveRollingPedestal(bReplayCluster ? replay_cluster_output_file
+                : replay_hit_output_file, (*ev).event_number);
     }
     else {
         event_data.emplace_back(std::move(*ev)); // save event
@@ -720,6 +836,11 @@ void GEMDataHandler::Reset()
         delete root_cluster_tree;
         root_cluster_tree = nullptr;
     }
+
+    if(pedestal_shards != nullptr) {
+        delete pedestal_shards;
+        pedestal_shards = nullptr;
+    }
 } 
 
 
@@ -769,6 +890,32 @@ void GEMDataHandler::SetOutputPath(const char *str)
         output_path = _output_path;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// setup the pedestal worker threads, each owns a fixed subset of APVs
+
+void GEMDataHandler::SetupPedestalShards()
+{
+    if(pedestal_shards != nullptr) {
+        delete pedestal_shards;
+        pedestal_shards = nullptr;
+    }
+
+    int nthreads = fPedestalThreads;
+    if(nthreads < 0 && gem_sys != nullptr)
+        nthreads = gem_sys -> Value<int>("Pedestal Threads", 0, false);
+    if(nthreads == 0)
+        nthreads = static_cast<int>(std::thread::hardware_concurrency());
+
+    // one thread: keep the original single threaded path
+    if(nthreads <= 1) {
+        std::cout<<"INFO::Pedestal runs in single thread mode."<<std::endl;
+        return;
+    }
+
+    pedestal_shards = new GEMPedestalShards(gem_sys, nthreads);
+    pedestal_shards -> Start();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // set max pedestal events
 
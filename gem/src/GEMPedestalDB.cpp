@@ -0,0 +1,230 @@
+#include "GEMPedestalDB.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char pedestal_db_magic[8] = {'G', 'E', 'M', 'P', 'E', 'D', 'D', 'B'};
+
+static_assert(sizeof(GEMPedestalDB::FileHeader) == 48,
+        "GEMPedestalDB: unexpected header size");
+static_assert(sizeof(GEMPedestalDB::APVRecord) == 24 + 8 * APV_STRIP_SIZE,
+        "GEMPedestalDB: unexpected record size");
+
+////////////////////////////////////////////////////////////////
+// dtor
+
+GEMPedestalDB::~GEMPedestalDB()
+{
+    Close();
+}
+
+////////////////////////////////////////////////////////////////
+// map the file read-only and check header and checksum
+
+bool GEMPedestalDB::Open(const std::string &path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cout<<"ERROR GEMPedestalDB::Open(): cannot open file: "<<path<<std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        std::cout<<"ERROR GEMPedestalDB::Open(): file too short: "<<path<<std::endl;
+        close(fd);
+        return false;
+    }
+
+    map_size = static_cast<size_t>(st.st_size);
+    map_addr = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(map_addr == MAP_FAILED) {
+        std::cout<<"ERROR GEMPedestalDB::Open(): mmap failed for: "<<path<<std::endl;
+        map_addr = nullptr;
+        map_size = 0;
+        return false;
+    }
+
+    const FileHeader *h = static_cast<const FileHeader*>(map_addr);
+    std::string error;
+
+    if(memcmp(h->magic, pedestal_db_magic, sizeof(pedestal_db_magic)) != 0)
+        error = "not a pedestal database";
+    else if(h->byte_order != kByteOrder)
+        error = "byte order mismatch";
+    else if(h->version != kVersion)
+        error = "unsupported version " + std::to_string(h->version);
+    else if(h->header_size != sizeof(FileHeader) || h->record_size != sizeof(APVRecord)
+            || h->n_strips != APV_STRIP_SIZE)
+        error = "record layout mismatch";
+    else if(map_size < sizeof(FileHeader) + static_cast<size_t>(h->n_records) * sizeof(APVRecord))
+        error = "file truncated";
+
+    const APVRecord *r = reinterpret_cast<const APVRecord*>(
+            static_cast<const char*>(map_addr) + sizeof(FileHeader));
+
+    if(error.empty() && CRC32(r, h->n_records * sizeof(APVRecord)) != h->checksum)
+        error = "checksum mismatch";
+
+    if(!error.empty()) {
+        std::cout<<"ERROR GEMPedestalDB::Open(): "<<error<<": "<<path<<std::endl;
+        Close();
+        return false;
+    }
+
+    header = h;
+    records = r;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// map the file, it must cover the run
+
+bool GEMPedestalDB::Open(const std::string &path, const int &run)
+{
+    if(!Open(path))
+        return false;
+
+    if(run >= 0 && !CoversRun(run)) {
+        std::cout<<"ERROR GEMPedestalDB::Open(): "<<path<<" is for runs ["
+                 <<header->run_min<<", "<<header->run_max<<"], not for run "
+                 <<run<<std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// unmap
+
+void GEMPedestalDB::Close()
+{
+    if(map_addr != nullptr)
+        munmap(map_addr, map_size);
+
+    map_addr = nullptr;
+    map_size = 0;
+    header = nullptr;
+    records = nullptr;
+}
+
+////////////////////////////////////////////////////////////////
+// check if the run is inside the valid run range of this file
+
+bool GEMPedestalDB::CoversRun(const int &run) const
+{
+    if(header == nullptr)
+        return false;
+
+    if(header->run_min >= 0 && run < header->run_min)
+        return false;
+    if(header->run_max >= 0 && run > header->run_max)
+        return false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// records are sorted by apv address, binary search
+
+const GEMPedestalDB::APVRecord *GEMPedestalDB::Find(const APVAddress &addr) const
+{
+    if(header == nullptr)
+        return nullptr;
+
+    const APVRecord *end = records + header->n_records;
+    const APVRecord *it = std::lower_bound(records, end, addr,
+            [](const APVRecord &r, const APVAddress &a) {return r.GetAddress() < a;});
+
+    if(it == end || !(it->GetAddress() == addr))
+        return nullptr;
+    return it;
+}
+
+////////////////////////////////////////////////////////////////
+// write a database file
+
+bool GEMPedestalDB::Write(const std::string &path, std::vector<APVRecord> &recs,
+        const int &run_min, const int &run_max)
+{
+    std::sort(recs.begin(), recs.end(), [](const APVRecord &a, const APVRecord &b) {
+            return a.GetAddress() < b.GetAddress();
+            });
+
+    FileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, pedestal_db_magic, sizeof(pedestal_db_magic));
+    h.byte_order = kByteOrder;
+    h.version = kVersion;
+    h.header_size = sizeof(FileHeader);
+    h.record_size = sizeof(APVRecord);
+    h.n_records = static_cast<uint32_t>(recs.size());
+    h.n_strips = APV_STRIP_SIZE;
+    h.run_min = run_min;
+    h.run_max = run_max;
+    h.checksum = CRC32(recs.data(), recs.size() * sizeof(APVRecord));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "GEMPedestalDB: Failed to save pedestal, file "
+                  << path << " cannot be opened."
+                  << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(recs.data()), recs.size() * sizeof(APVRecord));
+
+    return out.good();
+}
+
+////////////////////////////////////////////////////////////////
+// peek at the magic word
+
+bool GEMPedestalDB::IsBinaryFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open())
+        return false;
+
+    char buf[sizeof(pedestal_db_magic)];
+    if(!in.read(buf, sizeof(buf)))
+        return false;
+
+    return memcmp(buf, pedestal_db_magic, sizeof(buf)) == 0;
+}
+
+////////////////////////////////////////////////////////////////
+// standard crc32 (same as zlib), table built on first use
+
+uint32_t GEMPedestalDB::CRC32(const void *data, size_t size)
+{
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for(uint32_t i=0; i<256; i++) {
+            uint32_t c = i;
+            for(int k=0; k<8; k++)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const unsigned char *p = static_cast<const unsigned char*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for(size_t i=0; i<size; i++)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
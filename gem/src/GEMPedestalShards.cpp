@@ -0,0 +1,243 @@
+#include "GEMPedestalShards.h"
+#include "GEMSystem.h"
+#include "GEMAPV.h"
+#include "hardcode.h"
+
+#include <iostream>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////
+// ctor
+
+GEMPedestalShards::GEMPedestalShards(GEMSystem *sys, int nthreads, size_t queue_depth)
+    : gem_sys(sys), max_queue_depth(queue_depth)
+{
+    if(nthreads < 1)
+        nthreads = 1;
+    if(max_queue_depth < 1)
+        max_queue_depth = 1;
+
+    for(int i=0; i<nthreads; i++)
+        shards.push_back(new Shard());
+}
+
+////////////////////////////////////////////////////////////////
+// dtor
+
+GEMPedestalShards::~GEMPedestalShards()
+{
+    Stop();
+
+    for(auto &s: shards) {
+        for(auto &b: s->all_batches)
+            delete b;
+        delete s;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// assign every apv to a shard
+// apvs are sorted by address and dealt out round robin, so the
+// assignment is reproducible and neighbouring adc channels of
+// one mpd end up on different threads
+
+void GEMPedestalShards::buildShardMap()
+{
+    shard_map.clear();
+
+    if(gem_sys == nullptr)
+        return;
+
+    std::vector<GEMAPV*> apvs = gem_sys -> GetAPVList();
+    std::sort(apvs.begin(), apvs.end(), [](GEMAPV *a, GEMAPV *b) {
+            return a->GetAddress() < b->GetAddress();
+            });
+
+    int nshards = static_cast<int>(shards.size());
+    int index = 0;
+    for(auto &apv: apvs)
+    {
+        APVAddress addr = apv -> GetAddress();
+        Target t;
+        t.shard = (index++) % nshards;
+        t.apv = apv;
+        t.ghost_apv = gem_sys -> GetGhostAPV(addr);
+        shard_map[addr] = t;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// start worker threads
+
+void GEMPedestalShards::Start()
+{
+    if(running)
+        return;
+
+    buildShardMap();
+
+    for(auto &s: shards)
+    {
+        s->done = false;
+        s->pending.clear();
+        s->free_batches.clear();
+
+        // queue depth + the one being staged + the one being processed
+        while(s->all_batches.size() < max_queue_depth + 2)
+            s->all_batches.push_back(new Batch());
+        for(auto &b: s->all_batches) {
+            b->n = 0;
+            s->free_batches.push_back(b);
+        }
+
+        s->staging = s->free_batches.back();
+        s->free_batches.pop_back();
+
+        s->th = std::thread(&GEMPedestalShards::workerLoop, this, s);
+    }
+
+    running = true;
+
+    std::cout<<"GEMPedestalShards: "<<shards.size()<<" threads, "
+             <<shard_map.size()<<" APVs."<<std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+// stage one apv frame for its owning shard (decode thread only)
+
+void GEMPedestalShards::Feed(const APVAddress &addr, const std::vector<int> &raw,
+        const APVDataType &flags)
+{
+    auto it = shard_map.find(addr);
+    if(it == shard_map.end())
+        return;
+
+    Batch *b = shards[it->second.shard]->staging;
+    if(b->n >= b->frames.size())
+        b->frames.emplace_back();
+
+    APVFrame &f = b->frames[b->n++];
+    f.target = &(it->second);
+    // assign() reuses the capacity left over from previous events
+    f.raw.assign(raw.begin(), raw.end());
+    f.flags = flags;
+}
+
+////////////////////////////////////////////////////////////////
+// hand the staged frames of this event over to the workers
+// blocks only if a worker has fallen max_queue_depth events behind
+
+void GEMPedestalShards::EndOfEvent()
+{
+    for(auto &s: shards)
+    {
+        if(s->staging->n == 0)
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lk(s->mtx);
+            s->pending.push_back(s->staging);
+        }
+        s->cv_empty.notify_one();
+
+        s->staging = takeFreeBatch(s);
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// get an empty batch, wait for the worker if all are in flight
+
+GEMPedestalShards::Batch *GEMPedestalShards::takeFreeBatch(Shard *s)
+{
+    std::unique_lock<std::mutex> lk(s->mtx);
+    s->cv_full.wait(lk, [s]{return !s->free_batches.empty();});
+
+    Batch *b = s->free_batches.back();
+    s->free_batches.pop_back();
+    return b;
+}
+
+////////////////////////////////////////////////////////////////
+// flush whatever is staged, drain the queues and join the workers
+// after this returns, all pedestal accumulators in the APVs are
+// complete and can be fitted from the calling thread
+
+void GEMPedestalShards::Stop()
+{
+    if(!running)
+        return;
+
+    EndOfEvent();
+
+    for(auto &s: shards)
+    {
+        {
+            std::lock_guard<std::mutex> lk(s->mtx);
+            s->done = true;
+        }
+        s->cv_empty.notify_one();
+    }
+
+    for(auto &s: shards)
+    {
+        if(s->th.joinable())
+            s->th.join();
+    }
+
+    running = false;
+}
+
+////////////////////////////////////////////////////////////////
+// worker: pull batches, fill pedestal accumulators of own apvs
+
+void GEMPedestalShards::workerLoop(Shard *s)
+{
+    while(true)
+    {
+        Batch *b = nullptr;
+        {
+            std::unique_lock<std::mutex> lk(s->mtx);
+            s->cv_empty.wait(lk, [s]{return s->done || !s->pending.empty();});
+
+            if(s->pending.empty())
+                return; // done and drained
+
+            b = s->pending.front();
+            s->pending.pop_front();
+        }
+
+        for(size_t i=0; i<b->n; i++)
+            processFrame(b->frames[i]);
+
+        {
+            std::lock_guard<std::mutex> lk(s->mtx);
+            b->n = 0;
+            s->free_batches.push_back(b);
+        }
+        s->cv_full.notify_one();
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// same as GEMSystem::FillRawData* in pedestal mode
+
+void GEMPedestalShards::processFrame(const APVFrame &f)
+{
+    auto process_apv = [&](GEMAPV *apv)
+    {
+#ifdef USE_SRS
+        apv -> FillRawDataSRS(f.raw);
+#else
+        apv -> FillRawDataMPD(f.raw, f.flags);
+#endif
+        apv -> FillPedHist();
+    };
+
+    process_apv(f.target->apv);
+
+#ifdef USE_SRS
+    // ghost apvs are only fed for srs, see GEMSystem::FillRawDataSRS
+    if(f.target->ghost_apv != nullptr)
+        process_apv(f.target->ghost_apv);
+#endif
+}
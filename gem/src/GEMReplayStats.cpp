@@ -0,0 +1,268 @@
+#include "GEMReplayStats.h"
+
+#include <iostream>
+#include <iomanip>
+
+////////////////////////////////////////////////////////////////
+// ctor
+
+GEMReplayStats::GEMReplayStats()
+    : start_time(clock::now()), last_report_time(start_time)
+{
+    for(int i=0; i<NStages; i++) {
+        stage_time[i] = clock::duration::zero();
+        last_stage_time[i] = clock::duration::zero();
+        stage_calls[i] = 0;
+    }
+
+    for(int i=0; i<NCounters; i++) {
+        event_count[i] = 0;
+        total_count[i] = 0;
+        max_count[i] = 0;
+        last_total_count[i] = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// dtor
+
+GEMReplayStats::~GEMReplayStats()
+{
+    if(report_file.is_open())
+        report_file.close();
+}
+
+////////////////////////////////////////////////////////////////
+// add time to a stage
+
+void GEMReplayStats::AddTime(Stage s, clock::duration d)
+{
+    stage_time[s] += d;
+    stage_calls[s]++;
+}
+
+////////////////////////////////////////////////////////////////
+// fold the counters of this event into the totals
+
+void GEMReplayStats::EndOfEvent()
+{
+    events++;
+
+    for(int i=0; i<NCounters; i++) {
+        total_count[i] += event_count[i];
+        if(event_count[i] > max_count[i])
+            max_count[i] = event_count[i];
+        event_count[i] = 0;
+    }
+
+    if(report_interval > 0 && (events % report_interval) == 0)
+        writeIntervalRow();
+}
+
+////////////////////////////////////////////////////////////////
+// set up the interval report
+
+void GEMReplayStats::SetReportInterval(int n, const std::string &path)
+{
+    report_interval = 0;
+    if(report_file.is_open())
+        report_file.close();
+
+    if(n <= 0)
+        return;
+
+    report_file.open(path, std::ofstream::out);
+    if(!report_file.is_open()) {
+        std::cout<<"ERROR: cannot open replay stats file: "<<path<<std::endl;
+        return;
+    }
+    report_interval = n;
+
+    // header, stage times in microseconds per event, counters per event
+    report_file<<"events,events_per_s";
+    for(int i=0; i<NStages; i++)
+        report_file<<","<<StageName(static_cast<Stage>(i))<<"_us";
+    for(int i=0; i<NCounters; i++)
+        report_file<<","<<CounterName(static_cast<Counter>(i));
+    report_file<<std::endl;
+
+    last_report_time = clock::now();
+    last_report_events = events;
+    for(int i=0; i<NStages; i++)
+        last_stage_time[i] = stage_time[i];
+    for(int i=0; i<NCounters; i++)
+        last_total_count[i] = total_count[i];
+}
+
+////////////////////////////////////////////////////////////////
+// one row for the events since the last row
+
+void GEMReplayStats::writeIntervalRow()
+{
+    clock::time_point now = clock::now();
+    double n = static_cast<double>(events - last_report_events);
+    double wall = std::chrono::duration<double>(now - last_report_time).count();
+    if(n <= 0)
+        return;
+
+    report_file<<events<<","<<(wall > 0 ? n / wall : 0.);
+    for(int i=0; i<NStages; i++) {
+        double us = std::chrono::duration<double, std::micro>(stage_time[i] - last_stage_time[i]).count();
+        report_file<<","<<us / n;
+        last_stage_time[i] = stage_time[i];
+    }
+    for(int i=0; i<NCounters; i++) {
+        report_file<<","<<(total_count[i] - last_total_count[i]) / n;
+        last_total_count[i] = total_count[i];
+    }
+    report_file<<std::endl;
+
+    last_report_time = now;
+    last_report_events = events;
+}
+
+////////////////////////////////////////////////////////////////
+// total time of a stage in seconds
+
+double GEMReplayStats::GetStageSeconds(Stage s) const
+{
+    return std::chrono::duration<double>(stage_time[s]).count();
+}
+
+////////////////////////////////////////////////////////////////
+// print summary
+
+void GEMReplayStats::Print(std::ostream &os) const
+{
+    double wall = std::chrono::duration<double>(clock::now() - start_time).count();
+    double n = events > 0 ? static_cast<double>(events) : 1.;
+
+    double staged = 0;
+    for(int i=0; i<NStages; i++)
+        staged += GetStageSeconds(static_cast<Stage>(i));
+
+    os<<"replay summary: "<<events<<" events in "<<wall<<" s, "
+        <<(wall > 0 ? events / wall : 0.)<<" events/s"<<std::endl;
+    os<<std::setw(22)<<"stage"<<std::setw(14)<<"total (s)"
+        <<std::setw(14)<<"us/event"<<std::setw(10)<<"share"<<std::endl;
+    for(int i=0; i<NStages; i++) {
+        double t = GetStageSeconds(static_cast<Stage>(i));
+        os<<std::setw(22)<<StageName(static_cast<Stage>(i))
+            <<std::setw(14)<<t
+            <<std::setw(14)<<t * 1e6 / n
+            <<std::setw(9)<<(staged > 0 ? 100. * t / staged : 0.)<<"%"<<std::endl;
+    }
+    os<<std::setw(22)<<"counter"<<std::setw(14)<<"total"
+        <<std::setw(14)<<"per event"<<std::setw(10)<<"max"<<std::endl;
+    for(int i=0; i<NCounters; i++) {
+        os<<std::setw(22)<<CounterName(static_cast<Counter>(i))
+            <<std::setw(14)<<total_count[i]
+            <<std::setw(14)<<total_count[i] / n
+            <<std::setw(10)<<max_count[i]<<std::endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+// write summary in json format
+
+bool GEMReplayStats::WriteJSON(const std::string &path) const
+{
+    std::ofstream f(path, std::ofstream::out);
+    if(!f.is_open()) {
+        std::cout<<"ERROR: cannot open replay stats file: "<<path<<std::endl;
+        return false;
+    }
+
+    double wall = std::chrono::duration<double>(clock::now() - start_time).count();
+    double n = events > 0 ? static_cast<double>(events) : 1.;
+
+    f<<"{"<<std::endl;
+    f<<"  \"events\": "<<events<<","<<std::endl;
+    f<<"  \"wall_time_s\": "<<wall<<","<<std::endl;
+    f<<"  \"events_per_s\": "<<(wall > 0 ? events / wall : 0.)<<","<<std::endl;
+
+    f<<"  \"stages\": {"<<std::endl;
+    for(int i=0; i<NStages; i++) {
+        double t = GetStageSeconds(static_cast<Stage>(i));
+        f<<"    \""<<StageName(static_cast<Stage>(i))<<"\": {"
+            <<"\"total_s\": "<<t<<", "
+            <<"\"calls\": "<<stage_calls[i]<<", "
+            <<"\"us_per_event\": "<<t * 1e6 / n<<"}"
+            <<(i < NStages - 1 ? "," : "")<<std::endl;
+    }
+    f<<"  },"<<std::endl;
+
+    f<<"  \"counters\": {"<<std::endl;
+    for(int i=0; i<NCounters; i++) {
+        f<<"    \""<<CounterName(static_cast<Counter>(i))<<"\": {"
+            <<"\"total\": "<<total_count[i]<<", "
+            <<"\"per_event\": "<<total_count[i] / n<<", "
+            <<"\"max_per_event\": "<<max_count[i]<<"}"
+            <<(i < NCounters - 1 ? "," : "")<<std::endl;
+    }
+    f<<"  }"<<std::endl;
+    f<<"}"<<std::endl;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// write summary in csv format, one row per stage/counter
+
+bool GEMReplayStats::WriteCSV(const std::string &path) const
+{
+    std::ofstream f(path, std::ofstream::out);
+    if(!f.is_open()) {
+        std::cout<<"ERROR: cannot open replay stats file: "<<path<<std::endl;
+        return false;
+    }
+
+    double wall = std::chrono::duration<double>(clock::now() - start_time).count();
+    double n = events > 0 ? static_cast<double>(events) : 1.;
+
+    f<<"name,total,per_event,max_per_event"<<std::endl;
+    f<<"events,"<<events<<",,"<<std::endl;
+    f<<"wall_time_s,"<<wall<<",,"<<std::endl;
+    for(int i=0; i<NStages; i++) {
+        double t = GetStageSeconds(static_cast<Stage>(i));
+        f<<StageName(static_cast<Stage>(i))<<"_s,"<<t<<","<<t / n<<","<<std::endl;
+    }
+    for(int i=0; i<NCounters; i++) {
+        f<<CounterName(static_cast<Counter>(i))<<","<<total_count[i]<<","
+            <<total_count[i] / n<<","<<max_count[i]<<std::endl;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////
+// names used in the reports
+
+const char *GEMReplayStats::StageName(Stage s)
+{
+    switch(s) {
+        case Read: return "read";
+        case Parse: return "parse";
+        case APVFill: return "apv_fill";
+        case Clustering: return "clustering";
+        case Tracking: return "tracking";
+        case TreeFill: return "tree_fill";
+        case HistoFill: return "histo_fill";
+        case FadcAnalysis: return "fadc_analysis";
+        default: break;
+    }
+    return "unknown";
+}
+
+const char *GEMReplayStats::CounterName(Counter c)
+{
+    switch(c) {
+        case APVs: return "apvs";
+        case Strips: return "strips";
+        case TrackCandidates: return "track_candidates";
+        case AbortedLayerGroups: return "aborted_layer_groups";
+        case FadcPeaks: return "fadc_peaks";
+        default: break;
+    }
+    return "unknown";
+}
@@ -243,6 +243,26 @@ void GEMRootClusterTree::ClearPrevTracks()
     fBestTrackHitIsampMaxUstrip.clear(), fBestTrackHitIsampMaxVstrip.clear();
 }
 
+void GEMRootClusterTree::AddFadcBranches()
+{
+    ClearPrevFadc();
+
+    pTree -> Branch("nFadcPeak", &nFadcPeak, "nFadcPeak/I");
+    pTree -> Branch("fadcChannel", &fadcChannel);
+    pTree -> Branch("fadcPeakTime", &fadcPeakTime);
+    pTree -> Branch("fadcPeakIntegral", &fadcPeakIntegral);
+    pTree -> Branch("fadcPeakHeight", &fadcPeakHeight);
+    pTree -> Branch("fadcPedestal", &fadcPedestal);
+}
+
+void GEMRootClusterTree::ClearPrevFadc()
+{
+    nFadcPeak = 0;
+    fadcChannel.clear();
+    fadcPeakTime.clear(), fadcPeakIntegral.clear(), fadcPeakHeight.clear();
+    fadcPedestal.clear();
+}
+
 void GEMRootClusterTree::ClearPrevRawEvent()
 {
     nCluster = 0;
@@ -24,6 +24,7 @@
 #include "GEMMPD.h"
 #include "GEMDetectorLayer.h"
 #include "GEMException.h"
+#include "GEMPedestalDB.h"
 
 //============================================================================//
 // constructor, assigment operator, destructor                                //
@@ -55,7 +56,11 @@ GEMSystem::GEMSystem(const GEMSystem &that)
 : ConfigObject(that),
   gem_recon(that.gem_recon), PedestalMode(that.PedestalMode),
   def_ts(that.def_ts), def_cth(that.def_cth), def_zth(that.def_zth),
-  def_ctth(that.def_ctth), triggerTime(that.triggerTime)
+  def_ctth(that.def_ctth), rolling_pedestal(that.rolling_pedestal),
+  rolling_weight(that.rolling_weight),
+  rolling_snapshot_interval(that.rolling_snapshot_interval),
+  rolling_snapshot_prefix(that.rolling_snapshot_prefix),
+  triggerTime(that.triggerTime)
 {
     // copy daq system first
     for(auto &mpd : that.mpd_slots)
@@ -102,6 +107,9 @@ GEMSystem::GEMSystem(GEMSystem &&that)
   mpd_slots(std::move(that.mpd_slots)), det_slots(std::move(that.det_slots)),
   det_name_map(std::move(that.det_name_map)), def_ts(that.def_ts),
   def_cth(that.def_cth), def_zth(that.def_zth), def_ctth(that.def_ctth), 
+  rolling_pedestal(that.rolling_pedestal), rolling_weight(that.rolling_weight),
+  rolling_snapshot_interval(that.rolling_snapshot_interval),
+  rolling_snapshot_prefix(std::move(that.rolling_snapshot_prefix)),
   triggerTime(that.triggerTime)
 {
     // reset the system for all components
@@ -168,6 +176,11 @@ GEMSystem &GEMSystem::operator =(GEMSystem &&rhs)
     def_zth = rhs.def_zth;
     def_ctth = rhs.def_ctth;
 
+    rolling_pedestal = rhs.rolling_pedestal;
+    rolling_weight = rhs.rolling_weight;
+    rolling_snapshot_interval = rhs.rolling_snapshot_interval;
+    rolling_snapshot_prefix = std::move(rhs.rolling_snapshot_prefix);
+
     // reset the system for all components
     for(auto &mpd : mpd_slots)
     {
@@ -205,6 +218,12 @@ void GEMSystem::Configure(const std::string &path)
     CONF_CONN(def_zth, "Default Zero Suppression Threshold", 5, verbose);
     CONF_CONN(def_ctth, "Default Cross Talk Threshold", 8, verbose);
 
+    // rolling pedestal, off by default
+    rolling_pedestal = (Value<std::string>("Rolling Pedestal", "no", false) == "yes");
+    CONF_CONN(rolling_weight, "Rolling Pedestal Weight", 0.001, false);
+    CONF_CONN(rolling_snapshot_interval, "Rolling Pedestal Snapshot Interval", 0, false);
+    CONF_CONN(rolling_snapshot_prefix, "Rolling Pedestal Snapshot Prefix", "database/gem_ped_rolling", false);
+
     gem_recon.Configure(Value<std::string>("GEM Cluster Configuration"));
 
     // read gem map, build DAQ system and detectors
@@ -219,6 +238,20 @@ void GEMSystem::Configure(const std::string &path)
                   << e.FailureDesc() << std::endl;
     }
 
+    // apvs are built by ReadMapFile, pass the rolling pedestal setting on
+    for(auto &apv : GetAPVList())
+        apv->SetRollingPedestal(rolling_pedestal, rolling_weight);
+    for(auto &mpd : mpd_slots)
+    {
+        if(!mpd.second)
+            continue;
+        for(auto &ghost_apv : mpd.second->GetGhostAPVList())
+            ghost_apv->SetRollingPedestal(rolling_pedestal, rolling_weight);
+    }
+    if(rolling_pedestal)
+        std::cout << "GEM System: rolling pedestal enabled, weight = "
+                  << rolling_weight << std::endl;
+
     // set resolution for each detector, defalt 0.1
     float def_res = 0.1;
     for(auto &det : det_slots)
@@ -336,13 +369,20 @@ void GEMSystem::ReadMapFile(const std::string &path)
 }
 
 // Load pedestal and common mode files, update all APVs' pedestal and common mode
-void GEMSystem::ReadPedestalFile(std::string path, std::string c_path)
+// a binary pedestal database contains both, the common mode file is not needed,
+// it is not loaded for a run outside of its run range (run < 0: unknown run,
+// not checked), returns false then
+bool GEMSystem::ReadPedestalFile(std::string path, std::string c_path, const int &run)
 {
+    if(!path.empty() && GEMPedestalDB::IsBinaryFile(path))
+        return ReadPedestalBinary(path, run);
+
     // noise + offset
     ReadNoiseAndOffset(path);
 
     // common mode
     ReadCommonMode(c_path);
+    return true;
 }
 
 // Load pedestal file and update all APVs' pedestal
@@ -451,6 +491,48 @@ void GEMSystem::ReadCommonMode(const std::string &path)
     }
 }
 
+// Load a binary pedestal database (see GEMPedestalDB.h), update all APVs'
+// pedestal and common mode range; run < 0 skips the run range check, a
+// database that is not valid for the run is not loaded
+bool GEMSystem::ReadPedestalBinary(const std::string &path, const int &run)
+{
+    GEMPedestalDB db;
+    if(!db.Open(path, run)) {
+        std::cout<<"      Pedestal not loaded. Please check your config file."
+                 <<std::endl;
+        return false;
+    }
+
+    const GEMPedestalDB::APVRecord *recs = db.GetRecords();
+    for(size_t i=0; i<db.GetNumberOfRecords(); i++)
+    {
+        const GEMPedestalDB::APVRecord &r = recs[i];
+        APVAddress addr = r.GetAddress();
+
+        GEMAPV *apv = GetAPV(addr);
+        GEMAPV *ghost_apv = GetGhostAPV(addr);
+
+        if(apv == nullptr) {
+            std::cout << " GEM System Warning: Cannot find APV "
+                      << r.crate_id << ", " << r.mpd_id <<  ", " << r.adc_ch
+                      << " , skip updating its pedestal."
+                      << std::endl;
+            continue;
+        }
+
+        for(auto &a: {apv, ghost_apv})
+        {
+            if(a == nullptr)
+                continue;
+            for(uint32_t ch=0; ch<APV_STRIP_SIZE; ch++)
+                a->UpdatePedestal(r.offset[ch], r.noise[ch], ch);
+            a->UpdateCommonModeRange(r.cm_min, r.cm_max);
+        }
+    }
+
+    return true;
+}
+
 // return true if the detector is successfully registered
 bool GEMSystem::Register(GEMDetector *det)
 {
@@ -927,6 +1009,72 @@ const
     }
 }
 
+// save pedestal and common mode range for all APVs into one binary database
+// in pedestal mode the common mode range comes from the collected distribution,
+// otherwise the range currently used by the APV is saved
+bool GEMSystem::SavePedestalBinary(const std::string &name, const int &run_min,
+        const int &run_max)
+const
+{
+    std::vector<GEMPedestalDB::APVRecord> recs;
+
+    for(auto &apv: GetAPVList())
+    {
+        GEMPedestalDB::APVRecord r;
+        APVAddress addr = apv->GetAddress();
+        r.crate_id = addr.crate_id;
+        r.slot_id = apv->GetSlotID();
+        r.mpd_id = addr.mpd_id;
+        r.adc_ch = addr.adc_ch;
+
+        if(PedestalMode) {
+            apv->GetCommonModeDistRange(r.cm_min, r.cm_max);
+        } else {
+            r.cm_min = apv->GetCommonModeRangeMin();
+            r.cm_max = apv->GetCommonModeRangeMax();
+        }
+
+        std::vector<GEMAPV::Pedestal> peds = apv->GetPedestalList();
+        for(uint32_t ch=0; ch<APV_STRIP_SIZE; ch++) {
+            r.offset[ch] = peds[ch].offset;
+            r.noise[ch] = peds[ch].noise;
+        }
+
+        recs.push_back(r);
+    }
+
+    return GEMPedestalDB::Write(name, recs, run_min, run_max);
+}
+
+// write the current (rolling) pedestal to <prefix>_<output>_<event_number>.dat
+// <output> is the replay output file name without directory and .root, so the
+// splits and runs replayed at the same time do not overwrite each other
+// only writes every "Rolling Pedestal Snapshot Interval" events unless forced
+void GEMSystem::SaveRollingPedestal(const std::string &output_file, const int &event_number,
+        bool force) const
+{
+    if(!rolling_pedestal)
+        return;
+
+    if(!force) {
+        if(rolling_snapshot_interval <= 0 || event_number <= 0 ||
+                (event_number % rolling_snapshot_interval) != 0)
+            return;
+    }
+
+    size_t not_dir = output_file.find_last_of("/");
+    std::string output = output_file.substr(not_dir == std::string::npos ? 0 : not_dir + 1);
+    const std::string root_ext = ".root";
+    if(output.size() > root_ext.size() &&
+            output.compare(output.size() - root_ext.size(), root_ext.size(), root_ext) == 0)
+        output.resize(output.size() - root_ext.size());
+
+    std::string path = rolling_snapshot_prefix + "_" + output + "_"
+        + std::to_string(event_number) + ".dat";
+    std::cout << "GEM System: saving rolling pedestal snapshot to " << path << std::endl;
+    SavePedestal(path);
+}
+
 // set pedestal mode on/off
 // if the pedestal mode is on, filling raw data will also fill the histograms in
 // APV for future pedestal fitting
@@ -0,0 +1,31 @@
+#include "RunNumber.h"
+
+#include <iostream>
+
+////////////////////////////////////////////////////////////////
+// parse run number from input name
+// currently support:
+//        xxx[_.-(a-z)(A-Z)]334.evio.0
+//         xxx[_.-(a-z)(A-Z)]334.dat.0
+
+int ParseRunNumber(const std::string &path)
+{
+    size_t pos_start = path.find(".evio");
+    if(pos_start == std::string::npos)
+        pos_start = path.find(".dat");
+    if(pos_start == std::string::npos) {
+        std::cout<<__func__<<" Warning: only evio/dat files are accepted: "<<path
+                 <<std::endl;
+        return -1;
+    }
+
+    size_t first_digit = pos_start;
+    while(first_digit > 0 && path[first_digit - 1] >= '0' && path[first_digit - 1] <= '9')
+        first_digit--;
+
+    // at most 9 digits, fits in an int
+    if(first_digit == pos_start || pos_start - first_digit > 9)
+        return -1;
+
+    return std::stoi(path.substr(first_digit, pos_start - first_digit));
+}
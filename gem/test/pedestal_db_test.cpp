@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////
+// pedestal_db_test
+//
+// Binary pedestal database (GEMPedestalDB) checks:
+//
+//     pedestal_db_test [-o scratch_file]
+//
+// - round trip: records written unsorted are found again by apv
+//   address after Open, with the same offsets, noise and common
+//   mode range (bitwise), and sorted in the file
+// - an apv that is not in the file is not found
+// - run range: Open(path, run) only accepts runs inside the range
+//   stamped by Write, open ends (< 0) accept any run, run < 0 skips
+//   the check; ParseRunNumber gives the run of the raw data name
+// - broken files are rejected: shorter than the header, truncated
+//   records, a flipped record byte (checksum), a wrong magic word,
+//   a text pedestal file
+//
+// The scratch file (default pedestal_db_test.pdb) is removed at
+// the end. Returns 0 if every check passed.
+
+#include "GEMPedestalDB.h"
+#include "RunNumber.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(const std::string &what, bool ok)
+{
+    std::cout << what << (ok ? " -- PASSED" : " -- FAILED") << std::endl;
+    if (!ok)
+        failures++;
+}
+
+static GEMPedestalDB::APVRecord make_record(int crate, int mpd, int adc)
+{
+    GEMPedestalDB::APVRecord r;
+    r.crate_id = crate;
+    r.slot_id = mpd / 2;
+    r.mpd_id = mpd;
+    r.adc_ch = adc;
+    r.cm_min = 100.f + adc;
+    r.cm_max = 900.f - mpd;
+    for (int ch = 0; ch < APV_STRIP_SIZE; ch++)
+    {
+        r.offset[ch] = 2500.f + 0.25f * ch + 1000.f * crate + 10.f * mpd + adc;
+        r.noise[ch] = 5.f + 0.01f * ch + 0.1f * adc;
+    }
+    return r;
+}
+
+static bool same_record(const GEMPedestalDB::APVRecord &a, const GEMPedestalDB::APVRecord &b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// copy of the file with its size cut or one byte changed
+static void write_broken(const std::string &src, const std::string &dst, size_t size,
+        size_t flip = std::string::npos)
+{
+    std::ifstream in(src, std::ios::binary);
+    std::vector<char> buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (flip < buf.size())
+        buf[flip] ^= 0x10;
+    std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+    out.write(buf.data(), std::min(size, buf.size()));
+}
+
+int main(int argc, char* argv[])
+{
+    std::string path = "pedestal_db_test.pdb";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            path = argv[++i];
+        else
+        {
+            std::cout << "usage: " << argv[0] << " [-o scratch_file]" << std::endl;
+            return 1;
+        }
+    }
+    const std::string broken = path + ".broken";
+
+    // -: round trip
+    std::vector<GEMPedestalDB::APVRecord> recs = {
+        make_record(2, 5, 3), make_record(0, 1, 0), make_record(2, 0, 15), make_record(0, 1, 7)};
+    const std::vector<GEMPedestalDB::APVRecord> written = recs;
+    check("write", GEMPedestalDB::Write(path, recs, 100, 200));
+    check("magic word", GEMPedestalDB::IsBinaryFile(path));
+
+    GEMPedestalDB db;
+    bool opened = db.Open(path);
+    check("open", opened && db.GetNumberOfRecords() == written.size());
+    if (!opened)
+    {
+        std::remove(path.c_str());
+        std::cout << "pedestal_db_test: cannot go on without the file." << std::endl;
+        return 1;
+    }
+
+    bool found = true;
+    for (auto &r : written)
+    {
+        const GEMPedestalDB::APVRecord *f = db.Find(r.GetAddress());
+        found = found && f != nullptr && same_record(*f, r);
+    }
+    check("round trip of " + std::to_string(written.size()) + " apvs", found);
+
+    bool sorted = true;
+    for (size_t i = 1; i < db.GetNumberOfRecords(); i++)
+        sorted = sorted && db.GetRecords()[i - 1].GetAddress() < db.GetRecords()[i].GetAddress();
+    check("records sorted by apv address", sorted);
+
+    // -: unknown apv
+    check("unknown apv not found", db.Find(APVAddress(2, 5, 4)) == nullptr
+            && db.Find(APVAddress(1, 1, 0)) == nullptr && db.Find(APVAddress(9, 0, 0)) == nullptr);
+
+    // -: run range
+    check("run range stamped", db.GetHeader()->run_min == 100 && db.GetHeader()->run_max == 200);
+    db.Close();
+
+    check("run inside the range", db.Open(path, 100) && db.Open(path, 150) && db.Open(path, 200));
+    check("run outside the range", !db.Open(path, 99) && !db.IsOpen() && !db.Open(path, 201));
+    check("unknown run not checked", db.Open(path, -1));
+
+    recs = written;
+    GEMPedestalDB::Write(path, recs, 1440, -1);
+    check("open ended range", db.Open(path, 1440) && db.Open(path, 100000) && !db.Open(path, 1439));
+    check("run of the raw data file", ParseRunNumber("gem_cleanroom_1440.evio.0") == 1440
+            && db.Open(path, ParseRunNumber("data/gem_1439.evio.3")) == false
+            && ParseRunNumber("gem_cleanroom.evio.0") == -1);
+    db.Close();
+
+    // -: broken files
+    size_t header = sizeof(GEMPedestalDB::FileHeader), record = sizeof(GEMPedestalDB::APVRecord);
+    write_broken(path, broken, header - 4);
+    check("file shorter than the header", !db.Open(broken));
+    write_broken(path, broken, header + 3 * record + record / 2);
+    check("truncated records", !db.Open(broken));
+    write_broken(path, broken, header + 4 * record, header + 2 * record + 100);
+    check("corrupt record (checksum)", !db.Open(broken));
+    write_broken(path, broken, header + 4 * record, 0);
+    check("wrong magic word", !GEMPedestalDB::IsBinaryFile(broken) && !db.Open(broken));
+    {
+        std::ofstream text(broken, std::ios::trunc);
+        text << "APV                2               3               0               0\n"
+             << "               0         2899.44           5.865\n";
+    }
+    check("text pedestal file", !GEMPedestalDB::IsBinaryFile(broken) && !db.Open(broken));
+    check("missing file", !db.Open(broken + ".missing"));
+
+    std::remove(path.c_str());
+    std::remove(broken.c_str());
+
+    if (failures > 0)
+    {
+        std::cout << "pedestal_db_test: " << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "pedestal_db_test: all checks passed." << std::endl;
+    return 0;
+}
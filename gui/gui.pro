@@ -99,6 +99,9 @@ HEADERS += include/QRootCanvas.h \
            include/PixelPads.h \
            include/OnlineAnalysisInterface.h \
            include/PedestalPlotWindow.h \
+           include/OnlineGEMHistos.h \
+           include/OnlineHistoWindow.h \
+           include/GEMReplayEngine.h \
            experiment_setup/PRadSetup.h \
            experiment_setup/GeneralExpSetup.h \
 
@@ -119,5 +122,8 @@ SOURCES += src/main.cpp \
            src/InfoCenter.cpp \
            src/OnlineAnalysisInterface.cpp \
            src/PedestalPlotWindow.cpp \
+           src/OnlineGEMHistos.cpp \
+           src/OnlineHistoWindow.cpp \
+           src/GEMReplayEngine.cpp \
            experiment_setup/PRadSetup.cpp \
            experiment_setup/GeneralExpSetup.cpp \
@@ -10,10 +10,23 @@
 #include "MPDDataStruct.h"
 #include "hardcode.h"
 
-#include <TH1I.h>
-
 #include <string>
 #include <unordered_map>
+#include <list>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+////////////////////////////////////////////////////////////////////////////////
+// Event source for the viewer.
+//
+// The file is opened in evio random access mode ("ra", memory mapped with an
+// event pointer table), so AnalyzeEvent(n) goes straight to event n. Decoded
+// events are kept in an LRU cache limited in bytes, and a background thread
+// decodes the next events while the current one is looked at. If the file
+// cannot be opened for random access, events are read one after the other
+// as before and the event number is ignored.
 
 class GEMAnalyzer
 {
@@ -23,10 +36,9 @@ public:
 
     void Init();
     void AnalyzeEvent(int event);
-    const std::unordered_map<APVAddress, TH1I*> & GetHistos() const;
     const std::unordered_map<APVAddress, std::vector<int>> & GetData() const;
     const std::unordered_map<APVAddress, APVDataType> & GetDataFlags() const;
-    void FillHistos(const std::unordered_map<APVAddress, std::vector<int>> &,
+    void FillData(const std::unordered_map<APVAddress, std::vector<int>> &,
             const std::unordered_map<APVAddress, APVDataType> &);
     void Clear();
     void ClearPreviousEvent();
@@ -35,25 +47,68 @@ public:
     // setters
     void SetFile(const char* path);
     void SetMaxEvents(uint32_t);
+    void SetCacheLimit(size_t bytes) {cache_limit = bytes;}
+    void SetPrefetchDepth(int n) {prefetch_depth = n;}
     void CloseFile();
 
+    // random access
+    bool IsRandomAccess() const {return random_access;}
+    uint32_t GetNumberOfEvents() const {return nEventsInFile;}
+    size_t GetCacheSize() const;
+
+private:
+    struct DecodedEvent {
+        std::unordered_map<APVAddress, std::vector<int>> data;
+        std::unordered_map<APVAddress, APVDataType> flags;
+        size_t bytes = 0;
+    };
+    using EventPtr = std::shared_ptr<const DecodedEvent>;
+
+    EventPtr DecodeEvent(int event);
+    EventPtr FindCached(int event);
+    void InsertCache(int event, EventPtr ev);
+    void PrefetchLoop();
+    void StopPrefetch();
+
 private:
-    EvioFileReader *pFileReader;
-    EventParser *pEventParser;
+    EvioFileReader *pFileReader = nullptr;
+    EventParser *pEventParser = nullptr;
 #ifdef USE_VME
-    MPDVMERawEventDecoder *pRawEventDecoder;
+    MPDVMERawEventDecoder *pRawEventDecoder = nullptr;
 #elif defined(USE_SRS)
-    SRSRawEventDecoder *pRawEventDecoder;
+    SRSRawEventDecoder *pRawEventDecoder = nullptr;
 #else
-    MPDSSPRawEventDecoder *pRawEventDecoder;
+    MPDSSPRawEventDecoder *pRawEventDecoder = nullptr;
 #endif
-    TriggerDecoder *trigger_decoder;
+    TriggerDecoder *trigger_decoder = nullptr;
 
     std::string fFile;
     uint32_t nEvents = 5000;
     std::unordered_map<APVAddress, std::vector<int>> rawData;
     std::unordered_map<APVAddress, APVDataType> rawDataFlags;
-    std::unordered_map<APVAddress, TH1I*> rawHistos;
+
+    bool file_open = false;
+
+    // random access: current event, lru cache (front = most recent)
+    bool random_access = false;
+    uint32_t nEventsInFile = 0;
+    EventPtr current;
+    std::list<std::pair<int, EventPtr>> lru;
+    std::unordered_map<int, std::list<std::pair<int, EventPtr>>::iterator> cache;
+    size_t cache_bytes = 0;
+    size_t cache_limit = 256 * 1024 * 1024;
+    mutable std::mutex cache_mutex;
+
+    // the parser and decoders are shared by the viewer and the prefetcher
+    std::mutex decode_mutex;
+
+    // prefetch the events after the current one
+    int prefetch_depth = 32;
+    int prefetch_next = 0, prefetch_end = 0;
+    bool prefetch_stop = false;
+    std::mutex prefetch_mutex;
+    std::condition_variable prefetch_cv;
+    std::thread prefetch_thread;
 };
 
 #endif
@@ -0,0 +1,105 @@
+#ifndef GEM_REPLAY_ENGINE_H
+#define GEM_REPLAY_ENGINE_H
+
+////////////////////////////////////////////////////////////////////////////////
+// GEMReplayEngine
+//
+// In-process replay for the GUI. The splits of a run are handed out to a
+// pool of worker threads, each with its own copy of the GEM system and its
+// own GEMDataHandler, so every split is written to its own root file
+// (hit_<split>/cluster_<split>, as bin/replay does). Nothing runs on the
+// GUI thread: progress, events/s and ETA are reported by a timer through
+// Qt signals, every finished split is announced with splitFinished() and
+// Cancel() stops the workers after their current event.
+//
+// In cluster mode the reconstructed events can also be filled into an
+// OnlineGEMHistos (one shard per worker), so the plots grow split by
+// split. Hit replay goes through the PreAnalysis singleton of the hit
+// tree, it always runs on a single worker.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QObject>
+#include <QString>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+class QTimer;
+class GEMSystem;
+class OnlineGEMHistos;
+
+class GEMReplayEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Mode
+    {
+        Hit,
+        Cluster,
+    };
+
+    GEMReplayEngine(QObject *parent = nullptr);
+    ~GEMReplayEngine();
+
+    // setters, only used by the next Start()
+    void SetGEMSystem(GEMSystem *s) {gem_sys = s;}
+    void SetInputFile(const std::string &f) {ifile = f;}
+    void SetPedestalInputFile(const std::string &p, const std::string &c);
+    void SetSplitRange(int min, int max);
+    void SetNumberOfThreads(int n);
+    void SetHistos(OnlineGEMHistos *h) {histos = h;}
+
+    bool Start(Mode m);
+    void Cancel();
+    bool IsRunning() const {return running;}
+    int GetNumberOfThreads() const {return nthreads;}
+
+signals:
+    void progress(qint64 events, double events_per_s, double eta_s,
+            int splits_done, int splits_total);
+    void splitFinished(int split, const QString &output_file, qint64 events);
+    void finished(bool cancelled, qint64 events, double seconds);
+
+private slots:
+    void reportProgress();
+    void workersDone();
+
+private:
+    void workerLoop(int iworker);
+    void replaySplit(int iworker, int split, const std::string &path);
+
+private:
+    GEMSystem *gem_sys = nullptr;
+    OnlineGEMHistos *histos = nullptr;
+    std::string ifile;
+    std::string pedestal_input_file;
+    std::string common_mode_input_file;
+    int split_min = 0;
+    int split_max = -1;
+    int nthreads = 1;
+    Mode mode = Mode::Cluster;
+
+    // work list: split index and file, handed out in order
+    std::vector<std::pair<int, std::string>> splits;
+    std::atomic<size_t> next_split{0};
+
+    std::vector<GEMSystem*> worker_sys;
+    std::vector<std::thread> workers;
+    std::atomic<int> workers_running{0};
+    std::atomic<bool> cancelled{false};
+    bool running = false;
+
+    // progress, bytes are used for the eta
+    std::atomic<uint64_t> events_done{0};
+    std::atomic<uint64_t> bytes_done{0};
+    std::atomic<int> splits_done{0};
+    uint64_t bytes_total = 0;
+    std::chrono::steady_clock::time_point start_time;
+    QTimer *timer = nullptr;
+};
+
+#endif
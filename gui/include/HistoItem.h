@@ -4,6 +4,8 @@
  *     For the 1st case, the vector consists of only y values, 
  *     x will be default to: from 1 to the max length of the vector
  *     For the 2nd case, x axis is the QPair.first, y axis is the QPair.second
+ *     Integer samples (raw APV frames, strip ADCs) are kept as they are and
+ *     drawn as a min/max decimated line, one point pair per pixel column
  *     Xinzhan Bai 02/03/2024
  ******************************************************************************/
 
@@ -15,6 +17,8 @@
 #include <QStringList>
 #include <QVector>
 
+#include <vector>
+
 class HistoItem : public QGraphicsItem {
 public:
     HistoItem();
@@ -34,6 +38,7 @@ public:
 
     template<typename T> void ReceiveContents(const std::vector<T> &v) {
         original_data2.clear();
+        _samples.clear();
 
         for(size_t i=0; i<v.size(); i++) {
             original_data2.push_back(qMakePair(static_cast<double>(i), static_cast<double>(v.at(i))));
@@ -45,10 +50,14 @@ public:
     // data-quality plot path where the booked ROOT histogram range matters;
     // the template above is fine for raw-frame views where X = sample index.
     void ReceiveContents(const QVector<QPair<double, double>> &xy);
+    // integer samples, x = sample index, no conversion to (x, y) pairs
+    void ReceiveContents(const std::vector<int> &v) {ReceiveSamples(v.data(), v.size());}
+    void ReceiveSamples(const int *buf, size_t n);
     void PassData();
     void updateDrawingRange();
     void updateDrawingContent();
     void prepareDataShape();
+    void prepareSampleShape();
     void clearContent();
     void SetTitle(const std::string &);
     void SetStats(const std::vector<std::string> &stats);
@@ -74,7 +83,12 @@ private:
     // get the max and min of data, for drawing axis
     QPair<double, double> data_x_range, data_y_range;
 
+    // integer samples and the index range [begin, end) in view
+    std::vector<int> _samples;
+    size_t _sample_begin = 0, _sample_end = 0;
+
     QPolygonF _content;
+    bool _shape_dirty = true;   // _content needs rebuilding (data or geometry changed)
     QPolygonF _coordinate_frame;
 
     QRectF bounding_rect;
@@ -41,6 +41,10 @@ public:
     // draw histo, extract title from apv address
     void DrawCanvas(const std::vector<std::vector<int>> &data, 
             const std::vector<APVAddress> &addr, int, int);
+    // draw raw frames straight from int buffers (pointer, length),
+    // no copy into per-apv vectors
+    void DrawCanvas(const std::vector<std::pair<const int*, size_t>> &frames,
+            const std::vector<APVAddress> &addr, int, int);
     // draw histo, pass title directly
     void DrawCanvas(const std::vector<std::vector<int>> &data, 
             const std::vector<std::string> &title, int, int);
@@ -5,7 +5,9 @@
 // OnlineAnalysisInterface
 //
 // A popup window that does what scripts/../analyze_run_multi_core does:
-//   - split an EVIO run across several ./bin/replay processes,
+//   - split an EVIO run across several ./bin/replay processes, the splits
+//     sit in one shared queue (largest first) and every core pulls the next
+//     split as soon as its previous one is done,
 //   - hadd-merge the per-split outputs into Rootfiles/<prefix>_run<RUN>.root
 //     (and the matching _data_quality_check.root),
 //   - then plot the data-quality histograms directly on this window
@@ -74,7 +76,6 @@ private:
         int run = 0;
         int nSplit = 0;
         int nCore = 0;
-        int nJob = 0;
         int nFound = 0;
     };
 
@@ -102,9 +103,10 @@ private:
     bool PrepareAnalysisRequest(AnalysisRequest &request);
     void LogAnalysisPreamble(const AnalysisRequest &request);
     QString BuildWorkerCommand(const AnalysisRequest &request,
-                               int core, int start, int end) const;
+                               int core, int split) const;
     void CreateWorkerProcesses(const AnalysisRequest &request);
     void StartWorkerProcesses();
+    bool StartNextSplit(int core);           // false if the queue is empty
     QString BuildMergeCommand() const;
     void StartMergeProcess();
 
@@ -149,8 +151,11 @@ private:
     QMap<QString, bool> m_histoVisible;
 
     // ---- runtime state ----
-    QList<QProcess*> m_workers;
+    QList<QProcess*> m_workers;        // the running replay of each core
+    QList<int> m_pendingSplits;        // shared split queue, largest first
+    AnalysisRequest m_currentRequest;
     int     m_activeWorkers = 0;
+    int     m_splitsDone    = 0;
     int     m_currentRun    = 0;
     QString m_currentPrefix;
     QString m_currentOutDir;
@@ -0,0 +1,149 @@
+#ifndef ONLINE_GEM_HISTOS_H
+#define ONLINE_GEM_HISTOS_H
+
+////////////////////////////////////////////////////////////////////////////////
+// OnlineGEMHistos
+//
+// Run-level GEM quality histograms filled from every online (ET) event, not
+// only from the ones the GUI draws. Each analysis thread owns a private copy
+// of the GEM system (zero suppression + clustering) and a private shard of
+// plain-array histograms. Events are handed over with Feed(), which never
+// blocks: if the chosen thread is busy the event is counted as dropped.
+//
+// Shard bins are relaxed atomics written only by the owning thread, so the
+// GUI can merge all shards at display time (Snapshot) without any lock.
+// Reset() just records the current contents as a baseline that is
+// subtracted from later snapshots.
+//
+// The histograms follow the raw_histos() set of replay/src/
+// generate_gem_histos.h: per detector plane occupancy, fired strips,
+// cluster multiplicity/ADC/size/position, plus per detector the fraction of
+// events with x, y and x&y clusters.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "HistoWidget.h"
+#include "MPDDataStruct.h"
+#include "GEMStruct.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class GEMSystem;
+
+class OnlineGEMHistos
+{
+public:
+    typedef std::unordered_map<APVAddress, std::vector<int>> APVDataMap;
+    typedef std::unordered_map<APVAddress, APVDataType>      APVFlagMap;
+
+    OnlineGEMHistos(int nthreads = 2, size_t queue_depth = 4);
+    ~OnlineGEMHistos();
+
+    OnlineGEMHistos(const OnlineGEMHistos &) = delete;
+    OnlineGEMHistos &operator=(const OnlineGEMHistos &) = delete;
+
+    // copy the gem system for each thread and load the pedestal into the
+    // copies, then book the histograms from the detector list
+    void Init(const GEMSystem &sys, const std::string &ped, const std::string &cm);
+    void Start();
+    void Stop();
+
+    // called from the ET worker thread for every decoded event
+    void Feed(const APVDataMap &data, const APVFlagMap &flags);
+
+    // offline replay: fill shard i from an event the caller already
+    // reconstructed in its own gem system. One caller thread per shard,
+    // and only while the analysis threads are not started.
+    void FillShard(int i, GEMSystem *sys);
+
+    // merge all shards (GUI thread)
+    std::vector<HistoWidget::PlotData> Snapshot() const;
+    void Reset();
+
+    uint64_t GetEventsProcessed() const;
+    uint64_t GetEventsDropped() const { return n_dropped.load() - reset_dropped; }
+    int GetNumberOfThreads() const { return static_cast<int>(workers.size()); }
+
+private:
+    struct HistoDef
+    {
+        std::string title, x_title, y_title;
+        int nx = 1; double x_min = 0, x_max = 1;
+        bool normalize = false;     // show as fraction of processed events
+    };
+
+    // plain array histogram, bins [0] and [nx+1] are under/overflow
+    struct Histo
+    {
+        const HistoDef *def = nullptr;
+        std::unique_ptr<std::atomic<uint64_t>[]> bins;
+
+        void Init(const HistoDef *d);
+        void Fill(double x);   // NaN is not counted
+    };
+
+    struct Shard
+    {
+        std::vector<Histo> histos;
+        std::atomic<uint64_t> events{0};
+    };
+
+    // histogram indices of one detector
+    struct DetHistos
+    {
+        int occupancy[2], fired[2], multiplicity[2], adc[2], size[2], pos[2];
+        int efficiency;
+    };
+
+    struct Event
+    {
+        APVDataMap data;
+        APVFlagMap flags;
+    };
+
+    struct Worker
+    {
+        GEMSystem *sys = nullptr;
+        std::thread th;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<Event*> pending;
+        std::vector<Event*> free_events;
+        std::vector<std::unique_ptr<Event>> all_events;
+        EventData event_data;
+        Shard shard;
+        bool done = false;
+    };
+
+    int book(const std::string &title, const std::string &xt, int nx,
+             double xmin, double xmax, bool normalize = false);
+    void workerLoop(Worker *w);
+    void process(Worker *w, const Event &e);
+    void fill(GEMSystem *sys, Shard &shard);
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers;
+    size_t max_queue_depth;
+    size_t next_worker = 0;
+    bool running = false;
+
+    std::deque<HistoDef> defs;             // deque: stable addresses
+    std::unordered_map<int, DetHistos> det_histos;
+
+    // baseline recorded by Reset(), subtracted in Snapshot()
+    std::vector<std::vector<uint64_t>> reset_bins;
+    uint64_t reset_events = 0;
+    uint64_t reset_dropped = 0;
+
+    std::atomic<uint64_t> n_dropped{0};
+};
+
+#endif
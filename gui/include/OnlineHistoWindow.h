@@ -0,0 +1,56 @@
+#ifndef ONLINE_HISTO_WINDOW_H
+#define ONLINE_HISTO_WINDOW_H
+
+////////////////////////////////////////////////////////////////////////////////
+// OnlineHistoWindow
+//
+// A popup window showing the run-level histograms accumulated online by
+// OnlineGEMHistos. A timer merges the analysis shards and redraws the
+// current page; the histograms keep filling in between at full ET rate.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <QWidget>
+
+#include "HistoWidget.h"
+
+#include <vector>
+
+class QComboBox;
+class QPushButton;
+class QLabel;
+class QTimer;
+class OnlineGEMHistos;
+
+class OnlineHistoWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    OnlineHistoWindow(OnlineGEMHistos *src, QWidget *parent = nullptr);
+
+    void StartRefresh(int ms);
+    void StopRefresh();
+
+public slots:
+    void Refresh();
+
+private slots:
+    void ShowPage(int idx);
+    void ResetHistos();
+
+private:
+    OnlineGEMHistos *m_source = nullptr;
+
+    HistoWidget *m_plotWidget = nullptr;
+    QComboBox   *m_pageCombo  = nullptr;
+    QPushButton *m_btnReset   = nullptr;
+    QLabel      *m_status     = nullptr;
+    QTimer      *m_timer      = nullptr;
+
+    std::vector<HistoWidget::PlotData> m_plots;
+
+    static constexpr int kPageRows = 3;
+    static constexpr int kPageCols = 4;
+};
+
+#endif
@@ -37,6 +37,11 @@ class QRadioButton;
 // when the GUI is built with CONFIG+=et (HAVE_ET). Forward-declared so the
 // header stays ET-free.
 namespace online_monitor { class OnlineMonitor; }
+class OnlineGEMHistos;
+class OnlineHistoWindow;
+class GEMReplayEngine;
+class QProgressBar;
+class QTabWidget;
 
 class Viewer : public QMainWindow
 {
@@ -44,7 +49,7 @@ class Viewer : public QMainWindow
 
 public:
     Viewer(QWidget *parent = 0);
-    ~Viewer() {}
+    ~Viewer();
 
     void LoadMappingFile();
 
@@ -90,6 +95,8 @@ public slots:
     void ReloadPedestal();
     void DrawEvent(int);
     void DrawGEMRawHistos(int);
+    void DrawRawFramesTab(int);
+    void UpdateEventRange();
     void DrawGEMOnlineHits(int);
     void OpenFile();
     void GeneratePedestal_obsolete();
@@ -97,6 +104,11 @@ public slots:
     void PlotPedestal();
     void ReplayHit();
     void ReplayCluster();
+    void CancelReplay();
+    void ReplayProgress(qint64 events, double events_per_s, double eta_s,
+            int splits_done, int splits_total);
+    void ReplaySplitFinished(int split, const QString &output_file, qint64 events);
+    void ReplayFinished(bool cancelled, qint64 events, double seconds);
     void OpenOnlineAnalysisInterface();
     void LaunchTrackingViewer();
     void SaveCurrentEvent();
@@ -105,7 +117,7 @@ public slots:
     // online (ET) monitoring control. Bodies are no-ops unless built with
     // HAVE_ET, but the slots are always declared so moc/linkage is stable.
     void ToggleOnline(bool on);   // start/stop the live ET feed
-    void PollOnlineEvent();       // timer tick: pull + draw one ET event
+    void PollOnlineEvent();       // timer tick: sample + draw latest ET event
 
 signals:
     void onlineHitsDrawn(const QMap<int, QVector<QPointF>>&);
@@ -123,13 +135,15 @@ public:
 private:
     QComboBox *m_fileCombo; // file selector
     QComboBox *m_viewCombo; // view selector
-    QSpinBox *m_eventSpin;  // event number
+    QSpinBox *m_eventSpin = nullptr;  // event number
     QLineEdit *m_pedOut; // pedestal path
     QLineEdit *m_cmOut; // common mode path
-    QPlainTextEdit *m_logEdit;
+    QPlainTextEdit *m_logEdit = nullptr;
 
     // contents to show
     std::vector<HistoWidget*> vTabCanvas;   // tab contents, use self-implemented HistoWidgets
+    std::vector<bool> vTabStale;            // tab not drawn for the current event yet
+    QTabWidget *m_rawFramesTab = nullptr;
     // online hits
     std::vector<HistoWidget*> vTabCanvasOnlineHits; // tab contents, for drawing online hits
     bool reload_pedestal_for_online = true;
@@ -162,13 +176,37 @@ private:
     int fFileSplitEnd = -1;
     int fFileSplitStart = 0;
 
+    // in-process replay on worker threads, cluster results go to a
+    // histogram window that is refreshed after every split
+    void StartReplay(bool cluster);
+    GEMReplayEngine *pReplayEngine = nullptr;
+    OnlineGEMHistos *pReplayHistos = nullptr;
+    OnlineHistoWindow *winReplayHistos = nullptr;
+    QPushButton *m_btnHitReplay = nullptr;
+    QPushButton *m_btnClusterReplay = nullptr;
+    QPushButton *m_btnCancelReplay = nullptr;
+    QProgressBar *m_replayProgress = nullptr;
+    int fReplayThreads = 4;
+
 private:
     // section for GEM_Viewer status
     int event_number_checked = 0;
     int current_event_number = 0;
     size_t max_cache_events = 500;
-    std::deque<std::map<APVAddress, std::vector<int>>> event_cache;
-    std::deque<std::map<APVAddress, APVDataType>> event_flag_cache;
+
+    // a cached event: all APV frames packed in one buffer, APVs sorted by
+    // address, the tab of each APV is resolved once when the event is cached
+    struct CachedEvent {
+        std::vector<APVAddress> addr;
+        std::vector<APVDataType> flags;
+        std::vector<size_t> offset;     // frame i is adc[offset[i], offset[i+1])
+        std::vector<int> adc;
+        std::vector<int> tab;           // -1 if no tab for this apv
+    };
+    std::deque<CachedEvent> event_cache;
+    void CacheEvent(const std::unordered_map<APVAddress, std::vector<int>> &data,
+            const std::unordered_map<APVAddress, APVDataType> &flags);
+    const CachedEvent *GetCachedEvent(int num) const;
     QMap<int, QVector<QPointF>> detector_2d_geo_hits;
 
     // a text parser
@@ -187,12 +225,18 @@ private:
 #ifdef HAVE_ET
     online_monitor::OnlineMonitor *pOnlineMonitor = nullptr;
 #endif
+    // run-level histograms filled from every online event
+    OnlineGEMHistos *pOnlineHistos = nullptr;
+    OnlineHistoWindow *winOnlineHistos = nullptr;
     // connection params, loaded from config/online.conf
     std::string fOnlineEtFile  = "/tmp/et_sys_gem";
     std::string fOnlineHost    = "localhost";
     std::string fOnlineStation = "gem_monitor";
     int fOnlinePort   = 11111;
     int fOnlinePollMs = 200;
+    int fOnlineBatch  = 16;            // events per et_events_get
+    int fOnlineAnaThreads = 2;         // online histogram threads, 0 = off
+    bool online_connected = false;     // worker reported a live ET attachment
 };
 
 #endif
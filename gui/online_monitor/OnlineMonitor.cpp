@@ -11,6 +11,7 @@
 #include <arpa/inet.h>   // ntohl: ET payload is network (big-endian) order
 
 #include <iostream>
+#include <ctime>
 
 namespace online_monitor {
 
@@ -43,20 +44,56 @@ OnlineMonitor::OnlineMonitor()
 
 OnlineMonitor::~OnlineMonitor()
 {
-    Disconnect();
+    Stop();
     delete parser;
     delete decoder;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// connect to ET system + create/attach a monitoring station
+// start the worker thread (GUI thread)
 
-bool OnlineMonitor::Connect(const std::string &etFile, const std::string &host,
-                            int port, const std::string &station)
+void OnlineMonitor::Start(const std::string &etFile, const std::string &host,
+                          int port, const std::string &station,
+                          int batch_size)
+{
+    Stop();
+
+    if(batch_size < 1) batch_size = 1;
+
+    for(auto &slot : slots) {
+        slot.data.clear();
+        slot.flags.clear();
+    }
+    back = 0;
+    latest.store(1);
+    front = 2;
+    n_received.store(0);
+    n_sampled.store(0);
+    n_dropped.store(0);
+
+    stop_requested.store(false);
+    state.store(State::Connecting);
+    worker = std::thread(&OnlineMonitor::workerLoop, this,
+                         etFile, host, port, station, batch_size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// stop the worker thread (GUI thread), it detaches from ET on its way out
+
+void OnlineMonitor::Stop()
 {
-    if(connected)
-        Disconnect();
+    stop_requested.store(true);
+    if(worker.joinable())
+        worker.join();
+    state.store(State::Idle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// connect to ET system + create/attach a monitoring station (worker thread)
 
+bool OnlineMonitor::connect(const std::string &etFile, const std::string &host,
+                            int port, const std::string &station)
+{
     // --- open the ET system: direct TCP connection to host:port ---
     et_openconfig openconfig;
     et_open_config_init(&openconfig);
@@ -121,74 +158,139 @@ bool OnlineMonitor::Connect(const std::string &etFile, const std::string &host,
     }
     et_att = att;
 
-    connected = true;
     std::cout << "[OnlineMonitor] connected to ET '" << etFile << "' @ " << host
               << ":" << port << ", station '" << station << "'" << std::endl;
     return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// pull + decode one event (non-blocking)
+// worker: attach, then pull batches of events until stopped
 
-bool OnlineMonitor::NextEvent()
+void OnlineMonitor::workerLoop(std::string etFile, std::string host, int port,
+                               std::string station, int batch_size)
 {
-    if(!connected)
-        return false;
+    if(!connect(etFile, host, port, station)) {
+        state.store(State::Failed);
+        return;
+    }
+    state.store(State::Running);
+
+    std::vector<et_event*> pe(batch_size, nullptr);
+
+    while(!stop_requested.load())
+    {
+        // ET_TIMED: wake up regularly so Stop() is never kept waiting
+        // on an idle run
+        struct timespec timeout;
+        timeout.tv_sec  = 0;
+        timeout.tv_nsec = 100000000;   // 100 ms
+
+        int nread = 0;
+        int status = et_events_get(et_id, et_att, pe.data(), ET_TIMED, &timeout,
+                                   batch_size, &nread);
+        if(status == ET_ERROR_TIMEOUT || status == ET_ERROR_EMPTY
+                || status == ET_ERROR_WAKEUP)
+            continue;                           // simply no event yet
+        if(status != ET_OK) {
+            std::cout << "[OnlineMonitor] et_events_get error (status " << status
+                      << "); marking disconnected" << std::endl;
+            state.store(State::Failed);         // dead/closed system etc.
+            break;
+        }
 
-    et_event *pe = nullptr;
-    // ET_ASYNC: return immediately if nothing is available -- keeps the GUI
-    // thread responsive when driven from a QTimer.
-    int status = et_event_get(et_id, et_att, &pe, ET_ASYNC, nullptr);
-    if(status != ET_OK) {
-        if(status == ET_ERROR_EMPTY || status == ET_ERROR_TIMEOUT)
-            return false;                       // simply no event this tick
-        std::cout << "[OnlineMonitor] et_event_get error (status " << status
-                  << "); marking disconnected" << std::endl;
-        connected = false;                      // dead/closed system etc.
-        return false;
+        for(int i = 0; i < nread; ++i)
+        {
+            void  *data = nullptr;
+            size_t len  = 0;                    // length in BYTES
+            et_event_getdata(pe[i], &data);
+            et_event_getlength(pe[i], &len);
+
+            decode(data, len);
+            n_received++;
+
+            if(handler)
+                handler(decoder->GetAPV(), decoder->GetAPVDataFlags());
+            publish();
+        }
+
+        // return the events to the system so they can be recycled
+        et_events_put(et_id, et_att, pe.data(), nread);
     }
 
-    void  *data = nullptr;
-    size_t len  = 0;                            // length in BYTES
-    et_event_getdata(pe, &data);
-    et_event_getlength(pe, &len);
+    disconnect();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// decode one ET payload (worker thread)
 
+void OnlineMonitor::decode(void *data, size_t len)
+{
     // Decode the ET payload exactly like the proven SRS_GEM_View ETChannel:
     //   1) byte-swap network (big-endian) -> host order, and
     //   2) skip the 8-word CODA event header the EVIO decoder doesn't handle.
     uint32_t *w     = static_cast<uint32_t*>(data);
     uint32_t  total = static_cast<uint32_t>(len / sizeof(uint32_t));
 
-    if(w != nullptr && total > 0) {
-        // 1) network -> host order. Safe to swap in place: with
-        //    ET_HOST_AS_REMOTE the client owns a local copy of the data.
-        for(uint32_t i = 0; i < total; ++i)
-            w[i] = ntohl(w[i]);
-
-        // 2) skip the CODA event header (8 uint32_t words).
-        const uint32_t kCodaHeaderWords = 8;
-        if(total > kCodaHeaderWords) {
-            const uint32_t *ev = w + kCodaHeaderWords;
-            uint32_t nwords = total - kCodaHeaderWords;
-            // clamp to the EVIO event bank's own declared length (word[0]+1)
-            // so the parser never walks past the event into trailing words.
-            uint32_t evlen = ev[0] + 1;
-            if(evlen < nwords)
-                nwords = evlen;
-            parser->ParseEvent(ev, nwords);
-        }
+    if(w == nullptr || total == 0)
+        return;
+
+    // 1) network -> host order. Safe to swap in place: with
+    //    ET_HOST_AS_REMOTE the client owns a local copy of the data.
+    for(uint32_t i = 0; i < total; ++i)
+        w[i] = ntohl(w[i]);
+
+    // 2) skip the CODA event header (8 uint32_t words).
+    const uint32_t kCodaHeaderWords = 8;
+    if(total > kCodaHeaderWords) {
+        const uint32_t *ev = w + kCodaHeaderWords;
+        uint32_t nwords = total - kCodaHeaderWords;
+        // clamp to the EVIO event bank's own declared length (word[0]+1)
+        // so the parser never walks past the event into trailing words.
+        uint32_t evlen = ev[0] + 1;
+        if(evlen < nwords)
+            nwords = evlen;
+        parser->ParseEvent(ev, nwords);
     }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// make the decoded event the latest one (worker thread)
+// the newest event always wins: a latest event the GUI has not sampled yet
+// is replaced and counted as dropped -- the handler has already seen it
+
+void OnlineMonitor::publish()
+{
+    // assignment reuses the nodes/capacity already held by the slot
+    DecodedEvent &slot = slots[back];
+    slot.data  = decoder->GetAPV();
+    slot.flags = decoder->GetAPVDataFlags();
+
+    int prev = latest.exchange(back | kFresh, std::memory_order_acq_rel);
+    if(prev & kFresh)
+        n_dropped++;
+    back = prev & ~kFresh;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// sample the newest decoded event (GUI thread, non-blocking)
+// the front slot is handed back and the worker overwrites it in place
+
+bool OnlineMonitor::NextEvent()
+{
+    if(!(latest.load(std::memory_order_relaxed) & kFresh))
+        return false;                           // nothing new this tick
 
-    // return the event to the system so it can be recycled
-    et_event_put(et_id, et_att, pe);
+    int prev = latest.exchange(front, std::memory_order_acq_rel);
+    front = prev & ~kFresh;
 
+    n_sampled++;
     return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// detach + close
+// detach + close (worker thread)
 
-void OnlineMonitor::Disconnect()
+void OnlineMonitor::disconnect()
 {
     if(et_id != nullptr) {
         if(et_att >= 0)
@@ -198,20 +300,6 @@ void OnlineMonitor::Disconnect()
     et_id   = nullptr;
     et_att  = -1;
     et_stat = -1;
-    connected = false;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// decoded data accessors (mirror GEMAnalyzer)
-
-const std::unordered_map<APVAddress, std::vector<int>> & OnlineMonitor::GetData() const
-{
-    return decoder ? decoder->GetAPV() : empty_data;
-}
-
-const std::unordered_map<APVAddress, APVDataType> & OnlineMonitor::GetDataFlags() const
-{
-    return decoder ? decoder->GetAPVDataFlags() : empty_flags;
 }
 
 } // namespace online_monitor
@@ -5,12 +5,19 @@
 // OnlineMonitor
 //
 // Encapsulates ALL CODA ET (Event Transfer) client code so the rest of the
-// GUI never needs to know about ET. It attaches to a live ET system, pulls
-// one EVIO event at a time, decodes it with the same EventParser +
-// MPDSSPRawEventDecoder used by the offline path, and exposes the decoded
-// per-APV maps through GetData()/GetDataFlags() -- the exact same interface
-// as GEMAnalyzer, so Viewer can treat the online and offline feeds
-// identically.
+// GUI never needs to know about ET. A background worker thread attaches to a
+// live ET system, pulls EVIO events in batches (et_events_get), byte-swaps
+// and decodes them with the same EventParser + MPDSSPRawEventDecoder used by
+// the offline path, and publishes the decoded per-APV maps through a
+// lock-free latest-event slot.
+//
+// The GUI thread never touches ET. It samples the slot at display rate
+// through NextEvent(), which takes the most recent decoded event, and reads
+// it through GetData()/GetDataFlags() -- the exact same interface as
+// GEMAnalyzer, so Viewer can treat the online and offline feeds identically.
+// Events the GUI does not sample are still decoded; an optional handler
+// sees every one of them on the worker thread, so online statistics can be
+// accumulated at the full trigger rate.
 //
 // IMPORTANT: this header deliberately exposes NO ET types. The ET system
 // handle is held as void* (et_sys_id is itself typedef'd to void*) and the
@@ -22,6 +29,10 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
 
 #include "MPDDataStruct.h"   // APVAddress, APVDataType
 #include "hardcode.h"        // USE_VME / USE_SRS / (else) SSP decoder switch
@@ -42,39 +53,77 @@ namespace online_monitor {
 class OnlineMonitor
 {
 public:
+    typedef std::unordered_map<APVAddress, std::vector<int>> APVDataMap;
+    typedef std::unordered_map<APVAddress, APVDataType>      APVFlagMap;
+    // called on the worker thread for every decoded event
+    typedef std::function<void(const APVDataMap &, const APVFlagMap &)> EventHandler;
+
+    enum class State : int { Idle, Connecting, Running, Failed };
+
     OnlineMonitor();
     ~OnlineMonitor();
 
-    // Attach to an ET system via a direct host:port connection, then create
-    // (or join, if it already exists) the named station and attach to it.
-    //   etFile  : the ET system file name (e.g. /tmp/et_sys_myexp)
-    //   host    : host running the ET system
-    //   port    : ET system TCP server port
-    //   station : name of the monitoring station to create/attach
-    // Returns true on success.
-    bool Connect(const std::string &etFile, const std::string &host,
-                 int port, const std::string &station);
+    OnlineMonitor(const OnlineMonitor &) = delete;
+    OnlineMonitor &operator=(const OnlineMonitor &) = delete;
+
+    // Start the worker thread. It attaches to the ET system via a direct
+    // host:port connection, creates (or joins, if it already exists) the
+    // named station and then keeps pulling events until Stop().
+    //   etFile     : the ET system file name (e.g. /tmp/et_sys_myexp)
+    //   host       : host running the ET system
+    //   port       : ET system TCP server port
+    //   station    : name of the monitoring station to create/attach
+    //   batch_size : max number of events per et_events_get call
+    // Returns immediately; poll GetState() for the connection result.
+    void Start(const std::string &etFile, const std::string &host,
+               int port, const std::string &station,
+               int batch_size = 16);
+
+    // stop the worker, detach from the station and close the ET system
+    void Stop();
+
+    State GetState() const { return state.load(); }
+    bool IsConnected() const { return GetState() == State::Running; }
+
+    // Must be set before Start(); runs on the worker thread.
+    void SetEventHandler(const EventHandler &h) { handler = h; }
+
+    // Sample the most recent decoded event (non-blocking, GUI thread).
+    // Returns true if a new event was taken (GetData/GetDataFlags then hold
+    // its contents), false if nothing new has been decoded since last call.
+    bool NextEvent();
 
-    bool IsConnected() const { return connected; }
+    // Decoded per-APV data for the most recently sampled event. Same return
+    // types as GEMAnalyzer::GetData()/GetDataFlags().
+    const APVDataMap & GetData() const { return slots[front].data; }
+    const APVFlagMap & GetDataFlags() const { return slots[front].flags; }
 
-    // Pull and decode ONE event (non-blocking). Returns true if an event was
-    // received and decoded (GetData/GetDataFlags then hold its contents),
-    // false if no event was available or on error.
-    bool NextEvent();
+    // worker statistics, dropped: decoded events replaced by a newer one
+    // before the GUI sampled them
+    uint64_t GetEventsReceived() const { return n_received.load(); }
+    uint64_t GetEventsSampled() const { return n_sampled.load(); }
+    uint64_t GetEventsDropped() const { return n_dropped.load(); }
 
-    void Disconnect();
+private:
+    struct DecodedEvent
+    {
+        APVDataMap data;
+        APVFlagMap flags;
+    };
 
-    // Decoded per-APV data for the most recently received event. Same return
-    // types as GEMAnalyzer::GetData()/GetDataFlags().
-    const std::unordered_map<APVAddress, std::vector<int>> & GetData() const;
-    const std::unordered_map<APVAddress, APVDataType> & GetDataFlags() const;
+    bool connect(const std::string &etFile, const std::string &host,
+                 int port, const std::string &station);
+    void disconnect();
+    void workerLoop(std::string etFile, std::string host, int port,
+                    std::string station, int batch_size);
+    void decode(void *data, size_t len);
+    void publish();
 
 private:
-    // ET handles kept ET-type-free (see header note above).
+    // ET handles kept ET-type-free (see header note above), worker thread only
     void *et_id  = nullptr;   // et_sys_id  (typedef void*)
     int   et_att = -1;        // et_att_id
     int   et_stat = -1;       // et_stat_id
-    bool  connected = false;
 
     EventParser           *parser  = nullptr;
 #ifdef USE_VME
@@ -85,9 +134,24 @@ private:
     MPDSSPRawEventDecoder *decoder = nullptr;
 #endif
 
-    // safe fallbacks returned before any event / when decoder is unavailable
-    std::unordered_map<APVAddress, std::vector<int>> empty_data;
-    std::unordered_map<APVAddress, APVDataType>      empty_flags;
+    std::thread worker;
+    std::atomic<bool> stop_requested{false};
+    std::atomic<State> state{State::Idle};
+    EventHandler handler;
+
+    // three slots passed between the worker (single producer) and the GUI
+    // (single consumer): the worker fills its back slot and swaps it with
+    // the latest one, the GUI swaps its front slot with the latest one when
+    // that is fresh. Slots are reused so the maps keep their capacity.
+    static constexpr int kFresh = 4;      // flag in latest: not sampled yet
+    DecodedEvent slots[3];
+    std::atomic<int> latest{1};           // slot index | kFresh
+    int back = 0;                         // owned by the worker thread
+    int front = 2;                        // owned by the GUI thread
+
+    std::atomic<uint64_t> n_received{0};
+    std::atomic<uint64_t> n_sampled{0};
+    std::atomic<uint64_t> n_dropped{0};
 };
 
 } // namespace online_monitor
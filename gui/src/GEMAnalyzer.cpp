@@ -32,11 +32,24 @@ void GEMAnalyzer::Init()
         return;
     }
 
-    // set up evio file reader
+    // a new file: drop everything from the previous one
+    Clear();
+
+    // set up evio file reader, random access if possible
     pFileReader = new EvioFileReader();
-    pFileReader -> SetFileOpenMode("r"); // random access
     pFileReader -> SetFile(fFile);
-    pFileReader -> OpenFile();
+    pFileReader -> SetFileOpenMode("ra");
+    random_access = pFileReader -> OpenFile();
+    if(random_access) {
+        if(pFileReader -> GetNumberOfEvents(&nEventsInFile) != S_SUCCESS)
+            nEventsInFile = 0;
+        std::cout<<"GEMAnalyzer: random access to "<<nEventsInFile<<" events."<<std::endl;
+    }
+    else {
+        std::cout<<"GEMAnalyzer: random access not available, reading events in order."<<std::endl;
+        pFileReader -> SetFileOpenMode("r");
+    }
+    file_open = random_access || pFileReader -> OpenFile();
 
     // set up event parser
     pEventParser = new EventParser();
@@ -58,6 +71,12 @@ void GEMAnalyzer::Init()
 
     trigger_decoder = new TriggerDecoder();
     pEventParser -> RegisterRawDecoder(static_cast<int>(Bank_TagID::Trigger), trigger_decoder);
+
+    if(random_access && prefetch_depth > 0) {
+        prefetch_stop = false;
+        prefetch_next = prefetch_end = 0;
+        prefetch_thread = std::thread(&GEMAnalyzer::PrefetchLoop, this);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,14 +90,38 @@ void GEMAnalyzer::SetFile(const char* path)
 ////////////////////////////////////////////////////////////////////////////////
 // analzyer event 
 
-void GEMAnalyzer::AnalyzeEvent([[maybe_unused]] int event)
+void GEMAnalyzer::AnalyzeEvent(int event)
 {
     ClearPreviousEvent();
+    if(pFileReader == nullptr)
+        return;
+
+    if(random_access)
+    {
+        EventPtr ev = FindCached(event);
+        if(!ev) {
+            ev = DecodeEvent(event);
+            if(!ev) {
+                std::cout<<"Error: cannot read event "<<event<<"."<<std::endl;
+                return;
+            }
+            InsertCache(event, ev);
+        }
+        current = ev;
+
+        // decode the next events while this one is looked at
+        {
+            std::lock_guard<std::mutex> lk(prefetch_mutex);
+            prefetch_next = event + 1;
+            prefetch_end = std::min(event + prefetch_depth, static_cast<int>(nEventsInFile)) + 1;
+        }
+        prefetch_cv.notify_one();
+        return;
+    }
 
     const uint32_t *pBuf;
     uint32_t fBufLen;
 
-    //if((pFileReader->ReadEventNum(&pBuf, &fBufLen, event)) != S_SUCCESS)
     if((pFileReader->ReadNoCopy(&pBuf, &fBufLen)) != S_SUCCESS)
     {
         std::cout<<"Error: cannot read event."<<std::endl;
@@ -90,15 +133,121 @@ void GEMAnalyzer::AnalyzeEvent([[maybe_unused]] int event)
     [[maybe_unused]] auto & decoded_data = pRawEventDecoder->GetAPV();
     [[maybe_unused]] auto & decoded_data_flags = pRawEventDecoder -> GetAPVDataFlags();
 
-    FillHistos(decoded_data, decoded_data_flags);
+    FillData(decoded_data, decoded_data_flags);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// decode one event (random access), nullptr if it cannot be read
+
+GEMAnalyzer::EventPtr GEMAnalyzer::DecodeEvent(int event)
+{
+    if(event <= 0 || (nEventsInFile > 0 && static_cast<uint32_t>(event) > nEventsInFile))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lk(decode_mutex);
+
+    const uint32_t *pBuf;
+    uint32_t fBufLen;
+    if(pFileReader -> ReadEventNum(&pBuf, &fBufLen, static_cast<uint32_t>(event)) != S_SUCCESS)
+        return nullptr;
+
+    pEventParser -> ParseEvent(pBuf, fBufLen);
+
+    auto ev = std::make_shared<DecodedEvent>();
+    auto &flags = pRawEventDecoder -> GetAPVDataFlags();
+    for(auto &i: pRawEventDecoder -> GetAPV())
+    {
+        ev -> data[i.first] = i.second;
+        auto it = flags.find(i.first);
+        ev -> flags[i.first] = (it != flags.end()) ? it->second : APVDataType();
+        ev -> bytes += i.second.size() * sizeof(int) + sizeof(APVAddress) + sizeof(APVDataType) + 64;
+    }
+    return ev;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// look up a decoded event, marks it as most recently used
+
+GEMAnalyzer::EventPtr GEMAnalyzer::FindCached(int event)
+{
+    std::lock_guard<std::mutex> lk(cache_mutex);
+    auto it = cache.find(event);
+    if(it == cache.end())
+        return nullptr;
+
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// add a decoded event, least recently used events go when over the limit
+
+void GEMAnalyzer::InsertCache(int event, EventPtr ev)
+{
+    std::lock_guard<std::mutex> lk(cache_mutex);
+    if(cache.find(event) != cache.end())
+        return;
+
+    lru.emplace_front(event, ev);
+    cache[event] = lru.begin();
+    cache_bytes += ev -> bytes;
+
+    // always keep the newest one, even if it is over the limit alone
+    while(cache_bytes > cache_limit && lru.size() > 1) {
+        cache_bytes -= lru.back().second -> bytes;
+        cache.erase(lru.back().first);
+        lru.pop_back();
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// get the analyzed histos
+// memory used by the cached events
 
-const std::unordered_map<APVAddress, TH1I*> & GEMAnalyzer::GetHistos() const
+size_t GEMAnalyzer::GetCacheSize() const
 {
-    return rawHistos;
+    std::lock_guard<std::mutex> lk(cache_mutex);
+    return cache_bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// prefetch thread: decode the events after the current one
+
+void GEMAnalyzer::PrefetchLoop()
+{
+    std::unique_lock<std::mutex> lk(prefetch_mutex);
+    while(true)
+    {
+        prefetch_cv.wait(lk, [this]{return prefetch_stop || prefetch_next < prefetch_end;});
+        if(prefetch_stop)
+            return;
+
+        int event = prefetch_next++;
+        lk.unlock();
+
+        if(!FindCached(event)) {
+            EventPtr ev = DecodeEvent(event);
+            if(ev)
+                InsertCache(event, ev);
+        }
+
+        lk.lock();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// stop prefetch thread
+
+void GEMAnalyzer::StopPrefetch()
+{
+    if(!prefetch_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lk(prefetch_mutex);
+        prefetch_stop = true;
+    }
+    prefetch_cv.notify_one();
+    prefetch_thread.join();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -106,14 +255,27 @@ const std::unordered_map<APVAddress, TH1I*> & GEMAnalyzer::GetHistos() const
 
 void GEMAnalyzer::Clear()
 {
-    for(auto &i: rawHistos)
-        if(i.second) i.second->Delete();
+    StopPrefetch();
+    CloseFile();
 
-    rawData.clear();
-    rawDataFlags.clear();
+    ClearPreviousEvent();
+    {
+        std::lock_guard<std::mutex> lk(cache_mutex);
+        lru.clear();
+        cache.clear();
+        cache_bytes = 0;
+    }
 
     delete pEventParser;
     delete pRawEventDecoder;
+    delete trigger_decoder;
+    delete pFileReader;
+    pEventParser = nullptr;
+    pRawEventDecoder = nullptr;
+    trigger_decoder = nullptr;
+    pFileReader = nullptr;
+    random_access = false;
+    nEventsInFile = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -121,11 +283,9 @@ void GEMAnalyzer::Clear()
 
 void GEMAnalyzer::ClearPreviousEvent()
 {
-    for(auto &i: rawHistos)
-        if(i.second) i.second -> Reset();
-
     rawData.clear();
     rawDataFlags.clear();
+    current.reset();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -133,41 +293,24 @@ void GEMAnalyzer::ClearPreviousEvent()
 
 void GEMAnalyzer::CloseFile()
 {
-    pFileReader->CloseFile();
+    StopPrefetch();
+    if(pFileReader && file_open)
+        pFileReader->CloseFile();
+    file_open = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// fill event histos
+// keep a copy of the event data, the viewer draws straight from it
 
-void GEMAnalyzer::FillHistos(const std::unordered_map<APVAddress, std::vector<int>> &event_data,
+void GEMAnalyzer::FillData(const std::unordered_map<APVAddress, std::vector<int>> &event_data,
         const std::unordered_map<APVAddress, APVDataType> &event_data_flags)
 {
-    int nAPV = 0;
     for(auto &i: event_data)
     {
-        if(rawHistos.find(i.first) == rawHistos.end()){
-            int nBins = static_cast<int>(i.second.size());
-            rawHistos[i.first] = new TH1I(
-                    Form("h%d_crate%d_mpd%d_adc%d", nAPV, i.first.crate_id, i.first.mpd_id, i.first.adc_ch), 
-                    Form("crate_%d_mpd_%d_adc_ch_%d", i.first.crate_id, i.first.mpd_id, i.first.adc_ch), 
-                    nBins, 0, nBins);
-        }
-        else
-            rawHistos[i.first] -> Reset();
-
-        nAPV++;
+        rawData[i.first] = i.second;
 
-        int ts = 0;
-        for(auto &j: i.second)
-        {
-            rawHistos[i.first] -> SetBinContent(ts, j);
-            rawData[i.first].push_back(j);
-            if(event_data_flags.find(i.first) != event_data_flags.end())
-                rawDataFlags[i.first] = event_data_flags.at(i.first);
-            else
-                rawDataFlags[i.first] = APVDataType();
-            ts++;
-        }
+        auto it = event_data_flags.find(i.first);
+        rawDataFlags[i.first] = (it != event_data_flags.end()) ? it->second : APVDataType();
     }
 }
 
@@ -176,7 +319,7 @@ void GEMAnalyzer::FillHistos(const std::unordered_map<APVAddress, std::vector<in
 
 const std::unordered_map<APVAddress, std::vector<int>> & GEMAnalyzer::GetData() const
 {
-    return rawData;
+    return current ? current->data : rawData;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -184,7 +327,7 @@ const std::unordered_map<APVAddress, std::vector<int>> & GEMAnalyzer::GetData()
 
 const std::unordered_map<APVAddress, APVDataType> & GEMAnalyzer::GetDataFlags() const
 {
-    return rawDataFlags;
+    return current ? current->flags : rawDataFlags;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
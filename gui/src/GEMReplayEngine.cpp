@@ -0,0 +1,267 @@
+#include "GEMReplayEngine.h"
+#include "GEMSystem.h"
+#include "GEMDataHandler.h"
+#include "GEMRootHitTree.h"
+#include "GEMRootClusterTree.h"
+#include "EvioFileReader.h"
+#include "OnlineGEMHistos.h"
+
+#include <QTimer>
+#include <QFileInfo>
+#include <QMetaObject>
+
+#include <TROOT.h>
+
+#include <iostream>
+#include <algorithm>
+
+#define PROGRESS_INTERVAL_MS 500
+
+////////////////////////////////////////////////////////////////////////////////
+// ctor
+
+GEMReplayEngine::GEMReplayEngine(QObject *parent)
+    : QObject(parent)
+{
+    timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &GEMReplayEngine::reportProgress);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// dtor
+
+GEMReplayEngine::~GEMReplayEngine()
+{
+    cancelled = true;
+    for(auto &th: workers)
+        if(th.joinable())
+            th.join();
+
+    for(auto &s: worker_sys)
+        delete s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// set pedestal input
+
+void GEMReplayEngine::SetPedestalInputFile(const std::string &p, const std::string &c)
+{
+    pedestal_input_file = p;
+    common_mode_input_file = c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// set split range, max < 0 means no split
+
+void GEMReplayEngine::SetSplitRange(int min, int max)
+{
+    split_min = min;
+    split_max = max;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// set number of worker threads
+
+void GEMReplayEngine::SetNumberOfThreads(int n)
+{
+    nthreads = std::max(n, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// start replay on the worker threads, returns immediately
+
+bool GEMReplayEngine::Start(Mode m)
+{
+    if(running) {
+        std::cout<<"GEMReplayEngine: a replay is already running."<<std::endl;
+        return false;
+    }
+    if(gem_sys == nullptr) {
+        std::cout<<"GEMReplayEngine: gem system not set."<<std::endl;
+        return false;
+    }
+
+    // work list
+    splits.clear();
+    bytes_total = 0;
+    if(split_max < 0)
+        splits.emplace_back(split_min, ifile);
+    else {
+        for(int i=split_min; i<split_max; i++) {
+            std::string path = GEMDataHandler::SplitFilePath(ifile, i);
+            if(path.empty())
+                break;
+            splits.emplace_back(i, path);
+        }
+    }
+    for(auto &s: splits)
+        bytes_total += QFileInfo(QString::fromStdString(s.second)).size();
+
+    if(splits.empty()) {
+        std::cout<<"GEMReplayEngine: no file to replay."<<std::endl;
+        return false;
+    }
+
+    mode = m;
+    int n = (mode == Mode::Hit) ? 1 : std::min(nthreads, static_cast<int>(splits.size()));
+
+    // several root files are written at the same time
+    if(n > 1)
+        ROOT::EnableThreadSafety();
+
+    // one gem system per worker
+    for(auto &s: worker_sys)
+        delete s;
+    worker_sys.clear();
+    for(int i=0; i<n; i++) {
+        GEMSystem *sys = new GEMSystem(*gem_sys);
+        sys -> SetReplayMode(true);
+        worker_sys.push_back(sys);
+    }
+
+    next_split = 0;
+    events_done = 0;
+    bytes_done = 0;
+    splits_done = 0;
+    cancelled = false;
+    workers_running = n;
+    running = true;
+    start_time = std::chrono::steady_clock::now();
+
+    workers.clear();
+    for(int i=0; i<n; i++)
+        workers.emplace_back(&GEMReplayEngine::workerLoop, this, i);
+
+    timer -> start(PROGRESS_INTERVAL_MS);
+
+    std::cout<<"GEMReplayEngine: replaying "<<splits.size()<<" file(s) on "
+        <<n<<" thread(s)."<<std::endl;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// stop after the current event of every worker
+
+void GEMReplayEngine::Cancel()
+{
+    cancelled = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// worker: take the next split until none is left
+
+void GEMReplayEngine::workerLoop(int iworker)
+{
+    while(!cancelled)
+    {
+        size_t i = next_split++;
+        if(i >= splits.size())
+            break;
+
+        replaySplit(iworker, splits[i].first, splits[i].second);
+    }
+
+    // the last worker hands the clean up to the GUI thread
+    if(--workers_running == 0)
+        QMetaObject::invokeMethod(this, "workersDone", Qt::QueuedConnection);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// replay one split into its own root file
+
+void GEMReplayEngine::replaySplit(int iworker, int split, const std::string &path)
+{
+    GEMSystem *sys = worker_sys[iworker];
+
+    EvioFileReader evio_reader;
+    GEMDataHandler data_handler;
+    data_handler.SetGEMSystem(sys);
+    data_handler.SetEvioFileReader(&evio_reader);
+    data_handler.SetReplayMode(true);
+    if(mode == Mode::Cluster)
+        data_handler.TurnOnClustering();
+    else
+        data_handler.TurnOffClustering();
+
+    // loads the pedestal and names the output after the split
+    if(!data_handler.SetupReplay(ifile, split, -1, pedestal_input_file, common_mode_input_file)) {
+        std::cout<<"Skipped file, no valid pedestal: "<<path<<std::endl;
+        splits_done++;
+        return;
+    }
+
+    if(!data_handler.OpenEvioFile(path)) {
+        std::cout<<"Skipped file: "<<path<<std::endl;
+        splits_done++;
+        return;
+    }
+    data_handler.RegisterRawDecoders();
+
+    const uint32_t *pBuf;
+    uint32_t fBufLen;
+    int event_number = 0;
+    while(!cancelled && evio_reader.ReadNoCopy(&pBuf, &fBufLen) == S_SUCCESS)
+    {
+        data_handler.ProcessEvent(pBuf, fBufLen, event_number);
+        data_handler.EndofThisEvent(event_number);
+        event_number++;
+
+        // clusters of this event are still in the worker's gem system
+        if(histos && mode == Mode::Cluster)
+            histos -> FillShard(iworker, sys);
+
+        events_done.fetch_add(1, std::memory_order_relaxed);
+        bytes_done.fetch_add(fBufLen * sizeof(uint32_t), std::memory_order_relaxed);
+    }
+    evio_reader.CloseFile();
+
+    // a cancelled split still keeps what was replayed so far
+    data_handler.Write();
+
+    std::string output = (mode == Mode::Cluster) ? data_handler.GetClusterTreeOutputFileName()
+        : data_handler.GetHitTreeOutputFileName();
+    delete data_handler.GetHitTree();
+    delete data_handler.GetClusterTree();
+
+    if(!cancelled)
+        splits_done++;
+    emit splitFinished(split, QString::fromStdString(output), event_number);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// progress report (GUI thread)
+
+void GEMReplayEngine::reportProgress()
+{
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    uint64_t nev = events_done.load(std::memory_order_relaxed);
+    uint64_t nbytes = bytes_done.load(std::memory_order_relaxed);
+
+    double rate = elapsed > 0 ? nev / elapsed : 0.;
+    double eta = -1.;
+    if(nbytes > 0 && bytes_total > nbytes)
+        eta = elapsed * static_cast<double>(bytes_total - nbytes) / nbytes;
+    else if(nbytes >= bytes_total)
+        eta = 0.;
+
+    emit progress(static_cast<qint64>(nev), rate, eta, splits_done.load(),
+            static_cast<int>(splits.size()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// all workers returned (GUI thread)
+
+void GEMReplayEngine::workersDone()
+{
+    for(auto &th: workers)
+        if(th.joinable())
+            th.join();
+    workers.clear();
+
+    timer -> stop();
+    reportProgress();
+    running = false;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    emit finished(cancelled.load(), static_cast<qint64>(events_done.load()), elapsed);
+}
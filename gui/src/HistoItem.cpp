@@ -1,6 +1,7 @@
 #include "HistoItem.h"
 
 #include <cmath>
+#include <algorithm>
 #include <QPen>
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
@@ -51,6 +52,8 @@ void HistoItem::updateDrawingRange()
 void HistoItem::clearContent()
 {
     original_data2.clear();
+    _samples.clear();
+    _sample_begin = _sample_end = 0;
     _data2.clear();
     _content.clear();
     _select_box.clear();
@@ -69,6 +72,7 @@ void HistoItem::SetBoundingRect(const QRectF &f)
     setPos(f.x(), f.y());
 
     updateDrawingRange();
+    _shape_dirty = true;
 }
 
 QRectF HistoItem::boundingRect() const
@@ -94,10 +98,18 @@ void HistoItem::PassData()
 
 void HistoItem::ReceiveContents(const QVector<QPair<double, double>> &xy)
 {
+    _samples.clear();
     original_data2 = xy;
     updateDrawingContent();
 }
 
+void HistoItem::ReceiveSamples(const int *buf, size_t n)
+{
+    original_data2.clear();
+    _samples.assign(buf, buf + n);
+    updateDrawingContent();
+}
+
 void HistoItem::updateDrawingContent()
 {
     // clear previous event, drawing content is saved in _data2
@@ -113,6 +125,19 @@ void HistoItem::updateDrawingContent()
         //qDebug()<<"data range selected" << draw_data_range.first<<", "<<draw_data_range.second;
     }
 
+    // samples: only the index range in view is kept
+    if(!_samples.empty()) {
+        _sample_begin = 0, _sample_end = _samples.size();
+        if(second_pos > first_pos) {
+            double b = std::max(0., std::ceil(draw_data_range.first));
+            double e = std::min(static_cast<double>(_samples.size()), std::floor(draw_data_range.second) + 1);
+            if(e > b)
+                _sample_begin = static_cast<size_t>(b), _sample_end = static_cast<size_t>(e);
+        }
+        prepareDataShape();
+        return;
+    }
+
     // extract drawable-part data
     for(auto &i: original_data2) {
         if(second_pos > first_pos) {
@@ -129,6 +154,12 @@ void HistoItem::updateDrawingContent()
 void HistoItem::prepareDataShape()
 {
     updateDrawingRange();
+    _shape_dirty = false;
+
+    if(!_samples.empty()) {
+        prepareSampleShape();
+        return;
+    }
 
     // shape data
     auto find_data_range = [&](QPair<double, double> &xr, QPair<double, double> &yr){
@@ -187,6 +218,65 @@ void HistoItem::prepareDataShape()
     }
 }
 
+void HistoItem::prepareSampleShape()
+{
+    _content.clear();
+    if(_sample_end <= _sample_begin)
+        return;
+
+    const int *v = _samples.data();
+    size_t b = _sample_begin, e = _sample_end, n = e - b;
+
+    auto mm = std::minmax_element(v + b, v + e);
+    data_x_range = qMakePair(static_cast<double>(b), static_cast<double>(e - 1));
+    data_y_range = qMakePair(static_cast<double>(*mm.first), static_cast<double>(*mm.second));
+
+    double x_span = data_x_range.second - data_x_range.first;
+    if(x_span <= 0) {
+        x_span = 1.0;
+        data_x_range.second = data_x_range.first + 1.0;
+    }
+    double y_span = data_y_range.second - data_y_range.first;
+    if(y_span <= 0)
+        y_span = 1.0;
+
+    double scale_factor_x = drawing_range.width() / x_span;
+    double scale_factor_y = drawing_range.height() / y_span;
+    double x0 = drawing_range.x(), y0 = drawing_range.y() + drawing_range.height();
+    auto Y = [&](int a) -> double {return y0 - (a - data_y_range.first) * scale_factor_y;};
+
+    _content << QPointF(x0, y0);
+
+    size_t ncol = std::max(1, static_cast<int>(drawing_range.width()));
+    if(n <= 2 * ncol)
+    {
+        // few samples: steps, same as the (x, y) pair drawing
+        _content.reserve(static_cast<int>(2 * n + 2));
+        for(size_t i=b; i+1<e; i++)
+            _content << QPointF(x0 + (i - b) * scale_factor_x, Y(v[i]))
+                << QPointF(x0 + (i + 1 - b) * scale_factor_x, Y(v[i]));
+    }
+    else
+    {
+        // more samples than pixels: min and max of every pixel column,
+        // a single sample spike still shows up
+        _content.reserve(static_cast<int>(2 * ncol + 2));
+        size_t i = b;
+        for(size_t c=0; c<ncol; c++)
+        {
+            size_t end = b + (c + 1) * n / ncol;
+            if(end <= i)
+                continue;
+            auto col = std::minmax_element(v + i, v + end);
+            double x = x0 + (i - b) * scale_factor_x;
+            _content << QPointF(x, Y(*col.first)) << QPointF(x, Y(*col.second));
+            i = end;
+        }
+    }
+
+    _content << QPointF(x0 + (data_x_range.second - data_x_range.first) * scale_factor_x, y0);
+}
+
 void HistoItem::paint(QPainter *painter,
         [[maybe_unused]] const QStyleOptionGraphicsItem *option,
         [[maybe_unused]] QWidget *widget)
@@ -201,7 +291,8 @@ void HistoItem::paint(QPainter *painter,
 
     // draw data
     painter -> setPen(pen1);
-    prepareDataShape();
+    if(_shape_dirty)
+        prepareDataShape();
     painter -> drawPolygon(_content);
 
     pen1.setColor(Qt::black);
@@ -191,6 +191,31 @@ void HistoWidget::DrawCanvas(const std::vector<std::vector<int>> &data,
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// distribute painting area, raw frames from int buffers
+
+void HistoWidget::DrawCanvas(const std::vector<std::pair<const int*, size_t>> &frames,
+        const std::vector<APVAddress> &addr, int row, int col)
+{
+    if(row != fRow || col != fCol)
+    {
+        Divide(row, col);
+    }
+
+    assert(static_cast<int>(frames.size()) <= fRow * fCol);
+
+    // fill histoitems
+    for(unsigned int i=0; i < frames.size(); i++) {
+        EnsureSlotType(i, PlotData::Plot1D);
+        HistoItem *item = static_cast<HistoItem*>(pItem[i].item);
+        item -> ReceiveSamples(frames[i].first, frames[i].second);
+        std::string title = "slot_" + std::to_string(addr[i].crate_id) +
+            "_fiber_" + std::to_string(addr[i].mpd_id) + 
+            "_apv_" + std::to_string(addr[i].adc_ch);
+        item -> SetTitle(title);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // distribute painting area, get title from parameters
 
@@ -31,6 +31,7 @@
 
 #include <vector>
 #include <cstdio>
+#include <algorithm>
 
 #include <TFile.h>
 #include <TKey.h>
@@ -63,8 +64,11 @@ OnlineAnalysisInterface::OnlineAnalysisInterface(QWidget *parent)
 
 OnlineAnalysisInterface::~OnlineAnalysisInterface()
 {
-    // make sure no background processes outlive us
+    // make sure no background processes outlive us; a killed worker must
+    // not come back through OnWorkerFinished and pull the next split
+    m_pendingSplits.clear();
     for(auto *p : m_workers) {
+        if(p) p->disconnect(this);
         if(p && p->state() != QProcess::NotRunning) {
             p->kill();
             p->waitForFinished(1000);
@@ -538,7 +542,6 @@ bool OnlineAnalysisInterface::PrepareAnalysisRequest(AnalysisRequest &request)
         request.nCore = request.nSplit;
     if(request.nCore < 1)
         request.nCore = 1;
-    request.nJob = (request.nSplit + request.nCore - 1) / request.nCore;
 
     if(!QDir().mkpath(request.outDir)) {
         QMessageBox::warning(this, tr("Online Analysis"),
@@ -550,9 +553,9 @@ bool OnlineAnalysisInterface::PrepareAnalysisRequest(AnalysisRequest &request)
 
 void OnlineAnalysisInterface::LogAnalysisPreamble(const AnalysisRequest &request)
 {
-    AppendLog(QString("Analyzing run %1: %2 splits across %3 core(s) (~%4 file(s) per core)")
+    AppendLog(QString("Analyzing run %1: %2 splits across %3 core(s), shared queue")
               .arg(request.run).arg(request.nSplit)
-              .arg(request.nCore).arg(request.nJob));
+              .arg(request.nCore));
     AppendLog(QString("Replay binary: %1").arg(request.replayBin));
     AppendLog(QString("Pedestal:      %1").arg(request.ped));
     AppendLog(QString("Common mode:   %1").arg(request.cm));
@@ -564,16 +567,11 @@ void OnlineAnalysisInterface::LogAnalysisPreamble(const AnalysisRequest &request
 }
 
 QString OnlineAnalysisInterface::BuildWorkerCommand(const AnalysisRequest &request,
-                                                    int core, int start,
-                                                    int end) const
+                                                    int core, int split) const
 {
     // Every user-controlled string is shell-quoted before splicing into the
     // bash command so paths containing spaces, $, `, ; or ' cannot end up
     // being interpreted by the shell.
-    QStringList quotedFiles;
-    for(int i = start; i <= end; ++i)
-        quotedFiles << ShellQuote(request.absFiles[i]);
-
     const QString cdLine = m_repoRoot.isEmpty()
         ? QString()
         : QString("cd %1 2>/dev/null; ").arg(ShellQuote(m_repoRoot));
@@ -581,21 +579,18 @@ QString OnlineAnalysisInterface::BuildWorkerCommand(const AnalysisRequest &reque
     // - Cd to the repo root so the relative `./setup_env.sh` and any other
     //   relative paths inside it resolve regardless of QProcess CWD.
     // - Source setup_env.sh so dyld/ld can find libgem/libdecoder/etc.
+    // - One split per process, the next one is handed out by StartNextSplit.
     return QString(
         "%10"
         "[ -f ./setup_env.sh ] && . ./setup_env.sh >/dev/null 2>&1; "
-        "files=( %1 ); "
-        "for ((k=0; k<${#files[@]}; k++)); do "
-        "  idx=$((%2 + k)); "
-        "  out=%9/%3_run%4_split${idx}.root; "
-        "  echo \"[core %5] split ${idx} -> ${out}\"; "
-        "  %6 -c 0 -t 0 -z 1 -n -1 --tracking off "
-        "     --pedestal %7 --common_mode %8 "
-        "     --output_root_filename \"${out}\" \"${files[$k]}\"; "
-        "done"
+        "out=%9/%3_run%4_split%2.root; "
+        "echo \"[core %5] split %2 -> ${out}\"; "
+        "%6 -c 0 -t 0 -z 1 -n -1 --tracking off "
+        "   --pedestal %7 --common_mode %8 "
+        "   --output_root_filename \"${out}\" %1"
         )
-        .arg(quotedFiles.join(' '))
-        .arg(start)
+        .arg(ShellQuote(request.absFiles[split]))
+        .arg(split)
         .arg(ShellQuote(request.prefix))
         .arg(request.run)
         .arg(core)
@@ -614,45 +609,67 @@ void OnlineAnalysisInterface::CreateWorkerProcesses(const AnalysisRequest &reque
     m_workers.clear();
     m_activeWorkers = 0;
     m_workerFailures = 0;
+    m_splitsDone = 0;
     m_currentRun = request.run;
     m_currentPrefix = request.prefix;
     m_currentOutDir = request.outDir;
+    m_currentRequest = request;
+
+    // Splits differ a lot in size, so instead of a fixed block per core all
+    // splits go into one queue that idle cores pull from. Largest first, so
+    // the run does not end waiting on a big split started last.
+    std::vector<qint64> size(request.nSplit);
+    for(int i = 0; i < request.nSplit; ++i)
+        size[i] = QFileInfo(request.absFiles[i]).size();
+
+    std::vector<int> order(request.nSplit);
+    for(int i = 0; i < request.nSplit; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+            [&size](int a, int b) { return size[a] > size[b]; });
+
+    m_pendingSplits.clear();
+    for(int i : order)
+        m_pendingSplits.append(i);
+
+    AppendLog(QString("%1 split(s) queued for %2 core(s), largest first")
+              .arg(m_pendingSplits.size()).arg(request.nCore));
+}
 
-    for(int core = 0; core < request.nCore; ++core) {
-        int start = core * request.nJob;
-        int end = start + request.nJob - 1;
-        if(end >= request.nSplit)
-            end = request.nSplit - 1;
-        if(start > end) continue;
-
-        QProcess *p = new QProcess(this);
-        p->setProgram("/bin/bash");
-        p->setArguments({"-c", BuildWorkerCommand(request, core, start, end)});
-        p->setProcessChannelMode(QProcess::MergedChannels);
-        p->setProperty("core", core);
-        p->setProperty("buf", QByteArray());   // per-process line buffer
-        connect(p, &QProcess::readyReadStandardOutput,
-                this, &OnlineAnalysisInterface::OnWorkerReadyRead);
-        connect(p, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, &OnlineAnalysisInterface::OnWorkerFinished);
-        m_workers.append(p);
-
-        AppendLog(QString("CPU %1 will process splits %2 -> %3")
-                  .arg(core).arg(start).arg(end));
-    }
+bool OnlineAnalysisInterface::StartNextSplit(int core)
+{
+    if(m_pendingSplits.isEmpty())
+        return false;
+    const int split = m_pendingSplits.takeFirst();
+
+    QProcess *p = new QProcess(this);
+    p->setProgram("/bin/bash");
+    p->setArguments({"-c", BuildWorkerCommand(m_currentRequest, core, split)});
+    p->setProcessChannelMode(QProcess::MergedChannels);
+    p->setProperty("core", core);
+    p->setProperty("split", split);
+    p->setProperty("buf", QByteArray());   // per-process line buffer
+    connect(p, &QProcess::readyReadStandardOutput,
+            this, &OnlineAnalysisInterface::OnWorkerReadyRead);
+    connect(p, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &OnlineAnalysisInterface::OnWorkerFinished);
+    m_workers.append(p);
+    p->start();
+    return true;
 }
 
 void OnlineAnalysisInterface::StartWorkerProcesses()
 {
-    if(m_workers.isEmpty()) {
+    if(m_pendingSplits.isEmpty()) {
         AppendLog("No work to do.");
         return;
     }
 
     SetControlsEnabled(false);
-    m_activeWorkers = m_workers.size();
-    for(QProcess *p : m_workers)
-        p->start();
+    const int nCore = std::min(m_currentRequest.nCore, int(m_pendingSplits.size()));
+    for(int core = 0; core < nCore; ++core)
+        if(StartNextSplit(core))
+            ++m_activeWorkers;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -695,8 +712,10 @@ void OnlineAnalysisInterface::OnWorkerReadyRead()
 void OnlineAnalysisInterface::OnWorkerFinished(int exitCode, int exitStatus)
 {
     QProcess *p = qobject_cast<QProcess*>(sender());
+    int core = -1;
     if(p) {
-        const int core = p->property("core").toInt();
+        core = p->property("core").toInt();
+        const int split = p->property("split").toInt();
         // flush any tail bytes that didn't end with a newline
         const QByteArray tail = p->property("buf").toByteArray();
         if(!tail.isEmpty()) {
@@ -707,12 +726,20 @@ void OnlineAnalysisInterface::OnWorkerFinished(int exitCode, int exitStatus)
         const bool ok = (exitStatus == QProcess::NormalExit && exitCode == 0);
         if(!ok) {
             ++m_workerFailures;
-            AppendLog(QString("[core %1] FAILED (exit code %2, status %3)")
-                      .arg(core).arg(exitCode).arg(int(exitStatus)));
+            AppendLog(QString("[core %1] split %2 FAILED (exit code %3, status %4)")
+                      .arg(core).arg(split).arg(exitCode).arg(int(exitStatus)));
         } else {
-            AppendLog(QString("[core %1] finished (exit %2)").arg(core).arg(exitCode));
+            AppendLog(QString("[core %1] split %2 finished (%3/%4)")
+                      .arg(core).arg(split).arg(++m_splitsDone)
+                      .arg(m_currentRequest.nSplit));
         }
+        m_workers.removeOne(p);
+        p->deleteLater();
     }
+
+    // this core is idle now, give it the next split in the queue
+    if(core >= 0 && StartNextSplit(core))
+        return;
     if(--m_activeWorkers > 0)
         return;
 
@@ -0,0 +1,466 @@
+#include "OnlineGEMHistos.h"
+
+#include "GEMSystem.h"
+#include "GEMDetector.h"
+#include "GEMPlane.h"
+#include "hardcode.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+////////////////////////////////////////////////////////////////////////////////
+// ctor
+
+OnlineGEMHistos::OnlineGEMHistos(int nthreads, size_t queue_depth)
+    : max_queue_depth(queue_depth)
+{
+    if(nthreads < 1)
+        nthreads = 1;
+    if(max_queue_depth < 1)
+        max_queue_depth = 1;
+
+    for(int i=0; i<nthreads; i++)
+        workers.emplace_back(new Worker());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// dtor
+
+OnlineGEMHistos::~OnlineGEMHistos()
+{
+    Stop();
+
+    for(auto &w: workers)
+        delete w->sys;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// setup the per thread gem systems and book all histograms
+
+void OnlineGEMHistos::Init(const GEMSystem &sys, const std::string &ped,
+        const std::string &cm)
+{
+    Stop();
+
+    for(auto &w: workers) {
+        delete w->sys;
+        w->sys = new GEMSystem(sys);
+        w->sys->ReadPedestalFile(ped, cm);
+    }
+
+    defs.clear();
+    det_histos.clear();
+
+    std::vector<GEMDetector*> detectors = sys.GetDetectorList();
+    std::sort(detectors.begin(), detectors.end(), [](GEMDetector *a, GEMDetector *b) {
+            return a->GetDetID() < b->GetDetID();
+            });
+
+    const char *axis[2] = {"x", "y"};
+    for(auto &det: detectors)
+    {
+        DetHistos dh;
+        std::string name = det->GetName();
+
+        for(int p=0; p<2; p++)
+        {
+            GEMPlane *pln = det->GetPlane(p == 0 ? GEMPlane::Plane_X : GEMPlane::Plane_Y);
+            if(pln == nullptr) {
+                dh.occupancy[p] = dh.fired[p] = dh.multiplicity[p] = -1;
+                dh.adc[p] = dh.size[p] = dh.pos[p] = -1;
+                continue;
+            }
+
+            std::string pre = name + " " + axis[p] + " plane ";
+            int nstrips = pln->GetCapacity() * APV_STRIP_SIZE;
+            double half = pln->GetSize() / 2.;
+            if(half <= 0) half = 700.;
+
+            dh.occupancy[p] = book(pre + "occupancy", "strip index", nstrips,
+                    -0.5, nstrips - 0.5, true);
+            dh.fired[p] = book(pre + "fired strips", "fired strips", 50, -0.5, 49.5);
+            dh.multiplicity[p] = book(pre + "cluster multiplicity", "clusters", 10, -0.5, 9.5);
+            dh.adc[p] = book(pre + "cluster ADC", "cluster peak ADC", 100, 0, 2500);
+            dh.size[p] = book(pre + "cluster size", "cluster size", 20, -0.5, 19.5);
+            dh.pos[p] = book(pre + "cluster position", "position [mm]", 200, -half, half);
+        }
+
+        dh.efficiency = book(name + " events with clusters (x, y, x&y)",
+                "0: x, 1: y, 2: x&y", 3, -0.5, 2.5, true);
+
+        det_histos[det->GetDetID()] = dh;
+    }
+
+    for(auto &w: workers) {
+        w->shard.histos.clear();
+        w->shard.histos.resize(defs.size());
+        for(size_t i=0; i<defs.size(); i++)
+            w->shard.histos[i].Init(&defs[i]);
+        w->shard.events.store(0);
+    }
+
+    reset_bins.assign(defs.size(), std::vector<uint64_t>());
+    for(size_t i=0; i<defs.size(); i++)
+        reset_bins[i].assign(defs[i].nx + 2, 0);
+    reset_events = 0;
+    reset_dropped = n_dropped.load();
+
+    std::cout<<"OnlineGEMHistos: "<<workers.size()<<" threads, "
+             <<defs.size()<<" histograms."<<std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// add a histogram definition, return its index
+
+int OnlineGEMHistos::book(const std::string &title, const std::string &xt, int nx,
+        double xmin, double xmax, bool normalize)
+{
+    HistoDef d;
+    d.title = title;
+    d.x_title = xt;
+    d.y_title = normalize ? "fraction of events" : "entries";
+    d.nx = nx > 0 ? nx : 1;
+    d.x_min = xmin;
+    d.x_max = xmax > xmin ? xmax : xmin + 1;
+    d.normalize = normalize;
+
+    defs.push_back(d);
+    return static_cast<int>(defs.size()) - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// histogram shard
+
+void OnlineGEMHistos::Histo::Init(const HistoDef *d)
+{
+    def = d;
+    bins.reset(new std::atomic<uint64_t>[d->nx + 2]);
+    for(int i=0; i<d->nx+2; i++)
+        bins[i].store(0, std::memory_order_relaxed);
+}
+
+void OnlineGEMHistos::Histo::Fill(double x)
+{
+    // NaN fails every comparison below and would give an undefined bin
+    if(std::isnan(x))
+        return;
+
+    int b;
+    if(x < def->x_min)
+        b = 0;
+    else if(x >= def->x_max)
+        b = def->nx + 1;
+    else
+        b = std::min(def->nx, 1 + static_cast<int>((x - def->x_min) /
+                    (def->x_max - def->x_min) * def->nx));
+
+    // only the owning thread writes, no read-modify-write needed
+    std::atomic<uint64_t> &c = bins[b];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// start worker threads
+
+void OnlineGEMHistos::Start()
+{
+    if(running)
+        return;
+
+    for(auto &w: workers)
+    {
+        if(w->sys == nullptr) {
+            std::cout<<"OnlineGEMHistos: not initialized, call Init() first."<<std::endl;
+            return;
+        }
+    }
+
+    for(auto &w: workers)
+    {
+        w->done = false;
+        w->pending.clear();
+        w->free_events.clear();
+        while(w->all_events.size() < max_queue_depth)
+            w->all_events.emplace_back(new Event());
+        for(auto &e: w->all_events)
+            w->free_events.push_back(e.get());
+
+        w->th = std::thread(&OnlineGEMHistos::workerLoop, this, w.get());
+    }
+
+    running = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// drain and join worker threads
+
+void OnlineGEMHistos::Stop()
+{
+    if(!running)
+        return;
+
+    for(auto &w: workers)
+    {
+        {
+            std::lock_guard<std::mutex> lk(w->mtx);
+            w->done = true;
+        }
+        w->cv.notify_one();
+    }
+
+    for(auto &w: workers)
+    {
+        if(w->th.joinable())
+            w->th.join();
+    }
+
+    running = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// hand one event to the next worker, drop it if that worker is busy
+// single producer: only the ET worker thread calls this
+
+void OnlineGEMHistos::Feed(const APVDataMap &data, const APVFlagMap &flags)
+{
+    if(!running)
+        return;
+
+    Worker *w = workers[next_worker].get();
+    next_worker = (next_worker + 1) % workers.size();
+
+    Event *e = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(w->mtx);
+        if(!w->free_events.empty()) {
+            e = w->free_events.back();
+            w->free_events.pop_back();
+        }
+    }
+
+    if(e == nullptr) {
+        n_dropped++;
+        return;
+    }
+
+    // assignment reuses the nodes/capacity of the recycled event
+    e->data = data;
+    e->flags = flags;
+
+    {
+        std::lock_guard<std::mutex> lk(w->mtx);
+        w->pending.push_back(e);
+    }
+    w->cv.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// worker: take events, reconstruct, fill own shard
+
+void OnlineGEMHistos::workerLoop(Worker *w)
+{
+    while(true)
+    {
+        Event *e = nullptr;
+        {
+            std::unique_lock<std::mutex> lk(w->mtx);
+            w->cv.wait(lk, [w]{return w->done || !w->pending.empty();});
+
+            if(w->pending.empty())
+                return; // done and drained
+
+            e = w->pending.front();
+            w->pending.pop_front();
+        }
+
+        process(w, *e);
+
+        {
+            std::lock_guard<std::mutex> lk(w->mtx);
+            w->free_events.push_back(e);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// zero suppression + clustering, same path as GEMDataHandler in replay mode
+
+void OnlineGEMHistos::process(Worker *w, const Event &e)
+{
+    GEMSystem *sys = w->sys;
+
+    for(auto &i: e.data)
+    {
+        if(sys->GetAPV(i.first) == nullptr)
+            continue;
+#ifdef USE_SRS
+        sys->FillRawDataSRS(i.first, i.second, w->event_data);
+#else
+        auto flags_it = e.flags.find(i.first);
+        APVDataType default_flags;
+        default_flags.SetAPVAddress(i.first);
+        const APVDataType &flags = (flags_it != e.flags.end()) ?
+            flags_it->second : default_flags;
+        sys->FillRawDataMPD(i.first, i.second, flags, w->event_data);
+#endif
+    }
+
+    sys->Reconstruct(w->event_data);
+    fill(sys, w->shard);
+    w->event_data.Clear();
+
+    w->shard.events.store(w->shard.events.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// fill an externally reconstructed event (replay), the caller owns shard i
+
+void OnlineGEMHistos::FillShard(int i, GEMSystem *sys)
+{
+    if(running || i < 0 || i >= static_cast<int>(workers.size()))
+        return;
+
+    Shard &shard = workers[i]->shard;
+    fill(sys, shard);
+    shard.events.store(shard.events.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// fill the reconstructed event into a shard
+
+void OnlineGEMHistos::fill(GEMSystem *sys, Shard &shard)
+{
+    std::vector<Histo> &h = shard.histos;
+
+    for(auto &det: sys->GetDetectorList())
+    {
+        auto it = det_histos.find(det->GetDetID());
+        if(it == det_histos.end())
+            continue;
+        const DetHistos &dh = it->second;
+
+        bool has_cluster[2] = {false, false};
+        for(int p=0; p<2; p++)
+        {
+            if(dh.occupancy[p] < 0)
+                continue;
+            GEMPlane *pln = det->GetPlane(p == 0 ? GEMPlane::Plane_X : GEMPlane::Plane_Y);
+            if(pln == nullptr)
+                continue;
+
+            const std::vector<StripHit> &hits = pln->GetStripHits();
+            h[dh.fired[p]].Fill(hits.size());
+            for(auto &s: hits)
+                h[dh.occupancy[p]].Fill(s.strip);
+
+            const std::vector<StripCluster> &clusters = pln->GetStripClusters();
+            h[dh.multiplicity[p]].Fill(clusters.size());
+            for(auto &c: clusters) {
+                h[dh.adc[p]].Fill(c.peak_charge);
+                h[dh.size[p]].Fill(c.hits.size());
+                h[dh.pos[p]].Fill(c.position);
+            }
+            has_cluster[p] = !clusters.empty();
+        }
+
+        if(has_cluster[0]) h[dh.efficiency].Fill(0);
+        if(has_cluster[1]) h[dh.efficiency].Fill(1);
+        if(has_cluster[0] && has_cluster[1]) h[dh.efficiency].Fill(2);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// number of events processed since the last reset
+
+uint64_t OnlineGEMHistos::GetEventsProcessed() const
+{
+    uint64_t n = 0;
+    for(auto &w: workers)
+        n += w->shard.events.load(std::memory_order_relaxed);
+    return n - reset_events;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// merge all shards into plots (GUI thread)
+
+std::vector<HistoWidget::PlotData> OnlineGEMHistos::Snapshot() const
+{
+    std::vector<HistoWidget::PlotData> res;
+    uint64_t nevents = GetEventsProcessed();
+
+    std::vector<uint64_t> sum;
+    for(size_t i=0; i<defs.size(); i++)
+    {
+        const HistoDef &d = defs[i];
+        sum.assign(d.nx + 2, 0);
+        for(auto &w: workers) {
+            const Histo &h = w->shard.histos[i];
+            for(int b=0; b<d.nx+2; b++)
+                sum[b] += h.bins[b].load(std::memory_order_relaxed);
+        }
+        for(int b=0; b<d.nx+2; b++)
+            sum[b] -= std::min(sum[b], reset_bins[i][b]);
+
+        HistoWidget::PlotData plot;
+        plot.type = HistoWidget::PlotData::Plot1D;
+        plot.title = d.title;
+        plot.xTitle = d.x_title;
+        plot.yTitle = d.y_title;
+        plot.nx = d.nx;
+        plot.xMin = d.x_min;
+        plot.xMax = d.x_max;
+        plot.y.resize(d.nx);
+
+        double entries = 0, sw = 0, swx = 0, swx2 = 0;
+        double bw = (d.x_max - d.x_min) / d.nx;
+        for(int b=1; b<=d.nx; b++) {
+            double c = static_cast<double>(sum[b]);
+            double x = d.x_min + (b - 0.5) * bw;
+            sw += c; swx += c * x; swx2 += c * x * x;
+            plot.y[b-1] = (d.normalize && nevents > 0) ? c / nevents : c;
+        }
+        for(auto &c: sum)
+            entries += static_cast<double>(c);
+
+        double mean = sw > 0 ? swx / sw : 0;
+        double rms = sw > 0 ? std::sqrt(std::max(0., swx2 / sw - mean * mean)) : 0;
+
+        char buf[128];
+        std::snprintf(buf, sizeof(buf), "Entries %.0f", entries);
+        plot.stats.push_back(buf);
+        std::snprintf(buf, sizeof(buf), "Mean %.3g", mean);
+        plot.stats.push_back(buf);
+        std::snprintf(buf, sizeof(buf), "Std Dev %.3g", rms);
+        plot.stats.push_back(buf);
+
+        res.push_back(plot);
+    }
+
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// restart accumulation: remember the current contents as baseline (GUI thread)
+
+void OnlineGEMHistos::Reset()
+{
+    for(size_t i=0; i<defs.size(); i++)
+    {
+        for(int b=0; b<defs[i].nx+2; b++) {
+            uint64_t s = 0;
+            for(auto &w: workers)
+                s += w->shard.histos[i].bins[b].load(std::memory_order_relaxed);
+            reset_bins[i][b] = s;
+        }
+    }
+
+    uint64_t n = 0;
+    for(auto &w: workers)
+        n += w->shard.events.load(std::memory_order_relaxed);
+    reset_events = n;
+    reset_dropped = n_dropped.load();
+}
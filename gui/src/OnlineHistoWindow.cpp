@@ -0,0 +1,121 @@
+#include "OnlineHistoWindow.h"
+#include "OnlineGEMHistos.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QComboBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QTimer>
+
+////////////////////////////////////////////////////////////////////////////////
+// ctor
+
+OnlineHistoWindow::OnlineHistoWindow(OnlineGEMHistos *src, QWidget *parent)
+    : QWidget(parent, Qt::Window), m_source(src)
+{
+    resize(1100, 700);
+    setWindowTitle(tr("Online Histograms"));
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    QWidget *topRow = new QWidget(this);
+    QHBoxLayout *topRowLayout = new QHBoxLayout(topRow);
+    topRowLayout->setContentsMargins(0, 0, 0, 0);
+
+    m_pageCombo = new QComboBox(topRow);
+    m_pageCombo->setMinimumWidth(160);
+    m_btnReset = new QPushButton(tr("Reset"), topRow);
+    m_status = new QLabel(topRow);
+    topRowLayout->addWidget(new QLabel(tr("Page:"), topRow));
+    topRowLayout->addWidget(m_pageCombo);
+    topRowLayout->addWidget(m_btnReset);
+    topRowLayout->addStretch(1);
+    topRowLayout->addWidget(m_status);
+    layout->addWidget(topRow);
+
+    m_plotWidget = new HistoWidget(this);
+    m_plotWidget->setMinimumHeight(480);
+    layout->addWidget(m_plotWidget, 1);
+
+    m_timer = new QTimer(this);
+
+    connect(m_timer, &QTimer::timeout, this, &OnlineHistoWindow::Refresh);
+    connect(m_pageCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &OnlineHistoWindow::ShowPage);
+    connect(m_btnReset, &QPushButton::clicked, this, &OnlineHistoWindow::ResetHistos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// periodic refresh on/off
+
+void OnlineHistoWindow::StartRefresh(int ms)
+{
+    m_timer->start(ms);
+}
+
+void OnlineHistoWindow::StopRefresh()
+{
+    m_timer->stop();
+    Refresh();   // show the final state
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// merge the shards and redraw the current page
+
+void OnlineHistoWindow::Refresh()
+{
+    if(!m_source)
+        return;
+
+    m_plots = m_source->Snapshot();
+
+    m_status->setText(QString("events: %1, dropped: %2")
+            .arg(m_source->GetEventsProcessed())
+            .arg(m_source->GetEventsDropped()));
+
+    const int perPage = kPageRows * kPageCols;
+    const int nPages = (static_cast<int>(m_plots.size()) + perPage - 1) / perPage;
+    if(m_pageCombo->count() != nPages) {
+        int cur = m_pageCombo->currentIndex();
+        m_pageCombo->blockSignals(true);
+        m_pageCombo->clear();
+        for(int i = 0; i < nPages; ++i)
+            m_pageCombo->addItem(tr("Page %1").arg(i + 1));
+        m_pageCombo->setCurrentIndex(cur >= 0 && cur < nPages ? cur : 0);
+        m_pageCombo->blockSignals(false);
+    }
+
+    // only redraw while someone can see it
+    if(isVisible())
+        ShowPage(m_pageCombo->currentIndex());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// draw one page of the last snapshot
+
+void OnlineHistoWindow::ShowPage(int idx)
+{
+    if(idx < 0 || m_plots.empty()) {
+        m_plotWidget->Clear();
+        return;
+    }
+
+    const int perPage = kPageRows * kPageCols;
+    const int base = idx * perPage;
+    std::vector<HistoWidget::PlotData> page;
+    for(int i = base; i < base + perPage && i < static_cast<int>(m_plots.size()); ++i)
+        page.push_back(m_plots[i]);
+
+    m_plotWidget->DrawCanvas(page, kPageRows, kPageCols);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// restart accumulation
+
+void OnlineHistoWindow::ResetHistos()
+{
+    if(m_source)
+        m_source->Reset();
+    Refresh();
+}
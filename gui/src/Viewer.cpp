@@ -4,6 +4,9 @@
 #include "hardcode.h"
 #include "experiment_setup/PRadSetup.h"
 #include "experiment_setup/GeneralExpSetup.h"
+#include "OnlineGEMHistos.h"
+#include "OnlineHistoWindow.h"
+#include "GEMReplayEngine.h"
 #ifdef HAVE_ET
 #include "OnlineMonitor.h"
 #endif
@@ -27,10 +30,12 @@
 #include <QFormLayout>
 #include <QRadioButton>
 #include <QButtonGroup>
+#include <QProgressBar>
 
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <algorithm>
 
 //#define SHOW_APV_BY_MPD
 #define APVS_PER_TAB_X 4
@@ -59,6 +64,27 @@ Viewer::Viewer(QWidget *parent) : QMainWindow(parent)
     resize(sizeHint());
 }
 
+////////////////////////////////////////////////////////////////
+// dtor
+
+Viewer::~Viewer()
+{
+#ifdef HAVE_ET
+    // the online monitor owns a worker thread, join it before exit
+    if(pOnlineMonitor) {
+        pOnlineMonitor -> Stop();
+        delete pOnlineMonitor;
+    }
+#endif
+    // after the monitor: it feeds the histogram threads
+    delete pOnlineHistos;
+
+    // the replay workers fill the replay histograms, join them first
+    delete pReplayEngine;
+    delete winReplayHistos;
+    delete pReplayHistos;
+}
+
 ////////////////////////////////////////////////////////////////
 // load mapping file for detector setup
 
@@ -188,6 +214,7 @@ QWidget* Viewer::createTopToolbar()
     m_eventSpin = new QSpinBox(w);
     m_eventSpin -> setRange(0, 999999);
     m_eventSpin -> setValue(0);
+    UpdateEventRange();
 
     // save event button
     QPushButton *saveEvtBtn = new QPushButton(tr("Save Event"), w);
@@ -296,6 +323,14 @@ QWidget* Viewer::createRawFramesView(QWidget *w)
         QString s = QString("APV Raw Frames:") + QString::number(i);
         tabW -> addTab(w, s);
     }
+    vTabStale.assign(nTab, true);
+    m_rawFramesTab = tabW;
+
+    // only the visible tab is drawn, the others when they are shown
+    connect(tabW, &QTabWidget::currentChanged, this, [this](int i) {
+            if(i >= 0 && i < nTab && vTabStale[i])
+                DrawRawFramesTab(i);
+            });
 
     return tabW;
 }
@@ -506,8 +541,20 @@ QWidget* Viewer::createReplayPage()
     QLineEdit *clusterOut = new QLineEdit(page);
     clusterOut -> setPlaceholderText("Rootfiles/cluster_[prefix]_[run].root");
 
-    QPushButton *hitReplayBtn = new QPushButton(tr("Run Hit Replay"), page);
-    QPushButton *clusterReplayBtn = new QPushButton(tr("Run Cluster Replay"), page);
+    m_btnHitReplay = new QPushButton(tr("Run Hit Replay"), page);
+    m_btnClusterReplay = new QPushButton(tr("Run Cluster Replay"), page);
+    m_btnCancelReplay = new QPushButton(tr("Cancel Replay"), page);
+    m_btnCancelReplay -> setEnabled(false);
+
+    QSpinBox *replayThreads = new QSpinBox(page);
+    replayThreads -> setRange(1, 256);
+    replayThreads -> setValue(fReplayThreads);
+    replayThreads -> setToolTip(tr("splits replayed in parallel (hit replay always uses one)"));
+
+    m_replayProgress = new QProgressBar(page);
+    m_replayProgress -> setRange(0, 100);
+    m_replayProgress -> setValue(0);
+    m_replayProgress -> setFormat(tr("idle"));
 
     QSpinBox *splitFrom = new QSpinBox(page);
     QSpinBox *splitTo = new QSpinBox(page);
@@ -519,15 +566,22 @@ QWidget* Viewer::createReplayPage()
     form -> addRow(tr("Cluster Output"), clusterOut);
     form -> addRow(tr("File Split From"), splitFrom);
     form -> addRow(tr("File Split To"), splitTo);
-    form -> addRow(QString(), hitReplayBtn);
-    form -> addRow(QString(), clusterReplayBtn);
+    form -> addRow(tr("Replay Threads"), replayThreads);
+    form -> addRow(QString(), m_btnHitReplay);
+    form -> addRow(QString(), m_btnClusterReplay);
+    form -> addRow(QString(), m_btnCancelReplay);
+    form -> addRow(tr("Progress"), m_replayProgress);
 
     connect(hitOut, &QLineEdit::textChanged, this, &Viewer::SetRootFileOutputPath);
     //connect(clusterOut, &QLineEdit::textChanged, this, &Viewer::SetRootFileOutputPath);
     connect(splitFrom, QOverload<int>::of(&QSpinBox::valueChanged), this, &Viewer::SetFileSplitMin);
     connect(splitTo, QOverload<int>::of(&QSpinBox::valueChanged), this, &Viewer::SetFileSplitMax);
-    connect(hitReplayBtn, &QPushButton::pressed, this, &Viewer::ReplayHit);
-    connect(clusterReplayBtn, &QPushButton::pressed, this, &Viewer::ReplayCluster);
+    connect(replayThreads, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int n) {
+            fReplayThreads = n;
+            });
+    connect(m_btnHitReplay, &QPushButton::pressed, this, &Viewer::ReplayHit);
+    connect(m_btnClusterReplay, &QPushButton::pressed, this, &Viewer::ReplayCluster);
+    connect(m_btnCancelReplay, &QPushButton::pressed, this, &Viewer::CancelReplay);
 
     return page;
 }
@@ -655,6 +709,24 @@ void Viewer::SetFile([[maybe_unused]] const QString & s)
     pGEMAnalyzer -> CloseFile();
     pGEMAnalyzer -> SetFile(s.toStdString().c_str());
     pGEMAnalyzer -> Init();
+    UpdateEventRange();
+}
+
+////////////////////////////////////////////////////////////////
+// event spin box range, the whole file if it has random access
+
+void Viewer::UpdateEventRange()
+{
+    if(m_eventSpin == nullptr)
+        return;
+
+    int nmax = 999999;
+    if(pGEMAnalyzer -> IsRandomAccess() && pGEMAnalyzer -> GetNumberOfEvents() > 0) {
+        nmax = static_cast<int>(pGEMAnalyzer -> GetNumberOfEvents());
+        if(m_logEdit)
+            m_logEdit -> appendPlainText(QString("[info] %1 events in file, any event can be selected.").arg(nmax));
+    }
+    m_eventSpin -> setMaximum(nmax);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -667,10 +739,20 @@ void Viewer::InitGEMAnalyzer()
     SetCommonModeInputPath(QString::fromStdString(txt_parser.Value<std::string>("GEM Common Mode")));
 
     pGEMAnalyzer = new GEMAnalyzer();
+    pGEMAnalyzer -> SetCacheLimit(static_cast<size_t>(
+                txt_parser.Value<int>("Viewer Event Cache MB", 256, false)) * 1024 * 1024);
+    pGEMAnalyzer -> SetPrefetchDepth(txt_parser.Value<int>("Viewer Prefetch Events", 32, false));
     pGEMAnalyzer -> SetFile(fFile.c_str());
     pGEMAnalyzer -> Init();
 
     pGEMReplay = new GEMReplay();
+
+    pReplayEngine = new GEMReplayEngine();
+    pReplayEngine -> SetGEMSystem(pGEMReplay -> GetGEMSystem());
+    fReplayThreads = std::max(1, std::min(fReplayThreads, static_cast<int>(std::thread::hardware_concurrency())));
+    connect(pReplayEngine, &GEMReplayEngine::progress, this, &Viewer::ReplayProgress);
+    connect(pReplayEngine, &GEMReplayEngine::splitFinished, this, &Viewer::ReplaySplitFinished);
+    connect(pReplayEngine, &GEMReplayEngine::finished, this, &Viewer::ReplayFinished);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -695,7 +777,8 @@ void Viewer::ToggleOnline([[maybe_unused]] bool on)
     if(on)
     {
         // load connection parameters from config/online.conf (if present).
-        // Format: one "key value" per line; keys: et_file host port station poll_ms
+        // Format: one "key value" per line;
+        // keys: et_file host port station poll_ms batch analysis_threads
         {
             std::ifstream fin("config/online.conf");
             std::string key;
@@ -706,6 +789,8 @@ void Viewer::ToggleOnline([[maybe_unused]] bool on)
                 else if(key == "port")    fin >> fOnlinePort;
                 else if(key == "station") fin >> fOnlineStation;
                 else if(key == "poll_ms") fin >> fOnlinePollMs;
+                else if(key == "batch")   fin >> fOnlineBatch;
+                else if(key == "analysis_threads") fin >> fOnlineAnaThreads;
                 else { std::string skip; std::getline(fin, skip); }
             }
         }
@@ -724,33 +809,69 @@ void Viewer::ToggleOnline([[maybe_unused]] bool on)
             .arg(fOnlinePort)
             .arg(QString::fromStdString(fOnlineStation));
         m_logEdit -> appendPlainText(msg);
-        QCoreApplication::processEvents();
 
-        if(!pOnlineMonitor->Connect(fOnlineEtFile, fOnlineHost, fOnlinePort, fOnlineStation))
+        // run-level histograms: every decoded event is handed to the
+        // analysis threads from the monitor's worker thread
+        if(fOnlineAnaThreads > 0)
         {
-            m_logEdit -> appendPlainText("[error] failed to connect to ET system. Staying offline.");
-            // revert to Offline without recursing into a real stop
-            if(m_cbOffline) {
-                m_cbOffline -> blockSignals(true);
-                m_cbOffline -> setChecked(true);
-                m_cbOffline -> blockSignals(false);
+            if(pOnlineHistos && pOnlineHistos -> GetNumberOfThreads() != fOnlineAnaThreads) {
+                delete winOnlineHistos;
+                winOnlineHistos = nullptr;
+                delete pOnlineHistos;
+                pOnlineHistos = nullptr;
             }
-            return;
+            if(!pOnlineHistos)
+                pOnlineHistos = new OnlineGEMHistos(fOnlineAnaThreads);
+            pOnlineHistos -> Init(*(pGEMReplay -> GetGEMSystem()),
+                    fPedestalInputPath, fCommonModeInputPath);
+            pOnlineHistos -> Start();
+
+            OnlineGEMHistos *histos = pOnlineHistos;
+            pOnlineMonitor -> SetEventHandler([histos](
+                        const online_monitor::OnlineMonitor::APVDataMap &data,
+                        const online_monitor::OnlineMonitor::APVFlagMap &flags) {
+                    histos -> Feed(data, flags);
+                    });
+
+            if(!winOnlineHistos)
+                winOnlineHistos = new OnlineHistoWindow(pOnlineHistos, this);
+            winOnlineHistos -> show();
+            winOnlineHistos -> StartRefresh(1000);
         }
+        else
+            pOnlineMonitor -> SetEventHandler(nullptr);
+
+        // ET attachment, event transfer and decoding all run on the
+        // monitor's worker thread; the timer below only samples the
+        // latest decoded event, the connection result is picked up there
+        pOnlineMonitor -> Start(fOnlineEtFile, fOnlineHost, fOnlinePort, fOnlineStation,
+                fOnlineBatch);
 
         online_mode = true;
+        online_connected = false;
+        m_eventSpin -> setMaximum(999999);   // online events are counted, not indexed
         online_timer -> start(fOnlinePollMs);
         m_btnPause   -> setEnabled(true);
         m_btnPrevEvt -> setEnabled(true);
-        m_logEdit -> appendPlainText("[info] online monitoring started.");
     }
     else
     {
         if(online_timer)
             online_timer -> stop();
-        if(pOnlineMonitor)
-            pOnlineMonitor -> Disconnect();
+        if(pOnlineMonitor) {
+            pOnlineMonitor -> Stop();
+            if(online_connected)
+                m_logEdit -> appendPlainText(QString("[info] ET events decoded: %1, displayed: %2")
+                        .arg(pOnlineMonitor -> GetEventsReceived())
+                        .arg(pOnlineMonitor -> GetEventsSampled()));
+        }
+        if(pOnlineHistos)
+            pOnlineHistos -> Stop();
+        if(winOnlineHistos)
+            winOnlineHistos -> StopRefresh();
         online_mode = false;
+        online_connected = false;
+        UpdateEventRange();
         // reset playback controls (blockSignals: un-checking Pause must not
         // restart the stopped timer)
         if(m_btnPause) {
@@ -767,15 +888,39 @@ void Viewer::ToggleOnline([[maybe_unused]] bool on)
 }
 
 ////////////////////////////////////////////////////////////////
-// online (ET) monitoring: timer tick -- pull and draw one event
+// online (ET) monitoring: timer tick -- sample and draw the latest event
 
 void Viewer::PollOnlineEvent()
 {
 #ifdef HAVE_ET
     if(!online_mode)
         return;
+
+    switch(pOnlineMonitor -> GetState())
+    {
+        case online_monitor::OnlineMonitor::State::Connecting:
+            return;                             // still attaching
+        case online_monitor::OnlineMonitor::State::Running:
+            if(!online_connected) {
+                online_connected = true;
+                m_logEdit -> appendPlainText("[info] online monitoring started.");
+            }
+            break;
+        default:
+            m_logEdit -> appendPlainText(online_connected ?
+                    "[error] lost connection to ET system. Going offline." :
+                    "[error] failed to connect to ET system. Staying offline.");
+            // revert to Offline; unchecking Online stops the feed through
+            // ToggleOnline(false)
+            if(m_cbOffline)
+                m_cbOffline -> setChecked(true);
+            else
+                ToggleOnline(false);
+            return;
+    }
+
     // Always advance the counter so DrawGEMRawHistos takes its "forward"
-    // branch, which is where the ET event is actually pulled. This reuses
+    // branch, which is where the decoded ET event is sampled. This reuses
     // the entire offline draw + cache path unchanged; the spinbox can still
     // scroll back through recently received online events.
     online_event_counter++;
@@ -792,11 +937,14 @@ void Viewer::PollOnlineEvent()
 
 void Viewer::DrawGEMRawHistos(int num)
 {
-    std::map<APVAddress, std::vector<int>> mData;
-    std::map<APVAddress, APVDataType> mDataFlags;
+    // random access file: any event is fetched from the analyzer, which
+    // keeps its own cache, the viewer only keeps the event on display
+    bool fetch = (num > event_number_checked);
+    if(!online_mode && pGEMAnalyzer -> IsRandomAccess() && num != current_event_number)
+        fetch = true;
 
     // event number increased - forward
-    if(num > event_number_checked)
+    if(fetch)
     {
         // Fetch the next event's decoded APV maps. Offline pulls from the
         // EVIO file via GEMAnalyzer; online pulls from the live ET feed via
@@ -822,22 +970,9 @@ void Viewer::DrawGEMRawHistos(int num)
         }
         if(_pData->size() <= 0) return;
 
-        // sort raw histos
-        for(auto &i: *_pData)
-            mData[i.first] = i.second;
-        // sort flags
-        for(auto &i: *_pFlags)
-            mDataFlags[i.first] = i.second;
-
+        CacheEvent(*_pData, *_pFlags);
         event_number_checked = num;
         current_event_number = num;
-        event_cache.push_back(mData);
-        event_flag_cache.push_back(mDataFlags);
-        if(event_cache.size() > max_cache_events)
-        {
-            event_cache.pop_front();
-            event_flag_cache.pop_front();
-        }
     }
     // event number decreased - backward
     else if(num < event_number_checked) 
@@ -846,77 +981,141 @@ void Viewer::DrawGEMRawHistos(int num)
         if(index >= event_cache.size())
                 return;
 
-        size_t pos = event_cache.size() - index - 1;
         current_event_number = num;
-
-        mData = event_cache.at(pos);
     }
     else
     {
         if(event_cache.size() <= 0) return;
-        mData = event_cache.back();
     }
 
+    const CachedEvent *event = GetCachedEvent(current_event_number);
+    if(event == nullptr)
+        return;
+
     // print a log 
     std::string ss("[info] total number of APVs in event #");
-    ss = ss + std::to_string(m_eventSpin->value()) + " : " + std::to_string(mData.size());
+    ss = ss + std::to_string(m_eventSpin->value()) + " : " + std::to_string(event->addr.size());
     m_logEdit -> appendPlainText(ss.c_str());
 
-    std::vector<std::vector<std::vector<int>>> vH(nTab);
-    std::vector<std::vector<APVAddress>> vAddr(nTab);
-#ifdef SHOW_APV_BY_MPD
-    // dispath by mpd id
-    // a helper
-    auto find_index = [&](const MPDAddress &addr) -> int 
+    // draw the visible tab now, the others when they are shown
+    vTabStale.assign(nTab, true);
+    if(m_rawFramesTab && m_rawFramesTab -> currentIndex() >= 0)
+        DrawRawFramesTab(m_rawFramesTab -> currentIndex());
+}
+
+////////////////////////////////////////////////////////////////
+// draw one tab of apv raw frames for the current event
+
+void Viewer::DrawRawFramesTab(int t)
+{
+    if(t < 0 || t >= nTab)
+        return;
+
+    const CachedEvent *event = GetCachedEvent(current_event_number);
+    if(event == nullptr)
+        return;
+
+    // frames are drawn straight from the cached buffer
+    std::vector<std::pair<const int*, size_t>> vH;
+    std::vector<APVAddress> vAddr;
+    for(size_t i=0; i<event->addr.size(); i++)
     {
-        auto &vMPDAddr = apv_strip_mapping::Mapping::Instance()->GetMPDAddressVec();
-        int res = 0;
-        for(auto &i: vMPDAddr) {
-            if(i == addr)
-                return res;
-            res++;
-        }
-        return -1;
-    };
-    for(auto &i: mData) {
-        MPDAddress mpd_addr(i.first.crate_id, i.first.mpd_id);
-        int index = find_index(mpd_addr);
-        if(index >= 0 && index < nTab) {
-            vH[index].push_back(i.second);
-            vAddr[index].push_back(i.first);
-        }
+        if(event->tab[i] != t)
+            continue;
+        vH.emplace_back(event->adc.data() + event->offset[i],
+                event->offset[i+1] - event->offset[i]);
+        vAddr.push_back(event->addr[i]);
+    }
+
+    vTabCanvas[t] -> Clear();
+    vTabCanvas[t] -> DrawCanvas(vH, vAddr, APVS_PER_TAB_X, APVS_PER_TAB_Y);
+    vTabCanvas[t] -> Refresh();
+    vTabStale[t] = false;
+}
+
+////////////////////////////////////////////////////////////////
+// pack a decoded event into the cache, the oldest cached event
+// is recycled once the cache is full
+
+void Viewer::CacheEvent(const std::unordered_map<APVAddress, std::vector<int>> &data,
+        const std::unordered_map<APVAddress, APVDataType> &flags)
+{
+    size_t max_events = (!online_mode && pGEMAnalyzer -> IsRandomAccess()) ? 1 : max_cache_events;
+
+    CachedEvent event;
+    while(!event_cache.empty() && event_cache.size() >= max_events) {
+        event = std::move(event_cache.front());
+        event_cache.pop_front();
+    }
+
+    event.addr.clear();
+    for(auto &i: data)
+        event.addr.push_back(i.first);
+    std::sort(event.addr.begin(), event.addr.end());
+
+    size_t napv = event.addr.size();
+    event.flags.resize(napv);
+    event.offset.resize(napv + 1);
+    event.tab.resize(napv);
+    event.adc.clear();
+
+    for(size_t i=0; i<napv; i++)
+    {
+        const std::vector<int> &frame = data.at(event.addr[i]);
+        event.offset[i] = event.adc.size();
+        event.adc.insert(event.adc.end(), frame.begin(), frame.end());
+
+        auto it = flags.find(event.addr[i]);
+        event.flags[i] = (it != flags.end()) ? it->second : APVDataType();
+    }
+    event.offset[napv] = event.adc.size();
+
+    // dispatch apvs to tabs
+#ifdef SHOW_APV_BY_MPD
+    // by mpd id
+    auto &vMPDAddr = apv_strip_mapping::Mapping::Instance()->GetMPDAddressVec();
+    for(size_t i=0; i<napv; i++) {
+        MPDAddress mpd_addr(event.addr[i].crate_id, event.addr[i].mpd_id);
+        auto it = std::find(vMPDAddr.begin(), vMPDAddr.end(), mpd_addr);
+        int index = (it == vMPDAddr.end()) ? -1 : static_cast<int>(it - vMPDAddr.begin());
+        event.tab[i] = (index < nTab) ? index : -1;
     }
 #else
-    // dispatch by APV counts
-    int apv_count = 0;
+    // by APV counts
     int napvs_per_tab = APVS_PER_TAB_X * APVS_PER_TAB_Y;
-    for(auto &i: mData) {
-        int index = apv_count / napvs_per_tab;
+    bool overflow = false;
+    for(size_t i=0; i<napv; i++) {
+        int index = static_cast<int>(i) / napvs_per_tab;
         if(index >= nTab) {
-            m_logEdit -> appendPlainText("[error]: number of APVs in data exceeded the maximum allowed in mapping file.");
-            m_logEdit -> appendPlainText("[error]:        ------- mapping file is wrong.");
-            continue;
+            index = -1;
+            overflow = true;
         }
-        vH[index].push_back(i.second);
-        vAddr[index].push_back(i.first);
-        apv_count++;
+        event.tab[i] = index;
+    }
+    if(overflow) {
+        m_logEdit -> appendPlainText("[error]: number of APVs in data exceeded the maximum allowed in mapping file.");
+        m_logEdit -> appendPlainText("[error]:        ------- mapping file is wrong.");
     }
 #endif
 
-    // draw tab main canvas
-    for(int i=0;i<nTab;i++) 
-    {
-        vTabCanvas[i] -> Clear();
-        vTabCanvas[i] -> DrawCanvas(vH[i], vAddr[i], APVS_PER_TAB_X, APVS_PER_TAB_Y);
-        vTabCanvas[i] -> Refresh();
-    }
+    event_cache.push_back(std::move(event));
+}
+
+////////////////////////////////////////////////////////////////
+// cached event for an event number, nullptr if it is not cached
+
+const Viewer::CachedEvent *Viewer::GetCachedEvent(int num) const
+{
+    if(event_cache.empty())
+        return nullptr;
+
+    if(num >= event_number_checked)
+        return &event_cache.back();
 
-    // draw right-side canvas
-    std::vector<std::vector<int>> temp;
-    std::vector<APVAddress> temp_addr;
-    temp.push_back(mData.begin()->second);
-    temp_addr.push_back(mData.begin()->first);
-    //pRightCanvas->DrawCanvas(temp, temp_addr, 1, 1);
+    size_t index = event_number_checked - num;
+    if(index >= event_cache.size())
+        return nullptr;
+    return &event_cache.at(event_cache.size() - index - 1);
 }
 
 
@@ -931,36 +1130,16 @@ void Viewer::DrawGEMOnlineHits(int num)
                     + QString::fromStdString(fPedestalInputPath) + QString(" and ")
                     + QString::fromStdString(fCommonModeInputPath);
         m_logEdit -> appendPlainText(s);
-        pGEMReplay -> GetGEMSystem() -> ReadPedestalFile(fPedestalInputPath, fCommonModeInputPath);
+        if(!pGEMReplay -> GetGEMSystem() -> ReadPedestalFile(fPedestalInputPath, fCommonModeInputPath,
+                    InfoCenter::Instance() -> ParseRunNumber(fFile)))
+            m_logEdit -> appendPlainText("[error] pedestal not loaded, it is not valid for this run");
         reload_pedestal_for_online = false;
     }
 
-    if(event_cache.size() <= 0)
-        return;
-
     // get raw data
-    std::map<APVAddress, std::vector<int>> event_data;
-    std::map<APVAddress, APVDataType> event_data_flag;
-    if( num > event_number_checked)
-    {
-        event_data = event_cache.back();
-        event_data_flag = event_flag_cache.back();
-    }
-    else if( num < event_number_checked)
-    {
-        size_t index = event_number_checked - num;
-        if(index >= event_cache.size())
-            return;
-        size_t pos = event_cache.size() - index - 1;
-        event_data = event_cache.at(pos);
-        event_data_flag = event_flag_cache.at(pos);
-    }
-    else
-    {
-        if(event_cache.size() <= 0) return;
-        event_data = event_cache.back();
-        event_data_flag = event_flag_cache.back();
-    }
+    const CachedEvent *event = GetCachedEvent(num);
+    if(event == nullptr)
+        return;
 
     // online zero suppression
     // also collect the non-zero-suppressed (offset + common-mode subtracted,
@@ -977,13 +1156,15 @@ void Viewer::DrawGEMOnlineHits(int num)
         dst.insert(dst.end(), nzs.begin(), nzs.end());
     };
 
-    for(auto &i: event_data)
+    std::vector<int> frame;
+    for(size_t i=0; i<event->addr.size(); i++)
     {
-        GEMAPV *apv = pGEMReplay -> GetGEMSystem() -> GetAPV(i.first);
+        const APVAddress &addr = event->addr[i];
+        GEMAPV *apv = pGEMReplay -> GetGEMSystem() -> GetAPV(addr);
 
         if( apv == nullptr)
         {
-            std::cout<<__func__<<": Warning: apv "<<i.first<<" not initilized"
+            std::cout<<__func__<<": Warning: apv "<<addr<<" not initilized"
                 <<std::endl
                 <<"            make sure mapping file is correct."
                 <<std::endl
@@ -992,25 +1173,25 @@ void Viewer::DrawGEMOnlineHits(int num)
             continue;
         }
 
+        frame.assign(event->adc.begin() + event->offset[i],
+                event->adc.begin() + event->offset[i+1]);
 #ifdef USE_SRS
-        apv -> FillRawDataSRS(i.second);
+        apv -> FillRawDataSRS(frame);
 #else
-        auto flag_it = event_data_flag.find(i.first);
-        APVDataType flags = (flag_it != event_data_flag.end())
-            ? flag_it->second : APVDataType();
-        apv -> FillRawDataMPD(i.second, flags);
+        const APVDataType &flags = event->flags[i];
+        apv -> FillRawDataMPD(frame, flags);
 #endif
         apv -> ZeroSuppression();
         apv -> CollectZeroSupHits();
         collect_nzs(apv);
 
         // fill ghost apv data
-        GEMAPV *ghost_apv = pGEMReplay -> GetGEMSystem() -> GetGhostAPV(i.first);
+        GEMAPV *ghost_apv = pGEMReplay -> GetGEMSystem() -> GetGhostAPV(addr);
         if( ghost_apv != nullptr) {
 #ifdef USE_SRS
-            ghost_apv -> FillRawDataSRS(i.second);
+            ghost_apv -> FillRawDataSRS(frame);
 #else
-            ghost_apv -> FillRawDataMPD(i.second, flags);
+            ghost_apv -> FillRawDataMPD(frame, flags);
 #endif
             ghost_apv -> ZeroSuppression();
             ghost_apv -> CollectZeroSupHits();
@@ -1248,26 +1429,15 @@ void Viewer::SaveCurrentEvent()
     std::string file_name = "./Rootfiles/event_" +
         std::to_string(current_event_number) + ".txt";
 
-    std::map<APVAddress, std::vector<int>> _event;
-    if(current_event_number == event_number_checked)
-    {
-        _event = event_cache.back();
-    }
-    else
-    {
-        size_t index = event_number_checked - current_event_number;
-        if(index >= event_cache.size())
-                return;
-        size_t pos = event_cache.size() - index - 1;
-
-        _event = event_cache.at(pos);
-    }
+    const CachedEvent *event = GetCachedEvent(current_event_number);
+    if(event == nullptr)
+        return;
 
     std::fstream f(file_name.c_str(), std::fstream::out);
-    for(auto &i: _event) {
-        f<<"apv:"<<i.first;
-        for(auto &j: i.second)
-            f<<j<<std::endl;
+    for(size_t i=0; i<event->addr.size(); i++) {
+        f<<"apv:"<<event->addr[i];
+        for(size_t j=event->offset[i]; j<event->offset[i+1]; j++)
+            f<<event->adc[j]<<std::endl;
     }
 
     m_logEdit -> appendPlainText("[info] event saved to: " + QString::fromStdString(file_name));
@@ -1308,6 +1478,8 @@ void Viewer::OpenFile()
     // reset event counter to 0
     m_eventSpin -> setValue(0);
     event_number_checked = 0;
+    current_event_number = 0;
+    event_cache.clear();
 
     // update pedstal output path
     ParsePedestalsOutputPathFromEvioFile();
@@ -1542,80 +1714,137 @@ void Viewer::PlotPedestal()
 
 void Viewer::ReplayHit()
 {
-    QMessageBox::StandardButton reply = QMessageBox::information(
-            this,
-            tr("GEM Data Viewer"),
-            tr("Replay files usually takes a while... \
-                \nPress Yes to start..."),
-            QMessageBox::No | QMessageBox::Yes );
-    if(reply != QMessageBox::Yes)
+    StartReplay(false);
+}
+
+
+////////////////////////////////////////////////////////////////
+// replay cluster
+
+void Viewer::ReplayCluster()
+{
+    StartReplay(true);
+}
+
+////////////////////////////////////////////////////////////////
+// start a replay on the worker threads, the gui stays responsive
+
+void Viewer::StartReplay(bool cluster)
+{
+    if(pReplayEngine -> IsRunning()) {
+        m_logEdit -> appendPlainText("[warning] a replay is already running.");
         return;
+    }
 
-    m_logEdit -> appendPlainText("[info] Replaying for file: ");
-    m_logEdit -> appendPlainText(fFile.c_str());
-    m_logEdit -> appendPlainText("[info] this might take a while...");
-    QCoreApplication::processEvents();
+    m_logEdit -> appendPlainText(QString("[info] %1 replay for file: %2")
+            .arg(cluster ? "cluster" : "hit").arg(fFile.c_str()));
 
-    pGEMReplay -> SetInputFile(fFile);
-    pGEMReplay -> SetPedestalOutputFile(fPedestalOutputPath);
-    pGEMReplay -> SetPedestalInputFile(fPedestalInputPath, fCommonModeInputPath);
-    pGEMReplay -> SetCommonModeOutputFile(fCommonModeOutputPath);
-    //pGEMReplay -> SetOutputFile(fRootFileSavePath); // now code automatically deduct output path
-    pGEMReplay -> SetSplitMax(fFileSplitEnd);
-    pGEMReplay -> SetSplitMin(fFileSplitStart);
+    pReplayEngine -> SetInputFile(fFile);
+    pReplayEngine -> SetPedestalInputFile(fPedestalInputPath, fCommonModeInputPath);
+    pReplayEngine -> SetSplitRange(fFileSplitStart, fFileSplitEnd);
+    pReplayEngine -> SetNumberOfThreads(fReplayThreads);
 
-    std::thread th([&]() {
-            pGEMReplay -> ReplayHit();
-            }
-            );
+    // cluster replay fills run-level histograms, one shard per thread
+    if(cluster)
+    {
+        if(pReplayHistos && pReplayHistos -> GetNumberOfThreads() != fReplayThreads) {
+            delete winReplayHistos;
+            winReplayHistos = nullptr;
+            delete pReplayHistos;
+            pReplayHistos = nullptr;
+        }
+        if(!pReplayHistos)
+            pReplayHistos = new OnlineGEMHistos(fReplayThreads);
+        pReplayHistos -> Init(*(pGEMReplay -> GetGEMSystem()),
+                fPedestalInputPath, fCommonModeInputPath);
+
+        if(!winReplayHistos) {
+            winReplayHistos = new OnlineHistoWindow(pReplayHistos, this);
+            winReplayHistos -> setWindowTitle(tr("Replay Histograms"));
+        }
+        winReplayHistos -> Refresh();
+        winReplayHistos -> show();
 
-    th.join();
+        pReplayEngine -> SetHistos(pReplayHistos);
+    }
+    else
+        pReplayEngine -> SetHistos(nullptr);
 
-    QMessageBox::information(
-            this,
-            tr("GEM Data Viewer"),
-            tr("Replay Done!") );
-}
+    if(!pReplayEngine -> Start(cluster ? GEMReplayEngine::Mode::Cluster : GEMReplayEngine::Mode::Hit)) {
+        m_logEdit -> appendPlainText("[error] replay failed to start, check the input file.");
+        return;
+    }
 
+    m_btnHitReplay -> setEnabled(false);
+    m_btnClusterReplay -> setEnabled(false);
+    m_btnCancelReplay -> setEnabled(true);
+    m_replayProgress -> setValue(0);
+    m_replayProgress -> setFormat(tr("starting..."));
+}
 
 ////////////////////////////////////////////////////////////////
-// replay cluster
+// cancel the running replay, workers stop after their current event
 
-void Viewer::ReplayCluster()
+void Viewer::CancelReplay()
 {
-    QMessageBox::StandardButton reply = QMessageBox::information(
-            this,
-            tr("GEM Data Viewer"),
-            tr("Replay files usually takes a while... \
-                \nPress Yes to start..."),
-            QMessageBox::No | QMessageBox::Yes );
-    if(reply != QMessageBox::Yes)
+    if(!pReplayEngine -> IsRunning())
         return;
 
-    m_logEdit -> appendPlainText("[info] Replaying for file: ");
-    m_logEdit -> appendPlainText(fFile.c_str());
-    m_logEdit -> appendPlainText("[info] this might take a while...");
-    QCoreApplication::processEvents();
+    pReplayEngine -> Cancel();
+    m_btnCancelReplay -> setEnabled(false);
+    m_logEdit -> appendPlainText("[info] cancelling replay...");
+}
 
-    pGEMReplay -> SetInputFile(fFile);
-    pGEMReplay -> SetPedestalOutputFile(fPedestalOutputPath);
-    pGEMReplay -> SetPedestalInputFile(fPedestalInputPath, fCommonModeInputPath);
-    pGEMReplay -> SetCommonModeOutputFile(fCommonModeOutputPath);
-    //pGEMReplay -> SetOutputFile(fRootFileSavePath); // now code automatically deduct output path
-    pGEMReplay -> SetSplitMax(fFileSplitEnd);
-    pGEMReplay -> SetSplitMin(fFileSplitStart);
+////////////////////////////////////////////////////////////////
+// replay progress, from the engine timer
 
-    std::thread th([&]() {
-            pGEMReplay -> ReplayCluster();
-            }
-            );
+void Viewer::ReplayProgress(qint64 events, double events_per_s, double eta_s,
+        int splits_done, int splits_total)
+{
+    QString eta = (eta_s < 0) ? QString("--") :
+        QString("%1:%2").arg(static_cast<int>(eta_s) / 60).arg(static_cast<int>(eta_s) % 60, 2, 10, QChar('0'));
+
+    // the bar follows the data volume, that is what the eta is based on
+    double fraction = 0.;
+    if(eta_s >= 0) {
+        double elapsed = events_per_s > 0 ? events / events_per_s : 0.;
+        fraction = (elapsed + eta_s) > 0 ? elapsed / (elapsed + eta_s) : 1.;
+    }
+    m_replayProgress -> setValue(static_cast<int>(100. * fraction));
+    m_replayProgress -> setFormat(QString("%1 events, %2 ev/s, ETA %3, splits %4/%5")
+            .arg(events).arg(events_per_s, 0, 'f', 0).arg(eta).arg(splits_done).arg(splits_total));
+}
 
-    th.join();
+////////////////////////////////////////////////////////////////
+// one split done, show the results so far
 
-    QMessageBox::information(
-            this,
-            tr("GEM Data Viewer"),
-            tr("Replay Done!") );
+void Viewer::ReplaySplitFinished(int split, const QString &output_file, qint64 events)
+{
+    m_logEdit -> appendPlainText(QString("[info] split %1: %2 events -> %3")
+            .arg(split).arg(events).arg(output_file));
+
+    if(winReplayHistos && winReplayHistos -> isVisible())
+        winReplayHistos -> Refresh();
+}
+
+////////////////////////////////////////////////////////////////
+// replay done or cancelled
+
+void Viewer::ReplayFinished(bool cancelled, qint64 events, double seconds)
+{
+    m_btnHitReplay -> setEnabled(true);
+    m_btnClusterReplay -> setEnabled(true);
+    m_btnCancelReplay -> setEnabled(false);
+
+    if(winReplayHistos && winReplayHistos -> isVisible())
+        winReplayHistos -> Refresh();
+
+    QString msg = QString("%1 %2 events in %3 s (%4 ev/s)")
+        .arg(cancelled ? "Replay cancelled after" : "Replay done:")
+        .arg(events).arg(seconds, 0, 'f', 1).arg(seconds > 0 ? events / seconds : 0., 0, 'f', 0);
+    m_replayProgress -> setValue(cancelled ? m_replayProgress -> value() : 100);
+    m_replayProgress -> setFormat(msg);
+    m_logEdit -> appendPlainText("[info] " + msg);
 }
 
 void Viewer::OpenOnlineAnalysisInterface()
@@ -0,0 +1,84 @@
+#!/opt/homebrew/bin/python3
+
+# writes the pede.py result that alignment/test.cpp --millepede --validate
+# compares the C++ fit (alignment/millepede_align.cpp) with:
+#
+#     python3 pede_reference.py ../alignment/millepede_tracks.txt ../alignment/millepede_reference.txt
+#
+# with --generate, the track sample is generated first (the ToyModel
+# geometry, 5 layers, fixed seed)
+#
+# pede.py runs with its defaults (step size, momentum, regularization,
+# fixed layer 0) except: one batch of all tracks per iteration, a direct
+# solve ("lin") and double precision, so the reference is not limited by
+# the iterative solver or float rounding
+
+import sys
+import torch
+import numpy as np
+
+torch.set_default_dtype(torch.float64)
+
+from core import pede
+from core.text_parser import track_parser
+
+NITER = 20
+
+def generate(path, ntracks = 200, seed = 1234):
+    z = [3.0, 13.0, 63.0, 73.0, 103.0]
+    dx = [0.0, 1.0, -0.5, -2.0, -1.0]
+    dy = [0.0, -2.0, 1.0, 0.5, 1.0]
+    az = [0.0, 0.002, -0.001, 0.0, 0.001]
+    resolution = 0.08
+
+    rng = np.random.default_rng(seed)
+    with open(path, 'w') as f:
+        for _ in range(ntracks):
+            kx, ky = rng.uniform(-0.15, 0.15, 2)
+            bx, by = rng.uniform(-50., 50., 2)
+            hits = []
+            for i in range(len(z)):
+                x = bx + kx*z[i] + rng.normal(0., resolution)
+                y = by + ky*z[i] + rng.normal(0., resolution)
+                # rotate around the beam axis, then shift
+                hits.append((x - az[i]*y + dx[i], az[i]*x + y + dy[i], z[i]))
+            f.write(" ".join("{:.6f} {:.6f} {:.6f}".format(*h) for h in hits) + "\n")
+
+def main():
+    args = [a for a in sys.argv[1:] if a != "--generate"]
+    if len(args) != 2:
+        print("usage: pede_reference.py tracks.txt reference.txt [--generate]")
+        return 1
+    track_file, ref_file = args
+    if "--generate" in sys.argv:
+        generate(track_file)
+
+    tracks = track_parser(track_file).tracks
+    pede.N_on_T = len(tracks[0])
+    pede.nBatch = len(tracks)
+    pede.method = "lin"
+    pede.total_tracks = tracks
+    pede.global_params = torch.zeros(pede.N_on_T, 6)
+    pede.global_params_delta = torch.zeros(pede.N_on_T, 6)
+    pede.global_params_delta_prev = torch.zeros(pede.N_on_T, 6)
+
+    ndf = len(tracks) * (2*pede.N_on_T - 4)
+    chi2 = [pede.one_iteration(0, pede.nBatch) / ndf for _ in range(NITER)]
+
+    # one_iteration applies its correction at the start of the next call
+    params = (pede.global_params - pede.global_params_delta).numpy()
+
+    with open(ref_file, 'w') as f:
+        f.write("# pede.py reference for {}: {} tracks, {} iterations over all tracks,\n"
+                .format(track_file.split("/")[-1], len(tracks), NITER))
+        f.write("# step size {}, momentum {}, regularization {}, fixed layer {}\n"
+                .format(pede.step_size, pede.eta if pede.USE_MOMENTUM else 0,
+                        pede.regularization_lambda, pede.iFixLayerIndex))
+        for i, c in enumerate(chi2):
+            f.write("chi2/ndf {} {:.12e}\n".format(i, c))
+        for l, row in enumerate(params):
+            f.write("layer {} ".format(l) + " ".join("{:.12e}".format(v) for v in row) + "\n")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
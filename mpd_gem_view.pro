@@ -1,14 +1,27 @@
 TEMPLATE = subdirs
 
-SUBDIRS = decoder gem epics gui tracking_dev tracking_dev_app replay alignment
+SUBDIRS = decoder gem epics gui tracking_dev tracking_dev_app replay alignment benchmark microbench \
+          epics_test fadc_analyzer_test fadc_decoder_test decoder_parser_test \
+          gem_pedestal_db_test
 
 decoder.file             = decoder/decoder.pro
 
+decoder_parser_test.file = decoder/parser_test.pro
+
 epics.file               = epics/epics.pro
 
+epics_test.file          = epics/epics_test.pro
+epics_test.depends       = epics
+
+fadc_analyzer_test.file  = fadc/analyzer_test.pro
+
+fadc_decoder_test.file   = fadc/decoder_test.pro
+
 gem.file                 = gem/gem.pro
 gem.depends              = decoder
 
+gem_pedestal_db_test.file = gem/pedestal_db_test.pro
+
 gui.file                 = gui/gui.pro
 gui.depends              = decoder gem epics
 
@@ -34,3 +47,9 @@ replay.depends           = decoder gem tracking_dev
 
 alignment.file           = alignment/alignment.pro
 alignment.depends        = decoder gem tracking_dev
+
+benchmark.file           = benchmark/benchmark.pro
+benchmark.depends        = decoder gem tracking_dev
+
+microbench.file          = benchmark/microbench.pro
+microbench.depends       = decoder gem tracking_dev epics
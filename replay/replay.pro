@@ -37,6 +37,10 @@ INCLUDEPATH += ../tracking_dev/include
 # tracking lib
 LIBS += -L../tracking_dev/lib -ltracking_dev
 
+######################################################################
+# fadc headers, the decoder and analyzer are built in (fadc has no library)
+INCLUDEPATH += ../fadc/include
+
 ######################################################################
 # root headers
 INCLUDEPATH += $$system(root-config --incdir)
@@ -70,4 +74,6 @@ HEADERS += src/generate_gem_histos.h \
 
 # source path
 SOURCES += src/main.cpp \
+           ../fadc/src/Fadc250Decoder.cpp \
+           ../fadc/src/WfAnalyzer.cpp \
 
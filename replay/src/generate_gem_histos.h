@@ -14,6 +14,10 @@
 #include "Cuts.h"
 #include <vector>
 #include <utility>
+#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <TFile.h>
 #include <TH1F.h>
 #include <TH2F.h>
@@ -33,11 +37,53 @@ namespace quality_check_histos
 
     static int NDetector_Implemented = 0;
 
+    // raw histograms are filled into per-thread shards of plain array
+    // accumulators (same binning as histo.conf), so replay threads never
+    // contend on a fill. The shards are merged into histM in save_histos().
+    typedef histos::Handle<histos::BinnedHisto1D, histos::HistoShard<>> shard_h1;
+    typedef histos::Handle<histos::BinnedHisto2D, histos::HistoShard<>> shard_h2;
+
+    // pre-resolved handles of the raw histograms, so the per strip loops
+    // neither format names nor search a map
+    struct raw_plane_handles
+    {
+        shard_h1 fired_strip;
+        shard_h1 strip_maxtimebin, strip_adc, strip_mean_time;
+        shard_h2 strip_adc_index;
+        shard_h1 cluster_multiplicity, cluster_adc, cluster_size, cluster_pos;
+    };
+    struct raw_det_handles
+    {
+        raw_plane_handles plane[2]; // x, y
+        shard_h2 charge_correlation, size_correlation;
+        shard_h2 seed_time_correlation, pos_correlation;
+    };
+
+    // one per filling thread
+    struct raw_fill_context
+    {
+        raw_fill_context() : shard(&histM) {}
+
+        histos::HistoShard<> shard;
+        shard_h1 h_event_number;
+        shard_h2 h_fired_strip_plane[2], h_occupancy_plane[2];
+        std::unordered_map<int, raw_det_handles> handles; // key: det module id
+
+        // reused between events, so filling does not allocate
+        std::vector<double> b_timebin, b_adc, b_mean_time, b_strip;
+        std::vector<const StripCluster*> x_clusters, y_clusters;
+    };
+    static std::mutex raw_contexts_mtx;
+    static std::vector<std::unique_ptr<raw_fill_context>> raw_contexts;
+
     // 
     void pass_handles(GEMSystem *sys, tracking_dev::TrackingDataHandler *handle);
     void set_output_name(std::string name);
     void fill_gem_histos(int event_number);
-    void raw_histos(int event_number);
+    void raw_histos(int event_number, GEMSystem *sys = nullptr);
+    raw_fill_context &local_raw_context();
+    raw_det_handles &get_raw_handles(raw_fill_context &ctx, int det_module_id);
+    void merge_raw_histos();
     void tracking_histos();
     void generate_tracking_based_2d_efficiency_plots();
     void save_histos();
@@ -77,6 +123,7 @@ namespace quality_check_histos
         fDet = tracking_data_handler -> GetDetectorList();
 
         histM.init();
+        load_moller_strip_design_files();
 #ifdef WRITE_TRACKS_TO_DISK
         log_tracks::open_tracks_text_file();
 #endif
@@ -104,158 +151,198 @@ namespace quality_check_histos
     ///////////////////////////////////////////////////////////////////////////
 
     // data quality check ROOT histograms before tracking
-    void raw_histos(int event_number)
+    // sys: the gem system holding the reconstructed event, a replay thread
+    // passes its own copy; defaults to the one given in pass_handles()
+    void raw_histos(int event_number, GEMSystem *sys)
     {
+        if(sys == nullptr)
+            sys = gem_sys;
         // get all detectors
-        if(!gem_sys) {
+        if(!sys) {
             std::cout<<"Null gem_sys"<<std::endl;
         }
-        std::vector<GEMDetector*> detectors = gem_sys -> GetDetectorList();
+        const std::vector<GEMDetector*> &detectors = sys -> GetDetectorList();
         load_moller_strip_design_files();
 
+        raw_fill_context &ctx = local_raw_context();
+        std::vector<double> &b_timebin = ctx.b_timebin, &b_adc = ctx.b_adc;
+        std::vector<double> &b_mean_time = ctx.b_mean_time, &b_strip = ctx.b_strip;
+        std::vector<const StripCluster*> &x_clusters = ctx.x_clusters, &y_clusters = ctx.y_clusters;
+
         // event number
-        histM.histo_1d<float>("h_event_number") -> Fill((float)event_number);
+        ctx.h_event_number -> Fill((float)event_number);
 
-        // loop through all detectors
-        for(auto &det: detectors)
+        // fill the strip and cluster histograms of one plane, collect its clusters
+        auto fill_plane = [&](GEMPlane *pln, int p, int det_module_id, raw_det_handles &dh,
+                std::vector<const StripCluster*> &clusters)
         {
-            int det_module_id = det -> GetDetID();
-            GEMPlane *pln_x = det -> GetPlane(GEMPlane::Plane_X);
-            GEMPlane *pln_y = det -> GetPlane(GEMPlane::Plane_Y);
-
-            std::vector<StripCluster> x_clusters;
-            std::vector<StripCluster> y_clusters;
-
-            if(pln_x != nullptr) {
-                double x_total_strips = pln_x -> GetCapacity() * 128;
-                const std::vector<StripHit> &x_strip_hits = pln_x -> GetStripHits();
-                int xs = static_cast<int>(x_strip_hits.size());
-
-                // NOTE: X axis is det_module_id. Its range is fixed by
-                // config/histo.conf; module_ids outside that range silently
-                // land in the overflow bin. PRad-II uses 1..6 -- fine.
-                histM.histo_2d<float>(Form("h_raw_fired_strip_plane%d", 0)) -> Fill(det_module_id, xs);
-                histM.histo_2d<float>(Form("h_raw_occupancy_plane%d", 0)) -> Fill(
-                        det_module_id, x_total_strips > 0 ? xs / x_total_strips : 0.);
-                histM.histo_1d<float>(Form("h_raw_fired_strip_det%d_plane%d", det_module_id, 0)) -> Fill(xs);
-
-                for(auto &i: x_strip_hits) {
-                    histM.histo_1d<float>(Form("h_raw_xstrip_maxtimebin_layer%d", det_module_id)) -> Fill(i.max_timebin);
-                    histM.histo_1d<float>(Form("h_raw_xstrip_adc_layer%d", det_module_id)) -> Fill(i.charge);
-                    histM.histo_1d<float>(Form("h_raw_strip_mean_time_x_layer%d", det_module_id)) -> Fill(get_strip_mean_time(i));
-                    histM.histo_2d<float>(Form("h_raw_x_strip_adc_index_layer%d", det_module_id)) -> Fill(i.strip, i.charge);
-                }
-
-                x_clusters = pln_x -> GetStripClusters();
-
-                if(x_clusters.size() > 0)
-                    histM.histo_1d<float>(Form("h_raw_x_cluster_multiplicity_layer%d", det_module_id)) -> Fill(x_clusters.size());
-            }
-            else {
-                histM.histo_2d<float>(Form("h_raw_fired_strip_plane%d", 0)) -> Fill(det_module_id, 0);
-                histM.histo_2d<float>(Form("h_raw_occupancy_plane%d", 0)) -> Fill(det_module_id, 0);
-                histM.histo_1d<float>(Form("h_raw_fired_strip_det%d_plane%d", det_module_id, 0)) -> Fill(0);
+            raw_plane_handles &ph = dh.plane[p];
+            clusters.clear();
+
+            // NOTE: X axis is det_module_id. Its range is fixed by
+            // config/histo.conf; module_ids outside that range silently
+            // land in the overflow bin. PRad-II uses 1..6 -- fine.
+            if(pln == nullptr) {
+                ctx.h_fired_strip_plane[p] -> Fill(det_module_id, 0);
+                ctx.h_occupancy_plane[p] -> Fill(det_module_id, 0);
+                ph.fired_strip -> Fill(0);
+                return;
             }
 
-            if(pln_y != nullptr) {
-                double y_total_strips = pln_y -> GetCapacity() * 128;
-                const std::vector<StripHit> &y_strip_hits = pln_y -> GetStripHits();
-                int ys = static_cast<int>(y_strip_hits.size());
-
-                histM.histo_2d<float>(Form("h_raw_fired_strip_plane%d", 1)) -> Fill(det_module_id, ys);
-                histM.histo_2d<float>(Form("h_raw_occupancy_plane%d", 1)) -> Fill(
-                        det_module_id, y_total_strips > 0 ? ys / y_total_strips : 0.);
-                histM.histo_1d<float>(Form("h_raw_fired_strip_det%d_plane%d", det_module_id, 1)) -> Fill(ys);
-
-                for(auto &i: y_strip_hits) {
-                    histM.histo_1d<float>(Form("h_raw_ystrip_maxtimebin_layer%d", det_module_id)) -> Fill(i.max_timebin);
-                    histM.histo_1d<float>(Form("h_raw_ystrip_adc_layer%d", det_module_id)) -> Fill(i.charge);
-                    histM.histo_1d<float>(Form("h_raw_strip_mean_time_y_layer%d", det_module_id)) -> Fill(get_strip_mean_time(i));
-                    histM.histo_2d<float>(Form("h_raw_y_strip_adc_index_layer%d", det_module_id)) -> Fill(i.strip, i.charge);
+            double total_strips = pln -> GetCapacity() * 128;
+            const std::vector<StripHit> &strip_hits = pln -> GetStripHits();
+            int ns = static_cast<int>(strip_hits.size());
+
+            ctx.h_fired_strip_plane[p] -> Fill(det_module_id, ns);
+            ctx.h_occupancy_plane[p] -> Fill(det_module_id, total_strips > 0 ? ns / total_strips : 0.);
+            ph.fired_strip -> Fill(ns);
+
+            if(ns > 0) {
+                b_timebin.clear(); b_adc.clear(); b_mean_time.clear(); b_strip.clear();
+                for(auto &i: strip_hits) {
+                    b_timebin.push_back(i.max_timebin);
+                    b_adc.push_back(i.charge);
+                    b_mean_time.push_back(get_strip_mean_time(i));
+                    b_strip.push_back(i.strip);
                 }
+                ph.strip_maxtimebin.FillN(b_timebin);
+                ph.strip_adc.FillN(b_adc);
+                ph.strip_mean_time.FillN(b_mean_time);
+                ph.strip_adc_index.FillN(b_strip, b_adc);
+            }
 
-                y_clusters = pln_y -> GetStripClusters();
+            const std::vector<StripCluster> &strip_clusters = pln -> GetStripClusters();
+            if(strip_clusters.size() > 0)
+                ph.cluster_multiplicity -> Fill(strip_clusters.size());
 
-                if(y_clusters.size() > 0)
-                    histM.histo_1d<float>(Form("h_raw_y_cluster_multiplicity_layer%d", det_module_id)) -> Fill(y_clusters.size());
-            }
-            else {
-                histM.histo_2d<float>(Form("h_raw_fired_strip_plane%d", 1)) -> Fill(det_module_id, 0);
-                histM.histo_2d<float>(Form("h_raw_occupancy_plane%d", 1)) -> Fill(det_module_id, 0);
-                histM.histo_1d<float>(Form("h_raw_fired_strip_det%d_plane%d", det_module_id, 1)) -> Fill(0);
+            for(auto &i: strip_clusters) {
+                ph.cluster_adc -> Fill(i.peak_charge);
+                ph.cluster_size -> Fill(i.hits.size());
+                ph.cluster_pos -> Fill(i.position);
+                clusters.push_back(&i);
             }
+        };
+
+        // loop through all detectors
+        for(auto &det: detectors)
+        {
+            int det_module_id = det -> GetDetID();
+            raw_det_handles &dh = get_raw_handles(ctx, det_module_id);
+
+            fill_plane(det -> GetPlane(GEMPlane::Plane_X), 0, det_module_id, dh, x_clusters);
+            fill_plane(det -> GetPlane(GEMPlane::Plane_Y), 1, det_module_id, dh, y_clusters);
 
             // match x-y clusters according to their ADC values (tracking has its own histograms for this, which is more correct)
-            std::sort(x_clusters.begin(), x_clusters.end(), [&](const StripCluster &c1, const StripCluster &c2) {
-                    //return c1.total_charge > c2.total_charge;
-                    return c1.peak_charge > c2.peak_charge;
+            // sort pointers, the clusters themselves are not copied
+            std::sort(x_clusters.begin(), x_clusters.end(), [&](const StripCluster *c1, const StripCluster *c2) {
+                    //return c1->total_charge > c2->total_charge;
+                    return c1->peak_charge > c2->peak_charge;
                     });
-            std::sort(y_clusters.begin(), y_clusters.end(), [&](const StripCluster &c1, const StripCluster &c2) {
-                    //return c1.total_charge > c2.total_charge;
-                    return c1.peak_charge > c2.peak_charge;
+            std::sort(y_clusters.begin(), y_clusters.end(), [&](const StripCluster *c1, const StripCluster *c2) {
+                    //return c1->total_charge > c2->total_charge;
+                    return c1->peak_charge > c2->peak_charge;
                     });
             size_t c_s = x_clusters.size() < y_clusters.size() ? x_clusters.size() : y_clusters.size();
 
             for(size_t i=0; i<c_s; i++) {
-                histM.histo_2d<float>(Form("h_raw_charge_correlation_layer%d", det_module_id)) -> Fill(x_clusters[i].peak_charge, y_clusters[i].peak_charge);
-                histM.histo_2d<float>(Form("h_raw_size_correlation_layer%d", det_module_id)) -> Fill(x_clusters[i].hits.size(), y_clusters[i].hits.size());
-                histM.histo_2d<float>(Form("h_raw_seed_strip_mean_time_corr_layer%d", det_module_id)) -> Fill(get_seed_strip_mean_time(x_clusters[i]), get_seed_strip_mean_time(y_clusters[i]));
+                const StripCluster &xc = *x_clusters[i];
+                const StripCluster &yc = *y_clusters[i];
+
+                dh.charge_correlation -> Fill(xc.peak_charge, yc.peak_charge);
+                dh.size_correlation -> Fill(xc.hits.size(), yc.hits.size());
+                dh.seed_time_correlation -> Fill(get_seed_strip_mean_time(xc), get_seed_strip_mean_time(yc));
 
-				if(det->GetType() == "MOLLERGEM")
+                if(det->GetType() == "MOLLERGEM")
                 {
-					auto &x_strips = x_clusters[i].hits;
-					auto &y_strips = y_clusters[i].hits;
-					bool has_intersect = false;
-					for(auto &x_s_i: x_strips) {
-						int x_s_nb = x_s_i.strip;
-						for(auto &y_s_i: y_strips) {
-							int y_s_nb = y_s_i.strip;
-							bool _tmp_intersect = has_intersect_bot_top(x_s_nb, y_s_nb);
-							if(_tmp_intersect)
-								has_intersect = _tmp_intersect;
-						}
-					}
-					if(has_intersect) {
-						auto p2d = convert_uv_to_xy_moller(x_clusters[i].position, y_clusters[i].position);
-						histM.histo_2d<float>(Form("h_raw_pos_correlation_layer%d", det_module_id)) -> Fill(p2d.first, p2d.second);
-					}
-				}
+                    bool has_intersect = false;
+                    for(auto &x_s_i: xc.hits) {
+                        for(auto &y_s_i: yc.hits) {
+                            if(has_intersect_bot_top(x_s_i.strip, y_s_i.strip))
+                                has_intersect = true;
+                        }
+                    }
+                    if(has_intersect) {
+                        auto p2d = convert_uv_to_xy_moller(xc.position, yc.position);
+                        dh.pos_correlation -> Fill(p2d.first, p2d.second);
+                    }
+                }
                 else if( det -> GetType() == "FITCYLINDRICAL")
                 {
-                    auto p2d = convert_uv_to_xy_fit_cylindrical(x_clusters[i].position, y_clusters[i].position);
+                    auto p2d = convert_uv_to_xy_fit_cylindrical(xc.position, yc.position);
+                    dh.pos_correlation -> Fill(p2d.first, p2d.second);
+                }
+                else if( (det -> GetType() == "INFNXWGEM") || (det -> GetType() == "UVAXWGEM") )
+                {
+                    auto p2d = convert_xw_to_xy_sbs(xc.position, yc.position);
+                    dh.pos_correlation -> Fill(p2d.first, p2d.second);
+                }
+                else {
+                    dh.pos_correlation -> Fill(xc.position, yc.position);
+                }
+            }
+        }
+    }
 
-                    double half_x_length = 365.6/2.; // mm
-                    double half_y_length = 365.6/2.; // mm
+    ///////////////////////////////////////////////////////////////////////////
+    // per-thread raw histogram shards, names are formatted once per detector
+    ///////////////////////////////////////////////////////////////////////////
 
-                    //if( p2d.first < half_x_length && p2d.first > -half_x_length &&
-                    //        p2d.second < half_y_length && p2d.second > -half_y_length)
-                    {
-                        histM.histo_2d<float>(Form("h_raw_pos_correlation_layer%d", det_module_id)) -> Fill(p2d.first, p2d.second);
-                    }
-                }
-				else if( (det -> GetType() == "INFNXWGEM") || (det -> GetType() == "UVAXWGEM") )
-				{
-					auto p2d = convert_xw_to_xy_sbs(x_clusters[i].position, y_clusters[i].position);
-					histM.histo_2d<float>(Form("h_raw_pos_correlation_layer%d", det_module_id)) -> Fill(p2d.first, p2d.second);
-				}
-				else {
-					histM.histo_2d<float>(Form("h_raw_pos_correlation_layer%d", det_module_id)) -> Fill(x_clusters[i].position, y_clusters[i].position);
-				}
-			}
-			// x side clusters
-			for(auto &i: x_clusters) {
-				histM.histo_1d<float>(Form("h_raw_cluster_adc_x_layer%d", det_module_id)) -> Fill(i.peak_charge);
-				histM.histo_1d<float>(Form("h_raw_cluster_size_x_layer%d", det_module_id)) -> Fill(i.hits.size());
-				histM.histo_1d<float>(Form("h_raw_cluster_pos_x_layer%d", det_module_id)) -> Fill(i.position);
-			}
-			// y side clusters
-			for(auto &i: y_clusters) {
-				histM.histo_1d<float>(Form("h_raw_cluster_adc_y_layer%d", det_module_id)) -> Fill(i.peak_charge);
-				histM.histo_1d<float>(Form("h_raw_cluster_size_y_layer%d", det_module_id)) -> Fill(i.hits.size());
-				histM.histo_1d<float>(Form("h_raw_cluster_pos_y_layer%d", det_module_id)) -> Fill(i.position);
-			}
-		}
-	}
+    raw_fill_context &local_raw_context()
+    {
+        thread_local raw_fill_context *ctx = nullptr;
+        if(ctx != nullptr)
+            return *ctx;
+
+        std::lock_guard<std::mutex> lock(raw_contexts_mtx);
+        raw_contexts.emplace_back(new raw_fill_context());
+        ctx = raw_contexts.back().get();
+
+        ctx -> h_event_number = shard_h1(&ctx -> shard, "h_event_number");
+        for(int p=0; p<2; p++) {
+            ctx -> h_fired_strip_plane[p] = shard_h2(&ctx -> shard, Form("h_raw_fired_strip_plane%d", p));
+            ctx -> h_occupancy_plane[p] = shard_h2(&ctx -> shard, Form("h_raw_occupancy_plane%d", p));
+        }
+        return *ctx;
+    }
+
+    raw_det_handles &get_raw_handles(raw_fill_context &ctx, int det_module_id)
+    {
+        auto it = ctx.handles.find(det_module_id);
+        if(it != ctx.handles.end())
+            return it->second;
+
+        histos::HistoShard<> *sh = &ctx.shard;
+        raw_det_handles &dh = ctx.handles[det_module_id];
+        const char *axis[2] = {"x", "y"};
+        for(int p=0; p<2; p++) {
+            const char *a = axis[p];
+            raw_plane_handles &ph = dh.plane[p];
+            ph.fired_strip = shard_h1(sh, Form("h_raw_fired_strip_det%d_plane%d", det_module_id, p));
+            ph.strip_maxtimebin = shard_h1(sh, Form("h_raw_%sstrip_maxtimebin_layer%d", a, det_module_id));
+            ph.strip_adc = shard_h1(sh, Form("h_raw_%sstrip_adc_layer%d", a, det_module_id));
+            ph.strip_mean_time = shard_h1(sh, Form("h_raw_strip_mean_time_%s_layer%d", a, det_module_id));
+            ph.strip_adc_index = shard_h2(sh, Form("h_raw_%s_strip_adc_index_layer%d", a, det_module_id));
+            ph.cluster_multiplicity = shard_h1(sh, Form("h_raw_%s_cluster_multiplicity_layer%d", a, det_module_id));
+            ph.cluster_adc = shard_h1(sh, Form("h_raw_cluster_adc_%s_layer%d", a, det_module_id));
+            ph.cluster_size = shard_h1(sh, Form("h_raw_cluster_size_%s_layer%d", a, det_module_id));
+            ph.cluster_pos = shard_h1(sh, Form("h_raw_cluster_pos_%s_layer%d", a, det_module_id));
+        }
+        dh.charge_correlation = shard_h2(sh, Form("h_raw_charge_correlation_layer%d", det_module_id));
+        dh.size_correlation = shard_h2(sh, Form("h_raw_size_correlation_layer%d", det_module_id));
+        dh.seed_time_correlation = shard_h2(sh, Form("h_raw_seed_strip_mean_time_corr_layer%d", det_module_id));
+        dh.pos_correlation = shard_h2(sh, Form("h_raw_pos_correlation_layer%d", det_module_id));
+
+        return dh;
+    }
+
+    // add all thread shards to the ROOT histograms, call once the
+    // filling threads are done
+    void merge_raw_histos()
+    {
+        std::lock_guard<std::mutex> lock(raw_contexts_mtx);
+        for(auto &ctx: raw_contexts)
+            ctx -> shard.merge_into(histM);
+    }
 
 
 	///////////////////////////////////////////////////////////////////////////
@@ -581,6 +668,7 @@ namespace quality_check_histos
     {
         std::string path = output_file_name + std::string("_data_quality_check.root");
         std::cout<<"Writing data quality check histograms to : "<<path<<std::endl;
+        merge_raw_histos();
         histM.save(path.c_str());
     }
 
@@ -5,10 +5,14 @@
 #include "GEMSystem.h"
 #include "GEMDataHandler.h"
 #include "GEMRootClusterTree.h"
+#include "GEMReplayStats.h"
 #include "TrackingDataHandler.h"
 #include "Tracking.h"
 #include "TrackingUtility.h"
 #include "VirtualDetector.h"
+#include "RolStruct.h"
+#include "Fadc250Decoder.h"
+#include "WfAnalyzer.h"
 
 #define GENERATE_GEM_HISTOS_CXX
 #include "generate_gem_histos.h"
@@ -17,6 +21,8 @@
 
 void fill_tracking_result(tracking_dev::TrackingDataHandler *tracking_data_handler,
         tracking_dev::Tracking *tracking, GEMRootClusterTree *gem_tree);
+int fill_fadc_result(const fdec::Fadc250Event &event, const fdec::Analyzer &analyzer,
+        fdec::Workspace &ws, fdec::Fadc250Data &buffer, GEMRootClusterTree *gem_tree);
 
 int main(int argc, char* argv[])
 {
@@ -36,6 +42,10 @@ int main(int argc, char* argv[])
             "database/CommonModeRange_55.txt");
     arg_parser.AddArgs<std::string>({"--tracking"}, "tracking_switch", " switch on/off tracking",
             "off");
+    arg_parser.AddArgs<std::string>({"--stats"}, "stats_file", "replay timing summary prefix (writes .json and .csv, default: next to the root output)",
+            "");
+    arg_parser.AddArgs<int>({"--stats_interval"}, "stats_interval", "also write a timing row every N events (0 = off)", 0);
+    arg_parser.AddSwitches({"--fadc"}, "fadc", "decode fadc250 banks and save peak time/integral per channel to the cluster tree");
 
     auto args = arg_parser.ParseArgs(argc, argv);
 
@@ -85,7 +95,11 @@ int main(int argc, char* argv[])
     }
     if(args["output_root_path"].String().size() > 0)
         gem_data_handler -> SetOutputPath(args["output_root_path"].String().c_str());
-    gem_data_handler -> SetupReplay(args["raw_data"].String(), 0, -1, args["pedestal_file"].String(), args["common_mode_file"].String());
+    if(!gem_data_handler -> SetupReplay(args["raw_data"].String(), 0, -1, args["pedestal_file"].String(),
+                args["common_mode_file"].String())) {
+        std::cout<<"ERROR:: no valid pedestal for "<<args["raw_data"].String()<<", replay stopped."<<std::endl;
+        return -1;
+    }
     if(args["output_root_filename"].String().size() > 0) {
         if(args["replay_hit"].Bool())
             gem_data_handler -> SetHitRootFileName(args["output_root_filename"].String().c_str());
@@ -121,6 +135,41 @@ int main(int argc, char* argv[])
     quality_check_histos::pass_handles(gem_system, tracking_data_handler);
     quality_check_histos::set_output_name(gem_data_handler -> GetClusterTreeOutputFileName());
 
+    // -: stage timers and counters
+    GEMReplayStats replay_stats;
+    gem_data_handler -> SetReplayStats(&replay_stats);
+    std::string stats_prefix = args["stats_file"].String();
+    if(stats_prefix.size() <= 0)
+        stats_prefix = gem_data_handler -> GetClusterTreeOutputFileName() + "_replay_stats";
+    replay_stats.SetReportInterval(args["stats_interval"].Int(), stats_prefix + "_interval.csv");
+
+    // -: fadc250, its banks are parsed together with the gem banks, the
+    //    waveforms are analyzed right before the cluster tree is filled
+    fdec::Fadc250Decoder *fadc_decoder = nullptr;
+    fdec::Analyzer fadc_analyzer;
+    fdec::Workspace fadc_workspace;
+    fdec::Fadc250Data fadc_buffer;
+    bool fadc_branches = false;
+    if(args["fadc"].Bool()) {
+        std::cout<<"INFO:::: FADC250 is turned on."<<std::endl;
+        if(!args["replay_cluster"].Bool())
+            std::cout<<"WARNING:: FADC250 peaks are only saved in cluster replay mode [-z 1]."<<std::endl;
+
+        fadc_decoder = new fdec::Fadc250Decoder();
+        gem_data_handler -> RegisterRawDecoder(static_cast<int>(Bank_TagID::FADC), fadc_decoder);
+        gem_data_handler -> SetClusterTreeHook([&](GEMRootClusterTree *gem_tree) {
+            // the cluster tree is created with the first event
+            if(!fadc_branches) {
+                gem_tree -> AddFadcBranches();
+                fadc_branches = true;
+            }
+            GEMReplayStats::Timer timer(&replay_stats, GEMReplayStats::FadcAnalysis);
+            int npeaks = fill_fadc_result(fadc_decoder -> GetDecodedEvent(), fadc_analyzer,
+                    fadc_workspace, fadc_buffer, gem_tree);
+            replay_stats.AddCount(GEMReplayStats::FadcPeaks, npeaks);
+        });
+    }
+
     // -: do replay
     auto time_1 = std::chrono::steady_clock::now();
     auto time_2 = std::chrono::steady_clock::now();
@@ -131,12 +180,17 @@ int main(int argc, char* argv[])
     int event_counter = 0;
     const uint32_t *pBuf;
     uint32_t fBufLen;
-    while(evio_reader -> ReadNoCopy(&pBuf, &fBufLen) == S_SUCCESS)
+    while(true)
     {
+        auto read_start = GEMReplayStats::clock::now();
+        if(evio_reader -> ReadNoCopy(&pBuf, &fBufLen) != S_SUCCESS)
+            break;
+
         if(event_counter < start_event) {
             event_counter++;
             continue;
         }
+        replay_stats.AddTime(GEMReplayStats::Read, GEMReplayStats::clock::now() - read_start);
 
         if((event_counter % PROGRESS_COUNT) == 0) {
             time_2 = std::chrono::steady_clock::now();
@@ -151,20 +205,30 @@ int main(int argc, char* argv[])
         gem_data_handler -> EndofThisEvent(event_counter);
 
         // fill data quality check histos
-        quality_check_histos::fill_gem_histos(event_counter - start_event);
+        {
+            GEMReplayStats::Timer timer(&replay_stats, GEMReplayStats::HistoFill);
+            quality_check_histos::fill_gem_histos(event_counter - start_event);
+        }
 
         // fill tracking results
         if(is_tracking_on) {
             // tracking only works on clustering mode
             if(args["replay_cluster"].Bool()) {
                 // tracking process
-                tracking_data_handler -> ClearPrevEvent();
-                tracking_data_handler -> PackageEventData();
-                new_tracking -> FindTracks();
-
+                {
+                    GEMReplayStats::Timer timer(&replay_stats, GEMReplayStats::Tracking);
+                    tracking_data_handler -> ClearPrevEvent();
+                    tracking_data_handler -> PackageEventData();
+                    new_tracking -> FindTracks();
+                }
+                replay_stats.AddCount(GEMReplayStats::TrackCandidates, new_tracking -> GetNCandidatesTested());
+                replay_stats.AddCount(GEMReplayStats::AbortedLayerGroups, new_tracking -> GetNAbortedLayerGroups());
+
+                GEMReplayStats::Timer timer(&replay_stats, GEMReplayStats::TreeFill);
                 fill_tracking_result(tracking_data_handler, new_tracking, gem_data_handler -> GetClusterTree());
             }
         }
+        replay_stats.EndOfEvent();
 
         event_counter++;
         if(max_event > 0 && event_counter > max_event)
@@ -176,6 +240,11 @@ int main(int argc, char* argv[])
     quality_check_histos::generate_tracking_based_2d_efficiency_plots();
     quality_check_histos::save_histos();
 
+    replay_stats.Print(std::cout);
+    std::cout<<"Writing replay timing summary to : "<<stats_prefix<<".json/.csv"<<std::endl;
+    replay_stats.WriteJSON(stats_prefix + ".json");
+    replay_stats.WriteCSV(stats_prefix + ".csv");
+
     return 0;
 }
 
@@ -240,3 +309,31 @@ void fill_tracking_result(tracking_dev::TrackingDataHandler *tracking_data_handl
         (gem_tree->fBestTrackHitIsampMaxVstrip).push_back(p_local.y_max_timebin);
     }
 }
+
+int fill_fadc_result(const fdec::Fadc250Event &event, const fdec::Analyzer &analyzer,
+        fdec::Workspace &ws, fdec::Fadc250Data &buffer, GEMRootClusterTree *gem_tree)
+{
+    gem_tree -> ClearPrevFadc();
+
+    for(size_t ch = 0; ch < event.channels.size(); ch++)
+    {
+        // waveform mode: search the peaks, pulse mode: the module has done it
+        const fdec::Fadc250Data *data = &event.channels[ch];
+        if(!data -> raw.empty()) {
+            buffer.raw.assign(data -> raw.begin(), data -> raw.end());
+            analyzer.Analyze(buffer, ws);
+            data = &buffer;
+        }
+
+        for(auto &peak: data -> peaks) {
+            (gem_tree -> fadcChannel).push_back(static_cast<int>(ch));
+            (gem_tree -> fadcPeakTime).push_back(peak.time);
+            (gem_tree -> fadcPeakIntegral).push_back(peak.integral);
+            (gem_tree -> fadcPeakHeight).push_back(peak.height);
+            (gem_tree -> fadcPedestal).push_back(data -> ped.mean);
+        }
+    }
+
+    gem_tree -> nFadcPeak = static_cast<int>((gem_tree -> fadcChannel).size());
+    return gem_tree -> nFadcPeak;
+}
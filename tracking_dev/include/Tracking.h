@@ -44,6 +44,10 @@ public:
     int GetNGoodTrackCandidates(){return n_good_track_candidates;}
     int GetNTracksFound(){return n_tracks_found;}
     int GetBestTrackIndex(){return best_track_index;}
+    // work counters of the last event: fitted candidates, and layer groups
+    // (or outer hit pairs in grid mode) skipped by the abort quantity cut
+    int GetNCandidatesTested() const {return n_candidates_tested;}
+    int GetNAbortedLayerGroups() const {return n_aborted_layer_groups;}
     const std::vector<double> & GetAllXtrack() const {return v_xtrack;}
     const std::vector<double> & GetAllYtrack() const {return v_ytrack;}
     const std::vector<double> & GetAllXptrack() const {return v_xptrack;}
@@ -147,6 +151,8 @@ private:
     // this number estimate all possible combinations, b/c each combination have the same weight (we don't
     // know how to assign weight to a track).
     int n_good_track_candidates = 0;
+    int n_candidates_tested = 0;
+    int n_aborted_layer_groups = 0;
     std::vector<double> v_xtrack, v_ytrack, v_xptrack, v_yptrack, v_track_chi2ndf;
     std::vector<int> v_track_nhits;
     int n_total_good_hits;
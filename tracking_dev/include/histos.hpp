@@ -17,6 +17,14 @@
 //      2) to fill a histogram:                                               //
 //         histo_manager.hist_1d<float>("hist_name") -> Fill(0.9);            //
 //         histo_manager.hist_2d<float>("hist_name") -> Fill(0.9, 0.9);       //
+//         in hot loops, resolve the name once with histos::Handle            //
+//                                                                            //
+//      3) to fill from several threads, give each thread a HistoShard,       //
+//         which keeps plain array bins with the same config binning, and     //
+//         merge the shards into the manager before saving:                   //
+//         histos::HistoShard<> shard(&histo_manager);                        //
+//         shard.histo_1d<float>("hist_name") -> Fill(0.9);                   //
+//         shard.merge_into(histo_manager);                                   //
 //                                                                            //
 //  the default config file is "config/histo.conf". Config file format:       //
 //                                                                            //
@@ -52,7 +60,10 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
 #include <type_traits>
+#include <memory>
 
 #include <TH1F.h>
 #include <TH2F.h>
@@ -103,7 +114,7 @@ namespace histos
         }
 
         // @param: type = TH1F/TH2F; key=histo_name
-        std::vector<std::string> GetEntry(const std::string &type, const std::string &key)
+        std::vector<std::string> GetEntry(const std::string &type, const std::string &key) const
         {
             std::vector<std::string> res;
 
@@ -342,7 +353,7 @@ namespace histos
         }
 
         // print entries
-        void __print(const std::vector<std::string> &line)
+        void __print(const std::vector<std::string> &line) const
         {
             std::cout<<"size: "<<line.size()<<", ";
             for(auto &i: line)
@@ -431,6 +442,13 @@ namespace histos
             return __histos;
         }
 
+        // config entry of a histogram, read only, safe to call from
+        // several threads once init() is done
+        std::vector<std::string> get_entry(const std::string &type, const std::string &name) const
+        {
+            return text_parser.GetEntry(type, name);
+        }
+
         // build 1d histogram
         // format in : "TH1F, name, title, bins, min, max, title, title"
         TH1F* __build_th1f(const std::vector<std::string> &entry)
@@ -551,6 +569,302 @@ namespace histos
         std::unordered_map<std::string, TH1*> __histos;
         TextParser<> text_parser;
     };
+
+    // plain array binned accumulator, NDim = 1 or 2
+    //
+    // bin layout follows ROOT: global bin = ix + (nx+2)*iy, bin 0 and bin
+    // n+1 of each axis are underflow/overflow. Besides the bins, the same
+    // in-range sums ROOT keeps for the statistics box are accumulated, so
+    // the merged TH1F/TH2F shows the same entries/mean/rms as a direct fill.
+    // The per bin sum of weights squared is kept from the first fill with a
+    // weight != 1 on, as TH1::Fill does, and merged into the ROOT Sumw2.
+    template<int NDim> class BinnedHisto
+    {
+    public:
+        BinnedHisto() {}
+        BinnedHisto(int _nx, double _xlow, double _xhigh, int _ny = 1, double _ylow = 0, double _yhigh = 1)
+            : nx(_nx), ny(NDim == 2 ? _ny : 0), xlow(_xlow), xhigh(_xhigh), ylow(_ylow), yhigh(_yhigh)
+        {
+            bins.assign(static_cast<size_t>(nx + 2) * (ny + 2), 0.);
+        }
+
+        template<int D = NDim>
+            typename std::enable_if<D == 1>::type Fill(double x, double w = 1.)
+        {
+            int ix = __find_bin(x, nx, xlow, xhigh);
+            __add_w2(ix, w);
+            bins[ix] += w;
+            entries++;
+            if(ix > 0 && ix <= nx) {
+                stats[0] += w; stats[1] += w*w;
+                stats[2] += w*x; stats[3] += w*x*x;
+            }
+        }
+
+        template<int D = NDim>
+            typename std::enable_if<D == 2>::type Fill(double x, double y, double w = 1.)
+        {
+            int ix = __find_bin(x, nx, xlow, xhigh);
+            int iy = __find_bin(y, ny, ylow, yhigh);
+            __add_w2(ix + (nx + 2) * iy, w);
+            bins[ix + (nx + 2) * iy] += w;
+            entries++;
+            if(ix > 0 && ix <= nx && iy > 0 && iy <= ny) {
+                stats[0] += w; stats[1] += w*w;
+                stats[2] += w*x; stats[3] += w*x*x;
+                stats[4] += w*y; stats[5] += w*y*y;
+                stats[6] += w*x*y;
+            }
+        }
+
+        // same signatures as TH1::FillN/TH2::FillN, w = nullptr means unit weights
+        void FillN(int n, const double *x, const double *w)
+        {
+            for(int i=0; i<n; i++)
+                Fill(x[i], w ? w[i] : 1.);
+        }
+        void FillN(int n, const double *x, const double *y, const double *w)
+        {
+            for(int i=0; i<n; i++)
+                Fill(x[i], y[i], w ? w[i] : 1.);
+        }
+
+        void Reset()
+        {
+            std::fill(bins.begin(), bins.end(), 0.);
+            sumw2.clear();
+            std::fill(std::begin(stats), std::end(stats), 0.);
+            entries = 0;
+        }
+
+        // add the contents to a ROOT histogram with the same binning,
+        // number of bins and axis range both have to match
+        void AddTo(TH1 *h) const
+        {
+            if(entries == 0)
+                return;
+            if(!__same_axis(h -> GetXaxis(), nx, xlow, xhigh)
+               || (NDim == 2 && !__same_axis(h -> GetYaxis(), ny, ylow, yhigh))) {
+                std::cout<<"ERROR: histo manager: binning mismatch merging into "
+                    <<h -> GetName()<<std::endl;
+                return;
+            }
+
+            double h_entries = h -> GetEntries();
+            double h_stats[TH1::kNstat] = {0};
+            h -> GetStats(h_stats);
+
+            // before the contents are added, TH1::Sumw2 starts from them
+            if(!sumw2.empty() && h -> GetSumw2N() == 0)
+                h -> Sumw2();
+            if(h -> GetSumw2N() > 0) {
+                double *h_w2 = h -> GetSumw2() -> GetArray();
+                const std::vector<double> &w2 = sumw2.empty() ? bins : sumw2;
+                for(size_t bin=0; bin<w2.size(); bin++)
+                    h_w2[bin] += w2[bin];
+            }
+
+            for(size_t bin=0; bin<bins.size(); bin++)
+                if(bins[bin] != 0.)
+                    h -> AddBinContent(static_cast<int>(bin), bins[bin]);
+
+            for(int i=0; i<7; i++)
+                h_stats[i] += stats[i];
+            h -> PutStats(h_stats);
+            h -> SetEntries(h_entries + entries);
+        }
+
+        double GetEntries() const {return entries;}
+
+    private:
+        // same convention as TAxis::FindFixBin, NaN goes to underflow
+        static int __find_bin(double v, int n, double low, double high)
+        {
+            if(!(v >= low))
+                return 0;
+            if(!(v < high))
+                return n + 1;
+            return 1 + static_cast<int>(n * (v - low) / (high - low));
+        }
+
+        // the edges of both sides come from the same config entry, a
+        // mismatch beyond rounding means another booking of the histogram
+        static bool __same_axis(const TAxis *a, int n, double low, double high)
+        {
+            double tol = 1e-6 * (high - low) / n;
+            return a -> GetNbins() == n && std::abs(a -> GetXmin() - low) <= tol
+                && std::abs(a -> GetXmax() - high) <= tol;
+        }
+
+        // unit weights only: sum of weights squared = contents, not stored
+        void __add_w2(int bin, double w)
+        {
+            if(sumw2.empty()) {
+                if(w == 1.)
+                    return;
+                sumw2 = bins;
+            }
+            sumw2[bin] += w*w;
+        }
+
+    private:
+        int nx = 0, ny = 0;
+        double xlow = 0, xhigh = 1, ylow = 0, yhigh = 1;
+        std::vector<double> bins;
+        std::vector<double> sumw2;  // empty while all weights are 1
+        double stats[7] = {0};  // sumw, sumw2, sumwx, sumwx2, sumwy, sumwy2, sumwxy
+        double entries = 0;
+    };
+
+    typedef BinnedHisto<1> BinnedHisto1D;
+    typedef BinnedHisto<2> BinnedHisto2D;
+
+    // a per-thread set of binned accumulators, built lazily from the
+    // manager's config entries. Only the owning thread fills a shard, so
+    // filling takes no lock; merge_into() is called once all fills are done.
+    template<typename ThistShard=std::string> class HistoShard
+    {
+    public:
+        HistoShard(const HistoManager<> *m) : manager(m) {}
+
+        HistoShard(const HistoShard &) = delete;
+        HistoShard &operator=(const HistoShard &) = delete;
+
+        template<typename H>
+            typename std::enable_if<std::is_same<H, float>::value, BinnedHisto1D*>::type histo_1d(const char* name)
+            {
+                auto it = __histos_1d.find(name);
+                if(it != __histos_1d.end())
+                    return it -> second.get();
+
+                std::vector<std::string> entry = manager -> get_entry("TH1F", name);
+                int nbins = 100;
+                double low = 0, high = 0;
+                try {
+                    nbins = stoi(entry[3]);
+                    low = stod(entry[4]);
+                    high = stod(entry[5]);
+                }catch(...){
+                    std::cout<<"ERROR: failed to convert string to int/float"<<std::endl;
+                }
+
+                BinnedHisto1D *h = new BinnedHisto1D(nbins, low, high);
+                __histos_1d[name].reset(h);
+                return h;
+            }
+
+        template<typename H>
+            typename std::enable_if<std::is_same<H, float>::value, BinnedHisto2D*>::type histo_2d(const char* name)
+            {
+                auto it = __histos_2d.find(name);
+                if(it != __histos_2d.end())
+                    return it -> second.get();
+
+                std::vector<std::string> entry = manager -> get_entry("TH2F", name);
+                int xbins = 100, ybins = 100;
+                double xlow = 0, ylow = 0, xhigh = 0, yhigh = 0;
+                try{
+                    xbins = stoi(entry[3]), ybins = stoi(entry[6]);
+                    xlow = stod(entry[4]), ylow = stod(entry[7]);
+                    xhigh = stod(entry[5]), yhigh = stod(entry[8]);
+                }catch(...){
+                    std::cout<<"ERROR: failed to convert string to int/float"<<std::endl;
+                }
+
+                BinnedHisto2D *h = new BinnedHisto2D(xbins, xlow, xhigh, ybins, ylow, yhigh);
+                __histos_2d[name].reset(h);
+                return h;
+            }
+
+        // add all accumulated contents to the ROOT histograms of the manager
+        // and clear the shard, single threaded
+        void merge_into(HistoManager<> &m)
+        {
+            for(auto &i: __histos_1d) {
+                i.second -> AddTo(m.template histo_1d<float>(i.first.c_str()));
+                i.second -> Reset();
+            }
+            for(auto &i: __histos_2d) {
+                i.second -> AddTo(m.template histo_2d<float>(i.first.c_str()));
+                i.second -> Reset();
+            }
+        }
+
+        void reset()
+        {
+            for(auto &i: __histos_1d)
+                i.second -> Reset();
+            for(auto &i: __histos_2d)
+                i.second -> Reset();
+        }
+
+    private:
+        const HistoManager<> *manager = nullptr;
+        std::unordered_map<std::string, std::unique_ptr<BinnedHisto1D>> __histos_1d;
+        std::unordered_map<std::string, std::unique_ptr<BinnedHisto2D>> __histos_2d;
+    };
+
+    // dimension of a histogram type usable with Handle
+    template<typename THisto> struct histo_dim { static constexpr int value = 1; };
+    template<> struct histo_dim<TH2F> { static constexpr int value = 2; };
+    template<> struct histo_dim<BinnedHisto2D> { static constexpr int value = 2; };
+
+    // pre-resolved histogram handle, THisto = TH1F or TH2F
+    //
+    // the histogram name is formatted once when the handle is made, the
+    // histogram itself is looked up in the manager on first use only, so
+    // histograms that are never filled are still never created.
+    //
+    //     histos::Handle<TH1F> h(&histo_manager, "h_name");
+    //     h -> Fill(0.9);          // no string formatting, no map lookup
+    //     h.FillN(values);         // batched fill from a buffer
+    //
+    // with TSource = HistoShard<>, THisto = BinnedHisto1D or BinnedHisto2D
+    template<typename THisto, typename TSource = HistoManager<>> class Handle
+    {
+    public:
+        Handle() {}
+        Handle(TSource *m, const std::string &n)
+            : manager(m), name(n)
+        {}
+
+        THisto *get()
+        {
+            if(histo == nullptr)
+                histo = __resolve();
+            return histo;
+        }
+        THisto *operator->() {return get();}
+
+        // batched fills, the buffers are left untouched
+        void FillN(const std::vector<double> &x)
+        {
+            static_assert(histo_dim<THisto>::value == 1, "FillN(x) is for 1D histograms");
+            if(x.size() > 0)
+                get() -> FillN(static_cast<int>(x.size()), x.data(), nullptr);
+        }
+        void FillN(const std::vector<double> &x, const std::vector<double> &y)
+        {
+            static_assert(histo_dim<THisto>::value == 2, "FillN(x, y) is for 2D histograms");
+            size_t n = x.size() < y.size() ? x.size() : y.size();
+            if(n > 0)
+                get() -> FillN(static_cast<int>(n), x.data(), y.data(), nullptr);
+        }
+
+    private:
+        THisto *__resolve()
+        {
+            if constexpr (histo_dim<THisto>::value == 1)
+                return manager -> template histo_1d<float>(name.c_str());
+            else
+                return manager -> template histo_2d<float>(name.c_str());
+        }
+
+    private:
+        TSource *manager = nullptr;
+        std::string name;
+        THisto *histo = nullptr;
+    };
 };
 
 #endif
@@ -125,6 +125,8 @@ void Tracking::ClearPreviousEvent()
     best_hits_on_track.clear();
 
     n_good_track_candidates =  0;
+    n_candidates_tested = 0;
+    n_aborted_layer_groups = 0;
     n_tracks_found = 0;
     v_xtrack.clear(), v_ytrack.clear(), v_xptrack.clear(), v_yptrack.clear();
     v_track_chi2ndf.clear();
@@ -379,7 +381,10 @@ void Tracking::nextLayerGroup_gridway(const std::vector<int> &group)
     int E = (int)detector.at(end_layer) -> Get2DHitCounts();
 
     // if possible combinations in outter layers already passed max quantity, abort tracking
-    if(S * E > abort_quantity || S * E <= 0) return;
+    if(S * E > abort_quantity || S * E <= 0) {
+        if(S * E > abort_quantity) n_aborted_layer_groups++;
+        return;
+    }
 
     for(int start_layer_hit_index=0; start_layer_hit_index<S; start_layer_hit_index++)
     {
@@ -413,8 +418,10 @@ void Tracking::scanCandidate_gridway(const int &start_layer, const int &start_la
     for(auto &i: middle_layers)
         possible_track_combinations *= (hit_index_by_layer.at(i).size());
 
-    if(possible_track_combinations > abort_quantity || possible_track_combinations <= 0)
+    if(possible_track_combinations > abort_quantity || possible_track_combinations <= 0) {
+        if(possible_track_combinations > abort_quantity) n_aborted_layer_groups++;
         return;
+    }
 
     std::vector<int> layer_combo{start_layer, end_layer};
     std::vector<int> hit_combo{start_layer_hit_index, end_layer_hit_index};
@@ -579,6 +586,7 @@ void Tracking::nextTrackCandidate(const std::vector<point_t> &hits)
     double xtrack, ytrack, xptrack, yptrack, chi2ndf;
     std::vector<double> xresid, yresid;
 
+    n_candidates_tested++;
     tracking_utility -> FitLine(hits, xtrack, ytrack, xptrack, yptrack,
             chi2ndf, xresid, yresid);
 